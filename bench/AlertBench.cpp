@@ -0,0 +1,225 @@
+#include "Bench.h"
+#include "AlertRules.h"
+#include "DeviceTable.h"
+#include "StringPool.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Alert rules at fleet scale. Alerts_Evaluate_1k_x_2k runs 1,000 rules over
+// 2,048 devices whose levels all change every op, so every rule runs for
+// every device; one op is one evaluate(), evalsPerSecond counts rule
+// programs run. Alerts_Unchanged_10k leaves the readings of 10,000 devices
+// alone: what a refresh without changes costs (the change check over every
+// device, independent of the number of rules). Alerts_Compile_1k compiles
+// the rules.
+//
+// Alerts_Semantics steps one device through a script of readings and fails
+// unless exactly the expected rules fire at each step (hysteresis, cooldown,
+// drop(), globs, time of day, readings without a level), and checks that
+// malformed expressions are rejected.
+
+namespace {
+    // Five kinds of rule, thresholds spread over the level range
+    std::vector<AlertRule> makeRules(size_t count) {
+        std::vector<AlertRule> rules;
+        char when[160];
+        for (size_t i = 0; i < count; i++) {
+            int threshold = static_cast<int>(i % 100);
+            switch (i % 5) {
+                case 0:
+                    std::snprintf(when, sizeof(when), "connected && level < %d", threshold);
+                    break;
+                case 1:
+                    std::snprintf(when, sizeof(when), "name ~ 'Razer*' && level <= %d", threshold);
+                    break;
+                case 2:
+                    std::snprintf(when, sizeof(when), "drop(1h) > %d", threshold % 20);
+                    break;
+                case 3:
+                    std::snprintf(when, sizeof(when),
+                                  "level < %d && hour >= 9 && hour < 17 && weekday >= 1 && weekday <= 5", threshold);
+                    break;
+                default:
+                    std::snprintf(when, sizeof(when), "id ~ '*%02zX' || !connected && level > %d", i % 256, threshold);
+                    break;
+            }
+            rules.push_back({"rule " + std::to_string(i), when, 2, 3600});
+        }
+        return rules;
+    }
+
+    struct Fleet {
+        StringPool strings;
+        DeviceTable table;
+    };
+
+    std::unique_ptr<Fleet> makeFleet(size_t count) {
+        auto fleet = std::make_unique<Fleet>();
+        fleet->table.reserve(count);
+        char name[64];
+        char instanceId[64];
+        for (size_t i = 0; i < count; i++) {
+            std::snprintf(name, sizeof(name), i % 2 == 0 ? "Razer Device %zu" : "Mouse %zu", i);
+            std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\DEV_%012zX", i);
+            fleet->table.add(fleet->strings.intern(name), fleet->strings.intern(instanceId));
+        }
+        return fleet;
+    }
+
+    // Every device moves one point (and a few change connection)
+    void step(DeviceTable& table, uint64_t pass) {
+        for (DeviceTable::Row row = 0; row < table.size(); row++) {
+            int level = static_cast<int>((row + pass) % 101);
+            table.update(row, level, (row + pass) % 16 != 0, static_cast<int64_t>(pass));
+        }
+    }
+
+    constexpr AlertRules::Moment WORK_HOURS = {0, 10, 3};
+
+    void Alerts_Compile_1k(Bench::State& state) {
+        std::vector<AlertRule> rules = makeRules(1000);
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            AlertRules compiled(rules, false);
+            Bench::doNotOptimize(compiled);
+        }
+    }
+
+    // Rules, devices and alert state, built once per process: the first
+    // evaluation of a large fleet runs every rule for every device
+    struct Workload {
+        AlertRules rules;
+        std::unique_ptr<Fleet> fleet;
+        AlertRules::State alertState;
+        AlertRules::Moment moment = WORK_HOURS;
+        uint64_t pass = 0;
+
+        Workload(size_t ruleCount, size_t deviceCount)
+            : rules(makeRules(ruleCount), false)
+            , fleet(makeFleet(deviceCount))
+        {
+            step(fleet->table, 0);
+            rules.evaluate(fleet->table, fleet->strings, moment, alertState, nullptr);
+        }
+    };
+
+    void evaluateFleet(Bench::State& state, Workload& workload, bool changing) {
+        uint64_t alerts = 0;
+        AlertRules::OnAlert onAlert = [&](const AlertRules::Alert&) { alerts++; };
+        uint64_t before = workload.alertState.evaluations();
+        auto started = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            if (changing) {
+                workload.pass++;
+                step(workload.fleet->table, workload.pass);
+                workload.moment.now = static_cast<int64_t>(workload.pass) * 60;
+            }
+            workload.rules.evaluate(workload.fleet->table, workload.fleet->strings, workload.moment,
+                                    workload.alertState, onAlert);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        uint64_t evaluations = workload.alertState.evaluations() - before;
+        state.counter("evalsPerOp", static_cast<double>(evaluations) / static_cast<double>(state.iterations()));
+        if (changing && seconds > 0) {
+            state.counter("evalsPerSecond", static_cast<double>(evaluations) / seconds);
+        }
+        state.counter("alertsPerOp", static_cast<double>(alerts) / static_cast<double>(state.iterations()));
+        state.counter("stateKB", static_cast<double>(workload.alertState.memoryUsage()) / 1024.0);
+        if (!changing && evaluations != 0) {
+            state.fail("rules ran for devices that did not change");
+        }
+    }
+
+    void Alerts_Evaluate_1k_x_2k(Bench::State& state) {
+        static Workload workload(1000, 2048);
+        evaluateFleet(state, workload, true);
+    }
+
+    void Alerts_Unchanged_10k(Bench::State& state) {
+        static Workload workload(100, 10000);
+        evaluateFleet(state, workload, false);
+    }
+
+    struct Reading {
+        int64_t time;
+        std::optional<int> level;
+        bool connected;
+        std::vector<uint32_t> fired;
+    };
+
+    void Alerts_Semantics(Bench::State& state) {
+        const std::vector<AlertRule> ruleList = {
+            {"low", "level < 20", 5, 0},
+            {"low, cooldown", "level < 20", 0, 100},
+            {"falling", "drop(1h) >= 10", 2, 0},
+            {"razer", "name ~ 'razer*' && id ~ 'bthle*' && connected", 0, 0},
+            {"gone", "!connected", 0, 0},
+            {"work hours", "hour >= 9 && hour < 17 && level < 15", 0, 0},
+        };
+        const std::vector<Reading> script = {
+            {0, 50, true, {3}},
+            {10, 19, true, {0, 1, 2}},
+            {20, 21, true, {}},         // within the hysteresis of "low"
+            {30, 19, true, {}},         // "low, cooldown" re-armed but cooling down
+            {40, 25, true, {}},
+            {50, 18, true, {0}},
+            {200, 18, false, {4}},
+            {4000, 18, true, {3}},      // "falling": the last change is over an hour old
+            {4010, 17, true, {}},
+            {4020, 30, true, {}},
+            {4030, 10, true, {0, 1, 2, 5}},
+            {4040, std::nullopt, true, {}},
+            {4050, 10, true, {}},
+        };
+        const char* malformed[] = {
+            "", "level <", "level < 20 < 30", "levle < 20", "drop(0) > 5", "drop(1d) > 5", "name ~ Razer*",
+            "name ~ 'Razer*", "(level < 20", "level < 20)", "level < 99999999999", "connected &&",
+        };
+
+        std::string error;
+        for (const char* expression : malformed) {
+            if (AlertRules::check(expression, error)) {
+                state.fail(std::string("accepted \"") + expression + "\"");
+                return;
+            }
+        }
+        std::string nested = std::string(100, '(') + "level" + std::string(100, ')');
+        if (AlertRules::check(nested, error)) {
+            state.fail("accepted 100 nested parentheses");
+            return;
+        }
+        for (const AlertRule& rule : ruleList) {
+            if (!AlertRules::check(rule.when, error)) {
+                state.fail("rejected \"" + rule.when + "\": " + error);
+                return;
+            }
+        }
+
+        AlertRules rules(ruleList, true);
+        Fleet fleet;
+        fleet.table.add(fleet.strings.intern("Razer Basilisk"), fleet.strings.intern("BTHLE\\DEV_C8A2D3E4F501"));
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            AlertRules::State alertState;
+            for (const Reading& reading : script) {
+                fleet.table.update(0, reading.level, reading.connected, reading.time);
+                std::vector<uint32_t> fired;
+                AlertRules::Moment moment = {reading.time, 10, 3};
+                rules.evaluate(fleet.table, fleet.strings, moment, alertState,
+                               [&](const AlertRules::Alert& alert) { fired.push_back(alert.rule); });
+                if (fired != reading.fired) {
+                    state.fail("wrong rules fired at t=" + std::to_string(reading.time));
+                    return;
+                }
+            }
+        }
+    }
+
+    BENCHMARK(Alerts_Compile_1k);
+    BENCHMARK(Alerts_Evaluate_1k_x_2k);
+    BENCHMARK(Alerts_Unchanged_10k);
+    BENCHMARK(Alerts_Semantics);
+}
@@ -0,0 +1,242 @@
+#include "Bench.h"
+#include "JsonReader.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+
+namespace {
+    struct Entry {
+        const char* name;
+        Bench::Function function;
+    };
+
+    std::vector<Entry>& registry() {
+        static std::vector<Entry> entries;
+        return entries;
+    }
+
+    // Runs shorter than this are repeated with more iterations
+    constexpr double MIN_RUN_SECONDS = 0.2;
+
+    // Default slowdown (percent over the baseline) reported as a regression
+    constexpr double DEFAULT_THRESHOLD_PERCENT = 10.0;
+
+    struct Options {
+        std::vector<const char*> filters;
+        const char* jsonPath = nullptr;
+        const char* baselinePath = nullptr;
+        double thresholdPercent = DEFAULT_THRESHOLD_PERCENT;
+    };
+
+    struct Result {
+        std::string name;
+        uint64_t iterations;
+        double nsPerOp;
+        double megabytesPerSecond;  // 0 when the benchmark reports no bytes
+        std::vector<std::pair<std::string, double>> counters;
+        std::string failure;
+    };
+
+    bool parseOptions(int argc, char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            auto value = [&]() -> const char* {
+                return i + 1 < argc ? argv[++i] : nullptr;
+            };
+            if (std::strcmp(argv[i], "--json") == 0) {
+                if (!(options.jsonPath = value())) return false;
+            } else if (std::strcmp(argv[i], "--compare") == 0) {
+                if (!(options.baselinePath = value())) return false;
+            } else if (std::strcmp(argv[i], "--threshold") == 0) {
+                const char* percent = value();
+                if (!percent) return false;
+                options.thresholdPercent = std::atof(percent);
+            } else {
+                options.filters.push_back(argv[i]);
+            }
+        }
+        return true;
+    }
+
+    bool matchesFilters(const char* name, const std::vector<const char*>& filters) {
+        if (filters.empty()) return true;
+        for (const char* filter : filters) {
+            if (std::strstr(name, filter) != nullptr) return true;
+        }
+        return false;
+    }
+
+    Result run(const Entry& entry) {
+        uint64_t iterations = 1;
+        double seconds = 0;
+        Bench::State result(iterations);
+        while (true) {
+            Bench::State state(iterations);
+            auto start = std::chrono::steady_clock::now();
+            entry.function(state);
+            auto end = std::chrono::steady_clock::now();
+            seconds = std::chrono::duration<double>(end - start).count();
+            result = std::move(state);
+            if (!result.failure.empty()) break;
+            if (seconds >= MIN_RUN_SECONDS || iterations >= (1ull << 40)) break;
+            iterations *= (seconds < MIN_RUN_SECONDS / 10) ? 10 : 2;
+        }
+
+        return {
+            entry.name,
+            iterations,
+            seconds * 1e9 / static_cast<double>(iterations),
+            result.bytesProcessed != 0 ? result.bytesProcessed / seconds / 1e6 : 0.0,
+            std::move(result.counters),
+            std::move(result.failure),
+        };
+    }
+
+    std::string toJson(const std::vector<Result>& results) {
+        std::string json = "{\n  \"benchmarks\": [";
+        char buffer[96];
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& result = results[i];
+            json += i > 0 ? ",\n    { \"name\": " : "\n    { \"name\": ";
+            appendJsonString(json, result.name);
+            if (!result.failure.empty()) {
+                json += ", \"failure\": ";
+                appendJsonString(json, result.failure);
+                json += " }";
+                continue;
+            }
+            std::snprintf(buffer, sizeof(buffer), ", \"iterations\": %llu, \"nsPerOp\": %.17g",
+                          static_cast<unsigned long long>(result.iterations), result.nsPerOp);
+            json += buffer;
+            if (result.megabytesPerSecond != 0) {
+                std::snprintf(buffer, sizeof(buffer), ", \"MBps\": %.17g", result.megabytesPerSecond);
+                json += buffer;
+            }
+            json += ", \"counters\": {";
+            for (size_t c = 0; c < result.counters.size(); c++) {
+                json += c > 0 ? ", " : " ";
+                appendJsonString(json, result.counters[c].first);
+                std::snprintf(buffer, sizeof(buffer), ": %.17g", result.counters[c].second);
+                json += buffer;
+            }
+            json += result.counters.empty() ? "} }" : " } }";
+        }
+        json += "\n  ]\n}\n";
+        return json;
+    }
+
+    // name -> ns/op from a file written with --json
+    std::optional<std::map<std::string, double>> loadBaseline(const char* path) {
+        MappedFile file{std::filesystem::path(path)};
+        if (!file.isValid()) {
+            std::fprintf(stderr, "cannot read baseline %s\n", path);
+            return std::nullopt;
+        }
+
+        std::map<std::string, double> baseline;
+        JsonReader reader(file.contents());
+        bool ok = reader.readObject([&](std::string_view key) {
+            if (key != "benchmarks") return reader.skipValue();
+            return reader.readArray([&]() {
+                std::string name;
+                double nsPerOp = 0;
+                bool ok = reader.readObject([&](std::string_view field) {
+                    if (field == "name") return reader.readString(name);
+                    if (field == "nsPerOp") return reader.readDouble(nsPerOp);
+                    return reader.skipValue();
+                });
+                if (ok && !name.empty() && nsPerOp > 0) baseline[name] = nsPerOp;
+                return ok;
+            });
+        }) && reader.finish();
+
+        if (!ok) {
+            const JsonError& error = *reader.error();
+            std::fprintf(stderr, "%s:%zu:%zu: %s\n", path, error.line, error.column, error.message.c_str());
+            return std::nullopt;
+        }
+        return baseline;
+    }
+
+    // Print current against baseline; returns the number of regressions
+    int compare(const std::vector<Result>& results, const std::map<std::string, double>& baseline,
+                double thresholdPercent) {
+        std::printf("\n%-40s %14s %14s %9s\n", "comparison", "baseline ns", "current ns", "change");
+        int regressions = 0;
+        for (const Result& result : results) {
+            auto it = baseline.find(result.name);
+            if (!result.failure.empty() || it == baseline.end()) {
+                std::printf("%-40s %14s\n", result.name.c_str(), it == baseline.end() ? "(new)" : "(failed)");
+                continue;
+            }
+            double change = (result.nsPerOp / it->second - 1.0) * 100.0;
+            bool regressed = change > thresholdPercent;
+            regressions += regressed ? 1 : 0;
+            std::printf("%-40s %14.2f %14.2f %+8.1f%%%s\n", result.name.c_str(), it->second, result.nsPerOp,
+                        change, regressed ? "  REGRESSION" : "");
+        }
+        std::printf("%d regression(s) over %.1f%%\n", regressions, thresholdPercent);
+        return regressions;
+    }
+}
+
+Bench::Registration::Registration(const char* name, Function function) {
+    registry().push_back({name, function});
+}
+
+int Bench::runAll(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "usage: razertray_bench [--json out.json] [--compare baseline.json] "
+                             "[--threshold percent] [filter...]\n");
+        return 2;
+    }
+
+    std::optional<std::map<std::string, double>> baseline;
+    if (options.baselinePath) {
+        baseline = loadBaseline(options.baselinePath);
+        if (!baseline) return 2;
+    }
+
+    std::printf("%-40s %14s %16s  %s\n", "benchmark", "ns/op", "ops/s", "counters");
+    std::vector<Result> results;
+    int failures = 0;
+
+    for (const Entry& entry : registry()) {
+        if (!matchesFilters(entry.name, options.filters)) continue;
+
+        Result result = run(entry);
+        if (!result.failure.empty()) {
+            std::printf("%-40s FAILED: %s\n", entry.name, result.failure.c_str());
+            failures++;
+        } else {
+            std::printf("%-40s %14.2f %16.0f ", entry.name, result.nsPerOp, 1e9 / result.nsPerOp);
+            if (result.megabytesPerSecond != 0) {
+                std::printf(" MB/s=%.1f", result.megabytesPerSecond);
+            }
+            for (const auto& [name, value] : result.counters) {
+                std::printf(" %s=%.6g", name.c_str(), value);
+            }
+            std::printf("\n");
+        }
+        std::fflush(stdout);
+        results.push_back(std::move(result));
+    }
+
+    if (options.jsonPath) {
+        std::ofstream out(options.jsonPath, std::ios::binary);
+        out << toJson(results);
+        if (!out) {
+            std::fprintf(stderr, "cannot write %s\n", options.jsonPath);
+            failures++;
+        }
+    }
+
+    int regressions = baseline ? compare(results, *baseline, options.thresholdPercent) : 0;
+    return failures == 0 && regressions == 0 ? 0 : 1;
+}
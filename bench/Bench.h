@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal micro-benchmark harness for razertray_bench.
+// Each benchmark is a function taking a State; it runs its measured loop
+// state.iterations() times and may attach extra counters. The harness grows
+// the iteration count until a run takes long enough to time reliably.
+namespace Bench {
+    class State {
+    public:
+        explicit State(uint64_t iterations) : iterationCount(iterations) {}
+
+        uint64_t iterations() const { return iterationCount; }
+
+        // Report bytes handled by the whole run (shown as MB/s)
+        void setBytesProcessed(uint64_t bytes) { bytesProcessed = bytes; }
+
+        // Attach an extra named value to the result (e.g. memory footprint)
+        void counter(std::string name, double value) {
+            counters.emplace_back(std::move(name), value);
+        }
+
+        // Mark the run as failed (validation benchmarks); razertray_bench
+        // then exits non-zero
+        void fail(std::string message) {
+            if (failure.empty()) failure = std::move(message);
+        }
+
+        uint64_t bytesProcessed = 0;
+        std::vector<std::pair<std::string, double>> counters;
+        std::string failure;
+
+    private:
+        uint64_t iterationCount;
+    };
+
+    using Function = void (*)(State&);
+
+    // Registers a benchmark at static-initialization time (see BENCHMARK)
+    struct Registration {
+        Registration(const char* name, Function function);
+    };
+
+    // Keep the optimizer from discarding a computed value
+    template<typename T>
+    inline void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    // Run all registered benchmarks whose name contains one of the filters.
+    // --json <path> also writes the results as JSON; --compare <baseline>
+    // compares ns/op against such a file and fails on any benchmark more
+    // than --threshold percent (default 10) slower.
+    int runAll(int argc, char** argv);
+}
+
+#define BENCHMARK(function) \
+    static Bench::Registration function##Registration(#function, function)
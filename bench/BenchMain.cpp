@@ -0,0 +1,9 @@
+#include "Bench.h"
+
+// razertray_bench [--json out.json] [--compare baseline.json] [--threshold percent] [filter...]
+// Runs every registered benchmark, or only those whose name contains one of
+// the given filters. Exits non-zero if a benchmark fails its validation or,
+// with --compare, regresses against the baseline.
+int main(int argc, char** argv) {
+    return Bench::runAll(argc, argv);
+}
@@ -0,0 +1,413 @@
+#include "Bench.h"
+#include "Collector.h"
+#include "CollectorAgent.h"
+#include "CollectorProtocol.h"
+#include "DeviceTable.h"
+#include "StringPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// The multi-host collector. Every desk is an in-process CollectorAgent with
+// its own device table, and every op changes the level of each of its
+// devices, so one op is desks * devices updates.
+// Collector_Push_64x64 encodes each desk's batch and hands the datagrams
+// straight to Collector::receive (no sockets); applyUpdatesPerSec counts
+// the collector's side alone. Collector_Loopback_16x64 runs the real
+// thing on 127.0.0.1: 16 agents with their own sockets and receive threads
+// push to a listening collector, and an op ends when the collector has
+// applied every desk's last datagram (pushing a snapshot again whenever it
+// asked for one). Collector_GapRecovery drops a datagram every op and
+// checks that the RESYNC / snapshot round trip restores the desk. All
+// three compare the collector's view with the desks' tables afterwards.
+// Collector_Limits (one op: one fresh collector taken through it) fails if
+// a device index past the snapshot's index limit is applied, a desk whose
+// devices outgrow the limit is not brought back by a new snapshot, a host
+// renaming its devices batch after batch holds more than about
+// Collector::MAX_HOST_STRING_BYTES of strings (or keeps them past its next
+// snapshot), more than Collector::MAX_HOSTS hosts are kept, or a silent
+// host outlives Collector::HOST_TIMEOUT_SECONDS.
+
+namespace {
+    constexpr int64_t EPOCH = 1'700'000'000;
+
+    // One machine's devices and its agent
+    struct Desk {
+        Desk(std::string name, size_t count, std::string_view collector = {})
+            : agent(std::make_unique<CollectorAgent>(std::move(name), collector)) {
+            for (size_t i = 0; i < count; i++) {
+                char deviceName[64];
+                char instanceId[64];
+                std::snprintf(deviceName, sizeof(deviceName), "Razer Device %05zu", i);
+                std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\DEV_%012zX\\7&1A2B3C&0&0", 0xC8A2D3000000 + i);
+                DeviceTable::Row row = devices.add(strings.intern(deviceName), strings.intern(instanceId));
+                rows.emplace(instanceId, row);
+            }
+            step(0);
+        }
+
+        // Every device reports a new level; every fifth is disconnected
+        void step(uint64_t round) {
+            for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+                devices.update(row, static_cast<int>((row + round) % 101), (row + round) % 5 != 0,
+                               EPOCH + static_cast<int64_t>(round));
+            }
+        }
+
+        StringPool strings;
+        DeviceTable devices;
+        std::unordered_map<std::string, DeviceTable::Row> rows;
+        std::unique_ptr<CollectorAgent> agent;
+    };
+
+    std::vector<std::unique_ptr<Desk>> makeDesks(size_t count, size_t devices, std::string_view collector = {}) {
+        std::vector<std::unique_ptr<Desk>> desks;
+        for (size_t i = 0; i < count; i++) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "desk-%03zu", i);
+            desks.push_back(std::make_unique<Desk>(name, devices, collector));
+        }
+        return desks;
+    }
+
+    // Empty if the collector holds exactly the desks' devices and states
+    std::string compare(const Collector& collector, const std::vector<std::unique_ptr<Desk>>& desks) {
+        std::map<std::string, const Desk*, std::less<>> byHost;
+        size_t expected = 0;
+        for (const auto& desk : desks) {
+            byHost.emplace(desk->agent->hostName(), desk.get());
+            expected += desk->devices.size();
+            if (collector.sequence(desk->agent->hostName()).value_or(0) != desk->agent->sequence()) {
+                return desk->agent->hostName() + " is behind";
+            }
+        }
+        size_t seen = 0;
+        std::string mismatch;
+        collector.forEachDevice([&](const Collector::Device& device) {
+            seen++;
+            auto host = byHost.find(device.host);
+            if (!mismatch.empty()) return;
+            if (host == byHost.end()) {
+                mismatch = "unknown host " + std::string(device.host);
+                return;
+            }
+            const Desk& desk = *host->second;
+            auto row = desk.rows.find(std::string(device.instanceId));
+            if (row == desk.rows.end() || desk.strings.view(desk.devices.name(row->second)) != device.name ||
+                desk.devices.batteryLevel(row->second) != device.batteryLevel ||
+                desk.devices.isConnected(row->second) != device.connected ||
+                desk.devices.changedAt(row->second) != device.changedAt) {
+                mismatch = std::string(device.host) + " " + std::string(device.instanceId) + " differs";
+            }
+        });
+        if (mismatch.empty() && seen != expected) {
+            mismatch = "collector holds " + std::to_string(seen) + " devices, desks have " + std::to_string(expected);
+        }
+        return mismatch;
+    }
+
+    // A datagram header, without records
+    std::string header(CollectorProtocol::Kind kind, uint64_t session, uint64_t sequenceNumber) {
+        using namespace CollectorProtocol;
+        char buffer[sizeof(MAGIC) + 4 * MAX_VARINT + 1];
+        size_t length = sizeof(MAGIC);
+        std::copy(std::begin(MAGIC), std::end(MAGIC), buffer);
+        length += encodeVarint(VERSION, buffer + length);
+        buffer[length++] = static_cast<char>(kind);
+        length += encodeVarint(session, buffer + length);
+        length += encodeVarint(sequenceNumber, buffer + length);
+        length += encodeVarint(zigzag(EPOCH), buffer + length);
+        return std::string(buffer, length);
+    }
+
+    // A SNAPSHOT datagram, header and host, without records
+    std::string snapshotHeader(std::string_view host, uint64_t session, uint64_t indexLimit,
+                               uint64_t sequenceNumber = 1) {
+        using namespace CollectorProtocol;
+        std::string datagram = header(SNAPSHOT, session, sequenceNumber);
+        char buffer[MAX_VARINT];
+        datagram.append(buffer, encodeVarint(host.size(), buffer));
+        datagram.append(host);
+        datagram.append(buffer, encodeVarint(indexLimit, buffer));
+        return datagram;
+    }
+
+    void Collector_Push_64x64(Bench::State& state) {
+        auto desks = makeDesks(64, 64);
+        Collector collector({});
+        std::string reply;
+        int64_t now = EPOCH;
+        size_t datagrams = 0;
+        size_t bytes = 0;
+        bool resyncRequested = false;
+        std::chrono::steady_clock::duration applying{};
+
+        auto pushAll = [&]() {
+            for (auto& desk : desks) {
+                desk->agent->encode(desk->devices, desk->strings, now, [&](std::string_view datagram) {
+                    auto start = std::chrono::steady_clock::now();
+                    resyncRequested |= collector.receive(datagram, now, reply);
+                    applying += std::chrono::steady_clock::now() - start;
+                    datagrams++;
+                    bytes += datagram.size();
+                });
+            }
+        };
+        pushAll();  // snapshots
+        applying = {};
+        datagrams = 0;
+        bytes = 0;
+
+        for (uint64_t i = 1; i <= state.iterations(); i++) {
+            for (auto& desk : desks) desk->step(i);
+            now = EPOCH + static_cast<int64_t>(i);
+            pushAll();
+        }
+
+        std::string mismatch = compare(collector, desks);
+        if (resyncRequested || !mismatch.empty()) {
+            state.fail(resyncRequested ? "the collector asked for a snapshot" : mismatch);
+            return;
+        }
+        double updates = static_cast<double>(state.iterations()) * 64 * 64;
+        state.setBytesProcessed(bytes);
+        state.counter("applyUpdatesPerSec", updates / std::chrono::duration<double>(applying).count());
+        state.counter("bytesPerUpdate", static_cast<double>(bytes) / updates);
+        state.counter("datagramsPerOp", static_cast<double>(datagrams) / static_cast<double>(state.iterations()));
+    }
+
+    void Collector_Loopback_16x64(Bench::State& state) {
+        Collector collector("127.0.0.1:0");
+        if (!collector.isListening()) {
+            state.fail("could not bind the collector on 127.0.0.1");
+            return;
+        }
+        auto desks = makeDesks(16, 64, "127.0.0.1:" + std::to_string(collector.port()));
+        for (const auto& desk : desks) {
+            if (!desk->agent->isConnected()) {
+                state.fail("agent could not open its socket");
+                return;
+            }
+        }
+
+        // Until every desk's last datagram is applied; a desk the collector
+        // asked for a snapshot pushes one right away
+        auto settle = [&](int64_t now) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (std::chrono::steady_clock::now() < deadline) {
+                bool settled = true;
+                for (auto& desk : desks) {
+                    if (desk->agent->snapshotRequested()) {
+                        desk->agent->push(desk->devices, desk->strings, now);
+                    }
+                    settled = settled && collector.sequence(desk->agent->hostName()).value_or(0) == desk->agent->sequence();
+                }
+                if (settled) return true;
+                std::this_thread::yield();
+            }
+            return false;
+        };
+
+        int64_t now = EPOCH;
+        for (auto& desk : desks) desk->agent->push(desk->devices, desk->strings, now);
+        if (!settle(now)) {
+            state.fail("snapshots did not reach the collector");
+            return;
+        }
+        Collector::Stats before = collector.stats();
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 1; i <= state.iterations(); i++) {
+            now = EPOCH + static_cast<int64_t>(i);
+            for (auto& desk : desks) {
+                desk->step(i);
+                desk->agent->push(desk->devices, desk->strings, now);
+            }
+            if (!settle(now)) {
+                state.fail("the collector did not catch up within 10 s");
+                return;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::string mismatch = compare(collector, desks);
+        if (!mismatch.empty()) {
+            state.fail(mismatch);
+            return;
+        }
+        Collector::Stats after = collector.stats();
+        state.counter("updatesPerSec", static_cast<double>(state.iterations()) * 16 * 64 / seconds);
+        state.counter("gaps", static_cast<double>(after.gaps - before.gaps));
+        state.counter("resyncs", static_cast<double>(after.resyncs - before.resyncs));
+    }
+
+    void Collector_GapRecovery(Bench::State& state) {
+        auto desks = makeDesks(1, 64);
+        Desk& desk = *desks.front();
+        Collector collector({});
+        std::string reply;
+
+        // A batch from a session the collector never saw (it restarted)
+        desk.agent->encode(desk.devices, desk.strings, EPOCH, [](std::string_view) {});
+        bool asked = false;
+        desk.agent->encode(desk.devices, desk.strings, EPOCH, [&](std::string_view datagram) {
+            asked = collector.receive(datagram, EPOCH, reply);
+        });
+        if (!asked || !desk.agent->handleReply(reply)) {
+            state.fail("a batch of an unknown session was not answered with RESYNC");
+            return;
+        }
+
+        const std::string& host = desk.agent->hostName();
+        uint64_t resyncsBefore = collector.stats().resyncs;
+        for (uint64_t i = 1; i <= state.iterations(); i++) {
+            int64_t now = EPOCH + static_cast<int64_t>(i);
+            auto deliver = [&](std::string_view datagram) {
+                if (collector.receive(datagram, now, reply)) {
+                    desk.agent->handleReply(reply);
+                }
+            };
+
+            // This op's first datagram is lost...
+            desk.step(i);
+            bool dropped = false;
+            desk.agent->encode(desk.devices, desk.strings, now, [&](std::string_view datagram) {
+                if (dropped) deliver(datagram);
+                dropped = true;
+            });
+            // ...the next push (a heartbeat) shows the gap, the one after
+            // it is the snapshot the collector asked for
+            for (int push = 0; push < 3 && collector.sequence(host).value_or(0) != desk.agent->sequence(); push++) {
+                desk.agent->encode(desk.devices, desk.strings, now, deliver);
+            }
+            if (collector.sequence(host).value_or(0) != desk.agent->sequence()) {
+                state.fail("the desk did not recover from a lost datagram");
+                return;
+            }
+        }
+        if (collector.stats().resyncs - resyncsBefore < state.iterations()) {
+            state.fail("a gap was not answered with RESYNC");
+            return;
+        }
+
+        std::string mismatch = compare(collector, desks);
+        if (!mismatch.empty()) {
+            state.fail(mismatch);
+            return;
+        }
+        state.counter("gaps", static_cast<double>(collector.stats().gaps));
+    }
+
+    void Collector_Limits(Bench::State& state) {
+        using namespace CollectorProtocol;
+        std::string reply;
+        size_t memoryAfterIndex = 0;
+        for (uint64_t op = 0; op < state.iterations(); op++) {
+            Collector collector({});
+
+            // DEVICE at the largest index any snapshot may declare, in one
+            // that declared 64
+            std::string datagram = snapshotHeader("hostile", 1, 64);
+            char record[1 + 3 * MAX_VARINT];
+            size_t length = 0;
+            record[length++] = static_cast<char>(DEVICE);
+            length += encodeVarint(MAX_DEVICE_INDEX - 1, record + length);
+            length += encodeVarint(0, record + length);
+            length += encodeVarint(0, record + length);
+            datagram.append(record, length);
+            collector.receive(datagram, EPOCH, reply);
+            memoryAfterIndex = collector.memoryUsage();
+            if (collector.stats().rejected != 1 || memoryAfterIndex > 4096) {
+                state.fail("a device index past the snapshot's limit was applied");
+                return;
+            }
+
+            // A desk that finds many more devices after its first snapshot
+            auto desks = makeDesks(1, 8);
+            Desk& desk = *desks.front();
+            auto deliver = [&](std::string_view sent) { collector.receive(sent, EPOCH + 1, reply); };
+            desk.agent->encode(desk.devices, desk.strings, EPOCH, deliver);
+            for (size_t i = 0; i < 256; i++) {
+                char deviceName[64];
+                char instanceId[64];
+                std::snprintf(deviceName, sizeof(deviceName), "Razer Dongle %05zu", i);
+                std::snprintf(instanceId, sizeof(instanceId), "USB\\VID_1532&PID_00B7\\%zu", i);
+                desk.rows.emplace(instanceId, desk.devices.add(desk.strings.intern(deviceName),
+                                                               desk.strings.intern(instanceId)));
+            }
+            desk.step(1);
+            desk.agent->encode(desk.devices, desk.strings, EPOCH + 1, deliver);
+            std::string mismatch = compare(collector, desks);
+            if (!mismatch.empty()) {
+                state.fail("outgrowing the index limit: " + mismatch);
+                return;
+            }
+
+            // A host that gives its one device new MAX_STRING names in every
+            // batch, then snapshots again
+            size_t memoryBefore = collector.memoryUsage();
+            collector.receive(snapshotHeader("renamer", 2, 64), EPOCH + 1, reply);
+            uint64_t rejectedBefore = collector.stats().rejected;
+            std::string device(MAX_STRING, 'x');
+            uint64_t sequenceNumber = 2;
+            for (; collector.stats().rejected == rejectedBefore &&
+                   sequenceNumber < 4 * Collector::MAX_HOST_STRING_BYTES / MAX_STRING;
+                 sequenceNumber++) {
+                std::snprintf(device.data(), device.size(), "%020llu", static_cast<unsigned long long>(sequenceNumber));
+                datagram = header(BATCH, 2, sequenceNumber);
+                length = 0;
+                record[length++] = static_cast<char>(DEVICE);
+                length += encodeVarint(0, record + length);
+                for (int i = 0; i < 2; i++) {  // name and instance ID
+                    length += encodeVarint(device.size(), record + length);
+                    datagram.append(record, length);
+                    datagram.append(device);
+                    length = 0;
+                }
+                collector.receive(datagram, EPOCH + 1, reply);
+            }
+            size_t memoryCapped = collector.memoryUsage();
+            collector.receive(snapshotHeader("renamer", 2, 64, sequenceNumber), EPOCH + 1, reply);
+            if (collector.stats().rejected != rejectedBefore + 1 ||
+                memoryCapped > memoryBefore + 2 * Collector::MAX_HOST_STRING_BYTES ||
+                collector.memoryUsage() > memoryBefore + 16 * 1024) {
+                state.fail("a host's strings outgrew Collector::MAX_HOST_STRING_BYTES or its snapshot");
+                return;
+            }
+
+            // Hosts up to the limit, then one more
+            for (size_t i = 0; collector.stats().hosts < Collector::MAX_HOSTS && i < 2 * Collector::MAX_HOSTS; i++) {
+                collector.receive(snapshotHeader("host-" + std::to_string(i), 100 + i, 0), EPOCH, reply);
+            }
+            uint64_t rejected = collector.stats().rejected;
+            collector.receive(snapshotHeader("one-more", 99, 0), EPOCH, reply);
+            if (collector.stats().hosts != Collector::MAX_HOSTS || collector.stats().rejected != rejected + 1) {
+                state.fail("more hosts than Collector::MAX_HOSTS were kept");
+                return;
+            }
+
+            // Every host falls silent; the next datagram after the timeout
+            // drops them and is applied as the only host
+            collector.receive(snapshotHeader("late", 98, 0), EPOCH + 2 + Collector::HOST_TIMEOUT_SECONDS, reply);
+            Collector::Stats stats = collector.stats();
+            if (stats.hosts != 1 || stats.evicted != Collector::MAX_HOSTS || stats.devices != 0) {
+                state.fail("silent hosts were not dropped after Collector::HOST_TIMEOUT_SECONDS");
+                return;
+            }
+        }
+        state.counter("hostileBytes", static_cast<double>(memoryAfterIndex));
+    }
+
+    BENCHMARK(Collector_Push_64x64);
+    BENCHMARK(Collector_Loopback_16x64);
+    BENCHMARK(Collector_GapRecovery);
+    BENCHMARK(Collector_Limits);
+}
@@ -0,0 +1,67 @@
+#include "Bench.h"
+#include "ConfigManager.h"
+#include "LegacyConfigParser.h"
+#include <string>
+
+// Config parsing: single-pass JsonReader (ConfigManager::parseJson) against
+// the previous find()-based parser, on the shipped example and on generated
+// configs with thousands of device entries.
+
+namespace {
+    std::string makeConfig(size_t deviceCount) {
+        std::string json = "{\n  \"_comment\": \"generated benchmark config\",\n  \"version\": \"1.0.0\",\n  \"devices\": [";
+        for (size_t i = 0; i < deviceCount; i++) {
+            if (i > 0) json += ",";
+            std::string n = std::to_string(i);
+            json += "\n    {\n      \"name\": \"Device " + n + "\",\n"
+                    "      \"instanceIdPattern\": \"BTHLE\\\\DEV_*\",\n"
+                    "      \"enabled\": " + std::string(i % 7 ? "true" : "false") + ",\n"
+                    "      \"description\": \"Generated device number " + n + "\"\n    }";
+        }
+        json += "\n  ],\n  \"namePatterns\": [\"BSK*\", \"Razer*\", \"MX Master*\"],\n"
+                "  \"refreshInterval\": 300,\n"
+                "  \"batteryThresholds\": { \"high\": 60, \"medium\": 30, \"low\": 15 },\n"
+                "  \"_usage_notes\": { \"devices\": \"Explicit list of devices to monitor.\" }\n}\n";
+        return json;
+    }
+
+    void runCurrent(Bench::State& state, size_t deviceCount) {
+        std::string json = makeConfig(deviceCount);
+        ConfigManager configMgr;
+        size_t devices = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto config = configMgr.parseJson(json);
+            if (!config) {
+                state.fail("parse failed");
+                return;
+            }
+            devices = config->devices.size();
+        }
+        state.setBytesProcessed(json.size() * state.iterations());
+        state.counter("devices", static_cast<double>(devices));
+    }
+
+    void runLegacy(Bench::State& state, size_t deviceCount) {
+        std::string json = makeConfig(deviceCount);
+        size_t devices = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto config = LegacyConfigParser::parse(json);
+            devices = config ? config->devices.size() : 0;
+        }
+        state.setBytesProcessed(json.size() * state.iterations());
+        state.counter("devices", static_cast<double>(devices));
+    }
+
+    void ConfigParse_Small_JsonReader(Bench::State& state) { runCurrent(state, 4); }
+    void ConfigParse_Small_Legacy(Bench::State& state) { runLegacy(state, 4); }
+    void ConfigParse_1k_JsonReader(Bench::State& state) { runCurrent(state, 1000); }
+    void ConfigParse_1k_Legacy(Bench::State& state) { runLegacy(state, 1000); }
+    void ConfigParse_10k_JsonReader(Bench::State& state) { runCurrent(state, 10000); }
+    void ConfigParse_10k_Legacy(Bench::State& state) { runLegacy(state, 10000); }
+    BENCHMARK(ConfigParse_Small_JsonReader);
+    BENCHMARK(ConfigParse_Small_Legacy);
+    BENCHMARK(ConfigParse_1k_JsonReader);
+    BENCHMARK(ConfigParse_1k_Legacy);
+    BENCHMARK(ConfigParse_10k_JsonReader);
+    BENCHMARK(ConfigParse_10k_Legacy);
+}
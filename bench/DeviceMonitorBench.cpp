@@ -0,0 +1,107 @@
+#include "AllocationCounter.h"
+#include "Bench.h"
+#include "ConfigManager.h"
+#include "DeviceMonitor.h"
+#include "Discovery.h"
+#include "FakeDeviceBackend.h"
+#include <memory>
+
+// Enumeration and refresh through DeviceMonitor with an in-memory backend,
+// from one device to 10k, so the monitor's own cost (matching, interning,
+// per-device bookkeeping) shows without the OS calls. One op is one full
+// enumeration or one refresh of every tracked device. The refresh
+// benchmarks also report heap allocations per refresh when built with
+// RAZERTRAY_COUNT_ALLOCATIONS (should be 0). Monitor_Discover is one
+// `--discover --json` pass: every device matched, read and formatted as
+// its JSON line (the fake backend's other devices too); it fails unless
+// it matches exactly what enumeration tracks.
+
+namespace {
+    void runEnumerate(Bench::State& state, size_t deviceCount) {
+        auto backend = std::make_shared<FakeDeviceBackend>(deviceCount);
+        DeviceMonitor monitor(backend);
+
+        size_t found = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto devices = monitor.enumerateRazerDevices();
+            found = devices.size();
+        }
+        if (found != deviceCount) {
+            state.fail("enumeration matched the wrong devices");
+            return;
+        }
+        state.counter("devices", static_cast<double>(found));
+        state.counter("poolKB", static_cast<double>(monitor.strings().memoryUsage()) / 1024.0);
+    }
+
+    void runRefresh(Bench::State& state, size_t deviceCount) {
+        auto backend = std::make_shared<FakeDeviceBackend>(deviceCount);
+        DeviceMonitor monitor(backend);
+        auto devices = monitor.enumerateRazerDevices();
+
+        size_t allocationsBefore = AllocationCounter::count();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            monitor.updateDeviceInfo(devices);
+        }
+        size_t allocations = AllocationCounter::count() - allocationsBefore;
+
+        size_t withLevel = 0;
+        for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+            if (devices.batteryLevel(row).has_value()) withLevel++;
+        }
+        if (withLevel == 0) {
+            state.fail("refresh read no levels");
+            return;
+        }
+        state.counter("devices", static_cast<double>(devices.size()));
+        if (AllocationCounter::enabled()) {
+            state.counter("allocsPerRefresh", static_cast<double>(allocations) / static_cast<double>(state.iterations()));
+        }
+    }
+
+    void runDiscover(Bench::State& state, size_t deviceCount) {
+        ConfigManager configMgr;
+        Config config = configMgr.getDefaultConfig();
+        auto backend = std::make_shared<FakeDeviceBackend>(deviceCount);
+        DeviceMonitor monitor(backend, std::make_shared<const PatternMatcher>(config.namePatterns, config.devices,
+                                                                              config.caseInsensitivePatterns));
+
+        size_t found = 0;
+        size_t matched = 0;
+        size_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            found = matched = bytes = 0;
+            monitor.discover([&](const DeviceMonitor::Discovered& device) {
+                found++;
+                if (device.match) matched++;
+                bytes += Discovery::toJson(device, {}, config).size();
+            });
+        }
+        if (matched != deviceCount || matched != monitor.enumerateRazerDevices().size()) {
+            state.fail("discovery matched other devices than enumeration");
+            return;
+        }
+        state.counter("devices", static_cast<double>(found));
+        state.counter("matched", static_cast<double>(matched));
+        state.counter("bytesPerDevice", static_cast<double>(bytes) / static_cast<double>(found));
+    }
+
+    void Monitor_Enumerate_1(Bench::State& state) { runEnumerate(state, 1); }
+    void Monitor_Enumerate_100(Bench::State& state) { runEnumerate(state, 100); }
+    void Monitor_Enumerate_1k(Bench::State& state) { runEnumerate(state, 1000); }
+    void Monitor_Enumerate_10k(Bench::State& state) { runEnumerate(state, 10000); }
+    void Monitor_Refresh_1(Bench::State& state) { runRefresh(state, 1); }
+    void Monitor_Refresh_100(Bench::State& state) { runRefresh(state, 100); }
+    void Monitor_Refresh_1k(Bench::State& state) { runRefresh(state, 1000); }
+    void Monitor_Refresh_10k(Bench::State& state) { runRefresh(state, 10000); }
+    void Monitor_Discover_1k(Bench::State& state) { runDiscover(state, 1000); }
+    BENCHMARK(Monitor_Enumerate_1);
+    BENCHMARK(Monitor_Enumerate_100);
+    BENCHMARK(Monitor_Enumerate_1k);
+    BENCHMARK(Monitor_Enumerate_10k);
+    BENCHMARK(Monitor_Refresh_1);
+    BENCHMARK(Monitor_Refresh_100);
+    BENCHMARK(Monitor_Refresh_1k);
+    BENCHMARK(Monitor_Refresh_10k);
+    BENCHMARK(Monitor_Discover_1k);
+}
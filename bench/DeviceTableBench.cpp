@@ -0,0 +1,185 @@
+#include "Bench.h"
+#include "DeviceTable.h"
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+// Device state at fleet scale: 10k devices whose readings drift a little on
+// every refresh. One op is one refresh of every device followed by what the
+// tray icon needs (connected count and lowest battery).
+//
+// Aggregate_Legacy_10k is the previous layout and icon update: a heap node
+// per device, then a connected-device list rebuilt and scanned with
+// min_element. Aggregate_Table_10k writes the same readings into the
+// DeviceTable, whose aggregates follow along. The _Read variants leave the
+// readings alone and time only the aggregate query, which is what an icon
+// redraw without new readings (animation end, config change) costs.
+
+namespace {
+    constexpr size_t DEVICES = 10000;
+
+    struct LegacyDevice {
+        uint32_t name;
+        uint32_t instanceId;
+        std::optional<int> batteryLevel;
+        bool isConnected;
+    };
+
+    struct Aggregates {
+        size_t connected;
+        std::optional<int> lowest;
+    };
+
+    Aggregates legacyAggregates(const std::vector<std::unique_ptr<LegacyDevice>>& devices) {
+        std::vector<const LegacyDevice*> connectedDevices;
+        for (const auto& device : devices) {
+            if (device->isConnected) connectedDevices.push_back(device.get());
+        }
+        auto lowest = std::min_element(connectedDevices.begin(), connectedDevices.end(),
+            [](const LegacyDevice* a, const LegacyDevice* b) {
+                if (!a->batteryLevel.has_value()) return false;
+                if (!b->batteryLevel.has_value()) return true;
+                return a->batteryLevel.value() < b->batteryLevel.value();
+            });
+        return {connectedDevices.size(),
+                lowest != connectedDevices.end() ? (*lowest)->batteryLevel : std::nullopt};
+    }
+
+    Aggregates tableAggregates(const DeviceTable& table) {
+        std::optional<DeviceTable::Row> lowest = table.lowestBattery();
+        return {table.connectedCount(), lowest.has_value() ? table.batteryLevel(*lowest) : std::nullopt};
+    }
+
+    // Readings for refresh `pass`: about 1 in 10 devices drains (or charges)
+    // by a percent, 1 in 50 changes connection state, 1 in 200 loses its
+    // level
+    struct Reading {
+        std::optional<int> level;
+        bool connected;
+    };
+
+    std::vector<std::vector<Reading>> makePasses(size_t passes) {
+        std::mt19937 rng(42);
+        std::vector<Reading> current(DEVICES);
+        for (auto& reading : current) {
+            reading = {static_cast<int>(rng() % 101), rng() % 4 != 0};
+        }
+        std::vector<std::vector<Reading>> result;
+        for (size_t pass = 0; pass < passes; pass++) {
+            for (auto& reading : current) {
+                if (reading.level.has_value()) {
+                    uint32_t roll = rng() % 20;
+                    int drift = roll == 0 ? 1 : roll == 1 ? -1 : 0;
+                    reading.level = std::clamp(*reading.level + drift, 0, 100);
+                } else {
+                    reading.level = static_cast<int>(rng() % 101);
+                }
+                if (rng() % 200 == 0) reading.level.reset();
+                if (rng() % 50 == 0) reading.connected = !reading.connected;
+            }
+            result.push_back(current);
+        }
+        return result;
+    }
+
+    const std::vector<std::vector<Reading>>& passes() {
+        static const std::vector<std::vector<Reading>> generated = makePasses(16);
+        return generated;
+    }
+
+    std::vector<std::unique_ptr<LegacyDevice>> makeLegacy() {
+        std::vector<std::unique_ptr<LegacyDevice>> devices;
+        for (uint32_t i = 0; i < DEVICES; i++) {
+            devices.push_back(std::make_unique<LegacyDevice>(LegacyDevice{i, i + 1, std::nullopt, false}));
+        }
+        return devices;
+    }
+
+    DeviceTable makeTable() {
+        DeviceTable table;
+        table.reserve(DEVICES);
+        for (uint32_t i = 0; i < DEVICES; i++) {
+            table.add(i, i + 1);
+        }
+        return table;
+    }
+
+    void applyLegacy(std::vector<std::unique_ptr<LegacyDevice>>& devices, const std::vector<Reading>& readings) {
+        for (size_t i = 0; i < devices.size(); i++) {
+            devices[i]->batteryLevel = readings[i].level;
+            devices[i]->isConnected = readings[i].connected;
+        }
+    }
+
+    void applyTable(DeviceTable& table, const std::vector<Reading>& readings) {
+        for (DeviceTable::Row row = 0; row < table.size(); row++) {
+            table.update(row, readings[row].level, readings[row].connected, 1);
+        }
+    }
+
+    void Aggregate_Legacy_10k(Bench::State& state) {
+        auto devices = makeLegacy();
+        size_t connected = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            applyLegacy(devices, passes()[i % passes().size()]);
+            Aggregates aggregates = legacyAggregates(devices);
+            connected = aggregates.connected;
+            Bench::doNotOptimize(aggregates);
+        }
+        state.counter("connected", static_cast<double>(connected));
+    }
+
+    void Aggregate_Table_10k(Bench::State& state) {
+        // Same answers as the legacy scan after every pass (including ties
+        // and devices losing their level)
+        {
+            auto legacy = makeLegacy();
+            DeviceTable table = makeTable();
+            for (const auto& readings : passes()) {
+                applyLegacy(legacy, readings);
+                applyTable(table, readings);
+                Aggregates expected = legacyAggregates(legacy);
+                Aggregates actual = tableAggregates(table);
+                if (expected.connected != actual.connected || expected.lowest != actual.lowest) {
+                    state.fail("aggregates differ from a full scan");
+                    return;
+                }
+            }
+        }
+
+        DeviceTable table = makeTable();
+        size_t connected = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            applyTable(table, passes()[i % passes().size()]);
+            Aggregates aggregates = tableAggregates(table);
+            connected = aggregates.connected;
+            Bench::doNotOptimize(aggregates);
+        }
+        state.counter("connected", static_cast<double>(connected));
+    }
+
+    void Aggregate_Legacy_Read_10k(Bench::State& state) {
+        auto devices = makeLegacy();
+        applyLegacy(devices, passes().front());
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Aggregates aggregates = legacyAggregates(devices);
+            Bench::doNotOptimize(aggregates);
+        }
+    }
+
+    void Aggregate_Table_Read_10k(Bench::State& state) {
+        DeviceTable table = makeTable();
+        applyTable(table, passes().front());
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Aggregates aggregates = tableAggregates(table);
+            Bench::doNotOptimize(aggregates);
+        }
+    }
+
+    BENCHMARK(Aggregate_Legacy_10k);
+    BENCHMARK(Aggregate_Table_10k);
+    BENCHMARK(Aggregate_Legacy_Read_10k);
+    BENCHMARK(Aggregate_Table_Read_10k);
+}
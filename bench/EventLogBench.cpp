@@ -0,0 +1,239 @@
+#include "Bench.h"
+#include "EventLog.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// The device event log. EventLog_RecordDisabled is what every log site costs
+// while no log is open (one relaxed load). EventLog_Record is one event on
+// the hot path (a clock read and a store into the thread's ring), with the
+// rings written to the file every 512 events; recordNs counts the logging
+// alone, ns/op includes the writing. EventLog_Record_4Threads has four
+// threads log in bursts of half a ring while another drains, and checks that
+// every event is either in the file or counted as lost. EventLog_Rotation writes
+// ten times the size cap and checks the file and its predecessor stay under
+// it and the current file still names its devices. EventLog_Decode turns a
+// 1 MB log back into text.
+
+namespace {
+    std::filesystem::path logPath(const char* name) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+        std::filesystem::create_directories(dir);
+        std::filesystem::path path = dir / name;
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+        std::filesystem::path previous = path;
+        previous += ".1";
+        std::filesystem::remove(previous, ignored);
+        return path;
+    }
+
+    bool decodeFile(const std::filesystem::path& path, EventLog::Decoder& decoder, std::string& text) {
+        MappedFile file(path);
+        return file.isValid() && decoder.decode(file.contents(), text);
+    }
+
+    // STATE events in a log and the events its DROPPED records report lost,
+    // read straight from the records (decoding to text would dominate the
+    // timings)
+    struct Counts {
+        bool valid;
+        uint64_t states;
+        uint64_t lost;
+    };
+
+    Counts countEvents(const std::filesystem::path& path) {
+        MappedFile file(path);
+        std::string_view contents = file.contents();
+        constexpr size_t HEADER = sizeof(EventLog::MAGIC) + sizeof(uint32_t);
+        Counts counts = {contents.size() >= HEADER && contents.substr(0, 4) == std::string_view(EventLog::MAGIC, 4), 0, 0};
+        for (size_t offset = HEADER; counts.valid && offset + sizeof(EventLog::Event) <= contents.size();
+             offset += sizeof(EventLog::Event)) {
+            EventLog::Event event;
+            std::memcpy(&event, contents.data() + offset, sizeof(event));
+            counts.states += event.type == EventLog::Type::STATE ? 1 : 0;
+            counts.lost += event.type == EventLog::Type::DROPPED ? static_cast<uint64_t>(event.a) : 0;
+        }
+        return counts;
+    }
+
+    void logDevices(uint32_t count) {
+        char name[32];
+        char instanceId[64];
+        for (uint32_t device = 0; device < count; device++) {
+            std::snprintf(name, sizeof(name), "Razer Device %02u", device);
+            std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\DEV_C8A2D3%06X\\7&1A2B3C&0&0", device);
+            EventLog::recordText(EventLog::Type::DEVICE_NAME, device, name);
+            EventLog::recordText(EventLog::Type::DEVICE_ID, device, instanceId);
+        }
+    }
+
+    void EventLog_RecordDisabled(Bench::State& state) {
+        EventLog::stop();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            EventLog::log(EventLog::Type::STATE, static_cast<uint32_t>(i & 63), static_cast<int64_t>(i % 101), 1);
+            Bench::doNotOptimize(i);
+        }
+    }
+
+    void EventLog_Record(Bench::State& state) {
+        std::filesystem::path path = logPath("record.rzlog");
+        if (!EventLog::start(path, 1ULL << 40)) {
+            state.fail("could not open the event log");
+            return;
+        }
+
+        std::chrono::steady_clock::duration recording{};
+        for (uint64_t i = 0; i < state.iterations();) {
+            uint64_t batchEnd = std::min<uint64_t>(i + 512, state.iterations());
+            auto start = std::chrono::steady_clock::now();
+            for (; i < batchEnd; i++) {
+                EventLog::log(EventLog::Type::STATE, static_cast<uint32_t>(i & 63), static_cast<int64_t>(i % 101), 1);
+            }
+            recording += std::chrono::steady_clock::now() - start;
+            EventLog::flush();
+        }
+        uint64_t dropped = EventLog::dropped();
+        EventLog::stop();
+
+        Counts counts = countEvents(path);
+        if (!counts.valid) {
+            state.fail("the file is not an event log");
+            return;
+        }
+        if (dropped != 0 || counts.states != state.iterations()) {
+            state.fail("events were lost although the ring was drained in time");
+            return;
+        }
+        state.setBytesProcessed(state.iterations() * sizeof(EventLog::Event));
+        state.counter("recordNs", std::chrono::duration<double, std::nano>(recording).count() /
+                                      static_cast<double>(state.iterations()));
+    }
+
+    // Bursts of half a ring per thread, then a pause the drain can use
+    void EventLog_Record_4Threads(Bench::State& state) {
+        constexpr int THREADS = 4;
+        constexpr uint64_t BURST = EventLog::RING_CAPACITY / 2;
+        std::filesystem::path path = logPath("contended.rzlog");
+        if (!EventLog::start(path, 1ULL << 40)) {
+            state.fail("could not open the event log");
+            return;
+        }
+
+        std::atomic<int> running = THREADS;
+        std::atomic<int64_t> recordingNs = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREADS; t++) {
+            threads.emplace_back([&, t]() {
+                std::chrono::steady_clock::duration recording{};
+                for (uint64_t i = 0; i < state.iterations();) {
+                    uint64_t burstEnd = std::min(i + BURST, state.iterations());
+                    auto start = std::chrono::steady_clock::now();
+                    for (; i < burstEnd; i++) {
+                        EventLog::log(EventLog::Type::STATE, static_cast<uint32_t>(t), static_cast<int64_t>(i % 101), 1);
+                    }
+                    recording += std::chrono::steady_clock::now() - start;
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+                recordingNs.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(recording).count());
+                running.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        while (running.load(std::memory_order_acquire) > 0) {
+            EventLog::flush();
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+        for (auto& thread : threads) thread.join();
+        EventLog::stop();
+
+        Counts counts = countEvents(path);
+        uint64_t total = state.iterations() * THREADS;
+        if (!counts.valid || counts.states + counts.lost != total) {
+            state.fail("events neither written nor counted as lost");
+            return;
+        }
+        state.counter("recordNs", static_cast<double>(recordingNs.load()) / static_cast<double>(total));
+        state.counter("lostPercent", 100.0 * static_cast<double>(counts.lost) / static_cast<double>(total));
+    }
+
+    void EventLog_Rotation(Bench::State& state) {
+        constexpr uint64_t CAP = 64 * 1024;
+        std::filesystem::path path = logPath("rotation.rzlog");
+        std::filesystem::path previous = path;
+        previous += ".1";
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            if (!EventLog::start(path, CAP)) {
+                state.fail("could not open the event log");
+                return;
+            }
+            logDevices(8);
+            for (uint64_t event = 0; event < 10 * CAP / sizeof(EventLog::Event); event++) {
+                EventLog::log(EventLog::Type::STATE, static_cast<uint32_t>(event & 7), static_cast<int64_t>(event % 101), 1);
+                if ((event & 255) == 255) EventLog::flush();
+            }
+            EventLog::stop();
+
+            std::error_code error;
+            if (std::filesystem::file_size(path, error) > CAP || std::filesystem::file_size(previous, error) > CAP ||
+                error) {
+                state.fail("the log outgrew its cap");
+                return;
+            }
+            EventLog::Decoder decoder;
+            std::string text;
+            if (!decodeFile(path, decoder, text) || text.find("device #") != std::string::npos ||
+                text.find("Razer Device 07") == std::string::npos) {
+                state.fail("a rotated log does not name its devices");
+                return;
+            }
+        }
+    }
+
+    void EventLog_Decode(Bench::State& state) {
+        std::filesystem::path path = logPath("decode.rzlog");
+        if (!EventLog::start(path, 1ULL << 40)) {
+            state.fail("could not open the event log");
+            return;
+        }
+        logDevices(16);
+        for (uint64_t event = 0; event < 32768; event++) {
+            switch (event % 4) {
+                case 0: EventLog::log(EventLog::Type::SEEN, static_cast<uint32_t>(event & 15)); break;
+                case 1: EventLog::log(EventLog::Type::STATE, static_cast<uint32_t>(event & 15), static_cast<int64_t>(event % 101), 1); break;
+                case 2: EventLog::log(EventLog::Type::QUERY_FAILED, static_cast<uint32_t>(event & 15), 1); break;
+                default: EventLog::log(EventLog::Type::SCAN, EventLog::NO_DEVICE, 1500000, 16); break;
+            }
+            if ((event & 255) == 255) EventLog::flush();
+        }
+        EventLog::stop();
+
+        MappedFile file(path);
+        size_t lines = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            EventLog::Decoder decoder;
+            std::string text;
+            if (!decoder.decode(file.contents(), text)) {
+                state.fail("the log does not decode");
+                return;
+            }
+            lines = static_cast<size_t>(std::count(text.begin(), text.end(), '\n'));
+        }
+        state.setBytesProcessed(file.contents().size() * state.iterations());
+        state.counter("lines", static_cast<double>(lines));
+    }
+
+    BENCHMARK(EventLog_RecordDisabled);
+    BENCHMARK(EventLog_Record);
+    BENCHMARK(EventLog_Record_4Threads);
+    BENCHMARK(EventLog_Rotation);
+    BENCHMARK(EventLog_Decode);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "DeviceBackend.h"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// In-memory DeviceBackend for the benchmarks: a fixed population of Bluetooth
+// LE devices, every fourth one not Razer (so the matcher has something to
+// reject), with deterministic levels and connection states. query() is a
+// hash lookup and never allocates, like the real backend.
+class FakeDeviceBackend : public DeviceBackend {
+public:
+    explicit FakeDeviceBackend(size_t razerCount) {
+        devices.reserve(razerCount + razerCount / 3);
+        for (size_t i = 0; i < razerCount; i++) {
+            add("Razer Device", i);
+            if (i % 3 == 2) add("Other Headset", i);
+        }
+        for (const auto& device : devices) {
+            index.emplace(device.instanceId, &device.reading);
+        }
+    }
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override {
+        for (const auto& device : devices) {
+            onDevice(device.name, device.instanceId);
+        }
+    }
+
+    Reading query(std::string_view instanceId) override {
+        auto it = index.find(instanceId);
+        return it != index.end() ? *it->second : Reading{false, std::nullopt, false};
+    }
+
+    // Every device with a level reports the next one (100 wraps to 0),
+    // so the following refresh changes them all
+    void advance() {
+        for (auto& device : devices) {
+            if (device.reading.batteryLevel.has_value()) {
+                device.reading.batteryLevel = (*device.reading.batteryLevel + 1) % 101;
+            }
+        }
+    }
+
+private:
+    struct Device {
+        std::string name;
+        std::string instanceId;
+        Reading reading;
+    };
+
+    void add(const char* kind, size_t i) {
+        char name[64];
+        char instanceId[64];
+        size_t n = devices.size();
+        std::snprintf(name, sizeof(name), "%s %05zu", kind, i);
+        std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\DEV_%012zX\\7&1A2B3C&0&0", 0xC8A2D3000000 + n);
+        Reading reading = {true, std::nullopt, n % 5 != 0};
+        if (n % 7 != 6) reading.batteryLevel = static_cast<int>(n % 101);
+        devices.push_back({name, instanceId, reading});
+    }
+
+    std::vector<Device> devices;
+    std::unordered_map<std::string_view, const Reading*> index;
+};
@@ -0,0 +1,329 @@
+#include "AllocationCounter.h"
+#include "Bench.h"
+#include "DeviceMonitor.h"
+#include "FakeDeviceBackend.h"
+#include "HeadlessService.h"
+#include "RecordingBackend.h"
+#include "StatusSegment.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "SysfsBackend.h"
+extern char** environ;
+#endif
+
+// The headless service. Headless_Refresh_8 is one refresh cycle of the
+// service over the fake backend: read every device and publish to the
+// status segment and log its events (one op is one cycle).
+// Headless_Footprint starts the real razertray_headless from this directory
+// on a recording of 8 devices with its event log on, waits for its first
+// publish and fails if its resident set exceeds
+// HeadlessService::RESIDENT_BUDGET_BYTES (one op is one sample of its
+// memory); it must then stop cleanly on SIGTERM / Ctrl+Break.
+// Headless_Sysfs_Query (Linux) builds a power_supply tree with peripheral
+// batteries, the machine's battery and a charger, checks what the sysfs
+// backend enumerates and reads, then times one query.
+
+namespace {
+    std::filesystem::path benchDirectory() {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    std::string segmentName(const char* suffix) {
+#ifdef _WIN32
+        return std::string("Local\\RazerTrayBench") + suffix;
+#else
+        return std::string("/razertray-bench-") + suffix;
+#endif
+    }
+
+    // Wait up to 10 s until the segment holds a publish of count devices
+    bool waitForPublish(const std::string& name, uint32_t count) {
+        auto payload = std::make_unique<StatusSegment::Payload>();
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            StatusSegment::Reader reader(name);
+            if (reader.isValid() && reader.read(*payload) && payload->deviceCount == count) {
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return false;
+    }
+
+    void Headless_Refresh_8(Bench::State& state) {
+        HeadlessService::Options options;
+        options.configPath = benchDirectory() / "headless-config.json";
+        options.statusName = segmentName("headless");
+        options.useDeviceCache = false;
+        options.eventLogPath = benchDirectory() / "headless-events.rzlog";
+        HeadlessService service(std::make_shared<FakeDeviceBackend>(8), std::move(options));
+        service.scan();
+        if (service.devices().size() != 8 || !waitForPublish(segmentName("headless"), 8)) {
+            state.fail("scan not published");
+            return;
+        }
+
+        size_t allocationsBefore = AllocationCounter::count();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            service.refresh();
+        }
+        if (AllocationCounter::enabled()) {
+            state.counter("allocsPerRefresh", static_cast<double>(AllocationCounter::count() - allocationsBefore) /
+                                                  static_cast<double>(state.iterations()));
+        }
+    }
+
+    // The running service, stopped and reaped when this goes out of scope
+    // if stop() was not called
+    class HeadlessProcess {
+    public:
+        struct Memory {
+            uint64_t resident;
+            uint64_t privateBytes;
+        };
+
+        HeadlessProcess(const std::filesystem::path& executable, const std::filesystem::path& recording,
+                        const std::string& statusName) {
+#ifdef _WIN32
+            std::filesystem::path eventLog = benchDirectory() / "headless-events.rzlog";
+            std::wstring commandLine = L"\"" + executable.wstring() + L"\" --replay \"" + recording.wstring() +
+                                       L"\" --status-name " + std::wstring(statusName.begin(), statusName.end()) +
+                                       L" --event-log \"" + eventLog.wstring() + L"\"";
+            STARTUPINFOW startup = {};
+            startup.cb = sizeof(startup);
+            PROCESS_INFORMATION info = {};
+            if (CreateProcessW(nullptr, commandLine.data(), nullptr, nullptr, FALSE, CREATE_NEW_PROCESS_GROUP,
+                               nullptr, nullptr, &startup, &info)) {
+                CloseHandle(info.hThread);
+                process = info.hProcess;
+                processId = info.dwProcessId;
+            }
+#else
+            std::string path = executable.string();
+            std::string replay = recording.string();
+            std::string eventLog = (benchDirectory() / "headless-events.rzlog").string();
+            char* argv[] = {path.data(), const_cast<char*>("--replay"), replay.data(),
+                            const_cast<char*>("--status-name"), const_cast<char*>(statusName.c_str()),
+                            const_cast<char*>("--event-log"), eventLog.data(), nullptr};
+            if (posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv, environ) != 0) {
+                pid = -1;
+            }
+#endif
+        }
+
+        ~HeadlessProcess() {
+            if (isRunning()) {
+#ifdef _WIN32
+                TerminateProcess(process, 1);
+#else
+                kill(pid, SIGKILL);
+#endif
+                stop();
+            }
+        }
+
+        bool isRunning() const {
+#ifdef _WIN32
+            return process != nullptr;
+#else
+            return pid > 0;
+#endif
+        }
+
+        std::optional<Memory> memory() const {
+#ifdef _WIN32
+            PROCESS_MEMORY_COUNTERS_EX counters = {};
+            counters.cb = sizeof(counters);
+            if (!GetProcessMemoryInfo(process, reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters))) {
+                return std::nullopt;
+            }
+            return Memory{counters.WorkingSetSize, counters.PrivateUsage};
+#else
+            char statusPath[64];
+            std::snprintf(statusPath, sizeof(statusPath), "/proc/%d/status", static_cast<int>(pid));
+            std::FILE* status = std::fopen(statusPath, "r");
+            if (!status) {
+                return std::nullopt;
+            }
+            Memory memory = {0, 0};
+            char line[256];
+            unsigned long long kilobytes;
+            while (std::fgets(line, sizeof(line), status)) {
+                if (std::sscanf(line, "VmRSS: %llu", &kilobytes) == 1) memory.resident = kilobytes * 1024;
+                if (std::sscanf(line, "RssAnon: %llu", &kilobytes) == 1) memory.privateBytes = kilobytes * 1024;
+            }
+            std::fclose(status);
+            return memory;
+#endif
+        }
+
+        // Ask the service to stop and wait for it; true if it exited cleanly
+        bool stop() {
+            bool clean = false;
+#ifdef _WIN32
+            if (process) {
+                GenerateConsoleCtrlEvent(CTRL_BREAK_EVENT, processId);
+                DWORD exitCode = 1;
+                if (WaitForSingleObject(process, 10000) == WAIT_OBJECT_0) {
+                    clean = GetExitCodeProcess(process, &exitCode) && exitCode == 0;
+                } else {
+                    TerminateProcess(process, 1);
+                    WaitForSingleObject(process, INFINITE);
+                }
+                CloseHandle(process);
+                process = nullptr;
+            }
+#else
+            if (pid > 0) {
+                kill(pid, SIGTERM);
+                int status = 0;
+                clean = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+                pid = -1;
+            }
+#endif
+            return clean;
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE process = nullptr;
+        DWORD processId = 0;
+#else
+        pid_t pid = -1;
+#endif
+    };
+
+    std::filesystem::path headlessExecutable() {
+#ifdef _WIN32
+        wchar_t path[MAX_PATH];
+        GetModuleFileNameW(nullptr, path, MAX_PATH);
+        return std::filesystem::path(path).parent_path() / "razertray_headless.exe";
+#else
+        std::error_code ignored;
+        return std::filesystem::read_symlink("/proc/self/exe", ignored).parent_path() / "razertray_headless";
+#endif
+    }
+
+    void Headless_Footprint(Bench::State& state) {
+        std::filesystem::path recording = benchDirectory() / "headless.rzrec";
+        {
+            auto recorder = std::make_shared<RecordingBackend>(std::make_shared<FakeDeviceBackend>(8), recording);
+            DeviceMonitor monitor(recorder);
+            auto devices = monitor.enumerateRazerDevices();
+            monitor.updateDeviceInfo(devices);
+        }
+
+        std::string name = segmentName("footprint");
+        HeadlessProcess service(headlessExecutable(), recording, name);
+        if (!service.isRunning() || !waitForPublish(name, 8)) {
+            state.fail("razertray_headless did not start and publish");
+            return;
+        }
+
+        std::optional<HeadlessProcess::Memory> memory;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            memory = service.memory();
+        }
+        bool clean = service.stop();
+        std::error_code ignored;
+        std::filesystem::remove(recording, ignored);
+
+        if (!memory.has_value()) {
+            state.fail("could not sample the service's memory");
+            return;
+        }
+        state.counter("residentKB", static_cast<double>(memory->resident) / 1024.0);
+        state.counter("privateKB", static_cast<double>(memory->privateBytes) / 1024.0);
+        if (memory->resident > HeadlessService::RESIDENT_BUDGET_BYTES) {
+            state.fail("resident set over the budget");
+        } else if (!clean) {
+            state.fail("razertray_headless did not stop cleanly");
+        }
+    }
+
+#ifndef _WIN32
+    void writeAttribute(const std::filesystem::path& supply, const char* name, const std::string& value) {
+        std::ofstream(supply / name) << value << '\n';
+    }
+
+    void Headless_Sysfs_Query(Bench::State& state) {
+        constexpr int MICE = 8;
+        std::filesystem::path root = benchDirectory() / "power_supply";
+        std::error_code ignored;
+        std::filesystem::remove_all(root, ignored);
+
+        // Mouse i: level i * 12; 3 reports offline, 5 has no capacity
+        for (int i = 0; i < MICE; i++) {
+            char entry[64];
+            std::snprintf(entry, sizeof(entry), "hid-c8:a2:d3:e4:f5:%02x-battery", i);
+            std::filesystem::path supply = root / entry;
+            std::filesystem::create_directories(supply);
+            writeAttribute(supply, "type", "Battery");
+            writeAttribute(supply, "scope", "Device");
+            writeAttribute(supply, "model_name", "Razer Bench Mouse " + std::to_string(i));
+            if (i != 5) writeAttribute(supply, "capacity", std::to_string(i * 12));
+            if (i == 3) writeAttribute(supply, "online", "0");
+        }
+        std::filesystem::create_directories(root / "BAT0");
+        writeAttribute(root / "BAT0", "type", "Battery");
+        writeAttribute(root / "BAT0", "scope", "System");
+        writeAttribute(root / "BAT0", "capacity", "50");
+        std::filesystem::create_directories(root / "AC");
+        writeAttribute(root / "AC", "type", "Mains");
+        writeAttribute(root / "AC", "online", "1");
+
+        SysfsBackend backend(root.string());
+        int enumerated = 0;
+        bool namesMatch = true;
+        backend.enumerate([&](std::string_view name, std::string_view instanceId) {
+            enumerated++;
+            namesMatch = namesMatch && name.starts_with("Razer Bench Mouse ") && instanceId.starts_with("hid-");
+        });
+        if (enumerated != MICE || !namesMatch) {
+            state.fail("enumerated the wrong supplies");
+            return;
+        }
+        for (int i = 0; i < MICE; i++) {
+            char entry[64];
+            std::snprintf(entry, sizeof(entry), "hid-c8:a2:d3:e4:f5:%02x-battery", i);
+            DeviceBackend::Reading reading = backend.query(entry);
+            bool levelMatches = i == 5 ? !reading.batteryLevel.has_value() : reading.batteryLevel.value_or(-1) == i * 12;
+            if (!reading.present || reading.isConnected != (i != 3) || !levelMatches) {
+                state.fail("reading does not match the supply");
+                return;
+            }
+        }
+        if (backend.query("hid-gone-battery").present || backend.query("../power_supply/AC").present ||
+            backend.query("..").present) {
+            state.fail("a missing or outside supply read as present");
+            return;
+        }
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Bench::doNotOptimize(backend.query("hid-c8:a2:d3:e4:f5:02-battery"));
+        }
+        std::filesystem::remove_all(root, ignored);
+    }
+
+    BENCHMARK(Headless_Sysfs_Query);
+#endif
+
+    BENCHMARK(Headless_Refresh_8);
+    BENCHMARK(Headless_Footprint);
+}
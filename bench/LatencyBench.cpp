@@ -0,0 +1,106 @@
+#include "Bench.h"
+#include "LatencyHistogram.h"
+#include "LatencyProbes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Latency instrumentation cost. Latency_Record is one histogram update,
+// Latency_Probe one complete probe (two clock reads and an update) around an
+// empty body - the overhead every timed OS call pays; it fails above 1% of
+// the modeled ~20 us OS call (overheadPercent). Latency_Percentiles
+// checks the reported percentiles against exact ones from sorted samples
+// (each must be within one sub-bucket, ~3%).
+
+namespace {
+    constexpr size_t SAMPLE_COUNT = 1 << 16;
+    // Median of a timed OS call (SetupAPI query, BLE property read), ns
+    constexpr double OS_CALL_NS = 20000.0;
+    // Largest share of it a probe may add
+    constexpr double MAX_OVERHEAD_PERCENT = 1.0;
+
+    // Roughly the shape of OS call latencies: log-normal around ~20 us with
+    // a long tail
+    const std::vector<uint64_t>& samples() {
+        static const std::vector<uint64_t> generated = [] {
+            std::mt19937_64 rng(11);
+            std::lognormal_distribution<double> distribution(std::log(OS_CALL_NS), 1.0);
+            std::vector<uint64_t> values(SAMPLE_COUNT);
+            for (auto& value : values) {
+                value = static_cast<uint64_t>(distribution(rng));
+            }
+            return values;
+        }();
+        return generated;
+    }
+
+    void Latency_Record(Bench::State& state) {
+        auto histogram = std::make_unique<LatencyHistogram>();
+        const auto& values = samples();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            histogram->record(values[i % SAMPLE_COUNT]);
+        }
+        Bench::doNotOptimize(histogram->snapshot().count);
+    }
+
+    void Latency_Probe(Bench::State& state) {
+        constexpr auto SITE = LatencyProbes::Site::EnumDeviceInfo;
+        uint64_t before = LatencyProbes::histogram(SITE).snapshot().count;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            LatencyProbes::Probe probe(SITE);
+            Bench::doNotOptimize(i);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t recorded = LatencyProbes::histogram(SITE).snapshot().count - before;
+        LatencyProbes::histogram(SITE).reset();
+        if (recorded != state.iterations()) {
+            state.fail("probe did not record every call");
+            return;
+        }
+        double overheadPercent = elapsed.count() / static_cast<double>(state.iterations()) / OS_CALL_NS * 100.0;
+        // The short calibration runs are dominated by first-touch faults
+        if (state.iterations() >= 100000 && overheadPercent > MAX_OVERHEAD_PERCENT) {
+            state.fail("a probe costs more than 1% of the OS call it times");
+            return;
+        }
+        state.counter("overheadPercent", overheadPercent);
+    }
+
+    void Latency_Percentiles(Bench::State& state) {
+        const auto& values = samples();
+        std::vector<uint64_t> sorted(values);
+        std::sort(sorted.begin(), sorted.end());
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto histogram = std::make_unique<LatencyHistogram>();
+            for (uint64_t value : values) {
+                histogram->record(value);
+            }
+            LatencyHistogram::Snapshot snapshot = histogram->snapshot();
+
+            for (double fraction : {0.5, 0.9, 0.99, 0.999, 1.0}) {
+                size_t rank = static_cast<size_t>(std::ceil(fraction * SAMPLE_COUNT));
+                double exact = static_cast<double>(sorted[rank - 1]);
+                double reported = static_cast<double>(snapshot.percentile(fraction));
+                if (std::abs(reported - exact) > exact / LatencyHistogram::SUB_BUCKET_COUNT + 1.0) {
+                    state.fail("percentile outside bucket precision");
+                    return;
+                }
+            }
+            if (snapshot.count != SAMPLE_COUNT || snapshot.max != sorted.back()) {
+                state.fail("count or max mismatch");
+                return;
+            }
+        }
+        state.counter("samples", static_cast<double>(SAMPLE_COUNT));
+        state.counter("histogramKB", sizeof(LatencyHistogram) / 1024.0);
+    }
+
+    BENCHMARK(Latency_Record);
+    BENCHMARK(Latency_Probe);
+    BENCHMARK(Latency_Percentiles);
+}
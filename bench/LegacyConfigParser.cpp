@@ -0,0 +1,207 @@
+#include "LegacyConfigParser.h"
+#include <string>
+#include <vector>
+
+// The find()-based parser ConfigManager used before the single-pass
+// JsonReader, kept verbatim (minus the wide-string conversions) as the
+// baseline for ConfigParser benchmarks. Not used by the application.
+
+namespace {
+
+// Simple JSON parser - extracts values between quotes
+std::string extractQuotedValue(const std::string& json, const std::string& key) {
+    std::string searchFor = "\"" + key + "\"";
+    size_t pos = json.find(searchFor);
+    if (pos == std::string::npos) return "";
+
+    // Find the colon after the key
+    pos = json.find(':', pos);
+    if (pos == std::string::npos) return "";
+
+    // Skip whitespace after colon
+    pos++;
+    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r')) {
+        pos++;
+    }
+
+    // If it's a quoted string
+    if (json[pos] == '"') {
+        pos++;
+        size_t endPos = json.find('"', pos);
+        if (endPos != std::string::npos) {
+            return json.substr(pos, endPos - pos);
+        }
+    }
+
+    return "";
+}
+
+int extractIntValue(const std::string& json, const std::string& key) {
+    std::string searchFor = "\"" + key + "\"";
+    size_t pos = json.find(searchFor);
+    if (pos == std::string::npos) return 0;
+
+    // Find the colon after the key
+    pos = json.find(':', pos);
+    if (pos == std::string::npos) return 0;
+
+    // Skip whitespace after colon
+    pos++;
+    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t')) {
+        pos++;
+    }
+
+    // Extract digits
+    std::string numStr;
+    while (pos < json.length() && (json[pos] >= '0' && json[pos] <= '9')) {
+        numStr += json[pos];
+        pos++;
+    }
+
+    return numStr.empty() ? 0 : std::stoi(numStr);
+}
+
+std::vector<std::string> extractStringArray(const std::string& json, const std::string& arrayName) {
+    std::vector<std::string> result;
+    std::string searchFor = "\"" + arrayName + "\"";
+    size_t pos = json.find(searchFor);
+    if (pos == std::string::npos) return result;
+
+    // Find the opening bracket [
+    pos = json.find('[', pos);
+    if (pos == std::string::npos) return result;
+
+    // Find the closing bracket ]
+    size_t endPos = json.find(']', pos);
+    if (endPos == std::string::npos) return result;
+
+    // Extract array content
+    std::string arrayContent = json.substr(pos + 1, endPos - pos - 1);
+
+    // Find all quoted strings
+    pos = 0;
+    while (true) {
+        pos = arrayContent.find('"', pos);
+        if (pos == std::string::npos) break;
+
+        pos++; // Skip opening quote
+        size_t endQuote = arrayContent.find('"', pos);
+        if (endQuote == std::string::npos) break;
+
+        result.push_back(arrayContent.substr(pos, endQuote - pos));
+        pos = endQuote + 1;
+    }
+
+    return result;
+}
+
+}
+
+std::optional<Config> LegacyConfigParser::parse(const std::string& jsonContent) {
+    Config config;
+    config.caseInsensitivePatterns = false;
+    config.metricsPort = 0;  // not known to the legacy format
+
+    try {
+        // Parse simple values
+        config.version = extractQuotedValue(jsonContent, "version");
+
+        config.refreshInterval = extractIntValue(jsonContent, "refreshInterval");
+        if (config.refreshInterval == 0) {
+            config.refreshInterval = 300; // default 5 minutes
+        }
+
+        // Parse battery thresholds
+        size_t thresholdPos = jsonContent.find("\"batteryThresholds\"");
+        if (thresholdPos != std::string::npos) {
+            config.batteryThresholds.high = extractIntValue(jsonContent, "high");
+            config.batteryThresholds.medium = extractIntValue(jsonContent, "medium");
+            config.batteryThresholds.low = extractIntValue(jsonContent, "low");
+        }
+
+        // Set defaults if not found
+        if (config.batteryThresholds.high == 0) config.batteryThresholds.high = 60;
+        if (config.batteryThresholds.medium == 0) config.batteryThresholds.medium = 30;
+        if (config.batteryThresholds.low == 0) config.batteryThresholds.low = 15;
+
+        // Parse namePatterns array
+        config.namePatterns = extractStringArray(jsonContent, "namePatterns");
+
+        // Parse devices array (simplified - just extract enabled device names)
+        // This is a basic implementation - can be enhanced later
+        size_t devicesPos = jsonContent.find("\"devices\"");
+        if (devicesPos != std::string::npos) {
+            size_t arrayStart = jsonContent.find('[', devicesPos);
+            size_t arrayEnd = jsonContent.find(']', arrayStart);
+
+            if (arrayStart != std::string::npos && arrayEnd != std::string::npos) {
+                std::string devicesSection = jsonContent.substr(arrayStart, arrayEnd - arrayStart);
+
+                // Find all device objects
+                size_t pos = 0;
+                while (true) {
+                    pos = devicesSection.find('{', pos);
+                    if (pos == std::string::npos) break;
+
+                    size_t objEnd = devicesSection.find('}', pos);
+                    if (objEnd == std::string::npos) break;
+
+                    std::string deviceObj = devicesSection.substr(pos, objEnd - pos + 1);
+
+                    DevicePattern device;
+                    device.name = extractQuotedValue(deviceObj, "name");
+                    device.instanceIdPattern = extractQuotedValue(deviceObj, "instanceIdPattern");
+                    device.description = extractQuotedValue(deviceObj, "description");
+
+                    // Check enabled (default true)
+                    size_t enabledPos = deviceObj.find("\"enabled\"");
+                    if (enabledPos != std::string::npos) {
+                        size_t truePos = deviceObj.find("true", enabledPos);
+                        size_t falsePos = deviceObj.find("false", enabledPos);
+                        device.enabled = (truePos != std::string::npos && (falsePos == std::string::npos || truePos < falsePos));
+                    } else {
+                        device.enabled = true;
+                    }
+
+                    if (!device.name.empty()) {
+                        config.devices.push_back(device);
+                    }
+
+                    pos = objEnd + 1;
+                }
+            }
+        }
+
+        return config;
+
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+bool LegacyConfigParser::matchesDevicePatterns(std::string_view deviceName, const Config& config) {
+    // Check against namePatterns (supports wildcards)
+    for (const auto& pattern : config.namePatterns) {
+        // Simple wildcard matching: * at end
+        if (pattern.back() == '*') {
+            std::string_view prefix(pattern.data(), pattern.length() - 1);
+            if (deviceName.starts_with(prefix)) {
+                return true;
+            }
+        } else {
+            // Exact match
+            if (deviceName == pattern) {
+                return true;
+            }
+        }
+    }
+
+    // Check against specific device names (if enabled)
+    for (const auto& device : config.devices) {
+        if (device.enabled && deviceName.find(device.name) != std::string_view::npos) {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "ConfigManager.h"
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Pre-JsonReader config parser and pre-PatternMatcher device matching,
+// kept only as benchmark baselines
+namespace LegacyConfigParser {
+    std::optional<Config> parse(const std::string& jsonContent);
+
+    // Linear scan: trailing-'*' prefix globs, then device-name substrings.
+    // Crashes on an empty pattern, like the original.
+    bool matchesDevicePatterns(std::string_view deviceName, const Config& config);
+}
@@ -0,0 +1,135 @@
+#include "Bench.h"
+#include "EventLog.h"
+#include "FakeDeviceBackend.h"
+#include "HeadlessService.h"
+#include "MemoryAccounting.h"
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+
+// Memory accounting and the service's memory budget. Memory_Headless_64 and
+// Memory_Headless_1024 scan that many fake devices with a headless service
+// (status segment and event log on) and fail if the heap the service added
+// to the process, or the memory it accounts for outside History, exceeds
+// HeadlessService::heapBudgetBytes(); one op is one memoryUsage() report,
+// which every publish makes. History is left out of the check because it
+// is the process's (the trace ring an earlier Trace bench started stays
+// allocated), not the service's. Memory_Refresh_10000 runs 10,000 refresh
+// cycles over 64 devices whose levels all change every cycle and fails if
+// the accounted memory changed or the heap grew; one op is the 10,000
+// cycles. The heap is only checked where MemoryAccounting::heapInUse() can
+// tell (glibc, Windows, RAZERTRAY_COUNT_ALLOCATIONS builds).
+
+namespace {
+    // Blocks the event log's flush thread may hold for a moment while it
+    // starts a new file (the device texts it repeats)
+    constexpr uint64_t HEAP_GROWTH_SLACK_BYTES = 16 * 1024;
+
+    std::filesystem::path benchDirectory() {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    HeadlessService::Options serviceOptions(const char* name) {
+        HeadlessService::Options options;
+        options.configPath = benchDirectory() / "memory-config.json";
+#ifdef _WIN32
+        options.statusName = std::string("Local\\RazerTrayBench") + name;
+#else
+        options.statusName = std::string("/razertray-bench-") + name;
+#endif
+        options.useDeviceCache = false;
+        options.eventLogPath = benchDirectory() / "memory-events.rzlog";
+        return options;
+    }
+
+    std::optional<uint64_t> heapGrowth(std::optional<uint64_t> before, std::optional<uint64_t> after) {
+        if (!before.has_value() || !after.has_value()) return std::nullopt;
+        return *after > *before ? *after - *before : 0;
+    }
+
+    void memoryBudget(Bench::State& state, size_t count, const char* name) {
+        auto backend = std::make_shared<FakeDeviceBackend>(count);
+        std::optional<uint64_t> heapBefore = MemoryAccounting::heapInUse();
+        HeadlessService service(backend, serviceOptions(name));
+        service.scan();
+        service.refresh();
+        EventLog::flush();
+        if (service.devices().size() != count) {
+            state.fail("scan found the wrong devices");
+            return;
+        }
+        std::optional<uint64_t> heap = heapGrowth(heapBefore, MemoryAccounting::heapInUse());
+
+        MemoryAccounting::Report report;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            report = service.memoryUsage();
+            Bench::doNotOptimize(report);
+        }
+
+        uint64_t budget = HeadlessService::heapBudgetBytes(count);
+        uint64_t owned = report.total() - report[MemoryAccounting::Subsystem::History];
+        state.counter("accountedKB", static_cast<double>(report.total()) / 1024.0);
+        state.counter("ownedKB", static_cast<double>(owned) / 1024.0);
+        state.counter("devicesKB", static_cast<double>(report[MemoryAccounting::Subsystem::Devices]) / 1024.0);
+        state.counter("budgetKB", static_cast<double>(budget) / 1024.0);
+        if (heap.has_value()) {
+            state.counter("heapKB", static_cast<double>(*heap) / 1024.0);
+        }
+        if (owned > budget) {
+            state.fail("accounted memory over the budget");
+        } else if (heap.value_or(0) > budget) {
+            state.fail("heap over the budget");
+        }
+    }
+
+    void Memory_Headless_64(Bench::State& state) {
+        memoryBudget(state, 64, "memory-64");
+    }
+
+    void Memory_Headless_1024(Bench::State& state) {
+        memoryBudget(state, 1024, "memory-1024");
+    }
+
+    void Memory_Refresh_10000(Bench::State& state) {
+        constexpr int WARMUP_CYCLES = 1000;
+        constexpr int CYCLES = 10000;
+        auto backend = std::make_shared<FakeDeviceBackend>(64);
+        HeadlessService service(backend, serviceOptions("memory-refresh"));
+        service.scan();
+
+        // Up to a full ring of state changes between flushes
+        auto cycle = [&](int index) {
+            backend->advance();
+            service.refresh();
+            if (index % 8 == 7) EventLog::flush();
+        };
+        for (int i = 0; i < WARMUP_CYCLES; i++) cycle(i);
+        EventLog::flush();
+        MemoryAccounting::Report before = service.memoryUsage();
+        std::optional<uint64_t> heapBefore = MemoryAccounting::heapInUse();
+
+        for (uint64_t op = 0; op < state.iterations(); op++) {
+            for (int i = 0; i < CYCLES; i++) cycle(i);
+        }
+        EventLog::flush();
+        MemoryAccounting::Report after = service.memoryUsage();
+        std::optional<uint64_t> growth = heapGrowth(heapBefore, MemoryAccounting::heapInUse());
+
+        state.counter("accountedKB", static_cast<double>(after.total()) / 1024.0);
+        if (growth.has_value()) {
+            state.counter("heapGrowthKB", static_cast<double>(*growth) / 1024.0);
+        }
+        if (after.bytes != before.bytes) {
+            state.fail("accounted memory changed over the refresh cycles");
+        } else if (growth.value_or(0) > HEAP_GROWTH_SLACK_BYTES) {
+            state.fail("heap grew over the refresh cycles");
+        }
+    }
+
+    BENCHMARK(Memory_Headless_64);
+    BENCHMARK(Memory_Headless_1024);
+    BENCHMARK(Memory_Refresh_10000);
+}
@@ -0,0 +1,160 @@
+#include "AllocationCounter.h"
+#include "Bench.h"
+#include "DeviceMonitor.h"
+#include "FakeDeviceBackend.h"
+#include "MetricsServer.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// The loopback Prometheus endpoint, driven by the fake backend.
+// Metrics_Render_* formats a snapshot into a reused buffer (what a scrape
+// costs the server). Metrics_Scrape_* is a whole scrape as a client sees it:
+// connect, GET /metrics, read to close (one op is one scrape). Before
+// timing, a scrape is checked against the device table and a 404, and the
+// timed scrapes must not cause a single device query.
+
+namespace {
+    // GET path from 127.0.0.1:port; the whole response (empty on failure)
+    std::string httpGet(uint16_t port, const char* path) {
+        std::string response;
+#ifdef _WIN32
+        WSADATA data;
+        if (WSAStartup(MAKEWORD(2, 2), &data) != 0) return response;
+        SOCKET client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        bool opened = client != INVALID_SOCKET;
+#else
+        int client = socket(AF_INET, SOCK_STREAM, 0);
+        bool opened = client >= 0;
+#endif
+        if (opened) {
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            address.sin_port = htons(port);
+            char request[128];
+            int length = std::snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", path);
+            if (connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+                send(client, request, length, 0) == length) {
+                char buffer[16384];
+                int received;
+                while ((received = static_cast<int>(recv(client, buffer, sizeof(buffer), 0))) > 0) {
+                    response.append(buffer, static_cast<size_t>(received));
+                }
+            }
+#ifdef _WIN32
+            closesocket(client);
+#else
+            ::close(client);
+#endif
+        }
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return response;
+    }
+
+    size_t countLines(std::string_view text, std::string_view prefix) {
+        size_t count = 0;
+        for (size_t start = 0; start < text.size();) {
+            size_t end = text.find('\n', start);
+            if (end == std::string_view::npos) end = text.size();
+            if (text.substr(start, end - start).substr(0, prefix.size()) == prefix) count++;
+            start = end + 1;
+        }
+        return count;
+    }
+
+    struct Fixture {
+        explicit Fixture(size_t count)
+            : monitor(std::make_shared<FakeDeviceBackend>(count)), devices(monitor.enumerateRazerDevices()) {
+            monitor.updateDeviceInfo(devices);
+        }
+
+        DeviceMonitor monitor;
+        DeviceTable devices;
+    };
+
+    void runRender(Bench::State& state, size_t count) {
+        Fixture fixture(count);
+        auto snapshot = std::make_unique<StatusSegment::Payload>();
+        StatusSegment::capture(*snapshot, fixture.devices, fixture.monitor.strings(), 1, std::nullopt, {}, {});
+
+        std::string body;
+        MetricsServer::render(body, *snapshot);  // grows the buffer once
+        size_t allocationsBefore = AllocationCounter::count();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            body.clear();
+            MetricsServer::render(body, *snapshot);
+        }
+        size_t allocations = AllocationCounter::count() - allocationsBefore;
+
+        state.setBytesProcessed(state.iterations() * body.size());
+        state.counter("bodyKB", static_cast<double>(body.size()) / 1024.0);
+        if (AllocationCounter::enabled()) {
+            state.counter("allocsPerRender", static_cast<double>(allocations) / static_cast<double>(state.iterations()));
+        }
+    }
+
+    void runScrape(Bench::State& state, size_t count) {
+        Fixture fixture(count);
+        MetricsServer server(0);
+        if (!server.isListening()) {
+            state.fail("could not listen on loopback");
+            return;
+        }
+        server.update(fixture.devices, fixture.monitor.strings(), 1, std::nullopt);
+
+        // One sample per device with a level, one connection sample per device
+        std::string response = httpGet(server.port(), "/metrics");
+        size_t withLevel = 0;
+        for (DeviceTable::Row row = 0; row < fixture.devices.size(); row++) {
+            if (fixture.devices.batteryLevel(row).has_value()) withLevel++;
+        }
+        char devicesLine[64];
+        std::snprintf(devicesLine, sizeof(devicesLine), "\nrazertray_devices %zu\n", fixture.devices.size());
+        if (response.compare(0, 15, "HTTP/1.1 200 OK") != 0 ||
+            response.find(devicesLine) == std::string::npos ||
+            countLines(response, "razertray_battery_level_percent{") != withLevel ||
+            countLines(response, "razertray_device_connected{") != fixture.devices.size()) {
+            state.fail("scrape does not match the device table");
+            return;
+        }
+        if (httpGet(server.port(), "/other").compare(0, 12, "HTTP/1.1 404") != 0) {
+            state.fail("unknown path not rejected");
+            return;
+        }
+
+        uint64_t queriesBefore = DeviceMonitor::queryCounts().queries;
+        size_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            bytes += httpGet(server.port(), "/metrics").size();
+        }
+        if (DeviceMonitor::queryCounts().queries != queriesBefore) {
+            state.fail("a scrape queried devices");
+            return;
+        }
+        state.setBytesProcessed(bytes);
+        state.counter("scrapes", static_cast<double>(server.scrapes()));
+    }
+
+    void Metrics_Render_8(Bench::State& state) { runRender(state, 8); }
+    void Metrics_Render_1k(Bench::State& state) { runRender(state, 1000); }
+    void Metrics_Scrape_8(Bench::State& state) { runScrape(state, 8); }
+    void Metrics_Scrape_1k(Bench::State& state) { runScrape(state, 1000); }
+
+    BENCHMARK(Metrics_Render_8);
+    BENCHMARK(Metrics_Render_1k);
+    BENCHMARK(Metrics_Scrape_8);
+    BENCHMARK(Metrics_Scrape_1k);
+}
@@ -0,0 +1,299 @@
+#include "Bench.h"
+#include "LegacyConfigParser.h"
+#include "PatternMatcher.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Device matching at 10k rules x 10k names: the compiled PatternMatcher
+// against the previous linear scan, address-pinned lookups, plus a fuzz pass
+// checking the automata against a straightforward reference matcher.
+// One op is one device name matched against the whole rule set.
+
+namespace {
+    constexpr size_t RULE_COUNT = 10000;
+    constexpr size_t NAME_COUNT = 10000;
+
+    std::string number(size_t i) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%05zu", i);
+        return buffer;
+    }
+
+    // Rule shapes the legacy matcher understands: trailing-'*' prefixes,
+    // exact names and (a quarter of the rules) device-name substrings
+    Config makeLegacyConfig() {
+        Config config;
+        config.caseInsensitivePatterns = false;
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            switch (i % 4) {
+                case 0: config.namePatterns.push_back("Razer Model " + number(i) + "*"); break;
+                case 1: config.namePatterns.push_back("BSK " + number(i)); break;
+                case 2: config.namePatterns.push_back("Mouse-" + number(i) + "*"); break;
+                default: config.devices.push_back({"Keyboard " + number(i), "BTHLE\\DEV_*", true, ""}); break;
+            }
+        }
+        return config;
+    }
+
+    // Globs with '*' and '?' anywhere
+    Config makeGlobConfig() {
+        Config config;
+        config.caseInsensitivePatterns = true;
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            switch (i % 4) {
+                case 0: config.namePatterns.push_back("razer*" + number(i) + "*"); break;
+                case 1: config.namePatterns.push_back("BSK?" + number(i)); break;
+                case 2: config.namePatterns.push_back("*Mouse " + number(i)); break;
+                default: config.namePatterns.push_back("Kb*-" + number(i) + "-?"); break;
+            }
+        }
+        return config;
+    }
+
+    // Names drawn from twice the rule range, so most miss every rule
+    std::vector<std::string> makeNames() {
+        std::mt19937 rng(7);
+        std::vector<std::string> names;
+        names.reserve(NAME_COUNT);
+        for (size_t i = 0; i < NAME_COUNT; i++) {
+            std::string n = number(rng() % (RULE_COUNT * 2));
+            switch (i % 6) {
+                case 0: names.push_back("Razer Model " + n + " Pro"); break;
+                case 1: names.push_back("BSK " + n); break;
+                case 2: names.push_back("Mouse-" + n); break;
+                case 3: names.push_back("Wireless Keyboard " + n + " (BT)"); break;
+                case 4: names.push_back("Kbd-" + n + "-X"); break;
+                default: names.push_back("Unrelated Headset " + n); break;
+            }
+        }
+        return names;
+    }
+
+    const std::vector<std::string>& names() {
+        static const std::vector<std::string> generated = makeNames();
+        return generated;
+    }
+
+    std::string instanceId(uint64_t address) {
+        char buffer[48];
+        std::snprintf(buffer, sizeof(buffer), "BTHLE\\DEV_%012llX\\7&1A2B3C4D&0&%04u",
+                      static_cast<unsigned long long>(address), static_cast<unsigned>(address % 10000));
+        return buffer;
+    }
+
+    // One instance ID per name (parallel to names())
+    const std::vector<std::string>& instanceIds() {
+        static const std::vector<std::string> generated = [] {
+            std::vector<std::string> ids;
+            for (size_t i = 0; i < NAME_COUNT; i++) ids.push_back(instanceId(0xC8A200000000ull + i * 7));
+            return ids;
+        }();
+        return generated;
+    }
+
+    // Every device pinned by address; half of the probed IDs are configured
+    Config makePinnedConfig() {
+        Config config;
+        config.caseInsensitivePatterns = false;
+        for (size_t i = 0; i < RULE_COUNT; i++) {
+            std::string id = instanceId(0xC8A200000000ull + i * 14);
+            config.devices.push_back({"BSK MOBILE", id.substr(0, 22), true, ""});
+        }
+        return config;
+    }
+
+    void PatternMatch_10kx10k_Compiled(Bench::State& state) {
+        static const Config config = makeLegacyConfig();
+        static const PatternMatcher matcher(config);
+        static PatternMatcher::Cache cache;
+        const auto& inputs = names();
+        const auto& ids = instanceIds();
+        size_t matched = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            matched += matcher.match(inputs[i % inputs.size()], ids[i % ids.size()], cache).has_value();
+        }
+        state.counter("matched", static_cast<double>(matched) / state.iterations());
+        state.counter("dfa_states", static_cast<double>(cache.states()));
+    }
+
+    void PatternMatch_10kx10k_Legacy(Bench::State& state) {
+        static const Config config = makeLegacyConfig();
+        const auto& inputs = names();
+        size_t matched = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            matched += LegacyConfigParser::matchesDevicePatterns(inputs[i % inputs.size()], config);
+        }
+        state.counter("matched", static_cast<double>(matched) / state.iterations());
+    }
+
+    void PatternMatch_10kx10k_Globs(Bench::State& state) {
+        static const Config config = makeGlobConfig();
+        static const PatternMatcher matcher(config);
+        static PatternMatcher::Cache cache;
+        const auto& inputs = names();
+        const auto& ids = instanceIds();
+        size_t matched = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            matched += matcher.match(inputs[i % inputs.size()], ids[i % ids.size()], cache).has_value();
+        }
+        state.counter("matched", static_cast<double>(matched) / state.iterations());
+        state.counter("dfa_states", static_cast<double>(cache.states()));
+    }
+
+    // Identical names, told apart only by their Bluetooth address
+    void PatternMatch_10kx10k_Pinned(Bench::State& state) {
+        static const Config config = makePinnedConfig();
+        static const PatternMatcher matcher(config);
+        PatternMatcher::Cache cache;
+        const auto& ids = instanceIds();
+        size_t matched = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            matched += matcher.match("BSK MOBILE", ids[i % ids.size()], cache).has_value();
+        }
+        state.counter("matched", static_cast<double>(matched) / state.iterations());
+        state.counter("pinned", static_cast<double>(matcher.pinnedDevices()));
+    }
+
+    // One op compiles the full 10k rule set
+    void PatternMatch_Compile_10k(Bench::State& state) {
+        static const Config config = makeGlobConfig();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            PatternMatcher matcher(config);
+            Bench::doNotOptimize(matcher);
+        }
+    }
+
+    BENCHMARK(PatternMatch_10kx10k_Compiled);
+    BENCHMARK(PatternMatch_10kx10k_Legacy);
+    BENCHMARK(PatternMatch_10kx10k_Globs);
+    BENCHMARK(PatternMatch_10kx10k_Pinned);
+    BENCHMARK(PatternMatch_Compile_10k);
+
+    // Reference matcher: backtracking glob over decoded code points
+    std::vector<uint32_t> codePoints(const std::string& utf8, bool ignoreCase) {
+        std::vector<uint32_t> out;
+        for (size_t i = 0; i < utf8.size();) {
+            auto b = static_cast<unsigned char>(utf8[i]);
+            int length = b < 0x80 ? 1 : b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+            uint32_t cp = length == 1 ? b : b & (0x7F >> length);
+            for (int k = 1; k < length; k++) {
+                cp = (cp << 6) | (static_cast<unsigned char>(utf8[i + k]) & 0x3F);
+            }
+            if (ignoreCase && cp >= 'A' && cp <= 'Z') cp += 'a' - 'A';
+            out.push_back(cp);
+            i += length;
+        }
+        return out;
+    }
+
+    bool referenceGlob(const uint32_t* p, size_t pn, const uint32_t* s, size_t sn) {
+        if (pn == 0) return sn == 0;
+        if (*p == '*') {
+            for (size_t k = 0; k <= sn; k++) {
+                if (referenceGlob(p + 1, pn - 1, s + k, sn - k)) return true;
+            }
+            return false;
+        }
+        if (sn == 0) return false;
+        if (*p == '?' || *p == *s) return referenceGlob(p + 1, pn - 1, s + 1, sn - 1);
+        return false;
+    }
+
+    bool referenceContains(const std::vector<uint32_t>& haystack, const std::vector<uint32_t>& needle) {
+        if (needle.empty() || needle.size() > haystack.size()) return false;
+        for (size_t i = 0; i + needle.size() <= haystack.size(); i++) {
+            if (std::equal(needle.begin(), needle.end(), haystack.begin() + i)) return true;
+        }
+        return false;
+    }
+
+    // Small alphabet so rules collide, overlap and share prefixes
+    std::string randomText(std::mt19937& rng, size_t maxLength, bool glob) {
+        static const char* const pieces[] = {"a", "b", "A", "B", " ", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80"};
+        std::string text;
+        size_t length = rng() % (maxLength + 1);
+        for (size_t i = 0; i < length; i++) {
+            unsigned pick = rng() % (glob ? 11 : 8);
+            text += pick < 8 ? pieces[pick] : pick < 10 ? "*" : "?";
+        }
+        return text;
+    }
+
+    // Instance IDs over a handful of addresses, and instanceIdPatterns that
+    // pin one of them, constrain by glob, or leave the ID unconstrained
+    const char* const FUZZ_INSTANCE_IDS[] = {
+        "BTHLE\\DEV_00000000000A\\7&1", "BTHLE\\DEV_00000000000B\\7&2",
+        "BTHLE\\DEV_0000000000AB\\7&3", "USB\\VID_1532&PID_0001\\5&4",
+    };
+    const char* const FUZZ_INSTANCE_PATTERNS[] = {
+        "", "", "BTHLE\\DEV_*", "bthle\\dev_0000000000A?*", "USB\\*",
+        "BTHLE\\DEV_00000000000A", "bthle\\dev_00000000000b\\*",
+    };
+
+    void PatternMatch_Fuzz_AgainstReference(Bench::State& state) {
+        std::mt19937 rng(42);
+        for (uint64_t iteration = 0; iteration < state.iterations(); iteration++) {
+            bool ignoreCase = rng() % 2;
+            std::vector<std::string> globs(rng() % 6);
+            std::vector<DevicePattern> devices(rng() % 6);
+            for (auto& g : globs) g = randomText(rng, 6, true);
+            for (auto& d : devices) {
+                d.name = randomText(rng, 4, false);
+                d.instanceIdPattern = FUZZ_INSTANCE_PATTERNS[rng() % std::size(FUZZ_INSTANCE_PATTERNS)];
+                d.enabled = rng() % 5 != 0;
+            }
+            PatternMatcher matcher(globs, devices, ignoreCase);
+            PatternMatcher::Cache cache;
+
+            for (int n = 0; n < 8; n++) {
+                std::string name = randomText(rng, 10, false);
+                std::string instanceId = FUZZ_INSTANCE_IDS[rng() % std::size(FUZZ_INSTANCE_IDS)];
+                auto nameCp = codePoints(name, ignoreCase);
+                auto instanceCp = codePoints(instanceId, true);
+
+                std::optional<PatternMatcher::Match> expected;
+                for (size_t i = 0; i < globs.size() && !expected; i++) {
+                    auto globCp = codePoints(globs[i], ignoreCase);
+                    if (referenceGlob(globCp.data(), globCp.size(), nameCp.data(), nameCp.size())) {
+                        expected = PatternMatcher::Match{PatternMatcher::Match::Kind::NamePattern, static_cast<uint32_t>(i)};
+                    }
+                }
+                for (size_t i = 0; i < devices.size() && !expected; i++) {
+                    const auto& d = devices[i];
+                    if (!d.enabled) continue;
+                    bool matches;
+                    // Pins: a full 12-digit address with nothing but "\..." after it
+                    std::string_view pattern = d.instanceIdPattern;
+                    bool pin = pattern.size() >= 22 && (pattern.size() == 22 || pattern[22] == '\\') &&
+                               std::all_of(pattern.begin() + 10, pattern.begin() + 22,
+                                           [](char c) { return std::isxdigit(static_cast<unsigned char>(c)) != 0; });
+                    if (pin) {
+                        auto patternCp = codePoints(std::string(pattern.substr(0, 22)), true);
+                        matches = std::equal(patternCp.begin(), patternCp.end(), instanceCp.begin());
+                    } else {
+                        auto patternCp = codePoints(d.instanceIdPattern, true);
+                        matches = referenceContains(nameCp, codePoints(d.name, ignoreCase)) &&
+                                  (pattern.empty() || referenceGlob(patternCp.data(), patternCp.size(),
+                                                                    instanceCp.data(), instanceCp.size()));
+                    }
+                    if (matches) {
+                        expected = PatternMatcher::Match{PatternMatcher::Match::Kind::Device, static_cast<uint32_t>(i)};
+                    }
+                }
+
+                auto actual = matcher.match(name, instanceId, cache);
+                if (actual.has_value() != expected.has_value() ||
+                    (actual && (actual->kind != expected->kind || actual->index != expected->index))) {
+                    state.fail("mismatch on iteration " + std::to_string(iteration) + " for \"" + name + "\"");
+                    return;
+                }
+            }
+        }
+    }
+    BENCHMARK(PatternMatch_Fuzz_AgainstReference);
+}
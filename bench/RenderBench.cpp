@@ -0,0 +1,103 @@
+#include "Bench.h"
+#include "ConfigManager.h"
+#include "ConfigStore.h"
+#include "DeviceMonitor.h"
+#include "FakeDeviceBackend.h"
+#include "IconRaster.h"
+#include "RefreshArena.h"
+#include "Tooltip.h"
+#include <cstdio>
+#include <memory>
+
+// The rest of a refresh cycle after the device queries: drawing the icon
+// (one op is one 16x16 battery at a level from 0 to 100 or unknown),
+// building the tooltip in the refresh arena (one op is one tooltip), and
+// diffing a reloaded config against the running snapshot (one op is one
+// ConfigStore::publish of a 10k-rule config whose rules did not change, so
+// the compiled matcher must be reused rather than rebuilt).
+
+namespace {
+    void Render_BatteryIcon(Bench::State& state) {
+        IconRaster::Pixels pixels;
+
+        // Full and empty differ inside the body; the outline is always there
+        IconRaster::drawBattery(pixels, 100, 0x0000C800);
+        uint32_t full = pixels[IconRaster::SIZE * 8 + 8];
+        IconRaster::drawBattery(pixels, 0, 0x0000C800);
+        if (full != 0x00C800 || pixels[IconRaster::SIZE * 8 + 8] != 0 || pixels[IconRaster::SIZE * 8 + 3] != 0x00C800) {
+            state.fail("icon drawn wrong");
+            return;
+        }
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            int level = static_cast<int>(i % 102);
+            IconRaster::drawBattery(pixels, level == 101 ? std::nullopt : std::optional<int>(level), 0x0000C800);
+            Bench::doNotOptimize(pixels);
+        }
+    }
+
+    // NOTIFYICONDATAW::szTip holds 127 characters
+    constexpr size_t TOOLTIP_LIMIT = 127;
+
+    void runTooltip(Bench::State& state, size_t deviceCount) {
+        auto backend = std::make_shared<FakeDeviceBackend>(deviceCount);
+        DeviceMonitor monitor(backend);
+        auto devices = monitor.enumerateRazerDevices();
+        monitor.updateDeviceInfo(devices);
+
+        RefreshArena arena;
+        size_t length = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            RefreshArena::Scope cycle(arena);
+            std::pmr::wstring text(arena.resource());
+            text.reserve(512);
+            Tooltip::build(text, devices, monitor.strings(), std::nullopt, Tooltip::TimeOfDay{12, 34, 56},
+                           TOOLTIP_LIMIT);
+            length = text.size();
+        }
+        if (length > TOOLTIP_LIMIT) {
+            state.fail("tooltip longer than the shell allows");
+            return;
+        }
+        state.counter("chars", static_cast<double>(length));
+    }
+
+    Config makeConfig(size_t ruleCount) {
+        ConfigManager configMgr;
+        Config config = configMgr.getDefaultConfig();
+        for (size_t i = 0; i < ruleCount; i++) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "Razer*%05zu*", i);
+            if (i % 2) {
+                config.namePatterns.push_back(name);
+            } else {
+                config.devices.push_back({name + 6, "BTHLE\\DEV_*", true, "Device"});
+            }
+        }
+        return config;
+    }
+
+    void Snapshot_Diff_10k(Bench::State& state) {
+        static const Config config = makeConfig(10000);
+        ConfigStore store("unused.json", false);
+        store.publish(config);
+        auto first = store.current();
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Config edited = config;
+            edited.refreshInterval = 60 + static_cast<int>(i % 2);
+            store.publish(std::move(edited));
+        }
+        if (store.current()->matcher != first->matcher) {
+            state.fail("unchanged rules were recompiled");
+        }
+        state.counter("rules", static_cast<double>(config.namePatterns.size() + config.devices.size()));
+    }
+
+    void Render_Tooltip_8(Bench::State& state) { runTooltip(state, 8); }
+    void Render_Tooltip_100(Bench::State& state) { runTooltip(state, 100); }
+    BENCHMARK(Render_BatteryIcon);
+    BENCHMARK(Render_Tooltip_8);
+    BENCHMARK(Render_Tooltip_100);
+    BENCHMARK(Snapshot_Diff_10k);
+}
@@ -0,0 +1,194 @@
+#include "AllocationCounter.h"
+#include "Bench.h"
+#include "DeviceMonitor.h"
+#include "FakeDeviceBackend.h"
+#include "RecordingBackend.h"
+#include "ReplayBackend.h"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <thread>
+
+// Device recording and replay. Replay_Record_1k is what capturing costs on
+// top of a refresh of 1000 devices (one op is one recorded refresh).
+// Replay_Stepped records a session of devices flapping between connected and
+// disconnected, vanishing, and reporting out-of-range levels, then steps a
+// monitor through the replay with seek() and checks every step reproduces
+// what was recorded (one op is one step). Replay_Refresh_1k_1000x refreshes
+// 1000 replayed devices while the recording plays at 1000x.
+
+namespace {
+    // Readings that change with every step the bench takes
+    class FlappingBackend : public DeviceBackend {
+    public:
+        explicit FlappingBackend(size_t count) : count(count), step(0) {}
+
+        static Reading reading(size_t device, size_t step) {
+            Reading reading = {true, static_cast<int>((device * 7 + step * 13) % 101), (device + step) % 2 == 0};
+            if (step % 5 == 4) reading.batteryLevel = device % 2 ? 255 : -3;  // driver garbage
+            if (step % 6 == 5) reading.batteryLevel.reset();
+            if ((device + step) % 9 == 8) reading = {false, std::nullopt, false};
+            return reading;
+        }
+
+        void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override {
+            for (size_t i = 0; i < count; i++) {
+                char name[48];
+                char instanceId[48];
+                std::snprintf(name, sizeof(name), "Razer Flapper %06zu", i);
+                std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\FLAP_%06zu", i);
+                onDevice(name, instanceId);
+            }
+        }
+
+        Reading query(std::string_view instanceId) override {
+            size_t device = 0;
+            std::string_view digits = instanceId.substr(instanceId.size() - 6);
+            std::from_chars(digits.data(), digits.data() + digits.size(), device);
+            return reading(device, step);
+        }
+
+        size_t count;
+        size_t step;
+    };
+
+    // Record steps refreshes of count flapping devices; consecutive steps
+    // are a millisecond apart so each has its own span of recorded time
+    bool recordSession(const std::filesystem::path& path, size_t count, size_t steps) {
+        auto source = std::make_shared<FlappingBackend>(count);
+        auto recorder = std::make_shared<RecordingBackend>(source, path);
+        if (!recorder->isRecording()) return false;
+
+        DeviceMonitor monitor(recorder);
+        auto devices = monitor.enumerateRazerDevices();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        for (size_t step = 0; step < steps; step++) {
+            source->step = step;
+            monitor.updateDeviceInfo(devices);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return devices.size() == count;
+    }
+
+    std::filesystem::path recordingPath(const char* fileName) {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+        std::filesystem::create_directories(dir);
+        return dir / fileName;
+    }
+
+    void Replay_Record_1k(Bench::State& state) {
+        std::filesystem::path path = recordingPath("record.rzrec");
+        {
+            auto recorder = std::make_shared<RecordingBackend>(std::make_shared<FakeDeviceBackend>(1000), path);
+            DeviceMonitor monitor(recorder);
+            auto devices = monitor.enumerateRazerDevices();
+
+            size_t allocationsBefore = AllocationCounter::count();
+            for (uint64_t i = 0; i < state.iterations(); i++) {
+                monitor.updateDeviceInfo(devices);
+            }
+            size_t allocations = AllocationCounter::count() - allocationsBefore;
+            recorder->flush();
+
+            std::error_code ignored;
+            double queries = static_cast<double>(devices.size() * state.iterations());
+            state.counter("bytesPerQuery", static_cast<double>(std::filesystem::file_size(path, ignored)) / queries);
+            if (AllocationCounter::enabled()) {
+                state.counter("allocsPerRefresh", static_cast<double>(allocations) / static_cast<double>(state.iterations()));
+            }
+        }
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+
+    void Replay_Stepped(Bench::State& state) {
+        constexpr size_t DEVICES = 8;
+        constexpr size_t STEPS = 60;
+        std::filesystem::path path = recordingPath("stepped.rzrec");
+        bool recorded = recordSession(path, DEVICES, STEPS);
+        auto replay = ReplayBackend::open(path);
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+        if (!recorded || !replay || replay->queryCount() != DEVICES * STEPS) {
+            state.fail("recording did not round-trip");
+            return;
+        }
+
+        // The last event before each millisecond gap ends a step
+        std::vector<uint64_t> times = replay->eventTimes();
+        std::vector<uint64_t> stepEnds;
+        for (size_t i = 1; i < times.size(); i++) {
+            if (times[i] - times[i - 1] >= 500) stepEnds.push_back(times[i - 1]);
+        }
+        stepEnds.push_back(times.back());
+        stepEnds.erase(stepEnds.begin());  // the enumeration, before the first step
+        if (stepEnds.size() != STEPS) {
+            state.fail("steps not separable in the recording");
+            return;
+        }
+
+        replay->setSpeed(0);
+        DeviceMonitor monitor(replay);
+        auto devices = monitor.enumerateRazerDevices();
+        for (size_t step = 0; step < STEPS; step++) {
+            replay->seek(stepEnds[step]);
+            monitor.updateDeviceInfo(devices);
+            for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+                // Out-of-range levels come back raw and are stored as unknown
+                DeviceBackend::Reading expected = FlappingBackend::reading(row, step);
+                DeviceBackend::Reading raw = replay->query(monitor.strings().view(devices.instanceId(row)));
+                if (raw.present != expected.present || raw.batteryLevel != expected.batteryLevel) {
+                    state.fail("replay changed a recorded reading");
+                    return;
+                }
+                std::optional<int> level = expected.present ? expected.batteryLevel : std::nullopt;
+                if (level.has_value() && (*level < 0 || *level > 100)) level.reset();
+                if (devices.batteryLevel(row) != level ||
+                    devices.isConnected(row) != (expected.present && expected.isConnected)) {
+                    state.fail("replayed readings differ from the recording");
+                    return;
+                }
+            }
+        }
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            replay->seek(stepEnds[i % STEPS]);
+            monitor.updateDeviceInfo(devices);
+        }
+        state.counter("steps", static_cast<double>(STEPS));
+        state.counter("recordedMs", static_cast<double>(replay->duration()) / 1000.0);
+    }
+
+    void Replay_Refresh_1k_1000x(Bench::State& state) {
+        std::filesystem::path path = recordingPath("refresh.rzrec");
+        bool recorded = recordSession(path, 1000, 20);
+        std::error_code ignored;
+        uintmax_t bytes = std::filesystem::file_size(path, ignored);
+        auto replay = ReplayBackend::open(path);
+        std::filesystem::remove(path, ignored);
+        if (!recorded || !replay) {
+            state.fail("recording did not round-trip");
+            return;
+        }
+
+        DeviceMonitor monitor(replay);
+        auto devices = monitor.enumerateRazerDevices();
+        replay->seek(0);
+        replay->setSpeed(1000);
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            monitor.updateDeviceInfo(devices);
+        }
+        if (devices.size() != 1000) {
+            state.fail("replayed enumeration lost devices");
+            return;
+        }
+        state.counter("devices", static_cast<double>(devices.size()));
+        state.counter("bytesPerQuery", static_cast<double>(bytes) / static_cast<double>(replay->queryCount()));
+    }
+
+    BENCHMARK(Replay_Record_1k);
+    BENCHMARK(Replay_Stepped);
+    BENCHMARK(Replay_Refresh_1k_1000x);
+}
@@ -0,0 +1,191 @@
+#include "Bench.h"
+#include "BluetoothAddress.h"
+#include "MultiSourceBackend.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Enumeration across several device sources (MultiSourceBackend), one op
+// being one merged enumerate().
+//
+// Sources_Parallel_4 lists four sources that take 5, 10, 15 and 20 ms
+// each (a SetupAPI enumerator is in that range): it fails unless an op
+// takes less than the sources' sum (run one after the other: 50 ms) and
+// reports the op against the slowest source (~1.0 when fully parallel).
+// Sources_Merge_1k lists 1,000 Bluetooth devices as BTHLE nodes and again
+// as classic BTHENUM device and service nodes, plus 1,000 USB nodes; it
+// fails unless each device comes out once and queries reach the source
+// that listed it. Sources_Identity parses hardware identities of every
+// kind of node and fails on a wrong one.
+
+namespace {
+    // A fixed listing, optionally slow; query() answers only for its own
+    // instance IDs (present, level 50) to check routing
+    class ListBackend : public DeviceBackend {
+    public:
+        ListBackend(std::vector<std::pair<std::string, std::string>> devices, std::chrono::milliseconds delay)
+            : devices(std::move(devices)), delay(delay) {}
+
+        void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override {
+            std::this_thread::sleep_for(delay);
+            for (const auto& [name, instanceId] : devices) {
+                onDevice(name, instanceId);
+            }
+        }
+
+        Reading query(std::string_view instanceId) override {
+            for (const auto& device : devices) {
+                if (device.second == instanceId) return {true, 50, true};
+            }
+            return {false, std::nullopt, false};
+        }
+
+    private:
+        std::vector<std::pair<std::string, std::string>> devices;
+        std::chrono::milliseconds delay;
+    };
+
+    std::string hexAddress(size_t i) {
+        char address[16];
+        std::snprintf(address, sizeof(address), "C8A2D3%06zX", i);
+        return address;
+    }
+
+    MultiSourceBackend::Source makeSource(const char* name, std::vector<std::pair<std::string, std::string>> devices,
+                                          int delayMilliseconds = 0) {
+        return {name, std::string(name) + "\\",
+                std::make_shared<ListBackend>(std::move(devices), std::chrono::milliseconds(delayMilliseconds))};
+    }
+
+    void Sources_Parallel_4(Bench::State& state) {
+        const int delays[] = {5, 10, 15, 20};
+        const char* names[] = {"BTHLE", "BTHENUM", "USB", "HID"};
+        std::vector<MultiSourceBackend::Source> sources;
+        for (size_t s = 0; s < 4; s++) {
+            std::vector<std::pair<std::string, std::string>> devices;
+            for (size_t i = 0; i < 25; i++) {
+                devices.emplace_back("Device " + std::to_string(i), std::string(names[s]) + "\\VID_1532&PID_" +
+                                     std::to_string(s * 100 + i) + "\\0");
+            }
+            sources.push_back(makeSource(names[s], std::move(devices), delays[s]));
+        }
+        MultiSourceBackend backend(std::move(sources));
+
+        size_t found = 0;
+        auto started = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            found = 0;
+            backend.enumerate([&](std::string_view, std::string_view) { found++; });
+        }
+        double perOp = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count() /
+                       static_cast<double>(state.iterations());
+
+        double serial = 0.0;
+        double slowest = 0.0;
+        for (const auto& timing : backend.lastEnumeration()) {
+            double milliseconds = static_cast<double>(timing.nanoseconds) / 1e6;
+            serial += milliseconds;
+            if (milliseconds > slowest) slowest = milliseconds;
+        }
+        state.counter("devices", static_cast<double>(found));
+        state.counter("serialMs", serial);
+        state.counter("vsSlowest", perOp / slowest);
+        if (found != 100) {
+            state.fail("merged enumeration lost or repeated devices");
+        } else if (perOp >= serial) {
+            state.fail("sources were enumerated one after the other");
+        }
+    }
+
+    void Sources_Merge_1k(Bench::State& state) {
+        constexpr size_t COUNT = 1000;
+        std::vector<std::pair<std::string, std::string>> le;
+        std::vector<std::pair<std::string, std::string>> classic;
+        std::vector<std::pair<std::string, std::string>> usb;
+        for (size_t i = 0; i < COUNT; i++) {
+            std::string name = "Razer Device " + std::to_string(i);
+            std::string address = hexAddress(i);
+            le.emplace_back(name, "BTHLE\\DEV_" + address + "\\7&1A2B3C&0&0");
+            classic.emplace_back(name, "BTHENUM\\DEV_" + address + "\\7&2B3C4D&0&BLUETOOTHDEVICE_" + address);
+            classic.emplace_back(name + " Hands-Free AG",
+                                 "BTHENUM\\{0000111E-0000-1000-8000-00805F9B34FB}_LOCALMFG&0002\\7&3C4D5E&0&" + address +
+                                 "_C00000000");
+            usb.emplace_back("Razer Dongle " + std::to_string(i), "USB\\VID_1532&PID_00B7\\" + std::to_string(i));
+        }
+        std::vector<MultiSourceBackend::Source> sources;
+        sources.push_back(makeSource("BTHLE", std::move(le)));
+        sources.push_back(makeSource("BTHENUM", std::move(classic)));
+        sources.push_back(makeSource("USB", std::move(usb)));
+        MultiSourceBackend backend(std::move(sources));
+
+        size_t found = 0;
+        size_t fromBluetoothLe = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            found = fromBluetoothLe = 0;
+            backend.enumerate([&](std::string_view, std::string_view instanceId) {
+                found++;
+                if (backend.sourceOf(instanceId) == "BTHLE") fromBluetoothLe++;
+            });
+        }
+
+        auto timings = backend.lastEnumeration();
+        state.counter("devices", static_cast<double>(found));
+        state.counter("duplicates", static_cast<double>(timings.size() == 3 ? timings[1].duplicates : 0));
+        if (found != 2 * COUNT || fromBluetoothLe != COUNT || timings.size() != 3 || timings[1].duplicates != 2 * COUNT) {
+            state.fail("duplicates were not merged by Bluetooth address");
+            return;
+        }
+        std::string classicNode = "BTHENUM\\DEV_" + hexAddress(7) + "\\7&2B3C4D&0&BLUETOOTHDEVICE_" + hexAddress(7);
+        if (!backend.query(classicNode).present || !backend.query("USB\\VID_1532&PID_00B7\\7").present ||
+            backend.query("PCI\\VEN_8086").present) {
+            state.fail("queries did not reach the source that listed the device");
+        }
+    }
+
+    void Sources_Identity(Bench::State& state) {
+        struct Case {
+            const char* instanceId;
+            std::optional<uint64_t> address;
+        };
+        const Case cases[] = {
+            {"BTHLE\\DEV_C8A2D3E4F501\\7&1A2B3C&0&0", 0xC8A2D3E4F501},
+            {"bthle\\dev_c8a2d3e4f501", 0xC8A2D3E4F501},
+            {"BTHLE\\DEV_C8A2D3E4F501X", std::nullopt},
+            {"BTHLE\\DEV_*", std::nullopt},
+            {"bthenum\\Dev_C8A2D3E4F501\\7&2B3C4D&0&BLUETOOTHDEVICE_C8A2D3E4F501", 0xC8A2D3E4F501},
+            {"BTHENUM\\{0000111E-0000-1000-8000-00805F9B34FB}_LOCALMFG&0002\\7&3C4D5E&0&C8A2D3E4F501_C00000000",
+             0xC8A2D3E4F501},
+            {"hid-c8:a2:d3:e4:f5:01-battery", 0xC8A2D3E4F501},
+            {"hid-0003:1532:00B7.0005-battery", std::nullopt},
+            {"BTHENUM\\{0000111E-0000-1000-8000-00805F9B34FB}_LOCALMFG&0000\\7&3C4D5E&0&000000000000_00000000",
+             std::nullopt},
+            {"BTHENUM\\DEV_C8A2D3E4F5", std::nullopt},
+            {"USB\\VID_1532&PID_00B7\\6&1A2B3C&0&1", std::nullopt},
+        };
+        bool correct = true;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            for (const auto& c : cases) {
+                auto address = BluetoothAddress::fromDeviceNode(c.instanceId);
+                if (address != c.address) correct = false;
+                Bench::doNotOptimize(address);
+            }
+        }
+        if (!correct) {
+            state.fail("a device node's Bluetooth address was parsed wrongly");
+        } else if (MultiSourceBackend::identityOf("USB\\VID_1532&PID_00B7\\1") !=
+                       MultiSourceBackend::identityOf("usb\\vid_1532&pid_00b7\\1") ||
+                   MultiSourceBackend::identityOf("USB\\VID_1532&PID_00B7\\1") ==
+                       MultiSourceBackend::identityOf("USB\\VID_1532&PID_00B7\\2")) {
+            state.fail("instance ID identities do not fold case or collide");
+        }
+    }
+
+    BENCHMARK(Sources_Parallel_4);
+    BENCHMARK(Sources_Merge_1k);
+    BENCHMARK(Sources_Identity);
+}
@@ -0,0 +1,212 @@
+#include "Bench.h"
+#include "ConfigCache.h"
+#include "ConfigManager.h"
+#include "ConfigStore.h"
+#include "DeviceStateCache.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Startup config load: the cold path (map config.json, parse, compile the
+// pattern tables) against the warm path (hash config.json, map config.cache
+// and decode it). One op is one ConfigStore::reload() into a fresh store,
+// as at launch. The warm benchmarks first check that the decoded snapshot
+// is identical to the parsed config and matches the same devices, and that
+// two compiles of the same config save byte-identical snapshots.
+// Startup_DeviceCache_Load is the other step before the first icon: reading
+// the last known devices (devices.cache).
+
+namespace {
+    std::string number(size_t i) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "%05zu", i);
+        return buffer;
+    }
+
+    Config makeConfig(size_t ruleCount) {
+        ConfigManager configMgr;
+        Config config = configMgr.getDefaultConfig();
+        config.caseInsensitivePatterns = true;
+        for (size_t i = 0; i < ruleCount; i++) {
+            switch (i % 5) {
+                case 0: config.namePatterns.push_back("Razer*" + number(i) + "*"); break;
+                case 1: config.namePatterns.push_back("BSK?" + number(i)); break;
+                case 2: config.devices.push_back({"Keyboard " + number(i), "BTHLE\\DEV_*", true, "Keyboard"}); break;
+                case 3: config.devices.push_back({"Mouse " + number(i), "", i % 3 != 0, "Mouse"}); break;
+                default: {
+                    char address[32];
+                    std::snprintf(address, sizeof(address), "BTHLE\\DEV_%012zX", 0xC8A2D3000000 + i);
+                    config.devices.push_back({"Headset " + number(i), address, true, "Pinned headset"});
+                    break;
+                }
+            }
+        }
+        return config;
+    }
+
+    // A config.json (and its snapshot) written once per run, removed at exit
+    class ConfigFile {
+    public:
+        ConfigFile(const char* fileName, size_t ruleCount) {
+            std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+            std::filesystem::create_directories(dir);
+            path = dir / fileName;
+
+            ConfigManager configMgr;
+            configMgr.saveConfig(makeConfig(ruleCount), path);
+
+            ConfigStore store(path);
+            std::optional<JsonError> error;
+            store.reload(error);
+        }
+
+        ~ConfigFile() {
+            std::error_code ignored;
+            std::filesystem::remove(path, ignored);
+            std::filesystem::remove(ConfigCache::pathFor(path), ignored);
+        }
+
+        std::filesystem::path path;
+    };
+
+    const ConfigFile& smallConfig() {
+        static const ConfigFile file("startup_small.json", 8);
+        return file;
+    }
+
+    const ConfigFile& largeConfig() {
+        static const ConfigFile file("startup_10k.json", 10000);
+        return file;
+    }
+
+    std::shared_ptr<const ConfigSnapshot> loadOnce(const std::filesystem::path& path, bool useCache) {
+        ConfigStore store(path, useCache);
+        std::optional<JsonError> error;
+        return store.reload(error) ? store.current() : nullptr;
+    }
+
+    // The snapshot must round-trip: same Config, same match for every rule
+    // shape (glob, constrained substring, pinned address, miss)
+    bool sameResults(const ConfigSnapshot& parsed, const ConfigSnapshot& cached) {
+        if (!(parsed.config == cached.config)) return false;
+
+        PatternMatcher::Cache parsedCache;
+        PatternMatcher::Cache cachedCache;
+        for (size_t i = 0; i < 2000; i++) {
+            char address[40];
+            std::snprintf(address, sizeof(address), "BTHLE\\DEV_%012zX\\7&1", 0xC8A2D3000000 + i);
+            const std::string candidates[] = {
+                "razer x" + number(i) + "y", "BSK-" + number(i), "My Keyboard " + number(i),
+                "Mouse " + number(i), "Unrelated " + number(i),
+            };
+            for (const auto& name : candidates) {
+                auto a = parsed.matcher->match(name, address, parsedCache);
+                auto b = cached.matcher->match(name, address, cachedCache);
+                if (a.has_value() != b.has_value()) return false;
+                if (a && (a->kind != b->kind || a->index != b->index)) return false;
+            }
+        }
+        return true;
+    }
+
+    // Saves both snapshots and compares the files
+    bool sameSnapshotFile(const ConfigSnapshot& a, const ConfigSnapshot& b, const std::filesystem::path& configPath) {
+        std::filesystem::path first = configPath;
+        std::filesystem::path second = configPath;
+        first.replace_extension(".first.cache");
+        second.replace_extension(".second.cache");
+        bool same = ConfigCache::save(first, ConfigCache::Stamp{}, a.config, *a.matcher) &&
+                    ConfigCache::save(second, ConfigCache::Stamp{}, b.config, *b.matcher) &&
+                    MappedFile(first).contents() == MappedFile(second).contents();
+        std::error_code ignored;
+        std::filesystem::remove(first, ignored);
+        std::filesystem::remove(second, ignored);
+        return same;
+    }
+
+    void runLoad(Bench::State& state, const ConfigFile& file, bool useCache) {
+        if (useCache) {
+            auto parsed = loadOnce(file.path, false);
+            auto cached = loadOnce(file.path, true);
+            if (!parsed || !cached || !cached->fromCache) {
+                state.fail("snapshot was not used");
+                return;
+            }
+            if (!sameResults(*parsed, *cached)) {
+                state.fail("snapshot differs from parsed config");
+                return;
+            }
+            auto parsedAgain = loadOnce(file.path, false);
+            if (!parsedAgain || !sameSnapshotFile(*parsed, *parsedAgain, file.path)) {
+                state.fail("the same config saved different snapshot files");
+                return;
+            }
+        }
+
+        size_t rules = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto snapshot = loadOnce(file.path, useCache);
+            if (!snapshot) {
+                state.fail("config load failed");
+                return;
+            }
+            rules = snapshot->config.namePatterns.size() + snapshot->config.devices.size();
+            Bench::doNotOptimize(snapshot);
+        }
+
+        std::error_code ignored;
+        state.setBytesProcessed(std::filesystem::file_size(file.path, ignored) * state.iterations());
+        state.counter("rules", static_cast<double>(rules));
+        if (useCache) {
+            auto cacheBytes = std::filesystem::file_size(ConfigCache::pathFor(file.path), ignored);
+            state.counter("snapshotKB", static_cast<double>(cacheBytes) / 1024.0);
+        }
+    }
+
+    void Startup_DeviceCache_Load(Bench::State& state) {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "razertray_bench" / "devices.cache";
+        std::filesystem::create_directories(path.parent_path());
+
+        DeviceStateCache::State saved;
+        saved.savedAt = DeviceStateCache::now();
+        for (size_t i = 0; i < 8; i++) {
+            char instanceId[40];
+            std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\DEV_%012zX\\7&1", 0xC8A2D3000000 + i);
+            saved.devices.push_back({"Razer Device " + number(i), instanceId,
+                                     i % 3 ? std::optional<int>(static_cast<int>(i * 12)) : std::nullopt, i % 4 != 0});
+        }
+        if (!DeviceStateCache::save(path, saved)) {
+            state.fail("save failed");
+            return;
+        }
+
+        size_t devices = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto loaded = DeviceStateCache::load(path);
+            if (!loaded || loaded->devices.size() != saved.devices.size() ||
+                loaded->devices.back().batteryLevel != saved.devices.back().batteryLevel ||
+                loaded->devices.back().instanceId != saved.devices.back().instanceId) {
+                state.fail("device cache did not round-trip");
+                break;
+            }
+            devices = loaded->devices.size();
+        }
+        state.counter("devices", static_cast<double>(devices));
+
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+
+    void Startup_Small_ColdJson(Bench::State& state) { runLoad(state, smallConfig(), false); }
+    void Startup_Small_WarmSnapshot(Bench::State& state) { runLoad(state, smallConfig(), true); }
+    void Startup_10k_ColdJson(Bench::State& state) { runLoad(state, largeConfig(), false); }
+    void Startup_10k_WarmSnapshot(Bench::State& state) { runLoad(state, largeConfig(), true); }
+    BENCHMARK(Startup_Small_ColdJson);
+    BENCHMARK(Startup_Small_WarmSnapshot);
+    BENCHMARK(Startup_10k_ColdJson);
+    BENCHMARK(Startup_10k_WarmSnapshot);
+    BENCHMARK(Startup_DeviceCache_Load);
+}
@@ -0,0 +1,140 @@
+#include "Bench.h"
+#include "DeviceTable.h"
+#include "StatusSegment.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+// The --status shared-memory segment. Status_Publish_* is what the tray adds
+// to every icon update; Status_Read_* is a --status client's whole query
+// once the segment is open (one op is one consistent snapshot copied out).
+// Status_Read_Contended reads while a writer thread publishes generations in
+// which every device has the same level: every snapshot the reader accepts
+// must be one generation, not a mix (one op is one read attempt).
+
+namespace {
+    std::string segmentName(const char* suffix) {
+#ifdef _WIN32
+        return std::string("Local\\RazerTrayBench") + suffix;
+#else
+        return std::string("/razertray-bench-") + suffix;
+#endif
+    }
+
+    struct Fleet {
+        StringPool strings;
+        DeviceTable devices;
+    };
+
+    std::unique_ptr<Fleet> makeFleet(size_t count) {
+        auto fleet = std::make_unique<Fleet>();
+        fleet->devices.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            char name[48];
+            char instanceId[48];
+            std::snprintf(name, sizeof(name), "Razer Status Device %04zu", i);
+            std::snprintf(instanceId, sizeof(instanceId), "BTHLE\\STATUS_%04zu", i);
+            DeviceTable::Row row = fleet->devices.add(fleet->strings.intern(name), fleet->strings.intern(instanceId));
+            fleet->devices.update(row, static_cast<int>(i % 101), i % 3 != 0, 1);
+        }
+        return fleet;
+    }
+
+    void Status_Publish_8(Bench::State& state) {
+        auto fleet = makeFleet(8);
+        StatusSegment::Publisher publisher(segmentName("publish"));
+        if (!publisher.isValid()) {
+            state.fail("could not create the segment");
+            return;
+        }
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Bench::doNotOptimize(
+                publisher.publish(fleet->devices, fleet->strings, static_cast<int64_t>(i), std::nullopt, {}, {}));
+        }
+    }
+
+    // Readers copy into a caller buffer; a full Payload is ~180 KB
+    StatusSegment::Payload& readBuffer() {
+        static auto payload = std::make_unique<StatusSegment::Payload>();
+        return *payload;
+    }
+
+    void Status_Read_Contended(Bench::State& state) {
+        std::string name = segmentName("contended");
+        auto fleet = makeFleet(8);
+        StatusSegment::Publisher publisher(name);
+        StatusSegment::Reader reader(name);
+        if (!publisher.isValid() || !reader.isValid()) {
+            state.fail("could not open the segment");
+            return;
+        }
+
+        auto publishGeneration = [&](int generation) {
+            for (DeviceTable::Row row = 0; row < fleet->devices.size(); row++) {
+                fleet->devices.update(row, generation % 101, true, generation);
+            }
+            publisher.publish(fleet->devices, fleet->strings, generation, std::nullopt, {}, {});
+        };
+        publishGeneration(0);
+        std::atomic<bool> done = false;
+        std::thread writer([&] {
+            for (int generation = 1; !done.load(std::memory_order_relaxed); generation++) {
+                publishGeneration(generation);
+            }
+        });
+
+        StatusSegment::Payload& payload = readBuffer();
+        uint64_t accepted = 0;
+        bool consistent = true;
+        for (uint64_t i = 0; i < state.iterations() && consistent; i++) {
+            if (!reader.read(payload)) continue;
+            accepted++;
+            consistent = payload.deviceCount == 8;
+            for (uint32_t d = 0; consistent && d < payload.deviceCount; d++) {
+                consistent = payload.devices[d].batteryLevel == payload.publishedAt % 101;
+            }
+        }
+        done = true;
+        writer.join();
+
+        if (!consistent) {
+            state.fail("reader accepted a torn snapshot");
+            return;
+        }
+        state.counter("accepted%", 100.0 * static_cast<double>(accepted) / static_cast<double>(state.iterations()));
+    }
+
+    void readBench(Bench::State& state, size_t count, const char* suffix) {
+        auto fleet = makeFleet(count);
+        std::string name = segmentName(suffix);
+        StatusSegment::Publisher publisher(name);
+        publisher.publish(fleet->devices, fleet->strings, 1, std::nullopt, {}, {});
+        StatusSegment::Reader reader(name);
+        StatusSegment::Payload& payload = readBuffer();
+        if (!reader.isValid() || !reader.read(payload) || payload.deviceCount != count) {
+            state.fail("published snapshot not readable");
+            return;
+        }
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Bench::doNotOptimize(reader.read(payload));
+        }
+        state.setBytesProcessed(state.iterations() *
+                                (offsetof(StatusSegment::Payload, devices) + count * sizeof(StatusSegment::Device)));
+    }
+
+    void Status_Read_8(Bench::State& state) {
+        readBench(state, 8, "read8");
+    }
+
+    void Status_Read_1k(Bench::State& state) {
+        readBench(state, 1000, "read1k");
+    }
+
+    BENCHMARK(Status_Publish_8);
+    BENCHMARK(Status_Read_8);
+    BENCHMARK(Status_Read_1k);
+    BENCHMARK(Status_Read_Contended);
+}
@@ -0,0 +1,167 @@
+#include "Bench.h"
+#include "StringPool.h"
+#include <cstdio>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Device identity storage: wide strings (the previous model) against UTF-8
+// strings interned into a StringPool and referenced by 32-bit handles.
+
+namespace {
+    constexpr size_t DEVICE_COUNT = 1000;
+
+    // Realistic BTHLE instance IDs; they share a long common prefix, which is
+    // the worst case for full-string compares
+    std::vector<std::string> makeInstanceIds() {
+        std::vector<std::string> ids;
+        ids.reserve(DEVICE_COUNT);
+        for (size_t i = 0; i < DEVICE_COUNT; i++) {
+            char buffer[96];
+            std::snprintf(buffer, sizeof(buffer),
+                "BTHLE\\DEV_E0D55E%06zX\\7&12ABC&0&BLUETOOTHLE00000000_%08zX", i, i * 2654435761u);
+            ids.emplace_back(buffer);
+        }
+        return ids;
+    }
+
+    std::wstring widen(const std::string& ascii) {
+        return std::wstring(ascii.begin(), ascii.end());
+    }
+
+    // Counts bytes requested from the heap by pmr containers
+    class CountingResource : public std::pmr::memory_resource {
+    public:
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t align) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, align);
+        }
+        void do_deallocate(void* p, size_t size, size_t align) override {
+            std::pmr::new_delete_resource()->deallocate(p, size, align);
+        }
+        bool do_is_equal(const memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    void StringPool_Intern_Existing(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        StringPool pool;
+        for (const auto& id : ids) pool.intern(id);
+
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Bench::doNotOptimize(pool.intern(ids[i % DEVICE_COUNT]));
+        }
+    }
+    BENCHMARK(StringPool_Intern_Existing);
+
+    void Identity_Compare_WideString(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        std::vector<std::wstring> wide;
+        for (const auto& id : ids) wide.push_back(widen(id));
+        // Equal-length neighbours with identical prefixes
+        size_t equal = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            equal += wide[i % DEVICE_COUNT] == wide[(i + 1) % DEVICE_COUNT];
+        }
+        Bench::doNotOptimize(equal);
+    }
+    BENCHMARK(Identity_Compare_WideString);
+
+    void Identity_Compare_StringId(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        StringPool pool;
+        std::vector<StringId> handles;
+        for (const auto& id : ids) handles.push_back(pool.intern(id));
+
+        size_t equal = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            equal += handles[i % DEVICE_COUNT] == handles[(i + 1) % DEVICE_COUNT];
+        }
+        Bench::doNotOptimize(equal);
+    }
+    BENCHMARK(Identity_Compare_StringId);
+
+    void Identity_MapLookup_WideString(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        std::unordered_map<std::wstring, int> levels;
+        std::vector<std::wstring> keys;
+        for (const auto& id : ids) {
+            keys.push_back(widen(id));
+            levels[keys.back()] = 50;
+        }
+
+        int sum = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            sum += levels.find(keys[i % DEVICE_COUNT])->second;
+        }
+        Bench::doNotOptimize(sum);
+    }
+    BENCHMARK(Identity_MapLookup_WideString);
+
+    void Identity_MapLookup_StringId(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        StringPool pool;
+        std::unordered_map<StringId, int> levels;
+        std::vector<StringId> keys;
+        for (const auto& id : ids) {
+            keys.push_back(pool.intern(id));
+            levels[keys.back()] = 50;
+        }
+
+        int sum = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            sum += levels.find(keys[i % DEVICE_COUNT])->second;
+        }
+        Bench::doNotOptimize(sum);
+    }
+    BENCHMARK(Identity_MapLookup_StringId);
+
+    // Memory: heap bytes to hold DEVICE_COUNT identities, each referenced
+    // from two places (device list and a history/cache entry)
+    void Identity_Memory_WideString(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        size_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            CountingResource counting;
+            {
+                std::pmr::vector<std::pmr::wstring> devices(&counting);
+                std::pmr::vector<std::pmr::wstring> history(&counting);
+                devices.reserve(DEVICE_COUNT);
+                history.reserve(DEVICE_COUNT);
+                for (const auto& id : ids) {
+                    devices.emplace_back(id.begin(), id.end());
+                    history.push_back(devices.back());
+                }
+            }
+            bytes = counting.bytes;
+        }
+        state.counter("bytes", static_cast<double>(bytes));
+    }
+    BENCHMARK(Identity_Memory_WideString);
+
+    void Identity_Memory_StringId(Bench::State& state) {
+        auto ids = makeInstanceIds();
+        size_t bytes = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            StringPool pool;
+            std::vector<StringId> devices;
+            std::vector<StringId> history;
+            devices.reserve(DEVICE_COUNT);
+            history.reserve(DEVICE_COUNT);
+            for (const auto& id : ids) {
+                devices.push_back(pool.intern(id));
+                history.push_back(devices.back());
+            }
+            bytes = pool.memoryUsage()
+                + devices.capacity() * sizeof(StringId)
+                + history.capacity() * sizeof(StringId);
+        }
+        state.counter("bytes", static_cast<double>(bytes));
+    }
+    BENCHMARK(Identity_Memory_StringId);
+}
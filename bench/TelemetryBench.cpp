@@ -0,0 +1,103 @@
+#include "Bench.h"
+#include "EventLog.h"
+#include "FakeDeviceBackend.h"
+#include "HeadlessService.h"
+#include "ProcessTelemetry.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Process self-telemetry. Telemetry_Count is one wakeup counted,
+// Telemetry_Sample one sample() (the CPU time is a system call) as every
+// status publish takes it. Telemetry_Idle_Headless runs a headless service
+// over 8 fake devices (status segment, config watcher and event log on, an
+// hour between refreshes), lets it settle, then watches it for 2 s: it
+// fails if the process woke up at all (any cause, the event log's flush
+// thread included) or queried a device, and reports the window's wakeups
+// and CPU time per hour.
+
+namespace {
+    constexpr auto IDLE_WINDOW = std::chrono::seconds(2);
+
+    std::filesystem::path benchDirectory() {
+        std::filesystem::path dir = std::filesystem::temp_directory_path() / "razertray_bench";
+        std::filesystem::create_directories(dir);
+        return dir;
+    }
+
+    void Telemetry_Count(Bench::State& state) {
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+        }
+    }
+
+    void Telemetry_Sample(Bench::State& state) {
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            ProcessTelemetry::Sample sample = ProcessTelemetry::sample();
+            Bench::doNotOptimize(sample);
+        }
+    }
+
+    void Telemetry_Idle_Headless(Bench::State& state) {
+        std::filesystem::path configPath = benchDirectory() / "telemetry-config.json";
+        if (std::FILE* config = std::fopen(configPath.string().c_str(), "w")) {
+            std::fputs("{\"namePatterns\": [\"Razer*\"], \"refreshInterval\": 3600}\n", config);
+            std::fclose(config);
+        }
+        HeadlessService::Options options;
+        options.configPath = configPath;
+#ifdef _WIN32
+        options.statusName = "Local\\RazerTrayBenchTelemetry";
+#else
+        options.statusName = "/razertray-bench-telemetry";
+#endif
+        options.useDeviceCache = false;
+        options.eventLogPath = benchDirectory() / "telemetry-events.rzlog";
+
+        ProcessTelemetry::Sample before;
+        ProcessTelemetry::Sample after;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            HeadlessService service(std::make_shared<FakeDeviceBackend>(8), options);
+            std::thread runner([&service]() { service.run(); });
+
+            // The scan's events reach the file (a write the config watcher
+            // sees) before the window starts
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            EventLog::flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            before = ProcessTelemetry::sample();
+            std::this_thread::sleep_for(IDLE_WINDOW);
+            after = ProcessTelemetry::sample();
+
+            service.stop();
+            runner.join();
+        }
+
+        uint64_t window = after.uptimeMilliseconds - before.uptimeMilliseconds;
+        uint64_t wakeups = after.totalWakeups() - before.totalWakeups();
+        state.counter("wakeupsPerHour", ProcessTelemetry::perHour(wakeups, window));
+        state.counter("cpuMsPerHour",
+                      ProcessTelemetry::perHour(after.cpuMicroseconds - before.cpuMicroseconds, window) / 1000.0);
+        if (wakeups != 0) {
+            std::string causes;
+            for (size_t cause = 0; cause < ProcessTelemetry::WAKEUP_COUNT; cause++) {
+                auto wakeup = static_cast<ProcessTelemetry::Wakeup>(cause);
+                if (after[wakeup] != before[wakeup]) {
+                    causes += causes.empty() ? " (" : ", ";
+                    causes += ProcessTelemetry::name(wakeup);
+                }
+            }
+            state.fail("an idle service woke up" + causes + ")");
+        } else if (after.deviceQueries != before.deviceQueries) {
+            state.fail("an idle service queried devices");
+        }
+    }
+
+    BENCHMARK(Telemetry_Count);
+    BENCHMARK(Telemetry_Sample);
+    BENCHMARK(Telemetry_Idle_Headless);
+}
@@ -0,0 +1,77 @@
+#include "Bench.h"
+#include "JsonReader.h"
+#include "TraceRecorder.h"
+#include <string>
+
+// Tracing cost. Trace_SpanDisabled is the price every traced scope pays in
+// normal use (one relaxed load); Trace_SpanEnabled one span while recording
+// (two clock reads, a slot claim and a detail copy). Trace_Export writes a
+// wrapped ring as Chrome trace-event JSON and reads it back with JsonReader,
+// checking it is well-formed and keeps exactly the newest CAPACITY spans.
+
+namespace {
+    void Trace_SpanDisabled(Bench::State& state) {
+        Trace::stop();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Trace::Span span("disabled", "Razer Basilisk V3 Pro");
+            Bench::doNotOptimize(i);
+        }
+    }
+
+    void Trace_SpanEnabled(Bench::State& state) {
+        Trace::start();
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            Trace::Span span("enabled", "Razer Basilisk V3 Pro");
+            Bench::doNotOptimize(i);
+        }
+        Trace::stop();
+    }
+
+    // Number of complete ("X") events in a trace, or -1 if it does not parse
+    long countSpans(const std::string& json) {
+        JsonReader reader(json);
+        long spans = 0;
+        bool ok = reader.readObject([&](std::string_view key) {
+            if (key != "traceEvents") return reader.skipValue();
+            return reader.readArray([&]() {
+                return reader.readObject([&](std::string_view field) {
+                    if (field != "ph") return reader.skipValue();
+                    std::string phase;
+                    if (!reader.readString(phase)) return false;
+                    if (phase == "X") spans++;
+                    return true;
+                });
+            });
+        });
+        return ok ? spans : -1;
+    }
+
+    void Trace_Export(Bench::State& state) {
+        Trace::start();
+        for (size_t i = 0; i < Trace::CAPACITY + 1000; i++) {
+            // Quotes, backslashes, control characters and a multi-byte
+            // character cut at the detail limit all have to stay valid JSON
+            Trace::Span span("export", "\"Razer\" \\ Basilisk\t\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9"
+                                       "\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9");
+        }
+        Trace::stop();
+
+        size_t bytes = 0;
+        long spans = 0;
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            std::string json = Trace::toJson();
+            bytes = json.size();
+            spans = countSpans(json);
+            if (spans != static_cast<long>(Trace::CAPACITY)) {
+                state.fail(spans < 0 ? "trace is not valid JSON" : "wrong number of spans in trace");
+                return;
+            }
+        }
+        state.setBytesProcessed(bytes * state.iterations());
+        state.counter("spans", static_cast<double>(spans));
+    }
+
+    BENCHMARK(Trace_SpanDisabled);
+    BENCHMARK(Trace_SpanEnabled);
+    BENCHMARK(Trace_Export);
+}
@@ -0,0 +1,245 @@
+#include "Bench.h"
+#include "Utf8.h"
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// Transcoder throughput (bytes/second) for the selected SIMD path against the
+// scalar fallback, plus a fuzz pass that checks both against an independent
+// reference decoder.
+
+namespace {
+    constexpr size_t INPUT_SIZE = 64 * 1024;
+
+    // Reference UTF-8 decoder written directly from the Unicode well-formed
+    // byte sequence table (per-lead second-byte ranges), deliberately
+    // structured differently from Utf8.cpp
+    std::optional<std::u16string> referenceToUtf16(const std::string& utf8) {
+        std::u16string out;
+        const auto* s = reinterpret_cast<const unsigned char*>(utf8.data());
+        size_t n = utf8.size();
+        size_t i = 0;
+        auto cont = [&](size_t k) { return i + k < n && s[i + k] >= 0x80 && s[i + k] <= 0xBF; };
+
+        while (i < n) {
+            unsigned char b = s[i];
+            uint32_t cp;
+            if (b <= 0x7F) {
+                cp = b;
+                i += 1;
+            } else if (b >= 0xC2 && b <= 0xDF) {
+                if (!cont(1)) return std::nullopt;
+                cp = ((b & 0x1F) << 6) | (s[i + 1] & 0x3F);
+                i += 2;
+            } else if (b >= 0xE0 && b <= 0xEF) {
+                unsigned char lo = b == 0xE0 ? 0xA0 : 0x80;
+                unsigned char hi = b == 0xED ? 0x9F : 0xBF;
+                if (i + 1 >= n || s[i + 1] < lo || s[i + 1] > hi || !cont(2)) return std::nullopt;
+                cp = ((b & 0x0F) << 12) | ((s[i + 1] & 0x3F) << 6) | (s[i + 2] & 0x3F);
+                i += 3;
+            } else if (b >= 0xF0 && b <= 0xF4) {
+                unsigned char lo = b == 0xF0 ? 0x90 : 0x80;
+                unsigned char hi = b == 0xF4 ? 0x8F : 0xBF;
+                if (i + 1 >= n || s[i + 1] < lo || s[i + 1] > hi || !cont(2) || !cont(3)) return std::nullopt;
+                cp = ((b & 0x07) << 18) | ((s[i + 1] & 0x3F) << 12) | ((s[i + 2] & 0x3F) << 6) | (s[i + 3] & 0x3F);
+                i += 4;
+            } else {
+                return std::nullopt;
+            }
+
+            if (cp >= 0x10000) {
+                out.push_back(static_cast<char16_t>(0xD800 + ((cp - 0x10000) >> 10)));
+                out.push_back(static_cast<char16_t>(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+            } else {
+                out.push_back(static_cast<char16_t>(cp));
+            }
+        }
+        return out;
+    }
+
+    void appendCodePoint(std::string& out, uint32_t cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+
+    // Reference encoder: pair surrogates explicitly, reject anything unpaired
+    std::optional<std::string> referenceFromUtf16(const std::u16string& utf16) {
+        std::string out;
+        for (size_t i = 0; i < utf16.size(); i++) {
+            uint32_t unit = utf16[i];
+            if (unit >= 0xDC00 && unit <= 0xDFFF) return std::nullopt;
+            if (unit >= 0xD800 && unit <= 0xDBFF) {
+                if (i + 1 == utf16.size() || utf16[i + 1] < 0xDC00 || utf16[i + 1] > 0xDFFF) return std::nullopt;
+                appendCodePoint(out, 0x10000 + ((unit - 0xD800) << 10) + (utf16[i + 1] - 0xDC00));
+                i++;
+            } else {
+                appendCodePoint(out, unit);
+            }
+        }
+        return out;
+    }
+
+    // Mostly ASCII (like config files and device names) with a share of
+    // 2-, 3- and 4-byte sequences
+    std::string makeText(size_t bytes, int nonAsciiPercent, uint32_t seed) {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> percent(0, 99);
+        std::string text;
+        while (text.size() < bytes) {
+            if (percent(rng) >= nonAsciiPercent) {
+                text += static_cast<char>(0x20 + rng() % 0x5F);
+                continue;
+            }
+            switch (rng() % 3) {
+                case 0: appendCodePoint(text, 0x80 + rng() % 0x780); break;
+                case 1: appendCodePoint(text, 0x800 + rng() % 0xD000); break;
+                default: appendCodePoint(text, 0x10000 + rng() % 0xFFFFF); break;
+            }
+        }
+        return text;
+    }
+
+    std::u16string toUtf16(const std::string& utf8) {
+        std::u16string out(Utf8::maxUtf16Length(utf8.size()), u'\0');
+        out.resize(Utf8::toUtf16(utf8, out.data()).value_or(0));
+        return out;
+    }
+
+    void runToUtf16(Bench::State& state, int nonAsciiPercent, bool scalar) {
+        std::string input = makeText(INPUT_SIZE, nonAsciiPercent, 1);
+        std::u16string output(Utf8::maxUtf16Length(input.size()), u'\0');
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto written = scalar ? Utf8::toUtf16Scalar(input, output.data())
+                                  : Utf8::toUtf16(input, output.data());
+            Bench::doNotOptimize(written);
+        }
+        state.setBytesProcessed(input.size() * state.iterations());
+    }
+
+    void runFromUtf16(Bench::State& state, int nonAsciiPercent, bool scalar) {
+        std::u16string input = toUtf16(makeText(INPUT_SIZE, nonAsciiPercent, 2));
+        std::string output(Utf8::maxUtf8Length(input.size()), '\0');
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            auto written = scalar ? Utf8::fromUtf16Scalar(input, output.data())
+                                  : Utf8::fromUtf16(input, output.data());
+            Bench::doNotOptimize(written);
+        }
+        state.setBytesProcessed(input.size() * sizeof(char16_t) * state.iterations());
+    }
+
+    void Utf8_ToUtf16_Ascii_Simd(Bench::State& state) { runToUtf16(state, 0, false); }
+    void Utf8_ToUtf16_Ascii_Scalar(Bench::State& state) { runToUtf16(state, 0, true); }
+    void Utf8_ToUtf16_Mixed_Simd(Bench::State& state) { runToUtf16(state, 5, false); }
+    void Utf8_ToUtf16_Mixed_Scalar(Bench::State& state) { runToUtf16(state, 5, true); }
+    void Utf8_FromUtf16_Ascii_Simd(Bench::State& state) { runFromUtf16(state, 0, false); }
+    void Utf8_FromUtf16_Ascii_Scalar(Bench::State& state) { runFromUtf16(state, 0, true); }
+    void Utf8_FromUtf16_Mixed_Simd(Bench::State& state) { runFromUtf16(state, 5, false); }
+    void Utf8_FromUtf16_Mixed_Scalar(Bench::State& state) { runFromUtf16(state, 5, true); }
+    BENCHMARK(Utf8_ToUtf16_Ascii_Simd);
+    BENCHMARK(Utf8_ToUtf16_Ascii_Scalar);
+    BENCHMARK(Utf8_ToUtf16_Mixed_Simd);
+    BENCHMARK(Utf8_ToUtf16_Mixed_Scalar);
+    BENCHMARK(Utf8_FromUtf16_Ascii_Simd);
+    BENCHMARK(Utf8_FromUtf16_Ascii_Scalar);
+    BENCHMARK(Utf8_FromUtf16_Mixed_Simd);
+    BENCHMARK(Utf8_FromUtf16_Mixed_Scalar);
+
+    // Corrupt valid text in ways that hit every validation rule
+    void mutate(std::string& text, std::mt19937& rng) {
+        static const char* const malformed[] = {
+            "\x80", "\xBF", "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xED\xA0\x80",
+            "\xF0\x80\x80\x80", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF", "\xC3", "\xE2\x82",
+        };
+        size_t position = text.empty() ? 0 : rng() % text.size();
+        switch (rng() % 4) {
+            case 0: text.insert(position, malformed[rng() % std::size(malformed)]); break;
+            case 1: if (!text.empty()) text[position] = static_cast<char>(rng()); break;
+            case 2: text.resize(position); break;
+            default: break;  // leave valid
+        }
+    }
+
+    void Utf8_Fuzz_AgainstReference(Bench::State& state) {
+        std::mt19937 rng(42);
+        for (uint64_t i = 0; i < state.iterations(); i++) {
+            // Lengths around the 16/32-byte block boundaries matter most
+            std::string text = makeText(rng() % 100, static_cast<int>(rng() % 60), rng());
+            mutate(text, rng);
+
+            auto expected = referenceToUtf16(text);
+            std::u16string simd(Utf8::maxUtf16Length(text.size()), u'\0');
+            std::u16string scalar(simd.size(), u'\0');
+            auto simdLength = Utf8::toUtf16(text, simd.data());
+            auto scalarLength = Utf8::toUtf16Scalar(text, scalar.data());
+
+            if (simdLength.has_value() != expected.has_value() ||
+                scalarLength.has_value() != expected.has_value()) {
+                state.fail("validity mismatch on iteration " + std::to_string(i));
+                return;
+            }
+            if (!expected) continue;
+
+            simd.resize(*simdLength);
+            scalar.resize(*scalarLength);
+            if (simd != *expected || scalar != *expected) {
+                state.fail("UTF-16 output mismatch on iteration " + std::to_string(i));
+                return;
+            }
+
+            // Valid input must round-trip through both encoders
+            std::string back(Utf8::maxUtf8Length(simd.size()), '\0');
+            auto backLength = Utf8::fromUtf16(simd, back.data());
+            std::string backScalar(back.size(), '\0');
+            auto backScalarLength = Utf8::fromUtf16Scalar(simd, backScalar.data());
+            if (!backLength || !backScalarLength ||
+                back.substr(0, *backLength) != text || backScalar.substr(0, *backScalarLength) != text) {
+                state.fail("round trip mismatch on iteration " + std::to_string(i));
+                return;
+            }
+
+            // Random UTF-16 (including stray surrogates) through both encoders
+            std::u16string units;
+            size_t unitCount = rng() % 80;
+            for (size_t k = 0; k < unitCount; k++) {
+                switch (rng() % 8) {
+                    case 0: units.push_back(static_cast<char16_t>(0xD800 + rng() % 0x800)); break;
+                    case 1: units.push_back(static_cast<char16_t>(0x80 + rng() % 0xD780)); break;
+                    default: units.push_back(static_cast<char16_t>(rng() % 0x80)); break;
+                }
+            }
+            auto expectedUtf8 = referenceFromUtf16(units);
+            std::string encoded(Utf8::maxUtf8Length(units.size()), '\0');
+            std::string encodedScalar(encoded.size(), '\0');
+            auto encodedLength = Utf8::fromUtf16(units, encoded.data());
+            auto encodedScalarLength = Utf8::fromUtf16Scalar(units, encodedScalar.data());
+            if (encodedLength.has_value() != expectedUtf8.has_value() ||
+                encodedScalarLength.has_value() != expectedUtf8.has_value()) {
+                state.fail("surrogate validation mismatch on iteration " + std::to_string(i));
+                return;
+            }
+            if (expectedUtf8 &&
+                (encoded.substr(0, *encodedLength) != *expectedUtf8 ||
+                 encodedScalar.substr(0, *encodedScalarLength) != *expectedUtf8)) {
+                state.fail("UTF-8 output mismatch on iteration " + std::to_string(i));
+                return;
+            }
+        }
+        state.counter(Utf8::implementationName(), 1);
+    }
+    BENCHMARK(Utf8_Fuzz_AgainstReference);
+}
@@ -26,29 +26,42 @@ $configPath = Join-Path $scriptDir "config.json"
 function Test-DeviceMatchesPattern {
     param(
         [string]$DeviceName,
-        [string]$Pattern
+        [string]$Pattern,
+        [switch]$IgnoreCase
     )
 
-    # Wildcard matching (only supports * at end)
-    if ($Pattern.EndsWith('*')) {
-        $prefix = $Pattern.Substring(0, $Pattern.Length - 1)
-        return $DeviceName.StartsWith($prefix)
+    # Same rules as RazerTray: * and ? anywhere, whole-name match. Brackets are
+    # literal in config patterns, so escape them for -like
+    $escaped = $Pattern.Replace('`', '``').Replace('[', '`[').Replace(']', '`]')
+    if ($IgnoreCase) {
+        return $DeviceName -like $escaped
     }
+    return $DeviceName -clike $escaped
+}
+
+function Get-BluetoothAddress {
+    param(
+        [string]$InstanceId
+    )
 
-    # Exact match
-    return $DeviceName -eq $Pattern
+    # "BTHLE\DEV_<12 hex digits>" optionally followed by "\...", as RazerTray parses it
+    if ($InstanceId -match '^BTHLE\\DEV_([0-9A-Fa-f]{12})(\\|$)') {
+        return $matches[1].ToUpperInvariant()
+    }
+    return $null
 }
 
 function Get-DeviceMatchReason {
     param(
         [string]$DeviceName,
+        [string]$InstanceId,
         [object]$Config
     )
 
     # Check namePatterns first
     if ($Config.namePatterns) {
         foreach ($pattern in $Config.namePatterns) {
-            if (Test-DeviceMatchesPattern -DeviceName $DeviceName -Pattern $pattern) {
+            if (Test-DeviceMatchesPattern -DeviceName $DeviceName -Pattern $pattern -IgnoreCase:([bool]$Config.caseInsensitivePatterns)) {
                 return @{
                     Matched = $true
                     Reason = "Pattern"
@@ -60,8 +73,29 @@ function Get-DeviceMatchReason {
 
     # Check devices array
     if ($Config.devices) {
+        $deviceAddress = Get-BluetoothAddress -InstanceId $InstanceId
         foreach ($device in $Config.devices) {
-            if ($device.enabled -and $DeviceName.Contains($device.name)) {
+            if (-not $device.enabled) {
+                continue
+            }
+
+            # An instanceIdPattern naming one Bluetooth address pins that device
+            $pinnedAddress = Get-BluetoothAddress -InstanceId $device.instanceIdPattern
+            if ($pinnedAddress) {
+                if ($pinnedAddress -eq $deviceAddress) {
+                    return @{
+                        Matched = $true
+                        Reason = "Explicit"
+                        MatchedBy = $device.name
+                    }
+                }
+                continue
+            }
+
+            $comparison = if ($Config.caseInsensitivePatterns) { [StringComparison]::OrdinalIgnoreCase } else { [StringComparison]::Ordinal }
+            $instanceMatches = (-not $device.instanceIdPattern) -or
+                (Test-DeviceMatchesPattern -DeviceName $InstanceId -Pattern $device.instanceIdPattern -IgnoreCase)
+            if ($instanceMatches -and $DeviceName.Contains($device.name, $comparison)) {
                 return @{
                     Matched = $true
                     Reason = "Explicit"
@@ -204,6 +238,31 @@ function Show-CheckboxSelection {
     return $selected
 }
 
+function Get-DiscoveredDevices {
+    # RazerTray --discover --json: one JSON object per device, matched by the
+    # tray's own compiled rules against config.json. $null if RazerTray.exe
+    # is not next to this script or could not run
+    $exePath = Join-Path $scriptDir "RazerTray.exe"
+    if (-not (Test-Path $exePath)) {
+        return $null
+    }
+
+    $previousEncoding = [Console]::OutputEncoding
+    try {
+        [Console]::OutputEncoding = [System.Text.Encoding]::UTF8  # device names are written as UTF-8
+        $devices = @(& $exePath --discover --json | ForEach-Object { $_ | ConvertFrom-Json })
+        if ($LASTEXITCODE -ne 0) {
+            return $null
+        }
+        return ,$devices
+    } catch {
+        Write-Host "  RazerTray --discover failed: $_" -ForegroundColor Yellow
+        return $null
+    } finally {
+        [Console]::OutputEncoding = $previousEncoding
+    }
+}
+
 function Get-BluetoothLEDevices {
     param(
         [object]$Config
@@ -211,18 +270,37 @@ function Get-BluetoothLEDevices {
 
     Write-Host "`nScanning for Bluetooth LE devices..." -ForegroundColor Cyan
 
-    # Get all BTHLE devices
-    $devices = Get-PnpDevice -Class 'Bluetooth' -PresentOnly |
-        Where-Object {
-            $_.InstanceId -like 'BTHLE\*' -and
-            $_.Name -ne 'Bluetooth LE Device' -and
-            -not [string]::IsNullOrWhiteSpace($_.Name)
-        } |
-        Select-Object Name, InstanceId, Status, @{
-            Name='IsConnected'
-            Expression={$_.Status -eq 'OK'}
-        } |
-        Sort-Object Name -Unique
+    $discovered = Get-DiscoveredDevices
+    if ($null -ne $discovered) {
+        $devices = $discovered |
+            Where-Object {
+                $_.name -ne 'Bluetooth LE Device' -and
+                -not [string]::IsNullOrWhiteSpace($_.name)
+            } |
+            Select-Object @{Name='Name'; Expression={$_.name}},
+                @{Name='InstanceId'; Expression={$_.instanceId}},
+                @{Name='IsConnected'; Expression={$_.connected}},
+                @{Name='Source'; Expression={if ($_.source) { $_.source } else { 'BTHLE' }}},
+                @{Name='Match'; Expression={$_.match}} |
+            Sort-Object Name -Unique
+    } else {
+        # Without RazerTray.exe (e.g. run from the source tree): ask PnP and
+        # match with Get-DeviceMatchReason
+        $devices = Get-PnpDevice -Class 'Bluetooth' -PresentOnly |
+            Where-Object {
+                $_.InstanceId -like 'BTHLE\*' -and
+                $_.Name -ne 'Bluetooth LE Device' -and
+                -not [string]::IsNullOrWhiteSpace($_.Name)
+            } |
+            Select-Object Name, InstanceId, Status, @{
+                Name='IsConnected'
+                Expression={$_.Status -eq 'OK'}
+            }, @{
+                Name='Source'
+                Expression={'BTHLE'}
+            } |
+            Sort-Object Name -Unique
+    }
 
     if (-not $devices) {
         Write-Host "  No Bluetooth LE devices found." -ForegroundColor Yellow
@@ -234,7 +312,15 @@ function Get-BluetoothLEDevices {
     # Convert to checkbox items with match status
     $items = @()
     foreach ($device in $devices) {
-        $matchInfo = Get-DeviceMatchReason -DeviceName $device.Name -Config $Config
+        if ($null -ne $discovered) {
+            $matchInfo = @{
+                Matched = $null -ne $device.Match
+                Reason = if (-not $device.Match) { "None" } elseif ($device.Match.kind -eq "namePattern") { "Pattern" } else { "Explicit" }
+                MatchedBy = if ($device.Match) { $device.Match.rule } else { $null }
+            }
+        } else {
+            $matchInfo = Get-DeviceMatchReason -DeviceName $device.Name -InstanceId $device.InstanceId -Config $Config
+        }
 
         $statusIcon = if ($device.IsConnected) { "🔗" } else { "⏸" }
 
@@ -245,6 +331,9 @@ function Get-BluetoothLEDevices {
         } else {
             $displayText += " (Paired)"
         }
+        if ($device.Source -ne 'BTHLE') {
+            $displayText += " [$($device.Source)]"  # classic Bluetooth, USB or HID node
+        }
 
         if ($matchInfo.Matched) {
             if ($matchInfo.Reason -eq "Pattern") {
@@ -258,6 +347,7 @@ function Get-BluetoothLEDevices {
             Name = $device.Name
             InstanceId = $device.InstanceId
             IsConnected = $device.IsConnected
+            Source = $device.Source
             AlreadyMatched = $matchInfo.Matched
             MatchReason = $matchInfo.Reason
             MatchedBy = $matchInfo.MatchedBy
@@ -412,7 +502,7 @@ function Invoke-DiscoverDevices {
         # Check if device is already covered by a namePattern
         $coveredByPattern = $false
         foreach ($pattern in $newPatterns) {
-            if (Test-DeviceMatchesPattern -DeviceName $device.Name -Pattern $pattern) {
+            if (Test-DeviceMatchesPattern -DeviceName $device.Name -Pattern $pattern -IgnoreCase:([bool]$config.caseInsensitivePatterns)) {
                 $coveredByPattern = $true
                 break
             }
@@ -420,11 +510,12 @@ function Invoke-DiscoverDevices {
 
         # If not covered by a pattern, add to devices array
         if (-not $coveredByPattern) {
+            # Only the enumerator the device was found under
             $newDevices += [PSCustomObject]@{
                 name = $device.Name
-                instanceIdPattern = "BTHLE\DEV_*"
+                instanceIdPattern = if ($device.Source -eq 'BTHLE') { "BTHLE\DEV_*" } else { "$($device.Source)\*" }
                 enabled = $true
-                description = "User-selected Bluetooth LE device"
+                description = if ($device.Source -eq 'BTHLE') { "User-selected Bluetooth LE device" } else { "User-selected $($device.Source) device" }
             }
 
             # Optionally add a pattern if device has a common prefix
@@ -0,0 +1,612 @@
+#include "AlertRules.h"
+#include "EventLog.h"
+#include "MemoryAccounting.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <limits>
+#include <map>
+
+namespace {
+    std::atomic<uint64_t> nextAlertRulesId{1};
+
+    // Literals and durations stay far from int32 overflow
+    constexpr int64_t MAX_NUMBER = 1000000000;
+    constexpr int64_t MAX_DURATION_SECONDS = 366LL * 24 * 3600;
+    // Parentheses, ! and unary - nested deeper than this are rejected
+    constexpr int MAX_NESTING = 64;
+
+    // Globs of one kind, identical ones (after case folding) sharing an index
+    struct GlobTable {
+        std::array<uint8_t, 256> fold;
+        std::vector<std::string> globs;
+        std::map<std::string, uint32_t> indices;
+
+        explicit GlobTable(bool ignoreCase) : fold(GlobSet::foldTable(ignoreCase)) {}
+
+        uint32_t add(std::string_view glob) {
+            std::string key(glob);
+            for (char& c : key) c = static_cast<char>(fold[static_cast<uint8_t>(c)]);
+            auto [it, inserted] = indices.emplace(std::move(key), static_cast<uint32_t>(globs.size()));
+            if (inserted) globs.emplace_back(glob);
+            return it->second;
+        }
+    };
+
+    bool isWordCharacter(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+    bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    int32_t wrap(int64_t value) {
+        return static_cast<int32_t>(static_cast<uint32_t>(static_cast<uint64_t>(value)));
+    }
+}
+
+enum class AlertRules::Op : uint8_t {
+    END,
+    CONST,          // push arg
+    LEVEL,
+    CONNECTED,
+    HOUR,
+    WEEKDAY,
+    DROP,           // arg = seconds
+    NAME,           // arg = name glob
+    ID,             // arg = instance ID glob
+    NOT,
+    NEG,
+    ADD,
+    SUB,
+    LT, LE, GT, GE, EQ, NE,
+    LT_CONST, LE_CONST, GT_CONST, GE_CONST, EQ_CONST, NE_CONST,   // top against arg
+    JUMP_IF_FALSE,  // top is 0: jump to arg keeping it, else pop it (&&)
+    JUMP_IF_TRUE,   // top is not 0: jump to arg keeping it, else pop it (||)
+};
+
+// Recursive descent over one expression, emitting as it goes:
+//   or      := and ('||' and)*
+//   and     := not ('&&' not)*
+//   not     := '!' not | compare
+//   compare := sum (('<' | '<=' | '>' | '>=' | '==' | '!=') sum)?
+//   sum     := unary (('+' | '-') unary)*
+//   unary   := '-' unary | primary
+//   primary := number | true | false | level | connected | hour | weekday
+//            | drop '(' duration ')' | (name | id) '~' string | '(' or ')'
+class AlertRules::Compiler {
+public:
+    Compiler(std::string_view text, std::vector<Instruction>& code, GlobTable& names, GlobTable& instanceIds)
+        : text(text), code(code), names(names), instanceIds(instanceIds)
+    {
+    }
+
+    // Append the program (ending in END); false with error() set
+    bool compile() {
+        size_t begin = code.size();
+        if (!parseOr()) {
+            code.resize(begin);
+            return false;
+        }
+        skipSpace();
+        if (pos < text.size()) {
+            code.resize(begin);
+            return fail(std::string("unexpected '") + text[pos] + "'");
+        }
+        if (maxDepth > static_cast<int>(MAX_STACK)) {
+            code.resize(begin);
+            return fail("expression too large");
+        }
+        emit(Op::END, 0, 0);
+        return true;
+    }
+
+    const std::string& error() const { return message; }
+    bool readsLevel() const { return level; }
+    bool readsHistory() const { return history; }
+
+private:
+    bool fail(std::string what) {
+        message = "column " + std::to_string(pos + 1) + ": " + what;
+        return false;
+    }
+
+    void skipSpace() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n' || text[pos] == '\r')) {
+            pos++;
+        }
+    }
+
+    // Consume an operator if it is next (and not the start of a longer one)
+    bool accept(std::string_view token) {
+        skipSpace();
+        if (text.substr(pos, token.size()) != token) return false;
+        if (token.size() == 1 && pos + 1 < text.size() && text[pos + 1] == '=' &&
+            (token[0] == '<' || token[0] == '>' || token[0] == '!')) {
+            return false;  // "<=", ">=", "!="
+        }
+        pos += token.size();
+        return true;
+    }
+
+    std::string_view word() {
+        size_t start = pos;
+        while (pos < text.size() && isWordCharacter(text[pos])) pos++;
+        return text.substr(start, pos - start);
+    }
+
+    size_t emit(Op op, int32_t arg, int stackEffect) {
+        depth += stackEffect;
+        maxDepth = std::max(maxDepth, depth);
+        code.push_back({op, arg});
+        return code.size() - 1;
+    }
+
+    bool enter() {
+        if (++nesting > MAX_NESTING) return fail("nested too deeply");
+        return true;
+    }
+
+    bool parseOr() {
+        if (!parseAnd()) return false;
+        while (accept("||")) {
+            size_t jump = emit(Op::JUMP_IF_TRUE, 0, -1);
+            if (!parseAnd()) return false;
+            code[jump].arg = static_cast<int32_t>(code.size());
+        }
+        return true;
+    }
+
+    bool parseAnd() {
+        if (!parseNot()) return false;
+        while (accept("&&")) {
+            size_t jump = emit(Op::JUMP_IF_FALSE, 0, -1);
+            if (!parseNot()) return false;
+            code[jump].arg = static_cast<int32_t>(code.size());
+        }
+        return true;
+    }
+
+    bool parseNot() {
+        if (accept("!")) {
+            if (!enter() || !parseNot()) return false;
+            nesting--;
+            emit(Op::NOT, 0, 0);
+            return true;
+        }
+        return parseCompare();
+    }
+
+    bool parseCompare() {
+        if (!parseSum()) return false;
+        static constexpr std::pair<std::string_view, Op> OPERATORS[] = {
+            {"<=", Op::LE}, {">=", Op::GE}, {"==", Op::EQ}, {"!=", Op::NE}, {"<", Op::LT}, {">", Op::GT},
+        };
+        for (const auto& [token, op] : OPERATORS) {
+            if (!accept(token)) continue;
+            size_t right = code.size();
+            if (!parseSum()) return false;
+            if (code.size() == right + 1 && code.back().op == Op::CONST) {
+                // Against a constant: one instruction
+                int32_t constant = code.back().arg;
+                code.pop_back();
+                depth--;
+                emit(static_cast<Op>(static_cast<uint8_t>(op) - static_cast<uint8_t>(Op::LT) +
+                                     static_cast<uint8_t>(Op::LT_CONST)), constant, 0);
+            } else {
+                emit(op, 0, -1);
+            }
+            skipSpace();
+            for (const auto& other : OPERATORS) {
+                if (text.substr(pos, other.first.size()) == other.first) return fail("comparisons do not chain; use &&");
+            }
+            return true;
+        }
+        return true;
+    }
+
+    bool parseSum() {
+        if (!parseUnary()) return false;
+        while (true) {
+            if (accept("+")) {
+                if (!parseUnary()) return false;
+                emit(Op::ADD, 0, -1);
+            } else if (accept("-")) {
+                if (!parseUnary()) return false;
+                emit(Op::SUB, 0, -1);
+            } else {
+                return true;
+            }
+        }
+    }
+
+    bool parseUnary() {
+        if (accept("-")) {
+            size_t operand = code.size();
+            if (!enter() || !parseUnary()) return false;
+            nesting--;
+            if (code.size() == operand + 1 && code.back().op == Op::CONST) {
+                code.back().arg = wrap(-static_cast<int64_t>(code.back().arg));
+            } else {
+                emit(Op::NEG, 0, 0);
+            }
+            return true;
+        }
+        return parsePrimary();
+    }
+
+    bool parseNumber(int64_t& value) {
+        if (pos >= text.size() || !isDigit(text[pos])) return fail("expected a number");
+        value = 0;
+        while (pos < text.size() && isDigit(text[pos])) {
+            value = value * 10 + (text[pos] - '0');
+            if (value > MAX_NUMBER) return fail("number too large");
+            pos++;
+        }
+        return true;
+    }
+
+    bool parseString(std::string_view& value) {
+        skipSpace();
+        if (pos >= text.size() || (text[pos] != '\'' && text[pos] != '"')) return fail("expected a quoted glob");
+        char quote = text[pos];
+        size_t end = text.find(quote, pos + 1);
+        if (end == std::string_view::npos) return fail("unterminated string");
+        value = text.substr(pos + 1, end - pos - 1);
+        pos = end + 1;
+        return true;
+    }
+
+    bool parsePrimary() {
+        skipSpace();
+        if (pos >= text.size()) return fail("expected a value");
+        if (isDigit(text[pos])) {
+            int64_t value;
+            if (!parseNumber(value)) return false;
+            emit(Op::CONST, static_cast<int32_t>(value), 1);
+            return true;
+        }
+        if (accept("(")) {
+            if (!enter() || !parseOr()) return false;
+            nesting--;
+            if (!accept(")")) return fail("expected ')'");
+            return true;
+        }
+
+        size_t start = pos;
+        std::string_view name = word();
+        if (name == "true" || name == "false") {
+            emit(Op::CONST, name == "true" ? 1 : 0, 1);
+        } else if (name == "level") {
+            level = true;
+            emit(Op::LEVEL, 0, 1);
+        } else if (name == "connected") {
+            emit(Op::CONNECTED, 0, 1);
+        } else if (name == "hour") {
+            emit(Op::HOUR, 0, 1);
+        } else if (name == "weekday") {
+            emit(Op::WEEKDAY, 0, 1);
+        } else if (name == "drop") {
+            if (!accept("(")) return fail("expected '(' after drop");
+            skipSpace();
+            int64_t seconds;
+            if (!parseNumber(seconds)) return false;
+            if (pos < text.size() && (text[pos] == 's' || text[pos] == 'm' || text[pos] == 'h')) {
+                seconds *= text[pos] == 'h' ? 3600 : text[pos] == 'm' ? 60 : 1;
+                pos++;
+            }
+            if (seconds <= 0 || seconds > MAX_DURATION_SECONDS) return fail("duration must be 1s to 366 days");
+            if (!accept(")")) return fail("expected ')'");
+            level = true;
+            history = true;
+            emit(Op::DROP, static_cast<int32_t>(seconds), 1);
+        } else if (name == "name" || name == "id") {
+            if (!accept("~")) return fail(std::string("expected '~' after ") + std::string(name));
+            std::string_view glob;
+            if (!parseString(glob)) return false;
+            bool isName = name == "name";
+            uint32_t index = (isName ? names : instanceIds).add(glob);
+            emit(isName ? Op::NAME : Op::ID, static_cast<int32_t>(index), 1);
+        } else {
+            pos = start;
+            if (name.empty()) return fail(std::string("unexpected '") + text[pos] + "'");
+            return fail("unknown name '" + std::string(name) + "'");
+        }
+        return true;
+    }
+
+    std::string_view text;
+    size_t pos = 0;
+    std::vector<Instruction>& code;
+    GlobTable& names;
+    GlobTable& instanceIds;
+    int depth = 0;
+    int maxDepth = 0;
+    int nesting = 0;
+    bool level = false;
+    bool history = false;
+    std::string message;
+};
+
+AlertRules::AlertRules()
+    : AlertRules({}, false)
+{
+}
+
+AlertRules::AlertRules(const std::vector<AlertRule>& alerts, bool ignoreCase)
+    : names({}, ignoreCase)
+    , instanceIds({}, true)
+    , globWords(0)
+    , nameGlobCount(0)
+    , readsHistory(false)
+    , id(nextAlertRulesId.fetch_add(1, std::memory_order_relaxed))
+{
+    GlobTable nameGlobs(ignoreCase);
+    GlobTable instanceIdGlobs(true);
+    for (const AlertRule& alert : alerts) {
+        Rule rule;
+        rule.name = alert.name;
+        rule.begin = static_cast<uint32_t>(code.size());
+        rule.hysteresis = std::max(alert.hysteresis, 0);
+        rule.cooldown = std::max(alert.cooldown, 0);
+
+        // The config was checked when parsed; anything else never fires
+        Compiler compiler(alert.when, code, nameGlobs, instanceIdGlobs);
+        if (compiler.compile()) {
+            rule.readsLevel = compiler.readsLevel();
+            readsHistory = readsHistory || compiler.readsHistory();
+        } else {
+            code.push_back({Op::CONST, 0});
+            code.push_back({Op::END, 0});
+            rule.readsLevel = false;
+        }
+        rules.push_back(std::move(rule));
+    }
+
+    names = GlobSet(nameGlobs.globs, ignoreCase);
+    instanceIds = GlobSet(instanceIdGlobs.globs, true);
+    nameGlobCount = static_cast<uint32_t>(nameGlobs.globs.size());
+    globWords = (nameGlobs.globs.size() + instanceIdGlobs.globs.size() + 63) / 64;
+}
+
+bool AlertRules::check(std::string_view expression, std::string& error) {
+    std::vector<Instruction> code;
+    GlobTable nameGlobs(false);
+    GlobTable instanceIdGlobs(true);
+    Compiler compiler(expression, code, nameGlobs, instanceIdGlobs);
+    if (!compiler.compile()) {
+        error = compiler.error();
+        return false;
+    }
+    return true;
+}
+
+AlertRules::Moment AlertRules::Moment::local(int64_t now) {
+    std::time_t time = static_cast<std::time_t>(now);
+    std::tm local = {};
+#ifdef _WIN32
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    return Moment{now, local.tm_hour, local.tm_wday};
+}
+
+std::string AlertRules::describe(const DeviceTable& devices, const StringPool& strings, DeviceTable::Row row) {
+    std::string text(strings.view(devices.name(row)));
+    std::optional<int> level = devices.batteryLevel(row);
+    if (level.has_value()) {
+        text += ": ";
+        text += std::to_string(*level);
+        text += "%, ";
+    } else {
+        text += ": no level, ";
+    }
+    text += devices.isConnected(row) ? "connected" : "disconnected";
+    return text;
+}
+
+size_t AlertRules::memoryUsage() const {
+    size_t bytes = MemoryAccounting::bytesOf(rules) + MemoryAccounting::bytesOf(code) +
+                   names.memoryUsage() + instanceIds.memoryUsage();
+    for (const Rule& rule : rules) bytes += MemoryAccounting::bytesOf(rule.name);
+    return bytes;
+}
+
+size_t AlertRules::State::memoryUsage() const {
+    return MemoryAccounting::bytesOf(slots) + MemoryAccounting::bytesOf(flags) + MemoryAccounting::bytesOf(levels) +
+           MemoryAccounting::bytesOf(globBits) + MemoryAccounting::bytesOf(ruleStates) +
+           MemoryAccounting::bytesOf(historyTimes) + MemoryAccounting::bytesOf(historyLevels) +
+           MemoryAccounting::bytesOf(historyCounts) + MemoryAccounting::bytesOf(matched) +
+           nameCache.memoryUsage() + idCache.memoryUsage();
+}
+
+void AlertRules::bind(State& state, const StringPool& strings, int64_t now) const {
+    if (state.owner == id && state.pool == &strings) {
+        return;
+    }
+    state.owner = id;
+    state.pool = &strings;
+    state.epoch = now;
+    state.slots.clear();
+    state.flags.clear();
+    state.levels.clear();
+    state.globBits.clear();
+    state.ruleStates.clear();
+    state.historyTimes.clear();
+    state.historyLevels.clear();
+    state.historyCounts.clear();
+}
+
+uint32_t AlertRules::addDevice(State& state, std::string_view name, std::string_view instanceId) const {
+    uint32_t slot = static_cast<uint32_t>(state.flags.size());
+    state.flags.push_back(UNEVALUATED);
+    state.levels.push_back(DeviceTable::NO_LEVEL);
+    state.ruleStates.resize(state.ruleStates.size() + rules.size(), 0);
+    if (readsHistory) {
+        state.historyTimes.resize(state.historyTimes.size() + HISTORY, 0);
+        state.historyLevels.resize(state.historyLevels.size() + HISTORY, 0);
+        state.historyCounts.push_back(0);
+    }
+
+    state.globBits.resize(state.globBits.size() + globWords, 0);
+    uint64_t* bits = state.globBits.data() + slot * globWords;
+    names.matchAll(name, state.matched, state.nameCache);
+    for (uint32_t index : state.matched) bits[index / 64] |= uint64_t(1) << (index % 64);
+    instanceIds.matchAll(instanceId, state.matched, state.idCache);
+    for (uint32_t index : state.matched) {
+        uint32_t bit = nameGlobCount + index;
+        bits[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    return slot;
+}
+
+void AlertRules::evaluate(const DeviceTable& devices, const StringPool& strings, const Moment& moment,
+                          State& state, const OnAlert& onAlert) const {
+    if (rules.empty()) {
+        return;
+    }
+    bind(state, strings, moment.now);
+    if (state.slots.size() < strings.size()) {
+        state.slots.resize(strings.size(), NO_SLOT);
+    }
+
+    for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+        StringId device = devices.instanceId(row);
+        uint32_t slot = state.slots[device];
+        if (slot == NO_SLOT) {
+            slot = addDevice(state, strings.view(devices.name(row)), strings.view(device));
+            state.slots[device] = slot;
+        }
+
+        // Only devices that changed since the last evaluation
+        int8_t level = static_cast<int8_t>(devices.batteryLevel(row).value_or(DeviceTable::NO_LEVEL));
+        uint8_t flags = devices.isConnected(row) ? CONNECTED : 0;
+        if (state.flags[slot] == flags && state.levels[slot] == level) {
+            continue;
+        }
+        if (readsHistory && level != DeviceTable::NO_LEVEL && level != state.levels[slot]) {
+            uint32_t& count = state.historyCounts[slot];
+            size_t index = slot * HISTORY + count % HISTORY;
+            state.historyTimes[index] = moment.now;
+            state.historyLevels[index] = level;
+            count++;
+        }
+        state.flags[slot] = flags;
+        state.levels[slot] = level;
+
+        Context context;
+        context.level = level;
+        context.connected = flags & CONNECTED;
+        context.globs = state.globBits.data() + slot * globWords;
+        context.historyTimes = readsHistory ? state.historyTimes.data() + slot * HISTORY : nullptr;
+        context.historyLevels = readsHistory ? state.historyLevels.data() + slot * HISTORY : nullptr;
+        context.historyCount = readsHistory ? state.historyCounts[slot] : 0;
+        context.moment = &moment;
+        evaluateDevice(slot, device, row, context, state, onAlert);
+    }
+}
+
+void AlertRules::evaluateDevice(uint32_t slot, StringId device, DeviceTable::Row row, const Context& context,
+                                State& state, const OnAlert& onAlert) const {
+    uint32_t* ruleStates = state.ruleStates.data() + static_cast<size_t>(slot) * rules.size();
+    int64_t sinceEpoch = std::clamp<int64_t>(context.moment->now - state.epoch + 1, 1, ~ACTIVE);
+
+    for (uint32_t index = 0; index < rules.size(); index++) {
+        const Rule& rule = rules[index];
+        if (rule.readsLevel && context.level == DeviceTable::NO_LEVEL) {
+            continue;  // keeps its state until there is a level again
+        }
+        state.evaluationCount++;
+
+        uint32_t& ruleState = ruleStates[index];
+        if (ruleState & ACTIVE) {
+            // Re-armed once the expression is false across the hysteresis band
+            bool holds = run(rule.begin, context, 0) != 0 ||
+                         (rule.readsLevel && rule.hysteresis > 0 &&
+                          (run(rule.begin, context, rule.hysteresis) != 0 ||
+                           run(rule.begin, context, -rule.hysteresis) != 0));
+            if (!holds) ruleState &= ~ACTIVE;
+            continue;
+        }
+        if (run(rule.begin, context, 0) == 0) {
+            continue;
+        }
+
+        uint32_t lastAlert = ruleState;  // not ACTIVE here
+        if (lastAlert != 0 && sinceEpoch - lastAlert < rule.cooldown) {
+            ruleState |= ACTIVE;  // fired within the cooldown: no alert until it re-arms
+            continue;
+        }
+        ruleState = ACTIVE | static_cast<uint32_t>(sinceEpoch);
+        EventLog::log(EventLog::Type::ALERT, device, index, context.level);
+        EventLog::requestFlush();
+        if (onAlert) {
+            onAlert(Alert{index, row});
+        }
+    }
+}
+
+int32_t AlertRules::dropWithin(const Context& context, int32_t seconds, int32_t level) {
+    // Newest first; the first change at or before the window's start is the
+    // level the window started at
+    int64_t windowStart = context.moment->now - seconds;
+    uint32_t kept = std::min<uint32_t>(context.historyCount, HISTORY);
+    int32_t highest = std::numeric_limits<int32_t>::min();
+    for (uint32_t i = 0; i < kept; i++) {
+        size_t index = (context.historyCount - 1 - i) % HISTORY;
+        highest = std::max<int32_t>(highest, context.historyLevels[index]);
+        if (context.historyTimes[index] <= windowStart) break;
+    }
+    return kept == 0 ? 0 : wrap(static_cast<int64_t>(highest) - level);
+}
+
+int32_t AlertRules::run(uint32_t pc, const Context& context, int32_t levelOffset) const {
+    int32_t stack[MAX_STACK];
+    size_t top = 0;     // operands on the stack
+    const Instruction* program = code.data();
+    while (true) {
+        const Instruction& instruction = program[pc++];
+        int32_t arg = instruction.arg;
+        switch (instruction.op) {
+            case Op::END: return stack[0];
+            case Op::CONST: stack[top++] = arg; break;
+            case Op::LEVEL: stack[top++] = context.level + levelOffset; break;
+            case Op::CONNECTED: stack[top++] = context.connected; break;
+            case Op::HOUR: stack[top++] = context.moment->hour; break;
+            case Op::WEEKDAY: stack[top++] = context.moment->weekday; break;
+            case Op::DROP: stack[top++] = dropWithin(context, arg, context.level + levelOffset); break;
+            case Op::NAME:
+                stack[top++] = static_cast<int32_t>((context.globs[arg / 64] >> (arg % 64)) & 1);
+                break;
+            case Op::ID: {
+                uint32_t bit = nameGlobCount + static_cast<uint32_t>(arg);
+                stack[top++] = static_cast<int32_t>((context.globs[bit / 64] >> (bit % 64)) & 1);
+                break;
+            }
+            case Op::NOT: stack[top - 1] = stack[top - 1] == 0; break;
+            case Op::NEG: stack[top - 1] = wrap(-static_cast<int64_t>(stack[top - 1])); break;
+            case Op::ADD: top--; stack[top - 1] = wrap(static_cast<int64_t>(stack[top - 1]) + stack[top]); break;
+            case Op::SUB: top--; stack[top - 1] = wrap(static_cast<int64_t>(stack[top - 1]) - stack[top]); break;
+            case Op::LT: top--; stack[top - 1] = stack[top - 1] < stack[top]; break;
+            case Op::LE: top--; stack[top - 1] = stack[top - 1] <= stack[top]; break;
+            case Op::GT: top--; stack[top - 1] = stack[top - 1] > stack[top]; break;
+            case Op::GE: top--; stack[top - 1] = stack[top - 1] >= stack[top]; break;
+            case Op::EQ: top--; stack[top - 1] = stack[top - 1] == stack[top]; break;
+            case Op::NE: top--; stack[top - 1] = stack[top - 1] != stack[top]; break;
+            case Op::LT_CONST: stack[top - 1] = stack[top - 1] < arg; break;
+            case Op::LE_CONST: stack[top - 1] = stack[top - 1] <= arg; break;
+            case Op::GT_CONST: stack[top - 1] = stack[top - 1] > arg; break;
+            case Op::GE_CONST: stack[top - 1] = stack[top - 1] >= arg; break;
+            case Op::EQ_CONST: stack[top - 1] = stack[top - 1] == arg; break;
+            case Op::NE_CONST: stack[top - 1] = stack[top - 1] != arg; break;
+            case Op::JUMP_IF_FALSE:
+                if (stack[top - 1] == 0) pc = static_cast<uint32_t>(arg);
+                else top--;
+                break;
+            case Op::JUMP_IF_TRUE:
+                if (stack[top - 1] != 0) pc = static_cast<uint32_t>(arg);
+                else top--;
+                break;
+        }
+    }
+}
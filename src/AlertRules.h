@@ -0,0 +1,177 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ConfigManager.h"
+#include "DeviceTable.h"
+#include "GlobSet.h"
+#include "StringPool.h"
+
+// The config's `alerts`, compiled. Each rule's `when` expression is parsed
+// once, at load, into a flat program for a small stack machine: operands
+// are 32-bit integers (true is 1), && and || jump over their right side,
+// and a comparison with a constant is one instruction. Device names and
+// instance IDs are matched against the rules' globs (`name ~ 'Razer*'`) once
+// per device, when it is first seen; the programs test a bit.
+//
+// Expressions:
+//   level             battery level 0-100 (a rule reading it or drop() is
+//                     skipped while the device has no level)
+//   connected         1 when connected
+//   hour, weekday     local time, 0-23 and 0 (Sunday) - 6
+//   drop(<duration>)  how far the level fell within the duration (the
+//                     highest level since then minus the current one, from
+//                     the last HISTORY level changes); 90s, 30m, 2h or
+//                     seconds
+//   name ~ 'glob'     the device name matches (case folding as in
+//                     caseInsensitivePatterns); id ~ 'glob' the instance ID
+//                     (always ignoring case)
+//   numbers, true, false, ( ), ! - + < <= > >= == != && ||
+//
+// Rules are evaluated only for devices whose level or connection changed
+// since the previous evaluate() (every device the first time). A rule fires
+// when its expression becomes true for a device, and fires again for that
+// device only after it was false with the level `hysteresis` points higher
+// and lower, and no sooner than `cooldown` seconds after the last alert.
+//
+// The compiled rules are immutable and shared through the ConfigSnapshot;
+// the per-device state lives in a State owned by each caller. A State
+// remembers the rules and the string pool it was built for and starts over
+// when used with others.
+class AlertRules {
+public:
+    static constexpr size_t MAX_STACK = 32;   // operand depth of one expression
+    static constexpr size_t HISTORY = 8;      // level changes kept per device for drop()
+
+    // When evaluate() runs: Unix seconds and the local time of day
+    struct Moment {
+        int64_t now;
+        int hour;       // 0-23
+        int weekday;    // 0 = Sunday
+
+        static Moment local(int64_t now);
+    };
+
+    // A rule that fired for a device
+    struct Alert {
+        uint32_t rule;              // index into Config::alerts
+        DeviceTable::Row row;
+    };
+    using OnAlert = std::function<void(const Alert& alert)>;
+
+    class State {
+    public:
+        // Rule programs run so far
+        uint64_t evaluations() const { return evaluationCount; }
+
+        // Bytes held for the devices and the glob caches
+        size_t memoryUsage() const;
+
+    private:
+        friend class AlertRules;
+
+        uint64_t owner = 0;                 // AlertRules::id the state belongs to
+        const StringPool* pool = nullptr;   // the device handles' pool
+        int64_t epoch = 0;                  // alert times are stored relative to it
+        uint64_t evaluationCount = 0;
+
+        // Devices get a slot when first seen, so the per-rule state is
+        // only held for devices, not every string in the pool
+        std::vector<uint32_t> slots;        // by instance ID handle: slot or NO_SLOT
+
+        // By slot
+        std::vector<uint8_t> flags;         // CONNECTED (or UNEVALUATED) as last evaluated
+        std::vector<int8_t> levels;         // level as last evaluated
+        std::vector<uint64_t> globBits;     // globWords per device
+        std::vector<uint32_t> ruleStates;   // rules per device: ACTIVE | last alert (seconds after epoch + 1)
+        std::vector<int64_t> historyTimes;  // HISTORY per device (rules using drop() only)
+        std::vector<int8_t> historyLevels;
+        std::vector<uint32_t> historyCounts; // level changes recorded so far
+
+        GlobSet::Cache nameCache;
+        GlobSet::Cache idCache;
+        std::vector<uint32_t> matched;
+    };
+
+    // No rules
+    AlertRules();
+
+    AlertRules(const std::vector<AlertRule>& rules, bool ignoreCase);
+
+    // Parse an expression without keeping it; false with a message such as
+    // "column 9: expected a number" for config errors
+    static bool check(std::string_view expression, std::string& error);
+
+    bool empty() const { return rules.empty(); }
+    size_t size() const { return rules.size(); }
+    const std::string& name(uint32_t rule) const { return rules[rule].name; }
+
+    // Run the rules for every device whose level or connection changed since
+    // the last call with this state, and report each alert (also logged as
+    // an EventLog ALERT). Allocation-free unless new devices appeared.
+    void evaluate(const DeviceTable& devices, const StringPool& strings, const Moment& moment,
+                  State& state, const OnAlert& onAlert) const;
+
+    // "Razer Basilisk V3: 18%, connected"
+    static std::string describe(const DeviceTable& devices, const StringPool& strings, DeviceTable::Row row);
+
+    // Bytes held by the programs and globs
+    size_t memoryUsage() const;
+
+private:
+    enum class Op : uint8_t;
+
+    struct Instruction {
+        Op op;
+        int32_t arg;
+    };
+
+    struct Rule {
+        std::string name;
+        uint32_t begin;         // first instruction
+        int32_t hysteresis;
+        int32_t cooldown;
+        bool readsLevel;        // level or drop()
+    };
+
+    // What a program sees of one device
+    struct Context {
+        int32_t level;
+        int32_t connected;
+        const uint64_t* globs;
+        const int64_t* historyTimes;
+        const int8_t* historyLevels;
+        uint32_t historyCount;
+        const Moment* moment;
+    };
+
+    class Compiler;
+
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    static constexpr uint8_t CONNECTED = 1;
+    static constexpr uint8_t UNEVALUATED = 0x80;  // a new slot: differs from any reading
+    static constexpr uint32_t ACTIVE = 0x80000000u;
+
+    int32_t run(uint32_t begin, const Context& context, int32_t levelOffset) const;
+    static int32_t dropWithin(const Context& context, int32_t seconds, int32_t level);
+
+    // Start over if the state was built for other rules or another pool
+    void bind(State& state, const StringPool& strings, int64_t now) const;
+    // Slot for a device seen for the first time, with its glob bits
+    uint32_t addDevice(State& state, std::string_view name, std::string_view instanceId) const;
+    void evaluateDevice(uint32_t slot, StringId device, DeviceTable::Row row, const Context& context,
+                        State& state, const OnAlert& onAlert) const;
+
+    std::vector<Rule> rules;
+    std::vector<Instruction> code;
+    GlobSet names;
+    GlobSet instanceIds;
+    size_t globWords;           // 64-bit words per device: name globs, then instance ID globs
+    uint32_t nameGlobCount;
+    bool readsHistory;          // some rule uses drop()
+    uint64_t id;                // identifies the compiled rules for states
+};
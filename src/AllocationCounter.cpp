@@ -0,0 +1,134 @@
+#include "AllocationCounter.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef RAZERTRAY_COUNT_ALLOCATIONS
+
+#include <atomic>
+#ifndef _WIN32
+#include <malloc.h>
+#endif
+
+namespace {
+    // Per thread, so work on background threads (config reload, device
+    // discovery) does not trip checks made on the UI thread
+    thread_local size_t allocationCount = 0;
+
+    // Process-wide; counted in the blocks' usable sizes, which is what the
+    // allocator can tell again when they are freed
+    std::atomic<size_t> liveBytes = 0;
+
+    size_t usableSize(void* p) {
+#ifdef _WIN32
+        return _msize(p);
+#else
+        return malloc_usable_size(p);
+#endif
+    }
+
+    size_t alignedUsableSize(void* p, size_t alignment) {
+#ifdef _WIN32
+        return _aligned_msize(p, alignment, 0);
+#else
+        (void)alignment;
+        return malloc_usable_size(p);
+#endif
+    }
+
+    void* countedAlloc(size_t size) {
+        allocationCount++;
+        if (size == 0) size = 1;
+        void* p = std::malloc(size);
+        if (!p) throw std::bad_alloc();
+        liveBytes.fetch_add(usableSize(p), std::memory_order_relaxed);
+        return p;
+    }
+
+    void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+        allocationCount++;
+        size_t alignment = static_cast<size_t>(align);
+        if (size == 0) size = 1;
+#ifdef _WIN32
+        void* p = _aligned_malloc(size, alignment);
+#else
+        size = (size + alignment - 1) / alignment * alignment;
+        void* p = std::aligned_alloc(alignment, size);
+#endif
+        if (!p) throw std::bad_alloc();
+        liveBytes.fetch_add(alignedUsableSize(p, alignment), std::memory_order_relaxed);
+        return p;
+    }
+
+    void countedFree(void* p) {
+        if (!p) return;
+        liveBytes.fetch_sub(usableSize(p), std::memory_order_relaxed);
+        std::free(p);
+    }
+
+    void alignedFree(void* p, std::align_val_t align) {
+        if (!p) return;
+        liveBytes.fetch_sub(alignedUsableSize(p, static_cast<size_t>(align)), std::memory_order_relaxed);
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+void* operator new[](size_t size, std::align_val_t align) { return countedAlignedAlloc(size, align); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAlloc(size); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete[](void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+void operator delete[](void* p, size_t) noexcept { countedFree(p); }
+void operator delete(void* p, std::align_val_t align) noexcept { alignedFree(p, align); }
+void operator delete[](void* p, std::align_val_t align) noexcept { alignedFree(p, align); }
+void operator delete(void* p, size_t, std::align_val_t align) noexcept { alignedFree(p, align); }
+void operator delete[](void* p, size_t, std::align_val_t align) noexcept { alignedFree(p, align); }
+
+size_t AllocationCounter::count() {
+    return allocationCount;
+}
+
+size_t AllocationCounter::liveBytes() {
+    return ::liveBytes.load(std::memory_order_relaxed);
+}
+
+#else
+
+size_t AllocationCounter::count() {
+    return 0;
+}
+
+size_t AllocationCounter::liveBytes() {
+    return 0;
+}
+
+#endif
+
+ScopedNoAllocations::ScopedNoAllocations(const char* name)
+    : scopeName(name)
+    , startCount(AllocationCounter::count())
+{
+}
+
+ScopedNoAllocations::~ScopedNoAllocations() {
+    size_t allocations = AllocationCounter::count() - startCount;
+    if (allocations != 0) {
+        std::fprintf(stderr, "%s: %zu unexpected heap allocation(s)\n", scopeName, allocations);
+    }
+    assert(allocations == 0 && "steady-state path allocated from the global heap");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+// Global allocation counting hook.
+// When built with RAZERTRAY_COUNT_ALLOCATIONS the global operator new is
+// replaced by a counting version, so code paths that are supposed to stay off
+// the heap (the steady-state refresh cycle) can assert it. In normal builds
+// the counter always reads zero and the checks compile away.
+namespace AllocationCounter {
+    // Number of global operator new calls made by the calling thread
+    size_t count();
+
+    // Bytes currently allocated through global operator new, by all threads
+    size_t liveBytes();
+
+    // Whether the counting operator new is compiled in
+    constexpr bool enabled() {
+#ifdef RAZERTRAY_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+}
+
+// Asserts (debug builds) that the current thread makes no global operator
+// new call while in scope
+class ScopedNoAllocations {
+public:
+    explicit ScopedNoAllocations(const char* scopeName);
+    ~ScopedNoAllocations();
+
+    ScopedNoAllocations(const ScopedNoAllocations&) = delete;
+    ScopedNoAllocations& operator=(const ScopedNoAllocations&) = delete;
+
+private:
+    const char* scopeName;
+    size_t startCount;
+};
@@ -0,0 +1,17 @@
+#include "BatteryColors.h"
+
+BatteryColors::Table BatteryColors::build(const Config::BatteryThresholds& thresholds) {
+    Table table;
+    for (int level = 0; level <= 100; level++) {
+        if (level >= thresholds.high) {
+            table[level] = GREEN;
+        } else if (level >= thresholds.medium) {
+            table[level] = ORANGE;
+        } else if (level >= thresholds.low) {
+            table[level] = RED_ORANGE;
+        } else {
+            table[level] = RED;
+        }
+    }
+    return table;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "ConfigManager.h"
+
+// Icon fill color for every battery level, precomputed from the configured
+// thresholds so drawing an icon is a table lookup
+namespace BatteryColors {
+    // Colors use the Win32 COLORREF layout (0x00BBGGRR)
+    constexpr uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+        return static_cast<uint32_t>(r) | (static_cast<uint32_t>(g) << 8) | (static_cast<uint32_t>(b) << 16);
+    }
+
+    constexpr uint32_t GREEN = rgb(0, 200, 0);
+    constexpr uint32_t ORANGE = rgb(255, 165, 0);
+    constexpr uint32_t RED_ORANGE = rgb(255, 100, 0);
+    constexpr uint32_t RED = rgb(200, 0, 0);
+    constexpr uint32_t UNKNOWN = rgb(128, 128, 128);  // no battery reading
+
+    // Indexed by level 0-100
+    using Table = std::array<uint32_t, 101>;
+
+    // high and above = green, medium = orange, low = red-orange, below = red
+    Table build(const Config::BatteryThresholds& thresholds);
+}
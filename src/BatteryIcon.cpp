@@ -1,110 +1,44 @@
 #include "BatteryIcon.h"
+#include "IconRaster.h"
+#include "LatencyProbes.h"
 #include <windows.h>
-#include <gdiplus.h>
 #include <algorithm>
 
-using namespace Gdiplus;
-
-BatteryIcon::BatteryIcon() : gdiplusToken(0) {
-    // Initialize GDI+
-    GdiplusStartupInput gdiplusStartupInput;
-    GdiplusStartup(&gdiplusToken, &gdiplusStartupInput, nullptr);
+BatteryIcon::BatteryIcon()
+    : levelColors(BatteryColors::build({60, 30, 15}))  // Defaults until a config is applied
+{
+    // Icons are drawn with plain GDI on demand; nothing to start up
 }
 
 BatteryIcon::~BatteryIcon() {
-    // Shutdown GDI+
-    if (gdiplusToken != 0) {
-        GdiplusShutdown(gdiplusToken);
-    }
 }
 
 COLORREF BatteryIcon::getBatteryColor(int batteryLevel) {
-    if (batteryLevel >= 60) {
-        return RGB(0, 200, 0);  // Green
-    } else if (batteryLevel >= 30) {
-        return RGB(255, 165, 0);  // Orange
-    } else if (batteryLevel >= 15) {
-        return RGB(255, 100, 0);  // Red-Orange
-    } else {
-        return RGB(200, 0, 0);  // Red
-    }
+    return static_cast<COLORREF>(levelColors[std::clamp(batteryLevel, 0, 100)]);
 }
 
-void BatteryIcon::drawBatteryShape(HDC hdc, int batteryLevel, COLORREF color) {
-    // Battery dimensions (similar to C# version)
-    const int batteryWidth = 10;
-    const int batteryHeight = 13;
-    const int batteryX = 3;
-    const int batteryY = 2;
-
-    // Create pen for outline
-    HPEN pen = CreatePen(PS_SOLID, 2, color);
-    HPEN oldPen = static_cast<HPEN>(SelectObject(hdc, pen));
-
-    // Create brush for fill
-    HBRUSH brush = CreateSolidBrush(color);
-    HBRUSH oldBrush = static_cast<HBRUSH>(SelectObject(hdc, brush));
-
-    // Draw battery outline (hollow rectangle)
-    SelectObject(hdc, GetStockObject(NULL_BRUSH));  // No fill for outline
-    Rectangle(hdc, batteryX, batteryY, batteryX + batteryWidth, batteryY + batteryHeight);
-
-    // Draw battery terminal (small rectangle on top)
-    const int terminalWidth = 4;
-    const int terminalHeight = 2;
-    const int terminalX = batteryX + (batteryWidth - terminalWidth) / 2;
-    const int terminalY = batteryY - terminalHeight;
-    Rectangle(hdc, terminalX, terminalY, terminalX + terminalWidth, terminalY + terminalHeight);
-
-    // Draw battery fill based on level
-    if (batteryLevel > 0) {
-        SelectObject(hdc, brush);  // Use solid brush for fill
-
-        int fillHeight = static_cast<int>((batteryHeight - 2) * batteryLevel / 100.0f);
-        int fillY = batteryY + batteryHeight - fillHeight - 1;
-
-        Rectangle(hdc,
-            batteryX + 1,
-            fillY,
-            batteryX + batteryWidth - 1,
-            batteryY + batteryHeight - 1);
-    }
-
-    // Clean up
-    SelectObject(hdc, oldPen);
-    SelectObject(hdc, oldBrush);
-    DeleteObject(pen);
-    DeleteObject(brush);
+size_t BatteryIcon::iconBytes() {
+    // Mask rows are padded to 16 bits, which ICON_SIZE already is
+    return ICON_SIZE * ICON_SIZE * 4 + ICON_SIZE * ICON_SIZE / 8;
 }
 
 HICON BatteryIcon::createBatteryIcon(std::optional<int> batteryLevel) {
-    // Create bitmap for icon
-    HDC screenDC = GetDC(nullptr);
-    HDC memDC = CreateCompatibleDC(screenDC);
-    HBITMAP bitmap = CreateCompatibleBitmap(screenDC, ICON_SIZE, ICON_SIZE);
-    HBITMAP oldBitmap = static_cast<HBITMAP>(SelectObject(memDC, bitmap));
-
-    // Fill with transparent background
-    RECT rect = { 0, 0, ICON_SIZE, ICON_SIZE };
-    HBRUSH bgBrush = static_cast<HBRUSH>(GetStockObject(BLACK_BRUSH));
-    FillRect(memDC, &rect, bgBrush);
+    LatencyProbes::Probe probe(LatencyProbes::Site::CreateIcon);
 
     // Determine battery level and color
-    int level = batteryLevel.value_or(0);
-    COLORREF color = batteryLevel.has_value() ? getBatteryColor(level) : RGB(128, 128, 128);
-
-    // Draw battery shape
-    drawBatteryShape(memDC, level, color);
+    COLORREF color = batteryLevel.has_value() ? getBatteryColor(*batteryLevel) : static_cast<COLORREF>(BatteryColors::UNKNOWN);
 
-    // Create mask bitmap (for transparency)
-    HBITMAP maskBitmap = CreateBitmap(ICON_SIZE, ICON_SIZE, 1, 1, nullptr);
-    HDC maskDC = CreateCompatibleDC(screenDC);
-    HBITMAP oldMaskBitmap = static_cast<HBITMAP>(SelectObject(maskDC, maskBitmap));
+    // Draw into memory, then hand the pixels to the bitmap in one call
+    IconRaster::Pixels pixels;
+    IconRaster::drawBattery(pixels, batteryLevel, color);
+    HBITMAP bitmap = CreateBitmap(ICON_SIZE, ICON_SIZE, 1, 32, pixels.data());
 
-    // Fill mask with white (opaque)
-    RECT maskRect = { 0, 0, ICON_SIZE, ICON_SIZE };
-    HBRUSH whiteBrush = static_cast<HBRUSH>(GetStockObject(WHITE_BRUSH));
-    FillRect(maskDC, &maskRect, whiteBrush);
+    // All-white mask: the black background XORs to the screen (transparent)
+    static const WORD opaqueMask[ICON_SIZE] = {
+        0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+        0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+    };
+    HBITMAP maskBitmap = CreateBitmap(ICON_SIZE, ICON_SIZE, 1, 1, opaqueMask);
 
     // Create icon from bitmaps
     ICONINFO iconInfo = {};
@@ -114,14 +48,9 @@ HICON BatteryIcon::createBatteryIcon(std::optional<int> batteryLevel) {
 
     HICON icon = CreateIconIndirect(&iconInfo);
 
-    // Clean up
-    SelectObject(memDC, oldBitmap);
-    SelectObject(maskDC, oldMaskBitmap);
-    DeleteDC(memDC);
-    DeleteDC(maskDC);
+    // The icon keeps its own copies of the bitmaps
     DeleteObject(bitmap);
     DeleteObject(maskBitmap);
-    ReleaseDC(nullptr, screenDC);
 
     return icon;
 }
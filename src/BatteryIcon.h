@@ -3,6 +3,7 @@
 #include <windows.h>
 #include <optional>
 #include "SafeHandles.h"
+#include "BatteryColors.h"
 
 class BatteryIcon {
 public:
@@ -13,15 +14,18 @@ public:
     // Returns HICON that caller is responsible for (use SafeIcon wrapper)
     HICON createBatteryIcon(std::optional<int> batteryLevel);
 
+    // Use colors built for the configured thresholds (see BatteryColors)
+    void setLevelColors(const BatteryColors::Table& colors) { levelColors = colors; }
+
+    // GDI memory behind one icon (32-bit color and 1-bit mask bitmaps)
+    static size_t iconBytes();
+
 private:
-    static constexpr int ICON_SIZE = 16;  // 16x16 system tray icon
+    static constexpr int ICON_SIZE = 16;  // 16x16 system tray icon (IconRaster::SIZE)
 
     // Get color based on battery level
     COLORREF getBatteryColor(int batteryLevel);
 
-    // Draw battery shape on device context
-    void drawBatteryShape(HDC hdc, int batteryLevel, COLORREF color);
-
-    // GDI+ token for initialization
-    ULONG_PTR gdiplusToken;
+    // Fill color per battery level
+    BatteryColors::Table levelColors;
 };
@@ -0,0 +1,82 @@
+#include "BinaryIO.h"
+#include <cstdio>
+#include <system_error>
+
+namespace {
+    constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+
+    uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t mixWord(uint64_t word) {
+        return rotl(word * PRIME2, 31) * PRIME1;
+    }
+}
+
+std::FILE* BinaryIO::openForWriting(const std::filesystem::path& path) {
+#ifdef _WIN32
+    return _wfopen(path.c_str(), L"wb");
+#else
+    return std::fopen(path.c_str(), "wb");
+#endif
+}
+
+uint64_t BinaryIO::hash(std::string_view data) {
+    const char* p = data.data();
+    size_t remaining = data.size();
+    uint64_t h = PRIME3 ^ (static_cast<uint64_t>(data.size()) * PRIME1);
+
+    while (remaining >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = rotl(h ^ mixWord(word), 27) * PRIME1 + PRIME2;
+        p += 8;
+        remaining -= 8;
+    }
+
+    uint64_t tail = 0;
+    if (remaining > 0) std::memcpy(&tail, p, remaining);
+    h = rotl(h ^ mixWord(tail), 27) * PRIME1 + PRIME2;
+
+    // Final avalanche so every input bit affects every output bit
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+bool BinaryIO::replaceFile(const std::filesystem::path& path, std::string_view contents) {
+    std::filesystem::path temporary = path;
+    temporary += ".tmp";
+    {
+        std::FILE* file = openForWriting(temporary);
+        if (!file) {
+            return false;
+        }
+        bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+        if (std::fclose(file) != 0 || !written) {
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        // Some runtimes refuse to rename over an existing file
+        std::filesystem::remove(path, error);
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (error) {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        return false;
+    }
+    return true;
+}
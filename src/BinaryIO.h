@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Flat binary encoding for caches written and read by the same build.
+// Values are stored in native byte order and layout; arrays of trivially
+// copyable elements are one length prefix plus a single memcpy each way.
+// Written types may not have padding (it would copy whatever the bytes
+// held, so the same input could give different files): structs spell it
+// out as zeroed members.
+namespace BinaryIO {
+    class Writer {
+    public:
+        template<typename T>
+        void write(const T& value) {
+            static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>);
+            bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        template<typename T>
+        void writeArray(const std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T> && std::has_unique_object_representations_v<T>);
+            write(static_cast<uint64_t>(values.size()));
+            bytes.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        }
+
+        void writeString(std::string_view value) {
+            write(static_cast<uint64_t>(value.size()));
+            bytes.append(value.data(), value.size());
+        }
+
+        const std::string& data() const { return bytes; }
+
+    private:
+        std::string bytes;
+    };
+
+    // Bounds-checked reader; every read fails (returns false) once the input
+    // is exhausted
+    class Reader {
+    public:
+        explicit Reader(std::string_view data) : input(data), offset(0) {}
+
+        template<typename T>
+        bool read(T& value) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            if (input.size() - offset < sizeof(T)) return false;
+            std::memcpy(&value, input.data() + offset, sizeof(T));
+            offset += sizeof(T);
+            return true;
+        }
+
+        template<typename T>
+        bool readArray(std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            uint64_t count = 0;
+            if (!read(count) || count > (input.size() - offset) / sizeof(T)) return false;
+            values.resize(static_cast<size_t>(count));
+            std::memcpy(values.data(), input.data() + offset, values.size() * sizeof(T));
+            offset += values.size() * sizeof(T);
+            return true;
+        }
+
+        bool readString(std::string& value) {
+            uint64_t length = 0;
+            if (!read(length) || length > input.size() - offset) return false;
+            value.assign(input.data() + offset, static_cast<size_t>(length));
+            offset += static_cast<size_t>(length);
+            return true;
+        }
+
+        bool atEnd() const { return offset == input.size(); }
+
+    private:
+        std::string_view input;
+        size_t offset;
+    };
+
+    // 64-bit non-cryptographic hash (8 bytes per step) for change detection
+    // and corruption checks
+    uint64_t hash(std::string_view data);
+
+    // Write a whole file through a temporary (path + ".tmp") that is then
+    // renamed over the target, so readers never see a partial file
+    bool replaceFile(const std::filesystem::path& path, std::string_view contents);
+
+    // fopen(path, "wb") that takes any path (wide on Windows). Files are
+    // written with stdio rather than ofstream: the headless service saves
+    // on every refresh, and iostreams' locale machinery alone is most of
+    // its resident set.
+    std::FILE* openForWriting(const std::filesystem::path& path);
+}
@@ -0,0 +1,97 @@
+#include "BluetoothAddress.h"
+
+namespace {
+    constexpr size_t ADDRESS_DIGITS = 12;
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    }
+
+    char upper(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    bool startsWith(std::string_view text, std::string_view prefix) {
+        if (text.size() < prefix.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.size(); i++) {
+            if (upper(text[i]) != prefix[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // ADDRESS_DIGITS hex digits at the start of text, every `separator`
+    // after each pair skipped ('\0': none)
+    std::optional<uint64_t> parseAddress(std::string_view text, char separator) {
+        uint64_t address = 0;
+        size_t position = 0;
+        for (size_t digits = 0; digits < ADDRESS_DIGITS; digits++) {
+            if (separator != '\0' && digits != 0 && digits % 2 == 0) {
+                if (position >= text.size() || text[position] != separator) {
+                    return std::nullopt;
+                }
+                position++;
+            }
+            int digit = position < text.size() ? hexValue(text[position]) : -1;
+            if (digit < 0) {
+                return std::nullopt;
+            }
+            address = (address << 4) | static_cast<uint64_t>(digit);
+            position++;
+        }
+        return address;
+    }
+
+    // The segment after "DEV_": the address, which must be all of it
+    std::optional<uint64_t> deviceSegment(std::string_view rest) {
+        if (rest.size() > ADDRESS_DIGITS && rest[ADDRESS_DIGITS] != '\\') {
+            return std::nullopt;
+        }
+        return parseAddress(rest, '\0');
+    }
+}
+
+std::optional<uint64_t> BluetoothAddress::fromInstanceId(std::string_view instanceId) {
+    constexpr std::string_view PREFIX = "BTHLE\\DEV_";
+    if (!startsWith(instanceId, PREFIX)) {
+        return std::nullopt;
+    }
+    return deviceSegment(instanceId.substr(PREFIX.size()));
+}
+
+std::optional<uint64_t> BluetoothAddress::fromDeviceNode(std::string_view instanceId) {
+    if (auto address = fromInstanceId(instanceId)) {
+        return address;
+    }
+
+    constexpr std::string_view CLASSIC = "BTHENUM\\";
+    if (startsWith(instanceId, CLASSIC)) {
+        std::string_view rest = instanceId.substr(CLASSIC.size());
+        if (startsWith(rest, "DEV_")) {
+            return deviceSegment(rest.substr(4));
+        }
+        // Service node: the last segment ends in "&<address>_C<n>"; the
+        // local radio's own services carry address 0
+        size_t suffix = instanceId.rfind('_');
+        if (suffix == std::string_view::npos || suffix < ADDRESS_DIGITS + 1 ||
+            instanceId[suffix - ADDRESS_DIGITS - 1] != '&') {
+            return std::nullopt;
+        }
+        auto address = parseAddress(instanceId.substr(suffix - ADDRESS_DIGITS, ADDRESS_DIGITS), '\0');
+        return address != uint64_t(0) ? address : std::nullopt;
+    }
+
+    constexpr std::string_view SUPPLY = "hid-";
+    constexpr size_t SEPARATED_DIGITS = ADDRESS_DIGITS + ADDRESS_DIGITS / 2 - 1;   // aa:bb:cc:dd:ee:ff
+    if (instanceId.starts_with(SUPPLY) && instanceId.size() > SUPPLY.size() + SEPARATED_DIGITS &&
+        instanceId[SUPPLY.size() + SEPARATED_DIGITS] == '-') {
+        return parseAddress(instanceId.substr(SUPPLY.size(), SEPARATED_DIGITS), ':');
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Bluetooth device addresses as 48-bit integer keys
+namespace BluetoothAddress {
+    // Parse the address out of a Bluetooth LE instance ID or pattern:
+    // "BTHLE\DEV_C8A2D3E4F501" optionally followed by "\..." (prefix
+    // case-insensitive). Returns nullopt for anything else, including
+    // wildcard patterns such as "BTHLE\DEV_*".
+    std::optional<uint64_t> fromInstanceId(std::string_view instanceId);
+
+    // The address of any node a Bluetooth device shows up as, for telling
+    // that two enumerators list the same device: the above, classic
+    // "BTHENUM\DEV_<address>\..." device nodes, their service nodes
+    // ("BTHENUM\{<uuid>}_...\...&<address>_C<n>") and Linux supplies named
+    // "hid-aa:bb:cc:dd:ee:ff-battery". Returns nullopt for anything else.
+    std::optional<uint64_t> fromDeviceNode(std::string_view instanceId);
+}
@@ -0,0 +1,571 @@
+#include "Collector.h"
+#include "DeviceStateCache.h"
+#include "MemoryAccounting.h"
+#include "PrometheusText.h"
+#include "ProcessTelemetry.h"
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace CollectorProtocol;
+using namespace PrometheusText;
+
+namespace {
+    constexpr uintptr_t NO_SOCKET = ~uintptr_t(0);
+    // Room for bursts from many agents before the kernel drops datagrams
+    // (which the sequence numbers then recover from)
+    constexpr int RECEIVE_BUFFER = 4 * 1024 * 1024;
+    // How often receive() looks for hosts past the timeout
+    constexpr int64_t EVICTION_INTERVAL_SECONDS = 60;
+
+    // "[a.b.c.d:]port"; the address defaults to every interface
+    bool parseListen(std::string_view text, uint32_t& address, uint16_t& port) {
+        if (text.find(':') != std::string_view::npos) {
+            return parseEndpoint(text, address, port);
+        }
+        unsigned value = 0;
+        auto [next, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || error != std::errc() || next != text.data() + text.size() || value > 65535) {
+            return false;
+        }
+        address = INADDR_ANY;
+        port = static_cast<uint16_t>(value);
+        return true;
+    }
+
+    void appendHostSample(std::string& out, const char* name, std::string_view host, int64_t value) {
+        out += name;
+        out += '{';
+        appendLabel(out, "host", host);
+        out += "} ";
+        appendValue(out, value);
+    }
+}
+
+bool Collector::receive(std::string_view datagram, int64_t now, std::string& reply) {
+    std::lock_guard<std::mutex> lock(mutex);
+    datagramCount++;
+    if (now - lastEviction >= EVICTION_INTERVAL_SECONDS) {
+        evictStale(now);
+    }
+
+    Reader in(datagram);
+    uint64_t version = 0;
+    uint8_t kind = 0;
+    uint64_t session = 0;
+    uint64_t sequenceNumber = 0;
+    uint64_t sentAt = 0;
+    if (!in.readMagic(magic()) || !in.readVarint(version) || version != VERSION || !in.readByte(kind) ||
+        (kind != BATCH && kind != SNAPSHOT) || !in.readVarint(session) || !in.readVarint(sequenceNumber) ||
+        !in.readVarint(sentAt)) {
+        rejectedCount++;
+        return false;
+    }
+
+    if (kind == SNAPSHOT) {
+        std::string_view hostName;
+        uint64_t indexLimit = 0;
+        if (!in.readString(hostName) || hostName.empty() || hostName.size() > MAX_HOST_NAME ||
+            !in.readVarint(indexLimit) || indexLimit > MAX_DEVICE_INDEX) {
+            rejectedCount++;
+            return false;
+        }
+        auto named = hostsByName.find(hostName);
+        Host* host = nullptr;
+        if (named == hostsByName.end()) {
+            if (hosts.size() >= MAX_HOSTS) {
+                evictStale(now);
+            }
+            if (hosts.size() >= MAX_HOSTS) {
+                rejectedCount++;
+                return false;  // not answered: a RESYNC would only bring the snapshot back
+            }
+            host = hosts.emplace_back(std::make_unique<Host>()).get();
+            host->name = hostName;
+            hostsByName.emplace(host->name, host);
+        } else {
+            host = named->second;
+            if (host->session == session && host->synchronized && sequenceNumber < host->nextSequence) {
+                return false;  // a late duplicate of a snapshot already applied
+            }
+        }
+        if (host->session != session) {
+            hostsBySession.erase(host->session);
+            hostsBySession[session] = host;
+            host->session = session;
+        }
+        clear(*host);
+        host->indexLimit = indexLimit;
+        if (host->flags.size() > indexLimit) {
+            size_t size = static_cast<size_t>(indexLimit);
+            host->names.resize(size);
+            host->instanceIds.resize(size);
+            host->levels.resize(size);
+            host->flags.resize(size);
+            host->changeTimes.resize(size);
+        }
+        host->lastSeen = now;
+        host->synchronized = true;
+        host->nextSequence = sequenceNumber + 1;
+        if (!apply(*host, in, unzigzag(sentAt))) {
+            rejectedCount++;
+            host->synchronized = false;
+            return requestResync(session, reply);
+        }
+        return false;
+    }
+
+    auto known = hostsBySession.find(session);
+    if (known == hostsBySession.end()) {
+        return requestResync(session, reply);  // collector restarted, or the snapshot was lost
+    }
+    Host& host = *known->second;
+    host.lastSeen = now;
+    if (host.synchronized && sequenceNumber < host.nextSequence) {
+        return false;  // duplicate or reordered behind a later one
+    }
+    if (!host.synchronized || sequenceNumber != host.nextSequence) {
+        if (host.synchronized) {
+            gapCount++;
+            host.synchronized = false;
+        }
+        return requestResync(session, reply);
+    }
+    host.nextSequence++;
+    if (!apply(host, in, unzigzag(sentAt))) {
+        rejectedCount++;
+        host.synchronized = false;
+        return requestResync(session, reply);
+    }
+    return false;
+}
+
+bool Collector::apply(Host& host, Reader& in, int64_t sentAt) {
+    while (!in.atEnd()) {
+        uint8_t tag = 0;
+        uint64_t index = 0;
+        if (!in.readByte(tag) || !in.readVarint(index) || index >= host.indexLimit) {
+            return false;
+        }
+        switch (tag) {
+            case DEVICE: {
+                std::string_view name;
+                std::string_view instanceId;
+                if (!in.readString(name) || !in.readString(instanceId) ||
+                    host.strings.memoryUsage() + name.size() + instanceId.size() > MAX_HOST_STRING_BYTES) {
+                    return false;
+                }
+                if (index >= host.flags.size()) {
+                    size_t size = static_cast<size_t>(index) + 1;
+                    host.names.resize(size);
+                    host.instanceIds.resize(size);
+                    host.levels.resize(size, -1);
+                    host.flags.resize(size, 0);
+                    host.changeTimes.resize(size, 0);
+                }
+                if (!(host.flags[index] & LIVE)) {
+                    host.levels[index] = -1;
+                    host.flags[index] = LIVE;
+                    host.changeTimes[index] = 0;
+                    host.liveCount++;
+                    deviceCount++;
+                }
+                host.names[index] = host.strings.intern(name);
+                host.instanceIds[index] = host.strings.intern(instanceId);
+                break;
+            }
+            case STATE: {
+                uint64_t state = 0;
+                uint64_t age = 0;
+                if (!in.readVarint(state) || !in.readVarint(age) || index >= host.flags.size() ||
+                    !(host.flags[index] & LIVE) || (state >> 1) > 101) {
+                    return false;
+                }
+                host.levels[index] = static_cast<int8_t>(static_cast<int>(state >> 1) - 1);
+                host.flags[index] = LIVE | ((state & 1) ? CONNECTED : 0);
+                host.changeTimes[index] = age == 0 ? 0 : sentAt - static_cast<int64_t>(age - 1);
+                updateCount++;
+                break;
+            }
+            case REMOVE:
+                if (index < host.flags.size() && (host.flags[index] & LIVE)) {
+                    host.flags[index] = 0;
+                    host.liveCount--;
+                    deviceCount--;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+void Collector::clear(Host& host) {
+    // Keeps the arrays' capacity for the snapshot refilling them; the
+    // strings start over, so names a host no longer has are not kept
+    deviceCount -= host.liveCount;
+    host.liveCount = 0;
+    std::fill(host.flags.begin(), host.flags.end(), 0);
+    host.strings = StringPool();
+}
+
+void Collector::evictStale(int64_t now) {
+    lastEviction = now;
+    auto stale = [&](const std::unique_ptr<Host>& host) { return now - host->lastSeen > HOST_TIMEOUT_SECONDS; };
+    for (const auto& host : hosts) {
+        if (!stale(host)) {
+            continue;
+        }
+        deviceCount -= host->liveCount;
+        hostsByName.erase(host->name);
+        auto bySession = hostsBySession.find(host->session);
+        if (bySession != hostsBySession.end() && bySession->second == host.get()) {
+            hostsBySession.erase(bySession);
+        }
+        evictedCount++;
+    }
+    hosts.erase(std::remove_if(hosts.begin(), hosts.end(), stale), hosts.end());
+}
+
+bool Collector::requestResync(uint64_t session, std::string& reply) {
+    char message[sizeof(MAGIC) + 2 * MAX_VARINT + 1];
+    size_t length = sizeof(MAGIC);
+    std::copy(std::begin(MAGIC), std::end(MAGIC), message);
+    length += encodeVarint(VERSION, message + length);
+    message[length++] = static_cast<char>(RESYNC);
+    length += encodeVarint(session, message + length);
+    reply.assign(message, length);
+    resyncCount++;
+    return true;
+}
+
+Collector::Stats Collector::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return Stats{datagramCount, updateCount, gapCount, resyncCount, rejectedCount, evictedCount, hosts.size(),
+                 deviceCount};
+}
+
+size_t Collector::memoryUsage() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t bytes = MemoryAccounting::bytesOf(hosts) + MemoryAccounting::treeBytes(hostsByName) +
+                   MemoryAccounting::hashTableBytes(hostsBySession);
+    for (const auto& host : hosts) {
+        bytes += sizeof(Host) + MemoryAccounting::bytesOf(host->name) + host->strings.memoryUsage() +
+                 MemoryAccounting::bytesOf(host->names) + MemoryAccounting::bytesOf(host->instanceIds) +
+                 MemoryAccounting::bytesOf(host->levels) + MemoryAccounting::bytesOf(host->flags) +
+                 MemoryAccounting::bytesOf(host->changeTimes);
+    }
+    return bytes;
+}
+
+std::optional<uint64_t> Collector::sequence(std::string_view hostName) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto named = hostsByName.find(hostName);
+    if (named == hostsByName.end() || !named->second->synchronized) {
+        return std::nullopt;
+    }
+    return named->second->nextSequence - 1;
+}
+
+void Collector::forEachDevice(const std::function<void(const Device&)>& visit) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& [name, host] : hostsByName) {
+        for (size_t index = 0; index < host->flags.size(); index++) {
+            if (!(host->flags[index] & LIVE)) {
+                continue;
+            }
+            int8_t level = host->levels[index];
+            visit(Device{name, host->strings.view(host->names[index]), host->strings.view(host->instanceIds[index]),
+                         level < 0 ? std::nullopt : std::optional<int>(level),
+                         (host->flags[index] & CONNECTED) != 0, host->changeTimes[index]});
+        }
+    }
+}
+
+void Collector::render(std::string& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    appendHeader(out, "razertray_collector_hosts", "gauge", "Hosts that pushed to this collector.");
+    appendSample(out, "razertray_collector_hosts", static_cast<int64_t>(hosts.size()));
+    appendHeader(out, "razertray_collector_devices", "gauge", "Devices of all hosts.");
+    appendSample(out, "razertray_collector_devices", static_cast<int64_t>(deviceCount));
+    appendHeader(out, "razertray_collector_datagrams_total", "counter", "Datagrams received from agents.");
+    appendSample(out, "razertray_collector_datagrams_total", static_cast<int64_t>(datagramCount));
+    appendHeader(out, "razertray_collector_updates_total", "counter", "Device states applied.");
+    appendSample(out, "razertray_collector_updates_total", static_cast<int64_t>(updateCount));
+    appendHeader(out, "razertray_collector_gaps_total", "counter", "Sequence gaps (lost datagrams) detected.");
+    appendSample(out, "razertray_collector_gaps_total", static_cast<int64_t>(gapCount));
+    appendHeader(out, "razertray_collector_resyncs_total", "counter", "Snapshots requested from agents.");
+    appendSample(out, "razertray_collector_resyncs_total", static_cast<int64_t>(resyncCount));
+    appendHeader(out, "razertray_collector_rejected_datagrams_total", "counter",
+                 "Datagrams that were malformed, of another protocol version or from a host over the limit.");
+    appendSample(out, "razertray_collector_rejected_datagrams_total", static_cast<int64_t>(rejectedCount));
+    appendHeader(out, "razertray_collector_evicted_hosts_total", "counter",
+                 "Hosts dropped after a day without a datagram.");
+    appendSample(out, "razertray_collector_evicted_hosts_total", static_cast<int64_t>(evictedCount));
+
+    appendHeader(out, "razertray_host_synchronized", "gauge",
+                 "0 while the host's devices are its last known state (a snapshot was requested).");
+    for (const auto& [name, host] : hostsByName) {
+        appendHostSample(out, "razertray_host_synchronized", name, host->synchronized ? 1 : 0);
+    }
+    appendHeader(out, "razertray_host_last_seen_timestamp_seconds", "gauge",
+                 "Unix time the collector last heard from the host.");
+    for (const auto& [name, host] : hostsByName) {
+        appendHostSample(out, "razertray_host_last_seen_timestamp_seconds", name, host->lastSeen);
+    }
+
+    // One pass per metric family: a family's samples must be contiguous
+    struct Family {
+        const char* name;
+        const char* help;
+    };
+    const Family families[] = {
+        {"razertray_host_battery_level_percent", "Battery level of each device that reports one."},
+        {"razertray_host_device_connected", "1 if the device is connected."},
+        {"razertray_host_device_last_change_timestamp_seconds",
+         "Unix time (host clock) of the device's last level or connection change."},
+    };
+    for (size_t family = 0; family < std::size(families); family++) {
+        appendHeader(out, families[family].name, "gauge", families[family].help);
+        for (const auto& [name, host] : hostsByName) {
+            for (size_t index = 0; index < host->flags.size(); index++) {
+                uint8_t flags = host->flags[index];
+                int64_t value = 0;
+                if (family == 0) {
+                    value = host->levels[index];
+                } else if (family == 1) {
+                    value = (flags & CONNECTED) != 0;
+                } else {
+                    value = host->changeTimes[index];
+                }
+                if (!(flags & LIVE) || (family == 0 && value < 0) || (family == 2 && value == 0)) {
+                    continue;  // removed, no level, or never changed
+                }
+                out += families[family].name;
+                out += '{';
+                appendLabel(out, "host", name);
+                out += ',';
+                appendLabel(out, "name", host->strings.view(host->names[index]));
+                out += ',';
+                appendLabel(out, "instance_id", host->strings.view(host->instanceIds[index]));
+                out += "} ";
+                appendValue(out, value);
+            }
+        }
+    }
+}
+
+#ifdef _WIN32
+
+Collector::Collector(std::string_view listen)
+    : deviceCount(0)
+    , datagramCount(0)
+    , updateCount(0)
+    , gapCount(0)
+    , resyncCount(0)
+    , rejectedCount(0)
+    , evictedCount(0)
+    , lastEviction(0)
+    , boundPort(0)
+    , socketHandle(NO_SOCKET)
+    , receiveEvent(nullptr)
+    , stopEvent(nullptr)
+{
+    uint32_t address = 0;
+    uint16_t port = 0;
+    if (!parseListen(listen, address, port)) {
+        return;
+    }
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        return;
+    }
+
+    SOCKET server = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (server == INVALID_SOCKET) {
+        WSACleanup();
+        return;
+    }
+    BOOL exclusive = TRUE;
+    setsockopt(server, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive));
+    int bufferSize = RECEIVE_BUFFER;
+    setsockopt(server, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&bufferSize), sizeof(bufferSize));
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(address);
+    local.sin_port = htons(port);
+    int localLength = sizeof(local);
+    receiveEvent = WSACreateEvent();
+    stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (bind(server, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+        getsockname(server, reinterpret_cast<sockaddr*>(&local), &localLength) != 0 ||
+        receiveEvent == WSA_INVALID_EVENT || !stopEvent ||
+        WSAEventSelect(server, receiveEvent, FD_READ) != 0) {
+        closesocket(server);
+        if (receiveEvent != WSA_INVALID_EVENT) WSACloseEvent(receiveEvent);
+        if (stopEvent) CloseHandle(stopEvent);
+        receiveEvent = nullptr;
+        stopEvent = nullptr;
+        WSACleanup();
+        return;
+    }
+
+    socketHandle = static_cast<uintptr_t>(server);
+    boundPort = ntohs(local.sin_port);
+    thread = std::thread(&Collector::receiveLoop, this);
+}
+
+Collector::~Collector() {
+    if (!thread.joinable()) {
+        return;
+    }
+    SetEvent(stopEvent);
+    thread.join();
+    closesocket(static_cast<SOCKET>(socketHandle));
+    WSACloseEvent(receiveEvent);
+    CloseHandle(stopEvent);
+    WSACleanup();
+}
+
+void Collector::receiveLoop() {
+    SOCKET server = static_cast<SOCKET>(socketHandle);
+    char datagram[MAX_DATAGRAM];
+    std::string reply;
+    while (true) {
+        HANDLE handles[] = { stopEvent, receiveEvent };
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (wait != WAIT_OBJECT_0 + 1) {
+            return;  // stop requested (or the wait failed)
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+        WSAResetEvent(receiveEvent);
+
+        // Non-blocking since WSAEventSelect. WSAECONNRESET reports an
+        // earlier RESYNC the agent's host refused; WSAEMSGSIZE a datagram
+        // larger than any agent sends.
+        while (true) {
+            sockaddr_in source = {};
+            int sourceLength = sizeof(source);
+            int received = recvfrom(server, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&source),
+                                    &sourceLength);
+            if (received == SOCKET_ERROR) {
+                int error = WSAGetLastError();
+                if (error == WSAECONNRESET || error == WSAEMSGSIZE) continue;
+                break;
+            }
+            if (receive(std::string_view(datagram, static_cast<size_t>(received)), DeviceStateCache::now(), reply)) {
+                sendto(server, reply.data(), static_cast<int>(reply.size()), 0, reinterpret_cast<sockaddr*>(&source),
+                       sourceLength);
+            }
+        }
+    }
+}
+
+#else
+
+Collector::Collector(std::string_view listen)
+    : deviceCount(0)
+    , datagramCount(0)
+    , updateCount(0)
+    , gapCount(0)
+    , resyncCount(0)
+    , rejectedCount(0)
+    , evictedCount(0)
+    , lastEviction(0)
+    , boundPort(0)
+    , socketHandle(NO_SOCKET)
+    , stopFd(-1)
+{
+    uint32_t address = 0;
+    uint16_t port = 0;
+    if (!parseListen(listen, address, port)) {
+        return;
+    }
+
+    int server = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (server < 0) {
+        return;
+    }
+    int bufferSize = RECEIVE_BUFFER;  // capped at net.core.rmem_max
+    setsockopt(server, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(address);
+    local.sin_port = htons(port);
+    socklen_t localLength = sizeof(local);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0 ||
+        bind(server, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 ||
+        getsockname(server, reinterpret_cast<sockaddr*>(&local), &localLength) != 0) {
+        ::close(server);
+        if (stopFd >= 0) ::close(stopFd);
+        stopFd = -1;
+        return;
+    }
+
+    socketHandle = static_cast<uintptr_t>(server);
+    boundPort = ntohs(local.sin_port);
+    thread = std::thread(&Collector::receiveLoop, this);
+}
+
+Collector::~Collector() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(stopFd, &one, sizeof(one));
+    thread.join();
+    ::close(static_cast<int>(socketHandle));
+    ::close(stopFd);
+}
+
+void Collector::receiveLoop() {
+    int server = static_cast<int>(socketHandle);
+    char datagram[MAX_DATAGRAM];
+    std::string reply;
+    while (true) {
+        pollfd fds[] = { { stopFd, POLLIN, 0 }, { server, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;  // stop requested
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+
+        while (true) {
+            sockaddr_in source = {};
+            socklen_t sourceLength = sizeof(source);
+            ssize_t received = recvfrom(server, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&source),
+                                        &sourceLength);
+            if (received < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (receive(std::string_view(datagram, static_cast<size_t>(received)), DeviceStateCache::now(), reply)) {
+                [[maybe_unused]] ssize_t sent = sendto(server, reply.data(), reply.size(), 0,
+                                                       reinterpret_cast<sockaddr*>(&source), sourceLength);
+            }
+        }
+    }
+}
+
+#endif
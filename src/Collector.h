@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CollectorProtocol.h"
+#include "StringPool.h"
+
+// Receiving end of the collector protocol (`razertray_headless --collect`,
+// see CollectorProtocol.h): a background thread reads agents' datagrams
+// from a UDP port and keeps every host's devices in memory, for the
+// metrics endpoint to export with a host label.
+//
+// Each host is known by name and tracks the session and sequence number of
+// the last datagram applied. A gap, a session it has not seen (the agent or
+// the collector restarted) or a malformed datagram marks the host
+// unsynchronized and is answered with RESYNC; the host's batches are then
+// ignored until its snapshot arrives, while its last known devices stay
+// visible. Devices are stored per host as parallel arrays indexed by the
+// agent's device index, so applying a state change is a bounds check and a
+// few stores; the arrays grow no further than the index limit the host's
+// snapshot declared. Names and instance IDs are interned in a pool per
+// host that every snapshot starts afresh and that may hold at most
+// MAX_HOST_STRING_BYTES (a DEVICE record past it is rejected). At most
+// MAX_HOSTS hosts are kept (a snapshot from one more is rejected), and a
+// host not heard from for HOST_TIMEOUT_SECONDS is dropped with its devices.
+class Collector {
+public:
+    static constexpr size_t MAX_HOSTS = 1024;
+    static constexpr size_t MAX_HOST_STRING_BYTES = 256 * 1024;
+    static constexpr int64_t HOST_TIMEOUT_SECONDS = 24 * 60 * 60;
+
+    struct Stats {
+        uint64_t datagrams;     // received
+        uint64_t updates;       // device states applied
+        uint64_t gaps;          // sequence gaps detected
+        uint64_t resyncs;       // RESYNC requests sent
+        uint64_t rejected;      // malformed, of another protocol version or from a host over MAX_HOSTS
+        uint64_t evicted;       // hosts dropped after HOST_TIMEOUT_SECONDS
+        size_t hosts;
+        size_t devices;
+    };
+
+    struct Device {
+        std::string_view host;
+        std::string_view name;
+        std::string_view instanceId;
+        std::optional<int> batteryLevel;
+        bool connected;
+        int64_t changedAt;      // agent clock; 0 = never
+    };
+
+    // listen: "[a.b.c.d:]port" (default address 0.0.0.0, every interface;
+    // port 0 picks a free one). Empty: no socket, datagrams only come in
+    // through receive().
+    explicit Collector(std::string_view listen);
+    ~Collector();
+
+    Collector(const Collector&) = delete;
+    Collector& operator=(const Collector&) = delete;
+
+    // False if listen did not parse or the port could not be bound
+    bool isListening() const { return thread.joinable(); }
+    uint16_t port() const { return boundPort; }
+
+    // Apply one agent datagram received at `now` (unix seconds); true if
+    // the sender must be answered with reply (a RESYNC). Thread-safe.
+    bool receive(std::string_view datagram, int64_t now, std::string& reply);
+
+    Stats stats() const;
+    // Bytes held by the hosts and their devices
+    size_t memoryUsage() const;
+    // Sequence number of the host's last applied datagram; nullopt if the
+    // host is unknown or waiting for a snapshot
+    std::optional<uint64_t> sequence(std::string_view host) const;
+    // Every device of every host, under the collector's lock
+    void forEachDevice(const std::function<void(const Device&)>& visit) const;
+
+    // Prometheus section for MetricsServer: collector counters, per-host
+    // state and every host's devices
+    void render(std::string& out) const;
+
+private:
+    struct Host {
+        std::string name;
+        uint64_t session = 0;
+        uint64_t nextSequence = 0;
+        bool synchronized = false;
+        int64_t lastSeen = 0;       // collector clock
+        uint64_t indexLimit = 0;    // from the last snapshot
+        size_t liveCount = 0;
+        StringPool strings;
+        // Per device index
+        std::vector<StringId> names;
+        std::vector<StringId> instanceIds;
+        std::vector<int8_t> levels;         // -1: none
+        std::vector<uint8_t> flags;
+        std::vector<int64_t> changeTimes;
+    };
+    static constexpr uint8_t LIVE = 1;
+    static constexpr uint8_t CONNECTED = 2;
+
+    // Records of one datagram; false if malformed
+    bool apply(Host& host, CollectorProtocol::Reader& records, int64_t sentAt);
+    void clear(Host& host);
+    void evictStale(int64_t now);
+    bool requestResync(uint64_t session, std::string& reply);
+
+    void receiveLoop();
+
+    mutable std::mutex mutex;   // guards everything below up to the socket
+    std::vector<std::unique_ptr<Host>> hosts;
+    std::map<std::string, Host*, std::less<>> hostsByName;
+    std::unordered_map<uint64_t, Host*> hostsBySession;
+    size_t deviceCount;
+    uint64_t datagramCount;
+    uint64_t updateCount;
+    uint64_t gapCount;
+    uint64_t resyncCount;
+    uint64_t rejectedCount;
+    uint64_t evictedCount;
+    int64_t lastEviction;       // collector clock of the last evictStale()
+
+    std::thread thread;
+    uint16_t boundPort;
+    uintptr_t socketHandle;     // SOCKET / fd
+#ifdef _WIN32
+    void* receiveEvent;         // HANDLE, signaled by WSAEventSelect on the socket
+    void* stopEvent;            // HANDLE, signaled by the destructor
+#else
+    int stopFd;                 // eventfd, written by the destructor
+#endif
+};
@@ -0,0 +1,366 @@
+#include "CollectorAgent.h"
+#include "CollectorProtocol.h"
+#include "MemoryAccounting.h"
+#include "ProcessTelemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include "Utf8.h"
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace CollectorProtocol;
+
+namespace {
+    constexpr uintptr_t NO_SOCKET = ~uintptr_t(0);
+
+    // Longest record: DEVICE with both strings at MAX_STRING
+    constexpr size_t MAX_RECORD = 1 + MAX_VARINT + 2 * (MAX_VARINT + MAX_STRING);
+
+    // Unique per agent start: the wall clock in nanoseconds and a stack
+    // address (ASLR moves it every run), mixed. std::random_device would
+    // add ~70 KB to the headless service's resident set.
+    uint64_t newSession() {
+        int marker = 0;
+        uint64_t value = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count()) ^
+                         static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&marker));
+        // splitmix64 finalizer
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        value ^= value >> 31;
+        return value != 0 ? value : 1;
+    }
+
+    size_t putString(char* out, std::string_view value) {
+        size_t length = encodeVarint(value.size(), out);
+        std::copy(value.begin(), value.end(), out + length);
+        return length + value.size();
+    }
+}
+
+void CollectorAgent::beginDatagram(bool snapshot, int64_t now) {
+    char header[sizeof(MAGIC) + 4 * MAX_VARINT + 1];
+    size_t length = sizeof(MAGIC);
+    std::copy(std::begin(MAGIC), std::end(MAGIC), header);
+    length += encodeVarint(VERSION, header + length);
+    header[length++] = static_cast<char>(snapshot ? SNAPSHOT : BATCH);
+    length += encodeVarint(sessionId, header + length);
+    length += encodeVarint(++lastSequence, header + length);
+    length += encodeVarint(zigzag(now), header + length);
+    datagram.assign(header, length);
+    if (snapshot) {
+        char host[2 * MAX_VARINT + MAX_HOST_NAME];
+        size_t hostLength = putString(host, clip(name, MAX_HOST_NAME));
+        hostLength += encodeVarint(indexLimit, host + hostLength);
+        datagram.append(host, hostLength);
+    }
+}
+
+void CollectorAgent::appendRecord(const char* record, size_t length, int64_t now, const Emit& emit) {
+    if (datagram.size() + length > MAX_DATAGRAM) {
+        emit(datagram);
+        beginDatagram(false, now);
+    }
+    datagram.append(record, length);
+}
+
+void CollectorAgent::encode(const DeviceTable& devices, const StringPool& strings, int64_t now, const Emit& emit) {
+    // A device index at or past the limit the last snapshot declared would
+    // be refused by the collector
+    bool snapshot = snapshotPending || resyncRequested.exchange(false, std::memory_order_acquire) ||
+                    std::min<uint64_t>(strings.size(), MAX_DEVICE_INDEX) > indexLimit;
+    snapshotPending = false;
+    pushCount++;
+    if (snapshot) {
+        indexLimit = indexLimitFor(strings.size());
+        for (Sent& device : sent) {
+            device.flags = 0;  // the collector forgets everything it had
+        }
+    }
+    if (sent.size() < strings.size()) {
+        sent.resize(strings.size(), Sent{DeviceTable::NO_LEVEL, 0, 0, 0});
+    }
+
+    beginDatagram(snapshot, now);
+    char record[MAX_RECORD];
+    for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+        StringId index = devices.instanceId(row);
+        Sent& device = sent[index];
+        device.push = pushCount;
+
+        int level = devices.batteryLevel(row).value_or(DeviceTable::NO_LEVEL);
+        uint8_t flags = LIVE | (devices.isConnected(row) ? CONNECTED : 0);
+        int64_t changedAt = devices.changedAt(row);
+        if (device.flags & LIVE) {
+            if (device.level == level && device.flags == flags && device.changedAt == changedAt) {
+                continue;
+            }
+        } else {
+            size_t length = 0;
+            record[length++] = static_cast<char>(DEVICE);
+            length += encodeVarint(index, record + length);
+            length += putString(record + length, clip(strings.view(devices.name(row)), MAX_STRING));
+            length += putString(record + length, clip(strings.view(index), MAX_STRING));
+            appendRecord(record, length, now, emit);
+        }
+
+        size_t length = 0;
+        record[length++] = static_cast<char>(STATE);
+        length += encodeVarint(index, record + length);
+        length += encodeVarint(packState(level, (flags & CONNECTED) != 0), record + length);
+        length += encodeVarint(changedAt == 0 ? 0 : static_cast<uint64_t>(std::max<int64_t>(now - changedAt, 0)) + 1,
+                               record + length);
+        appendRecord(record, length, now, emit);
+        device = Sent{static_cast<int8_t>(level), flags, changedAt, pushCount};
+    }
+
+    // Devices a rescan dropped
+    for (StringId index = 0; index < sent.size(); index++) {
+        Sent& device = sent[index];
+        if ((device.flags & LIVE) && device.push != pushCount) {
+            size_t length = 0;
+            record[length++] = static_cast<char>(REMOVE);
+            length += encodeVarint(index, record + length);
+            appendRecord(record, length, now, emit);
+            device.flags = 0;
+        }
+    }
+
+    // Always at least one datagram: an empty batch is the heartbeat that
+    // lets the collector notice a lost one
+    emit(datagram);
+}
+
+bool CollectorAgent::handleReply(std::string_view reply) {
+    Reader in(reply);
+    uint64_t version = 0;
+    uint8_t kind = 0;
+    uint64_t session = 0;
+    if (!in.readMagic(magic()) || !in.readVarint(version) || version != VERSION ||
+        !in.readByte(kind) || kind != RESYNC || !in.readVarint(session) || session != sessionId) {
+        return false;
+    }
+    resyncRequested.store(true, std::memory_order_release);
+    return true;
+}
+
+size_t CollectorAgent::memoryUsage() const {
+    return MemoryAccounting::bytesOf(name) + MemoryAccounting::bytesOf(sent) + MemoryAccounting::bytesOf(datagram);
+}
+
+#ifdef _WIN32
+
+std::string CollectorAgent::machineName() {
+    wchar_t buffer[256];
+    DWORD length = static_cast<DWORD>(std::size(buffer));
+    if (!GetComputerNameExW(ComputerNameDnsHostname, buffer, &length)) {
+        return "unknown";
+    }
+    return std::string(clip(Utf8::fromWide(std::wstring_view(buffer, length)), MAX_HOST_NAME));
+}
+
+CollectorAgent::CollectorAgent(std::string hostName, std::string_view collector, std::function<void()> onResync)
+    : name(std::move(hostName))
+    , sessionId(newSession())
+    , lastSequence(0)
+    , pushCount(0)
+    , indexLimit(0)
+    , snapshotPending(true)
+    , resyncRequested(false)
+    , onResync(std::move(onResync))
+    , socketHandle(NO_SOCKET)
+    , receiveEvent(nullptr)
+    , stopEvent(nullptr)
+{
+    datagram.reserve(MAX_DATAGRAM);
+
+    uint32_t address = 0;
+    uint16_t port = 0;
+    if (!parseEndpoint(collector, address, port) || port == 0) {
+        return;
+    }
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        return;
+    }
+
+    // Connected: send() needs no address and only the collector's replies
+    // are received
+    SOCKET client = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_addr.s_addr = htonl(address);
+    target.sin_port = htons(port);
+    receiveEvent = WSACreateEvent();
+    stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (client == INVALID_SOCKET ||
+        connect(client, reinterpret_cast<sockaddr*>(&target), sizeof(target)) != 0 ||
+        receiveEvent == WSA_INVALID_EVENT || !stopEvent ||
+        WSAEventSelect(client, receiveEvent, FD_READ) != 0) {
+        if (client != INVALID_SOCKET) closesocket(client);
+        if (receiveEvent != WSA_INVALID_EVENT) WSACloseEvent(receiveEvent);
+        if (stopEvent) CloseHandle(stopEvent);
+        receiveEvent = nullptr;
+        stopEvent = nullptr;
+        WSACleanup();
+        return;
+    }
+
+    socketHandle = static_cast<uintptr_t>(client);
+    thread = std::thread(&CollectorAgent::receiveLoop, this);
+}
+
+CollectorAgent::~CollectorAgent() {
+    if (!thread.joinable()) {
+        return;
+    }
+    SetEvent(stopEvent);
+    thread.join();
+    closesocket(static_cast<SOCKET>(socketHandle));
+    WSACloseEvent(receiveEvent);
+    CloseHandle(stopEvent);
+    WSACleanup();
+}
+
+void CollectorAgent::push(const DeviceTable& devices, const StringPool& strings, int64_t now) {
+    encode(devices, strings, now, [this](std::string_view packet) {
+        if (socketHandle != NO_SOCKET) {
+            // Lost datagrams are what sequence numbers are for
+            send(static_cast<SOCKET>(socketHandle), packet.data(), static_cast<int>(packet.size()), 0);
+        }
+    });
+}
+
+void CollectorAgent::receiveLoop() {
+    SOCKET client = static_cast<SOCKET>(socketHandle);
+    while (true) {
+        HANDLE handles[] = { stopEvent, receiveEvent };
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (wait != WAIT_OBJECT_0 + 1) {
+            return;  // stop requested (or the wait failed)
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+        WSAResetEvent(receiveEvent);
+
+        // The socket is non-blocking since WSAEventSelect. WSAECONNRESET
+        // reports an earlier send the collector's host refused.
+        char reply[64];
+        while (true) {
+            int received = recv(client, reply, sizeof(reply), 0);
+            if (received == SOCKET_ERROR && WSAGetLastError() == WSAECONNRESET) continue;
+            if (received <= 0) break;
+            if (handleReply(std::string_view(reply, static_cast<size_t>(received))) && onResync) {
+                onResync();
+            }
+        }
+    }
+}
+
+#else
+
+std::string CollectorAgent::machineName() {
+    char buffer[MAX_HOST_NAME + 1] = {};
+    if (gethostname(buffer, sizeof(buffer) - 1) != 0 || buffer[0] == '\0') {
+        return "unknown";
+    }
+    return buffer;
+}
+
+CollectorAgent::CollectorAgent(std::string hostName, std::string_view collector, std::function<void()> onResync)
+    : name(std::move(hostName))
+    , sessionId(newSession())
+    , lastSequence(0)
+    , pushCount(0)
+    , indexLimit(0)
+    , snapshotPending(true)
+    , resyncRequested(false)
+    , onResync(std::move(onResync))
+    , socketHandle(NO_SOCKET)
+    , stopFd(-1)
+{
+    datagram.reserve(MAX_DATAGRAM);
+
+    uint32_t address = 0;
+    uint16_t port = 0;
+    if (!parseEndpoint(collector, address, port) || port == 0) {
+        return;
+    }
+
+    // Connected: send() needs no address and only the collector's replies
+    // are received
+    int client = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_addr.s_addr = htonl(address);
+    target.sin_port = htons(port);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (client < 0 || stopFd < 0 || connect(client, reinterpret_cast<sockaddr*>(&target), sizeof(target)) != 0) {
+        if (client >= 0) ::close(client);
+        if (stopFd >= 0) ::close(stopFd);
+        stopFd = -1;
+        return;
+    }
+
+    socketHandle = static_cast<uintptr_t>(client);
+    thread = std::thread(&CollectorAgent::receiveLoop, this);
+}
+
+CollectorAgent::~CollectorAgent() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(stopFd, &one, sizeof(one));
+    thread.join();
+    ::close(static_cast<int>(socketHandle));
+    ::close(stopFd);
+}
+
+void CollectorAgent::push(const DeviceTable& devices, const StringPool& strings, int64_t now) {
+    encode(devices, strings, now, [this](std::string_view packet) {
+        if (socketHandle != NO_SOCKET) {
+            // Lost datagrams are what sequence numbers are for
+            [[maybe_unused]] ssize_t result = ::send(static_cast<int>(socketHandle), packet.data(), packet.size(), 0);
+        }
+    });
+}
+
+void CollectorAgent::receiveLoop() {
+    int client = static_cast<int>(socketHandle);
+    while (true) {
+        pollfd fds[] = { { stopFd, POLLIN, 0 }, { client, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;  // stop requested
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+
+        // ECONNREFUSED reports an earlier send nobody was listening for
+        char reply[64];
+        while (true) {
+            ssize_t received = recv(client, reply, sizeof(reply), 0);
+            if (received < 0 && errno == ECONNREFUSED) continue;
+            if (received <= 0) break;
+            if (handleReply(std::string_view(reply, static_cast<size_t>(received))) && onResync) {
+                onResync();
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "DeviceTable.h"
+#include "StringPool.h"
+
+// Agent side of the collector protocol (config `collector`, see
+// CollectorProtocol.h). After each refresh the owner calls push(), which
+// sends what changed since the previous push - new devices, level and
+// connection changes, removed devices - batched into as few datagrams as
+// fit, or one empty batch as a heartbeat. The first push, the first after
+// the collector answered RESYNC and the first whose device indexes outgrow
+// the last snapshot's index limit are full snapshots.
+//
+// The agent remembers what it last sent per device, indexed by the instance
+// ID's string handle, so encoding is one pass over the table into a reused
+// buffer; only pushes that see a device for the first time allocate. A
+// background thread waits for the collector's RESYNC and calls onResync, so
+// the owner can push the snapshot without waiting for the next refresh.
+class CollectorAgent {
+public:
+    using Emit = std::function<void(std::string_view datagram)>;
+
+    // collector: "a.b.c.d:port". Without a usable address nothing is sent
+    // (see isConnected()) but encode() still works.
+    CollectorAgent(std::string hostName, std::string_view collector, std::function<void()> onResync = nullptr);
+    ~CollectorAgent();
+
+    CollectorAgent(const CollectorAgent&) = delete;
+    CollectorAgent& operator=(const CollectorAgent&) = delete;
+
+    // False if the address did not parse or no socket could be opened
+    bool isConnected() const { return thread.joinable(); }
+
+    // Hand emit the datagrams for the changes since the last encode()
+    void encode(const DeviceTable& devices, const StringPool& strings, int64_t now, const Emit& emit);
+    // encode() and send the datagrams to the collector
+    void push(const DeviceTable& devices, const StringPool& strings, int64_t now);
+
+    // A datagram from the collector; true if it asked this agent for a
+    // snapshot (the next encode() sends one)
+    bool handleReply(std::string_view datagram);
+    // Set from a RESYNC until the next encode()
+    bool snapshotRequested() const { return resyncRequested.load(std::memory_order_acquire); }
+
+    const std::string& hostName() const { return name; }
+    uint64_t session() const { return sessionId; }
+    // Sequence number of the last datagram encoded (0: none yet)
+    uint64_t sequence() const { return lastSequence; }
+
+    // Bytes held by the per-device records and the datagram buffer
+    size_t memoryUsage() const;
+
+    // This machine's host name, as sent when the config does not name one
+    static std::string machineName();
+
+private:
+    // What the collector was last told about one device
+    struct Sent {
+        int8_t level;
+        uint8_t flags;
+        int64_t changedAt;
+        uint32_t push;          // last encode() that saw the device in the table
+    };
+    static constexpr uint8_t LIVE = 1;
+    static constexpr uint8_t CONNECTED = 2;
+
+    void beginDatagram(bool snapshot, int64_t now);
+    void appendRecord(const char* record, size_t length, int64_t now, const Emit& emit);
+
+    void receiveLoop();
+
+    std::string name;
+    uint64_t sessionId;
+    uint64_t lastSequence;
+    uint32_t pushCount;
+    uint64_t indexLimit;        // declared by the last snapshot
+    bool snapshotPending;
+    std::atomic<bool> resyncRequested;
+    std::vector<Sent> sent;     // by instance ID handle
+    std::string datagram;       // the one being filled, reused
+
+    std::function<void()> onResync;
+    std::thread thread;
+    uintptr_t socketHandle;     // SOCKET / fd, connected to the collector
+#ifdef _WIN32
+    void* receiveEvent;         // HANDLE, signaled by WSAEventSelect on the socket
+    void* stopEvent;            // HANDLE, signaled by the destructor
+#else
+    int stopFd;                 // eventfd, written by the destructor
+#endif
+};
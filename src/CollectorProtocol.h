@@ -0,0 +1,110 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "DeviceRecording.h"
+
+// Push protocol between CollectorAgent (one per machine) and Collector, over
+// UDP. Same encoding as device recordings: a 4-byte magic followed by LEB128
+// varints, strings as a length and UTF-8 bytes.
+//
+// Agent -> collector, one BATCH or SNAPSHOT datagram at a time:
+//   header  : "RZCP" version kind session seq sentAt(unix seconds, signed)
+//   SNAPSHOT: header hostName indexLimit   replaces all the collector knows
+//             records...                   about hostName; device indexes
+//                                          stay below indexLimit until the
+//                                          next snapshot
+//   BATCH   : header records...            changes since the previous one
+//   DEVICE  : tag index name instanceId    defines device index
+//   STATE   : tag index state age          state = (level + 1) << 1 | connected
+//                                          (level -1: none); age = sentAt -
+//                                          changedAt + 1 (0: never changed)
+//   REMOVE  : tag index                    the device is no longer tracked
+//
+// Collector -> agent:
+//   RESYNC  : "RZCP" version kind session  send a SNAPSHOT next
+//
+// session is a random number the agent picks at startup and seq numbers its
+// datagrams from 1; every push is at least one datagram (an empty BATCH when
+// nothing changed), so a lost datagram shows up as a gap at the next
+// interval. A collector that sees a gap, or a session it does not know,
+// answers RESYNC and ignores that host's batches until the snapshot. Device
+// indexes are the agent's string handles of the instance IDs: stable for
+// the agent's lifetime and small. The collector sizes a host's storage by
+// the indexLimit its snapshot declares; an agent whose indexes outgrow it
+// sends a new snapshot.
+namespace CollectorProtocol {
+    constexpr char MAGIC[4] = {'R', 'Z', 'C', 'P'};
+    constexpr uint64_t VERSION = 2;
+
+    enum Kind : uint8_t {
+        BATCH = 1,
+        SNAPSHOT = 2,
+        RESYNC = 3,
+    };
+
+    enum Tag : uint8_t {
+        DEVICE = 1,
+        STATE = 2,
+        REMOVE = 3,
+    };
+
+    // Below a 1500-byte Ethernet MTU after IP and UDP headers: no datagram
+    // is fragmented
+    constexpr size_t MAX_DATAGRAM = 1400;
+    // Longer names and instance IDs are cut (at a UTF-8 boundary) so any
+    // record fits an otherwise empty SNAPSHOT
+    constexpr size_t MAX_STRING = 512;
+    constexpr size_t MAX_HOST_NAME = 255;
+    // Largest indexLimit the collector accepts per host (bounds what a
+    // snapshot can make it allocate)
+    constexpr uint64_t MAX_DEVICE_INDEX = 1 << 16;
+    // indexLimit an agent declares for this many string handles: room for
+    // as many again before the next snapshot
+    inline uint64_t indexLimitFor(size_t handles) {
+        uint64_t limit = handles < 32 ? 64 : static_cast<uint64_t>(handles) * 2;
+        return limit < MAX_DEVICE_INDEX ? limit : MAX_DEVICE_INDEX;
+    }
+
+    inline std::string_view magic() { return std::string_view(MAGIC, sizeof(MAGIC)); }
+
+    inline uint64_t packState(int level, bool connected) {
+        return static_cast<uint64_t>(level + 1) << 1 | (connected ? 1 : 0);
+    }
+
+    // The first limit bytes of value, less a UTF-8 sequence the cut split
+    inline std::string_view clip(std::string_view value, size_t limit) {
+        if (value.size() <= limit) return value;
+        size_t end = limit;
+        while (end > 0 && (static_cast<uint8_t>(value[end]) & 0xC0) == 0x80) end--;
+        return value.substr(0, end);
+    }
+
+    // "a.b.c.d:port" into an IPv4 address (host byte order) and port; no
+    // name lookups, so nothing beyond the socket API is needed at runtime
+    inline bool parseEndpoint(std::string_view text, uint32_t& address, uint16_t& port) {
+        const char* c = text.data();
+        const char* end = text.data() + text.size();
+        address = 0;
+        for (int octet = 0; octet < 4; octet++) {
+            unsigned value = 0;
+            auto [next, error] = std::from_chars(c, end, value);
+            if (error != std::errc() || value > 255 || next == end || *next != (octet < 3 ? '.' : ':')) return false;
+            address = address << 8 | value;
+            c = next + 1;
+        }
+        unsigned value = 0;
+        auto [next, error] = std::from_chars(c, end, value);
+        if (error != std::errc() || next != end || value > 65535) return false;
+        port = static_cast<uint16_t>(value);
+        return true;
+    }
+
+    using DeviceRecording::encodeVarint;
+    using DeviceRecording::zigzag;
+    using DeviceRecording::unzigzag;
+    using DeviceRecording::MAX_VARINT;
+    using Reader = DeviceRecording::Reader;
+}
@@ -0,0 +1,140 @@
+#include "ConfigCache.h"
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <string>
+
+namespace {
+    constexpr char MAGIC[4] = {'R', 'Z', 'T', 'C'};
+
+    struct Header {
+        char magic[4];
+        uint32_t formatVersion;
+        ConfigCache::Stamp source;
+        uint64_t payloadSize;
+        uint64_t payloadHash;
+    };
+
+    void writeConfig(BinaryIO::Writer& out, const Config& config) {
+        out.writeString(config.version);
+        out.write(static_cast<uint64_t>(config.devices.size()));
+        for (const auto& device : config.devices) {
+            out.writeString(device.name);
+            out.writeString(device.instanceIdPattern);
+            out.write(device.enabled);
+            out.writeString(device.description);
+        }
+        out.write(static_cast<uint64_t>(config.namePatterns.size()));
+        for (const auto& pattern : config.namePatterns) {
+            out.writeString(pattern);
+        }
+        out.write(config.caseInsensitivePatterns);
+        out.write(config.refreshInterval);
+        out.write(config.metricsPort);
+        out.writeString(config.collector);
+        out.write(static_cast<uint64_t>(config.alerts.size()));
+        for (const auto& alert : config.alerts) {
+            out.writeString(alert.name);
+            out.writeString(alert.when);
+            out.write(alert.hysteresis);
+            out.write(alert.cooldown);
+        }
+        out.write(config.batteryThresholds);
+    }
+
+    bool readConfig(BinaryIO::Reader& in, Config& config) {
+        uint64_t count = 0;
+        if (!in.readString(config.version) || !in.read(count)) return false;
+        for (uint64_t i = 0; i < count; i++) {
+            DevicePattern device;
+            if (!in.readString(device.name) || !in.readString(device.instanceIdPattern) ||
+                !in.read(device.enabled) || !in.readString(device.description)) {
+                return false;
+            }
+            config.devices.push_back(std::move(device));
+        }
+        if (!in.read(count)) return false;
+        for (uint64_t i = 0; i < count; i++) {
+            if (!in.readString(config.namePatterns.emplace_back())) return false;
+        }
+        if (!in.read(config.caseInsensitivePatterns) ||
+            !in.read(config.refreshInterval) ||
+            !in.read(config.metricsPort) ||
+            !in.readString(config.collector) ||
+            !in.read(count)) {
+            return false;
+        }
+        for (uint64_t i = 0; i < count; i++) {
+            AlertRule& alert = config.alerts.emplace_back();
+            if (!in.readString(alert.name) || !in.readString(alert.when) ||
+                !in.read(alert.hysteresis) || !in.read(alert.cooldown)) {
+                return false;
+            }
+        }
+        return in.read(config.batteryThresholds);
+    }
+}
+
+ConfigCache::Stamp ConfigCache::makeStamp(std::filesystem::file_time_type modified, std::string_view contents) {
+    return Stamp{
+        static_cast<int64_t>(modified.time_since_epoch().count()),
+        static_cast<uint64_t>(contents.size()),
+        BinaryIO::hash(contents),
+    };
+}
+
+std::filesystem::path ConfigCache::pathFor(const std::filesystem::path& configPath) {
+    std::filesystem::path path = configPath;
+    return path.replace_extension(".cache");
+}
+
+std::optional<ConfigCache::Contents> ConfigCache::load(const std::filesystem::path& cachePath, const Stamp& source) {
+    MappedFile file(cachePath);
+    std::string_view data = file.contents();
+    if (!file.isValid() || data.size() < sizeof(Header)) {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    std::string_view payload = data.substr(sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.formatVersion != FORMAT_VERSION ||
+        !(header.source == source) ||
+        header.payloadSize != payload.size() ||
+        header.payloadHash != BinaryIO::hash(payload)) {
+        return std::nullopt;
+    }
+
+    // Decode straight out of the mapping: strings are copied into the
+    // Config, table arrays are one memcpy each
+    BinaryIO::Reader in(payload);
+    Contents contents;
+    if (!readConfig(in, contents.config)) {
+        return std::nullopt;
+    }
+    auto matcher = PatternMatcher::deserialize(in);
+    if (!matcher || !in.atEnd()) {
+        return std::nullopt;
+    }
+    contents.matcher = std::make_shared<const PatternMatcher>(std::move(*matcher));
+    return contents;
+}
+
+bool ConfigCache::save(const std::filesystem::path& cachePath, const Stamp& source,
+                       const Config& config, const PatternMatcher& matcher) {
+    BinaryIO::Writer payload;
+    writeConfig(payload, config);
+    matcher.serialize(payload);
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.source = source;
+    header.payloadSize = payload.data().size();
+    header.payloadHash = BinaryIO::hash(payload.data());
+
+    std::string file(reinterpret_cast<const char*>(&header), sizeof(header));
+    file += payload.data();
+    return BinaryIO::replaceFile(cachePath, file);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include "ConfigManager.h"
+#include "PatternMatcher.h"
+
+// Binary snapshot of a parsed config and its compiled pattern tables,
+// stored next to config.json (config.cache) so a launch with an unchanged
+// config skips both parsing and compilation.
+//
+// The file starts with a header identifying the format version and the
+// config.json it was built from (modification time, size and content hash),
+// followed by a checksummed payload. A snapshot is only used when all of
+// them match; anything else (missing, stale, truncated, corrupt, written by
+// another version) is a miss and the JSON is parsed as usual.
+namespace ConfigCache {
+    // Bump whenever the payload layout (Config, GlobSet or PatternMatcher
+    // tables) changes
+    constexpr uint32_t FORMAT_VERSION = 4;
+
+    // Identity of one version of config.json
+    struct Stamp {
+        int64_t modified;   // last write time, file clock ticks
+        uint64_t size;
+        uint64_t hash;      // BinaryIO::hash of the contents
+
+        bool operator==(const Stamp&) const = default;
+    };
+
+    struct Contents {
+        Config config;
+        std::shared_ptr<const PatternMatcher> matcher;
+    };
+
+    Stamp makeStamp(std::filesystem::file_time_type modified, std::string_view contents);
+
+    // config.json -> config.cache in the same directory
+    std::filesystem::path pathFor(const std::filesystem::path& configPath);
+
+    // Memory-map the snapshot and decode it if it was built from `source`
+    std::optional<Contents> load(const std::filesystem::path& cachePath, const Stamp& source);
+
+    // Write a snapshot (atomically, see BinaryIO::replaceFile). Failure is
+    // harmless.
+    bool save(const std::filesystem::path& cachePath, const Stamp& source,
+              const Config& config, const PatternMatcher& matcher);
+}
@@ -1,7 +1,14 @@
 #include "ConfigManager.h"
-#include <fstream>
-#include <sstream>
-#include <algorithm>
+#include "AlertRules.h"
+#include "BinaryIO.h"
+#include "JsonReader.h"
+#include "MappedFile.h"
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 ConfigManager::ConfigManager() {
 }
@@ -9,80 +16,37 @@ ConfigManager::ConfigManager() {
 ConfigManager::~ConfigManager() {
 }
 
-std::wstring ConfigManager::getDefaultConfigPath() {
+std::filesystem::path ConfigManager::getDefaultConfigPath() {
+#ifdef _WIN32
     WCHAR exePath[MAX_PATH];
     GetModuleFileNameW(nullptr, exePath, MAX_PATH);
+    std::filesystem::path path(exePath);
+#else
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", error);
+#endif
 
-    std::wstring path(exePath);
-    size_t lastSlash = path.find_last_of(L"\\/");
-    if (lastSlash != std::wstring::npos) {
-        path = path.substr(0, lastSlash + 1);
-    }
-
-    return path + L"config.json";
-}
-
-std::optional<std::string> ConfigManager::readFile(const std::wstring& path) {
-    // Convert wstring to string for ifstream
-    std::ifstream file(path.c_str());
-    if (!file.is_open()) {
-        return std::nullopt;
-    }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
-}
-
-std::string ConfigManager::trim(const std::string& str) {
-    size_t first = str.find_first_not_of(" \t\n\r\"");
-    if (first == std::string::npos) return "";
-
-    size_t last = str.find_last_not_of(" \t\n\r\"");
-    return str.substr(first, (last - first + 1));
-}
-
-std::wstring ConfigManager::utf8ToWide(const std::string& utf8) {
-    if (utf8.empty()) return L"";
-
-    int size = MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, nullptr, 0);
-    if (size == 0) return L"";
-
-    std::wstring result(size - 1, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, utf8.c_str(), -1, &result[0], size);
-
-    return result;
-}
-
-std::string ConfigManager::wideToUtf8(const std::wstring& wide) {
-    if (wide.empty()) return "";
-
-    int size = WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, nullptr, 0, nullptr, nullptr);
-    if (size == 0) return "";
-
-    std::string result(size - 1, '\0');
-    WideCharToMultiByte(CP_UTF8, 0, wide.c_str(), -1, &result[0], size, nullptr, nullptr);
-
-    return result;
+    return path.parent_path() / "config.json";
 }
 
-bool ConfigManager::writeFile(const std::wstring& path, const std::string& content) {
-    std::ofstream file(path.c_str());
-    if (!file.is_open()) {
+bool ConfigManager::writeFile(const std::filesystem::path& path, const std::string& content) {
+    std::FILE* file = BinaryIO::openForWriting(path);
+    if (!file) {
         return false;
     }
 
-    file << content;
-    file.close();
-    return true;
+    bool written = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    return std::fclose(file) == 0 && written;
 }
 
 Config ConfigManager::getDefaultConfig() {
     Config config;
-    config.version = L"1.0.0";
+    config.version = "1.0.0";
     config.devices = {};  // Empty - use patterns only
-    config.namePatterns = {L"BSK*", L"Razer*"};
+    config.namePatterns = {"BSK*", "Razer*"};
+    config.caseInsensitivePatterns = false;
     config.refreshInterval = 300;  // 5 minutes
+    config.metricsPort = 0;
     config.batteryThresholds.high = 60;
     config.batteryThresholds.medium = 30;
     config.batteryThresholds.low = 15;
@@ -90,266 +54,246 @@ Config ConfigManager::getDefaultConfig() {
 }
 
 std::string ConfigManager::serializeJson(const Config& config) {
-    std::ostringstream json;
+    std::string json;
 
-    json << "{\n";
-    json << "  \"version\": \"" << wideToUtf8(config.version) << "\",\n";
+    json += "{\n";
+    json += "  \"version\": ";
+    appendJsonString(json, config.version);
+    json += ",\n";
 
     // Devices array
-    json << "  \"devices\": [";
+    json += "  \"devices\": [";
     for (size_t i = 0; i < config.devices.size(); i++) {
         const auto& device = config.devices[i];
-        if (i > 0) json << ",";
-        json << "\n    {\n";
-        json << "      \"name\": \"" << wideToUtf8(device.name) << "\",\n";
-        json << "      \"instanceIdPattern\": \"" << wideToUtf8(device.instanceIdPattern) << "\",\n";
-        json << "      \"enabled\": " << (device.enabled ? "true" : "false") << ",\n";
-        json << "      \"description\": \"" << wideToUtf8(device.description) << "\"\n";
-        json << "    }";
+        if (i > 0) json += ",";
+        json += "\n    {\n";
+        json += "      \"name\": ";
+        appendJsonString(json, device.name);
+        json += ",\n";
+        json += "      \"instanceIdPattern\": ";
+        appendJsonString(json, device.instanceIdPattern);
+        json += ",\n";
+        json += "      \"enabled\": ";
+        json += (device.enabled ? "true" : "false");
+        json += ",\n";
+        json += "      \"description\": ";
+        appendJsonString(json, device.description);
+        json += "\n";
+        json += "    }";
     }
     if (config.devices.size() > 0) {
-        json << "\n  ";
+        json += "\n  ";
     }
-    json << "],\n";
+    json += "],\n";
 
     // Name patterns array
-    json << "  \"namePatterns\": [";
+    json += "  \"namePatterns\": [";
     for (size_t i = 0; i < config.namePatterns.size(); i++) {
-        if (i > 0) json << ",";
-        json << "\n    \"" << wideToUtf8(config.namePatterns[i]) << "\"";
+        if (i > 0) json += ",";
+        json += "\n    ";
+        appendJsonString(json, config.namePatterns[i]);
     }
     if (config.namePatterns.size() > 0) {
-        json << "\n  ";
+        json += "\n  ";
     }
-    json << "],\n";
+    json += "],\n";
+    json += "  \"caseInsensitivePatterns\": ";
+    json += (config.caseInsensitivePatterns ? "true" : "false");
+    json += ",\n";
 
     // Refresh interval
-    json << "  \"refreshInterval\": " << config.refreshInterval << ",\n";
+    json += "  \"refreshInterval\": ";
+    json += std::to_string(config.refreshInterval);
+    json += ",\n";
+    json += "  \"metricsPort\": ";
+    json += std::to_string(config.metricsPort);
+    json += ",\n";
+    json += "  \"collector\": ";
+    appendJsonString(json, config.collector);
+    json += ",\n";
+
+    // Alert rules array
+    json += "  \"alerts\": [";
+    for (size_t i = 0; i < config.alerts.size(); i++) {
+        const auto& alert = config.alerts[i];
+        if (i > 0) json += ",";
+        json += "\n    {\n";
+        json += "      \"name\": ";
+        appendJsonString(json, alert.name);
+        json += ",\n";
+        json += "      \"when\": ";
+        appendJsonString(json, alert.when);
+        json += ",\n";
+        json += "      \"hysteresis\": ";
+        json += std::to_string(alert.hysteresis);
+        json += ",\n";
+        json += "      \"cooldown\": ";
+        json += std::to_string(alert.cooldown);
+        json += "\n";
+        json += "    }";
+    }
+    if (config.alerts.size() > 0) {
+        json += "\n  ";
+    }
+    json += "],\n";
 
     // Battery thresholds
-    json << "  \"batteryThresholds\": {\n";
-    json << "    \"high\": " << config.batteryThresholds.high << ",\n";
-    json << "    \"medium\": " << config.batteryThresholds.medium << ",\n";
-    json << "    \"low\": " << config.batteryThresholds.low << "\n";
-    json << "  }\n";
-
-    json << "}\n";
-
-    return json.str();
+    json += "  \"batteryThresholds\": {\n";
+    json += "    \"high\": ";
+    json += std::to_string(config.batteryThresholds.high);
+    json += ",\n";
+    json += "    \"medium\": ";
+    json += std::to_string(config.batteryThresholds.medium);
+    json += ",\n";
+    json += "    \"low\": ";
+    json += std::to_string(config.batteryThresholds.low);
+    json += "\n";
+    json += "  }\n";
+
+    json += "}\n";
+
+    return json;
 }
 
-bool ConfigManager::saveConfig(const Config& config, const std::wstring& configPath) {
-    std::wstring path = configPath.empty() ? getDefaultConfigPath() : configPath;
+bool ConfigManager::saveConfig(const Config& config, const std::filesystem::path& configPath) {
+    std::filesystem::path path = configPath.empty() ? getDefaultConfigPath() : configPath;
 
     std::string jsonContent = serializeJson(config);
     return writeFile(path, jsonContent);
 }
 
-std::optional<Config> ConfigManager::loadConfig(const std::wstring& configPath) {
-    std::wstring path = configPath.empty() ? getDefaultConfigPath() : configPath;
+std::optional<Config> ConfigManager::loadConfig(const std::filesystem::path& configPath) {
+    std::filesystem::path path = configPath.empty() ? getDefaultConfigPath() : configPath;
+    lastError.reset();
 
-    auto content = readFile(path);
-    if (!content.has_value()) {
+    // Parse straight out of the mapped file; only stored values are copied
+    MappedFile file(path);
+    if (!file.isValid()) {
         return std::nullopt;
     }
 
-    return parseJson(content.value());
+    return parseJson(file.contents());
 }
 
-// Simple JSON parser - extracts values between quotes
-std::string extractQuotedValue(const std::string& json, const std::string& key) {
-    std::string searchFor = "\"" + key + "\"";
-    size_t pos = json.find(searchFor);
-    if (pos == std::string::npos) return "";
-
-    // Find the colon after the key
-    pos = json.find(':', pos);
-    if (pos == std::string::npos) return "";
-
-    // Skip whitespace after colon
-    pos++;
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t' || json[pos] == '\n' || json[pos] == '\r')) {
-        pos++;
-    }
-
-    // If it's a quoted string
-    if (json[pos] == '"') {
-        pos++;
-        size_t endPos = json.find('"', pos);
-        if (endPos != std::string::npos) {
-            return json.substr(pos, endPos - pos);
-        }
+namespace {
+    // Fields of one "devices" entry; unknown keys are skipped
+    bool parseDevicePattern(JsonReader& reader, DevicePattern& device) {
+        device.enabled = true;  // default when "enabled" is missing
+        return reader.readObject([&](std::string_view key) {
+            if (key == "name") return reader.readString(device.name);
+            if (key == "instanceIdPattern") return reader.readString(device.instanceIdPattern);
+            if (key == "enabled") return reader.readBool(device.enabled);
+            if (key == "description") return reader.readString(device.description);
+            return reader.skipValue();
+        });
     }
 
-    return "";
-}
-
-int extractIntValue(const std::string& json, const std::string& key) {
-    std::string searchFor = "\"" + key + "\"";
-    size_t pos = json.find(searchFor);
-    if (pos == std::string::npos) return 0;
-
-    // Find the colon after the key
-    pos = json.find(':', pos);
-    if (pos == std::string::npos) return 0;
-
-    // Skip whitespace after colon
-    pos++;
-    while (pos < json.length() && (json[pos] == ' ' || json[pos] == '\t')) {
-        pos++;
+    // One "alerts" entry; "when" must compile
+    bool parseAlertRule(JsonReader& reader, AlertRule& alert) {
+        alert.hysteresis = ConfigManager::DEFAULT_ALERT_HYSTERESIS;
+        alert.cooldown = ConfigManager::DEFAULT_ALERT_COOLDOWN;
+        bool hasWhen = false;
+        bool parsed = reader.readObject([&](std::string_view key) {
+            if (key == "name") return reader.readString(alert.name);
+            if (key == "when") {
+                if (!reader.readString(alert.when)) return false;
+                std::string problem;
+                if (!AlertRules::check(alert.when, problem)) {
+                    return reader.fail("alert \"when\", " + problem);
+                }
+                hasWhen = true;
+                return true;
+            }
+            if (key == "hysteresis") return reader.readInt(alert.hysteresis);
+            if (key == "cooldown") return reader.readInt(alert.cooldown);
+            return reader.skipValue();
+        });
+        if (!parsed) return false;
+        if (!hasWhen) return reader.fail("alert without \"when\"");
+        if (alert.name.empty()) alert.name = alert.when;
+        if (alert.hysteresis < 0) alert.hysteresis = 0;
+        if (alert.cooldown < 0) alert.cooldown = 0;
+        return true;
     }
 
-    // Extract digits
-    std::string numStr;
-    while (pos < json.length() && (json[pos] >= '0' && json[pos] <= '9')) {
-        numStr += json[pos];
-        pos++;
+    bool parseThresholds(JsonReader& reader, Config::BatteryThresholds& thresholds) {
+        return reader.readObject([&](std::string_view key) {
+            if (key == "high") return reader.readInt(thresholds.high);
+            if (key == "medium") return reader.readInt(thresholds.medium);
+            if (key == "low") return reader.readInt(thresholds.low);
+            return reader.skipValue();
+        });
     }
-
-    return numStr.empty() ? 0 : std::stoi(numStr);
 }
 
-std::vector<std::string> extractStringArray(const std::string& json, const std::string& arrayName) {
-    std::vector<std::string> result;
-    std::string searchFor = "\"" + arrayName + "\"";
-    size_t pos = json.find(searchFor);
-    if (pos == std::string::npos) return result;
-
-    // Find the opening bracket [
-    pos = json.find('[', pos);
-    if (pos == std::string::npos) return result;
-
-    // Find the closing bracket ]
-    size_t endPos = json.find(']', pos);
-    if (endPos == std::string::npos) return result;
+std::optional<Config> ConfigManager::parseJson(std::string_view jsonContent) {
+    lastError.reset();
 
-    // Extract array content
-    std::string arrayContent = json.substr(pos + 1, endPos - pos - 1);
-
-    // Find all quoted strings
-    pos = 0;
-    while (true) {
-        pos = arrayContent.find('"', pos);
-        if (pos == std::string::npos) break;
-
-        pos++; // Skip opening quote
-        size_t endQuote = arrayContent.find('"', pos);
-        if (endQuote == std::string::npos) break;
-
-        result.push_back(arrayContent.substr(pos, endQuote - pos));
-        pos = endQuote + 1;
-    }
-
-    return result;
-}
-
-std::optional<Config> ConfigManager::parseJson(const std::string& jsonContent) {
     Config config;
-
-    try {
-        // Parse simple values
-        std::string version = extractQuotedValue(jsonContent, "version");
-        config.version = utf8ToWide(version);
-
-        config.refreshInterval = extractIntValue(jsonContent, "refreshInterval");
-        if (config.refreshInterval == 0) {
-            config.refreshInterval = 300; // default 5 minutes
+    config.caseInsensitivePatterns = false;
+    config.refreshInterval = 0;
+    config.metricsPort = 0;
+    config.batteryThresholds = {0, 0, 0};
+
+    // One pass over the document: each top-level key is dispatched exactly
+    // once, so keys nested elsewhere (e.g. inside "_usage_notes") can't
+    // shadow real settings
+    JsonReader reader(jsonContent);
+    bool parsed = reader.readObject([&](std::string_view key) {
+        if (key == "version") {
+            return reader.readString(config.version);
         }
-
-        // Parse battery thresholds
-        size_t thresholdPos = jsonContent.find("\"batteryThresholds\"");
-        if (thresholdPos != std::string::npos) {
-            config.batteryThresholds.high = extractIntValue(jsonContent, "high");
-            config.batteryThresholds.medium = extractIntValue(jsonContent, "medium");
-            config.batteryThresholds.low = extractIntValue(jsonContent, "low");
+        if (key == "refreshInterval") {
+            return reader.readInt(config.refreshInterval);
         }
-
-        // Set defaults if not found
-        if (config.batteryThresholds.high == 0) config.batteryThresholds.high = 60;
-        if (config.batteryThresholds.medium == 0) config.batteryThresholds.medium = 30;
-        if (config.batteryThresholds.low == 0) config.batteryThresholds.low = 15;
-
-        // Parse namePatterns array
-        std::vector<std::string> patterns = extractStringArray(jsonContent, "namePatterns");
-        for (const auto& pattern : patterns) {
-            config.namePatterns.push_back(utf8ToWide(pattern));
+        if (key == "metricsPort") {
+            return reader.readInt(config.metricsPort);
         }
-
-        // Parse devices array (simplified - just extract enabled device names)
-        // This is a basic implementation - can be enhanced later
-        size_t devicesPos = jsonContent.find("\"devices\"");
-        if (devicesPos != std::string::npos) {
-            size_t arrayStart = jsonContent.find('[', devicesPos);
-            size_t arrayEnd = jsonContent.find(']', arrayStart);
-
-            if (arrayStart != std::string::npos && arrayEnd != std::string::npos) {
-                std::string devicesSection = jsonContent.substr(arrayStart, arrayEnd - arrayStart);
-
-                // Find all device objects
-                size_t pos = 0;
-                while (true) {
-                    pos = devicesSection.find('{', pos);
-                    if (pos == std::string::npos) break;
-
-                    size_t objEnd = devicesSection.find('}', pos);
-                    if (objEnd == std::string::npos) break;
-
-                    std::string deviceObj = devicesSection.substr(pos, objEnd - pos + 1);
-
-                    DevicePattern device;
-                    device.name = utf8ToWide(extractQuotedValue(deviceObj, "name"));
-                    device.instanceIdPattern = utf8ToWide(extractQuotedValue(deviceObj, "instanceIdPattern"));
-                    device.description = utf8ToWide(extractQuotedValue(deviceObj, "description"));
-
-                    // Check enabled (default true)
-                    size_t enabledPos = deviceObj.find("\"enabled\"");
-                    if (enabledPos != std::string::npos) {
-                        size_t truePos = deviceObj.find("true", enabledPos);
-                        size_t falsePos = deviceObj.find("false", enabledPos);
-                        device.enabled = (truePos != std::string::npos && (falsePos == std::string::npos || truePos < falsePos));
-                    } else {
-                        device.enabled = true;
-                    }
-
-                    if (!device.name.empty()) {
-                        config.devices.push_back(device);
-                    }
-
-                    pos = objEnd + 1;
+        if (key == "collector") {
+            return reader.readString(config.collector);
+        }
+        if (key == "batteryThresholds") {
+            return parseThresholds(reader, config.batteryThresholds);
+        }
+        if (key == "alerts") {
+            return reader.readArray([&]() {
+                return parseAlertRule(reader, config.alerts.emplace_back());
+            });
+        }
+        if (key == "namePatterns") {
+            return reader.readArray([&]() {
+                config.namePatterns.emplace_back();
+                return reader.readString(config.namePatterns.back());
+            });
+        }
+        if (key == "caseInsensitivePatterns") {
+            return reader.readBool(config.caseInsensitivePatterns);
+        }
+        if (key == "devices") {
+            return reader.readArray([&]() {
+                DevicePattern device;
+                if (!parseDevicePattern(reader, device)) return false;
+                if (!device.name.empty()) {
+                    config.devices.push_back(std::move(device));
                 }
-            }
+                return true;
+            });
         }
+        // Comments, usage notes and unknown keys
+        return reader.skipValue();
+    }) && reader.finish();
 
-        return config;
-
-    } catch (const std::exception&) {
+    if (!parsed) {
+        lastError = reader.error();
         return std::nullopt;
     }
-}
-
-bool ConfigManager::matchesDevicePatterns(const std::wstring& deviceName, const Config& config) {
-    // Check against namePatterns (supports wildcards)
-    for (const auto& pattern : config.namePatterns) {
-        // Simple wildcard matching: * at end
-        if (pattern.back() == L'*') {
-            std::wstring prefix = pattern.substr(0, pattern.length() - 1);
-            if (deviceName.find(prefix) == 0) {
-                return true;
-            }
-        } else {
-            // Exact match
-            if (deviceName == pattern) {
-                return true;
-            }
-        }
-    }
 
-    // Check against specific device names (if enabled)
-    for (const auto& device : config.devices) {
-        if (device.enabled && deviceName.find(device.name) != std::wstring::npos) {
-            return true;
-        }
-    }
+    // Set defaults if not found
+    if (config.refreshInterval == 0) config.refreshInterval = 300;  // default 5 minutes
+    if (config.metricsPort < 0 || config.metricsPort > 65535) config.metricsPort = 0;  // not a port: off
+    if (config.batteryThresholds.high == 0) config.batteryThresholds.high = 60;
+    if (config.batteryThresholds.medium == 0) config.batteryThresholds.medium = 30;
+    if (config.batteryThresholds.low == 0) config.batteryThresholds.low = 15;
 
-    return false;
+    return config;
 }
@@ -1,68 +1,87 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
-#include <windows.h>
+#include <filesystem>
+#include "JsonReader.h"
+
+// All config strings are UTF-8, exactly as stored in config.json
 
 struct DevicePattern {
-    std::wstring name;
-    std::wstring instanceIdPattern;
+    std::string name;
+    std::string instanceIdPattern;
     bool enabled;
-    std::wstring description;
+    std::string description;
+
+    bool operator==(const DevicePattern&) const = default;
+};
+
+// One entry of "alerts" (compiled by AlertRules)
+struct AlertRule {
+    std::string name;
+    std::string when;   // expression, see AlertRules
+    int hysteresis;     // level points the expression must clear by before it fires again
+    int cooldown;       // seconds between two alerts of the rule for one device
+
+    bool operator==(const AlertRule&) const = default;
 };
 
 struct Config {
-    std::wstring version;
+    std::string version;
     std::vector<DevicePattern> devices;
-    std::vector<std::wstring> namePatterns;
+    std::vector<std::string> namePatterns;
+    bool caseInsensitivePatterns;  // ASCII case folding for namePatterns and device names
     int refreshInterval;
+    int metricsPort;  // loopback Prometheus endpoint (MetricsServer); 0 = off
+    std::string collector;  // "a.b.c.d:port" to push device changes to (CollectorAgent); empty = off
+    std::vector<AlertRule> alerts;
 
     struct BatteryThresholds {
         int high;
         int medium;
         int low;
+
+        bool operator==(const BatteryThresholds&) const = default;
     } batteryThresholds;
+
+    bool operator==(const Config&) const = default;
 };
 
 class ConfigManager {
 public:
+    // Alert rules without "hysteresis" or "cooldown"
+    static constexpr int DEFAULT_ALERT_HYSTERESIS = 2;
+    static constexpr int DEFAULT_ALERT_COOLDOWN = 3600;
+
     ConfigManager();
     ~ConfigManager();
 
     // Load config from file (looks in executable directory by default)
-    std::optional<Config> loadConfig(const std::wstring& configPath = L"");
+    std::optional<Config> loadConfig(const std::filesystem::path& configPath = {});
 
     // Save config to file (saves to executable directory by default)
-    bool saveConfig(const Config& config, const std::wstring& configPath = L"");
+    bool saveConfig(const Config& config, const std::filesystem::path& configPath = {});
 
     // Get default config (Razer devices with standard settings)
     Config getDefaultConfig();
 
     // Get default config path (executable directory + config.json)
-    std::wstring getDefaultConfigPath();
+    std::filesystem::path getDefaultConfigPath();
 
-    // Check if device name matches any of the configured patterns
-    bool matchesDevicePatterns(const std::wstring& deviceName, const Config& config);
+    // Position and reason of the last load failure (nullopt if the file was
+    // missing or the last load succeeded)
+    const std::optional<JsonError>& getLastError() const { return lastError; }
 
-private:
-    // Parse JSON manually (simple implementation to avoid external dependencies)
-    std::optional<Config> parseJson(const std::string& jsonContent);
-
-    // Helper to read entire file
-    std::optional<std::string> readFile(const std::wstring& path);
-
-    // Helper to trim whitespace
-    std::string trim(const std::string& str);
-
-    // Helper to convert UTF-8 to wide string
-    std::wstring utf8ToWide(const std::string& utf8);
-
-    // Helper to convert wide string to UTF-8
-    std::string wideToUtf8(const std::wstring& wide);
+    // Parse a config document (single pass, no copies of the input)
+    std::optional<Config> parseJson(std::string_view jsonContent);
 
+private:
     // Helper to write file
-    bool writeFile(const std::wstring& path, const std::string& content);
+    bool writeFile(const std::filesystem::path& path, const std::string& content);
 
     // Helper to serialize config to JSON
     std::string serializeJson(const Config& config);
+
+    std::optional<JsonError> lastError;
 };
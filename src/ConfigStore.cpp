@@ -0,0 +1,112 @@
+#include "ConfigStore.h"
+#include "ConfigCache.h"
+#include "MappedFile.h"
+#include "MemoryAccounting.h"
+#include <system_error>
+#include <utility>
+
+namespace {
+    bool sameRules(const Config& a, const Config& b) {
+        return a.namePatterns == b.namePatterns &&
+               a.devices == b.devices &&
+               a.caseInsensitivePatterns == b.caseInsensitivePatterns;
+    }
+
+    bool sameAlerts(const Config& a, const Config& b) {
+        return a.alerts == b.alerts && a.caseInsensitivePatterns == b.caseInsensitivePatterns;
+    }
+}
+
+size_t ConfigSnapshot::memoryUsage() const {
+    size_t bytes = sizeof(*this) + MemoryAccounting::bytesOf(config.version) + MemoryAccounting::bytesOf(config.collector) +
+                   MemoryAccounting::bytesOf(config.devices) + MemoryAccounting::bytesOf(config.namePatterns);
+    for (const DevicePattern& device : config.devices) {
+        bytes += MemoryAccounting::bytesOf(device.name) + MemoryAccounting::bytesOf(device.instanceIdPattern) +
+                 MemoryAccounting::bytesOf(device.description);
+    }
+    for (const std::string& pattern : config.namePatterns) bytes += MemoryAccounting::bytesOf(pattern);
+    bytes += MemoryAccounting::bytesOf(config.alerts);
+    for (const AlertRule& alert : config.alerts) {
+        bytes += MemoryAccounting::bytesOf(alert.name) + MemoryAccounting::bytesOf(alert.when);
+    }
+    if (matcher) bytes += sizeof(PatternMatcher) + matcher->memoryUsage();
+    if (alerts) bytes += sizeof(AlertRules) + alerts->memoryUsage();
+    return bytes;
+}
+
+ConfigStore::ConfigStore(std::filesystem::path path, bool useCache)
+    : configPath(std::move(path))
+    , cachePath(useCache ? ConfigCache::pathFor(configPath) : std::filesystem::path())
+{
+}
+
+bool ConfigStore::reload(std::optional<JsonError>& error) {
+    error.reset();
+
+    // Stamp before mapping: if the file changes in between, the snapshot
+    // written below is simply never matched
+    std::error_code statError;
+    auto modified = std::filesystem::last_write_time(configPath, statError);
+    MappedFile file(configPath);
+    if (statError || !file.isValid()) {
+        return false;
+    }
+
+    std::optional<ConfigCache::Stamp> stamp;
+    if (!cachePath.empty()) {
+        stamp = ConfigCache::makeStamp(modified, file.contents());
+        if (auto cached = ConfigCache::load(cachePath, *stamp)) {
+            publish(std::move(cached->config), std::move(cached->matcher), true);
+            return true;
+        }
+    }
+
+    ConfigManager configMgr;
+    std::optional<Config> config = configMgr.parseJson(file.contents());
+    error = configMgr.getLastError();
+    if (!config.has_value()) {
+        return false;
+    }
+
+    auto published = publish(std::move(*config), nullptr, false);
+    if (stamp.has_value()) {
+        ConfigCache::save(cachePath, *stamp, published->config, *published->matcher);
+    }
+    return true;
+}
+
+void ConfigStore::publish(Config config) {
+    publish(std::move(config), nullptr, false);
+}
+
+std::shared_ptr<const ConfigSnapshot> ConfigStore::publish(Config config,
+                                                           std::shared_ptr<const PatternMatcher> compiled,
+                                                           bool fromCache) {
+    std::shared_ptr<const ConfigSnapshot> previous = current();
+
+    auto next = std::make_shared<ConfigSnapshot>();
+    next->generation = previous ? previous->generation + 1 : 1;
+    next->fromCache = fromCache;
+
+    // Only recompile the automaton if the rules changed
+    if (previous && sameRules(previous->config, config)) {
+        next->matcher = previous->matcher;
+    } else if (compiled) {
+        next->matcher = std::move(compiled);
+    } else {
+        next->matcher = std::make_shared<const PatternMatcher>(config);
+    }
+
+    if (previous && sameAlerts(previous->config, config)) {
+        next->alerts = previous->alerts;
+    } else {
+        next->alerts = std::make_shared<const AlertRules>(config.alerts, config.caseInsensitivePatterns);
+    }
+
+    next->levelColors = BatteryColors::build(config.batteryThresholds);
+    next->config = std::move(config);
+
+    std::shared_ptr<const ConfigSnapshot> published = next;
+    snapshot.store(std::move(next), std::memory_order_release);
+    return published;
+}
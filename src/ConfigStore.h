@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include "AlertRules.h"
+#include "BatteryColors.h"
+#include "ConfigManager.h"
+#include "PatternMatcher.h"
+
+// One immutable, fully prepared configuration. Once published it is never
+// modified, so any thread holding the pointer can read it without locking.
+struct ConfigSnapshot {
+    Config config;
+
+    // Compiled device rules; shared with the previous snapshot when
+    // namePatterns, devices and caseInsensitivePatterns did not change
+    std::shared_ptr<const PatternMatcher> matcher;
+
+    // Compiled alert rules; shared with the previous snapshot when alerts
+    // and caseInsensitivePatterns did not change
+    std::shared_ptr<const AlertRules> alerts;
+
+    // Icon colors for the configured thresholds
+    BatteryColors::Table levelColors;
+
+    // Increases with every publish
+    uint64_t generation;
+
+    // Decoded from config.cache instead of parsed and compiled
+    bool fromCache;
+
+    // Bytes held by the snapshot, its strings, its matcher and its alert rules
+    size_t memoryUsage() const;
+};
+
+// Holds the current ConfigSnapshot for one config file.
+// Writers (startup, the config watcher thread) parse and compile a new
+// snapshot on their own thread and publish it with a single atomic store;
+// readers load the pointer and keep the snapshot alive for as long as they
+// use it (read-copy-update). Writers must not run concurrently with each
+// other.
+class ConfigStore {
+public:
+    // useCache: read and write the binary snapshot next to the file
+    // (see ConfigCache)
+    explicit ConfigStore(std::filesystem::path configPath, bool useCache = true);
+
+    ConfigStore(const ConfigStore&) = delete;
+    ConfigStore& operator=(const ConfigStore&) = delete;
+
+    // Re-read the config file and publish it. An up-to-date binary snapshot
+    // is used instead of parsing; otherwise the file is parsed and a new
+    // snapshot written. Returns false and keeps the current snapshot if the
+    // file is missing or invalid (error is set for the latter).
+    bool reload(std::optional<JsonError>& error);
+
+    // Publish a config that did not come from the file (e.g. defaults)
+    void publish(Config config);
+
+    // Current snapshot (null until the first publish)
+    std::shared_ptr<const ConfigSnapshot> current() const {
+        return snapshot.load(std::memory_order_acquire);
+    }
+
+    const std::filesystem::path& path() const { return configPath; }
+
+private:
+    // Build the next snapshot around an already compiled matcher (or null
+    // to compile one) and publish it
+    std::shared_ptr<const ConfigSnapshot> publish(Config config, std::shared_ptr<const PatternMatcher> compiled,
+                                                  bool fromCache);
+
+    std::filesystem::path configPath;
+    std::filesystem::path cachePath;   // empty when caching is off
+    std::atomic<std::shared_ptr<const ConfigSnapshot>> snapshot;
+};
@@ -0,0 +1,248 @@
+#include "ConfigWatcher.h"
+#include "ProcessTelemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Milliseconds until the debounce deadline, for a wait's timeout
+    int remainingMs(Clock::time_point deadline) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        return static_cast<int>(std::max<decltype(remaining)>(remaining, 0));
+    }
+}
+
+ConfigWatcher::ConfigWatcher(std::filesystem::path path, std::function<void()> callback)
+    : filePath(std::move(path))
+    , onChange(std::move(callback))
+#ifdef _WIN32
+    , directory(INVALID_HANDLE_VALUE)
+    , stopEvent(nullptr)
+#else
+    , inotifyFd(-1)
+    , stopFd(-1)
+#endif
+{
+}
+
+ConfigWatcher::~ConfigWatcher() {
+    stop();
+}
+
+#ifdef _WIN32
+
+bool ConfigWatcher::start() {
+    if (thread.joinable()) {
+        return true;
+    }
+
+    directory = CreateFileW(filePath.parent_path().c_str(), FILE_LIST_DIRECTORY,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    if (directory == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!stopEvent) {
+        CloseHandle(directory);
+        directory = INVALID_HANDLE_VALUE;
+        return false;
+    }
+
+    thread = std::thread(&ConfigWatcher::watchLoop, this);
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (thread.joinable()) {
+        SetEvent(stopEvent);
+        thread.join();
+    }
+    if (directory != INVALID_HANDLE_VALUE) {
+        CloseHandle(directory);
+        directory = INVALID_HANDLE_VALUE;
+    }
+    if (stopEvent) {
+        CloseHandle(stopEvent);
+        stopEvent = nullptr;
+    }
+}
+
+void ConfigWatcher::watchLoop() {
+    const std::wstring fileName = filePath.filename().wstring();
+
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (!overlapped.hEvent) {
+        return;
+    }
+
+    alignas(DWORD) BYTE buffer[4096];
+    const DWORD filter = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE;
+    bool pending = false;  // a change was seen and the debounce timer is running
+    Clock::time_point deadline;
+
+    while (true) {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(directory, buffer, sizeof(buffer), FALSE, filter,
+                                   nullptr, &overlapped, nullptr)) {
+            break;
+        }
+
+        // Wait for the read to complete, coalescing changes until quiet
+        DWORD bytes = 0;
+        bool completed = false;
+        while (!completed) {
+            HANDLE handles[] = { stopEvent, overlapped.hEvent };
+            DWORD timeout = pending ? static_cast<DWORD>(remainingMs(deadline)) : INFINITE;
+            DWORD wait = WaitForMultipleObjects(2, handles, FALSE, timeout);
+            if (wait == WAIT_OBJECT_0 + 1) {
+                completed = GetOverlappedResult(directory, &overlapped, &bytes, FALSE) != FALSE;
+                if (!completed) {
+                    break;
+                }
+            } else if (wait == WAIT_TIMEOUT) {
+                ProcessTelemetry::count(ProcessTelemetry::Wakeup::FileWatch);
+                pending = false;
+                onChange();
+            } else {
+                // Stop requested (or the wait failed)
+                CancelIoEx(directory, &overlapped);
+                GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+                CloseHandle(overlapped.hEvent);
+                return;
+            }
+        }
+        if (!completed) {
+            break;
+        }
+
+        // Other files in the directory (the caches, the event log) wake
+        // the thread too but neither count nor restart the debounce timer.
+        // No bytes: the buffer overflowed and the events were dropped;
+        // assume the file was among them.
+        bool changed = bytes == 0;
+        for (DWORD offset = 0; bytes != 0;) {
+            const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer + offset);
+            int length = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+            if (CompareStringOrdinal(info->FileName, length, fileName.c_str(),
+                                     static_cast<int>(fileName.size()), TRUE) == CSTR_EQUAL) {
+                changed = true;
+            }
+            if (info->NextEntryOffset == 0) break;
+            offset += info->NextEntryOffset;
+        }
+        if (changed) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::FileWatch);
+            pending = true;
+            deadline = Clock::now() + std::chrono::milliseconds(DEBOUNCE_MS);
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+bool ConfigWatcher::start() {
+    if (thread.joinable()) {
+        return true;
+    }
+
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotifyFd < 0) {
+        return false;
+    }
+
+    std::filesystem::path dir = filePath.parent_path();
+    if (dir.empty()) {
+        dir = ".";
+    }
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO;
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0 || inotify_add_watch(inotifyFd, dir.c_str(), mask) < 0) {
+        stop();
+        return false;
+    }
+
+    thread = std::thread(&ConfigWatcher::watchLoop, this);
+    return true;
+}
+
+void ConfigWatcher::stop() {
+    if (thread.joinable()) {
+        uint64_t one = 1;
+        [[maybe_unused]] ssize_t written = ::write(stopFd, &one, sizeof(one));
+        thread.join();
+    }
+    if (inotifyFd >= 0) {
+        ::close(inotifyFd);
+        inotifyFd = -1;
+    }
+    if (stopFd >= 0) {
+        ::close(stopFd);
+        stopFd = -1;
+    }
+}
+
+void ConfigWatcher::watchLoop() {
+    const std::string fileName = filePath.filename().string();
+
+    alignas(inotify_event) char buffer[4096];
+    bool pending = false;  // a change was seen and the debounce timer is running
+    Clock::time_point deadline;
+
+    while (true) {
+        pollfd fds[] = { { stopFd, POLLIN, 0 }, { inotifyFd, POLLIN, 0 } };
+        int ready = poll(fds, 2, pending ? remainingMs(deadline) : -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;  // stop requested
+        }
+        if (ready == 0) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::FileWatch);
+            pending = false;
+            onChange();
+            continue;
+        }
+
+        // Other files in the directory (the caches, the event log) wake
+        // the thread too but neither count nor restart the debounce timer
+        bool changed = false;
+        ssize_t bytes;
+        while ((bytes = ::read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (ssize_t offset = 0; offset < bytes;) {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                if ((event->mask & IN_Q_OVERFLOW) != 0 ||
+                    (event->len > 0 && fileName == event->name)) {
+                    changed = true;
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+        if (changed) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::FileWatch);
+            pending = true;
+            deadline = Clock::now() + std::chrono::milliseconds(DEBOUNCE_MS);
+        }
+    }
+}
+
+#endif
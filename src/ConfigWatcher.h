@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <thread>
+
+// Watches one file for changes on a background thread
+// (ReadDirectoryChangesW on Windows, inotify elsewhere).
+// The containing directory is watched so that editors which save by writing
+// a temporary file and renaming it over the original are seen too. Bursts of
+// events are coalesced: onChange runs once the file has been quiet for
+// DEBOUNCE_MS, on the watcher thread.
+class ConfigWatcher {
+public:
+    static constexpr int DEBOUNCE_MS = 250;
+
+    ConfigWatcher(std::filesystem::path filePath, std::function<void()> onChange);
+    ~ConfigWatcher();
+
+    // Prevent copying (owns a thread and OS handles)
+    ConfigWatcher(const ConfigWatcher&) = delete;
+    ConfigWatcher& operator=(const ConfigWatcher&) = delete;
+
+    // Start watching; false if the directory cannot be watched
+    bool start();
+
+    // Stop the watcher thread (waits for a running onChange to return)
+    void stop();
+
+private:
+    void watchLoop();
+
+    std::filesystem::path filePath;
+    std::function<void()> onChange;
+    std::thread thread;
+
+#ifdef _WIN32
+    void* directory;   // HANDLE opened with FILE_FLAG_OVERLAPPED
+    void* stopEvent;   // HANDLE, signaled by stop()
+#else
+    int inotifyFd;
+    int stopFd;        // eventfd, written by stop()
+#endif
+};
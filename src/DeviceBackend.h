@@ -0,0 +1,32 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string_view>
+
+// Where DeviceMonitor gets its devices and readings from. The Windows build
+// uses SetupApiBackend (SetupAPI enumeration, Configuration Manager property
+// queries) for each enumerator, combined by a MultiSourceBackend; the
+// benchmarks drive DeviceMonitor through a fake one.
+//
+// A backend is shared by the UI thread's monitor and the startup discovery
+// thread's monitor, so both calls must be safe to make concurrently.
+class DeviceBackend {
+public:
+    // Battery and connection state of one device at query time
+    struct Reading {
+        bool present;                     // device node exists
+        std::optional<int> batteryLevel;  // 0-100, or nullopt if unavailable
+        bool isConnected;
+    };
+
+    virtual ~DeviceBackend() = default;
+
+    // Call onDevice(name, instanceId) for every candidate device (UTF-8; the
+    // views are only valid during the call)
+    virtual void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) = 0;
+
+    // Read the current state of the device with this instance ID; must not
+    // allocate (the refresh path is checked for heap use)
+    virtual Reading query(std::string_view instanceId) = 0;
+};
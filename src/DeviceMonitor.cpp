@@ -1,197 +1,148 @@
 #include "DeviceMonitor.h"
-#include "SafeHandles.h"
-#include <windows.h>
-#include <setupapi.h>
-#include <cfgmgr32.h>
-#include <devpkey.h>
-#include <initguid.h>
-#include <vector>
-#include <string>
-
-// Battery level property key: {104EA319-6EE2-4701-BD47-8DDBF425BBE5} 2
-DEFINE_GUID(GUID_BATTERY_LEVEL,
-    0x104EA319, 0x6EE2, 0x4701, 0xBD, 0x47, 0x8D, 0xDB, 0xF4, 0x25, 0xBB, 0xE5);
-
-const DEVPROPKEY DEVPKEY_Device_BatteryLevel = {
-    GUID_BATTERY_LEVEL,
-    2  // Property ID
-};
-
-// Connection status property key: DEVPKEY_Device_IsConnected
-// GUID: {83da6326-97a6-4088-9453-a1923f573b29}, Property ID: 15
-DEFINE_GUID(GUID_DEVICE_ISCONNECTED,
-    0x83da6326, 0x97a6, 0x4088, 0x94, 0x53, 0xa1, 0x92, 0x3f, 0x57, 0x3b, 0x29);
-
-const DEVPROPKEY DEVPKEY_Device_IsConnected_Custom = {
-    GUID_DEVICE_ISCONNECTED,
-    15  // Property ID (correct value!)
-};
-
-DeviceMonitor::DeviceMonitor() : config(std::nullopt) {
-    // Constructor - initialization if needed (no config = use default hardcoded patterns)
+#include "EventLog.h"
+#include "LatencyProbes.h"
+#include "MemoryAccounting.h"
+#include "TraceRecorder.h"
+#include <atomic>
+#include <utility>
+
+namespace {
+    std::atomic<uint64_t> totalQueries = 0;
+    std::atomic<uint64_t> totalNotPresent = 0;
+    std::atomic<uint64_t> totalNoLevel = 0;
 }
 
-DeviceMonitor::DeviceMonitor(const Config& cfg) : config(cfg) {
-    // Constructor with config
+DeviceMonitor::QueryCounts DeviceMonitor::queryCounts() {
+    return {totalQueries.load(std::memory_order_relaxed),
+            totalNotPresent.load(std::memory_order_relaxed),
+            totalNoLevel.load(std::memory_order_relaxed)};
 }
 
-DeviceMonitor::~DeviceMonitor() {
-    // Destructor - cleanup handled by RAII
+DeviceMonitor::DeviceMonitor(std::shared_ptr<DeviceBackend> source)
+    // Default hardcoded patterns (for backward compatibility)
+    : DeviceMonitor(std::move(source), std::make_shared<const PatternMatcher>(
+          std::vector<std::string>{},
+          std::vector<DevicePattern>{{"BSK", "", true, ""}, {"Razer", "", true, ""}, {"razer", "", true, ""}},
+          false))
+{
 }
 
-std::vector<std::unique_ptr<RazerDevice>> DeviceMonitor::enumerateRazerDevices() {
-    std::vector<std::unique_ptr<RazerDevice>> devices;
-
-    // Get device information set for Bluetooth devices
-    DeviceInfoHandle deviceInfo(
-        SetupDiGetClassDevsW(
-            nullptr,
-            L"BTHLE",  // Bluetooth LE enumerator
-            nullptr,
-            DIGCF_ALLCLASSES | DIGCF_PRESENT
-        )
-    );
-
-    if (!deviceInfo.isValid()) {
-        return devices;  // Return empty vector on failure
-    }
-
-    SP_DEVINFO_DATA deviceInfoData = {};
-    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
-
-    // Enumerate all devices
-    for (DWORD i = 0; SetupDiEnumDeviceInfo(deviceInfo.get(), i, &deviceInfoData); ++i) {
-        // Get device instance ID
-        WCHAR instanceId[MAX_PATH] = {};
-        if (!SetupDiGetDeviceInstanceIdW(
-                deviceInfo.get(),
-                &deviceInfoData,
-                instanceId,
-                MAX_PATH,
-                nullptr)) {
-            continue;
-        }
+DeviceMonitor::DeviceMonitor(std::shared_ptr<DeviceBackend> source, std::shared_ptr<const PatternMatcher> compiled)
+    : backend(std::move(source))
+    , matcher(std::move(compiled))
+{
+    // Patterns were compiled once by the config store, not per enumerated device
+}
 
-        // Get device description/name
-        WCHAR deviceName[256] = {};
-        DWORD propertyType = 0;
-        if (!SetupDiGetDeviceRegistryPropertyW(
-                deviceInfo.get(),
-                &deviceInfoData,
-                SPDRP_FRIENDLYNAME,
-                &propertyType,
-                reinterpret_cast<PBYTE>(deviceName),
-                sizeof(deviceName),
-                nullptr)) {
-            continue;
-        }
+void DeviceMonitor::setMatcher(std::shared_ptr<const PatternMatcher> compiled) {
+    // The cache notices the new automaton on its next use and starts over
+    matcher = std::move(compiled);
+}
 
-        // Filter for Razer devices
-        std::wstring name(deviceName);
-        std::wstring instId(instanceId);
+DeviceMonitor::~DeviceMonitor() {
+    // Destructor - cleanup handled by RAII
+}
 
-        // Check if device is BTHLE
-        if (instId.find(L"BTHLE\\") != 0) {
-            continue;
-        }
+void DeviceMonitor::logIdentity(StringId name, StringId instanceId) {
+    if (!EventLog::enabled()) return;
+    if (logged.size() <= instanceId) logged.resize(instanceId + 1);
+    if (logged[instanceId]) return;
+    logged[instanceId] = true;
+    EventLog::recordText(EventLog::Type::DEVICE_NAME, instanceId, devicePool.view(name));
+    EventLog::recordText(EventLog::Type::DEVICE_ID, instanceId, devicePool.view(instanceId));
+}
 
-        bool matches = false;
-
-        // Use config patterns if available, otherwise use default hardcoded patterns
-        if (config.has_value()) {
-            ConfigManager configMgr;
-            matches = configMgr.matchesDevicePatterns(name, config.value());
-        } else {
-            // Default hardcoded patterns (for backward compatibility)
-            matches = (name.find(L"BSK") != std::wstring::npos ||
-                      name.find(L"Razer") != std::wstring::npos ||
-                      name.find(L"razer") != std::wstring::npos);
+DeviceTable DeviceMonitor::enumerateRazerDevices() {
+    Trace::Span span("enumerate devices");
+    uint64_t started = LatencyProbes::now();
+    DeviceTable devices;
+
+    // Only devices that match get interned
+    backend->enumerate([&](std::string_view name, std::string_view instanceId) {
+        if (matcher->match(name, instanceId, matcherCache)) {
+            StringId nameId = devicePool.intern(name);
+            StringId instanceIdId = devicePool.intern(instanceId);
+            devices.add(nameId, instanceIdId);
+            logIdentity(nameId, instanceIdId);
+            EventLog::log(EventLog::Type::SEEN, instanceIdId);
         }
+    });
 
-        if (matches) {
-            devices.push_back(std::make_unique<RazerDevice>(name, instId));
-        }
-    }
-
+    EventLog::log(EventLog::Type::SCAN, EventLog::NO_DEVICE,
+                  static_cast<int64_t>(LatencyProbes::elapsedNanoseconds(started, LatencyProbes::now())),
+                  static_cast<int64_t>(devices.size()));
+    EventLog::requestFlush();
     return devices;
 }
 
-bool DeviceMonitor::getDeviceNode(const std::wstring& instanceId, DWORD& devInst) {
-    // Convert instance ID to device node
-    CONFIGRET ret = CM_Locate_DevNodeW(
-        &devInst,
-        const_cast<DEVINSTID_W>(instanceId.c_str()),
-        CM_LOCATE_DEVNODE_NORMAL
-    );
-
-    return ret == CR_SUCCESS;
+void DeviceMonitor::discover(const std::function<void(const Discovered& device)>& onDevice) {
+    Trace::Span span("discover devices");
+    backend->enumerate([&](std::string_view name, std::string_view instanceId) {
+        Discovered device = {name, instanceId, matcher->match(name, instanceId, matcherCache), backend->query(instanceId)};
+        onDevice(device);
+    });
 }
 
-std::optional<int> DeviceMonitor::getBatteryLevel(const std::wstring& instanceId) {
-    DWORD devInst = 0;
-    if (!getDeviceNode(instanceId, devInst)) {
-        return std::nullopt;
-    }
-
-    // Query battery level property
-    BYTE buffer[256] = {};
-    ULONG bufferSize = sizeof(buffer);
-    DEVPROPTYPE propertyType = 0;
-
-    CONFIGRET ret = CM_Get_DevNode_PropertyW(
-        devInst,
-        &DEVPKEY_Device_BatteryLevel,
-        &propertyType,
-        buffer,
-        &bufferSize,
-        0
-    );
-
-    if (ret != CR_SUCCESS || propertyType != DEVPROP_TYPE_BYTE) {
-        return std::nullopt;
-    }
-
-    // Battery level is returned as a byte (0-100)
-    int batteryLevel = static_cast<int>(buffer[0]);
-    if (batteryLevel >= 0 && batteryLevel <= 100) {
-        return batteryLevel;
-    }
-
-    return std::nullopt;
+size_t DeviceMonitor::memoryUsage() const {
+    return devicePool.memoryUsage() + MemoryAccounting::bytesOf(logged);
 }
 
-bool DeviceMonitor::isDeviceConnected(const std::wstring& instanceId) {
-    DWORD devInst = 0;
-    if (!getDeviceNode(instanceId, devInst)) {
-        return false;
+DeviceStateCache::State DeviceMonitor::captureState(const DeviceTable& devices) const {
+    DeviceStateCache::State state;
+    state.savedAt = DeviceStateCache::now();
+    state.devices.reserve(devices.size());
+    for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+        state.devices.push_back({
+            std::string(devicePool.view(devices.name(row))),
+            std::string(devicePool.view(devices.instanceId(row))),
+            devices.batteryLevel(row),
+            devices.isConnected(row),
+        });
     }
+    return state;
+}
 
-    // Query connection status property
-    BYTE buffer[256] = {};
-    ULONG bufferSize = sizeof(buffer);
-    DEVPROPTYPE propertyType = 0;
-
-    CONFIGRET ret = CM_Get_DevNode_PropertyW(
-        devInst,
-        &DEVPKEY_Device_IsConnected_Custom,
-        &propertyType,
-        buffer,
-        &bufferSize,
-        0
-    );
-
-    if (ret != CR_SUCCESS || propertyType != DEVPROP_TYPE_BOOLEAN) {
-        return false;
+DeviceTable DeviceMonitor::restoreState(const DeviceStateCache::State& state) {
+    DeviceTable devices;
+    devices.reserve(state.devices.size());
+    for (const auto& cached : state.devices) {
+        DeviceTable::Row row = devices.add(devicePool.intern(cached.name), devicePool.intern(cached.instanceId));
+        devices.update(row, cached.batteryLevel, cached.isConnected, state.savedAt);
+        logIdentity(devices.name(row), devices.instanceId(row));
     }
-
-    // Connection status is returned as DEVPROP_BOOLEAN (DEVPROP_TRUE/DEVPROP_FALSE)
-    DEVPROP_BOOLEAN isConnected = *reinterpret_cast<DEVPROP_BOOLEAN*>(buffer);
-    return isConnected == DEVPROP_TRUE;
+    return devices;
 }
 
-void DeviceMonitor::updateDeviceInfo(std::vector<std::unique_ptr<RazerDevice>>& devices) {
-    for (auto& device : devices) {
-        device->batteryLevel = getBatteryLevel(device->instanceId);
-        device->isConnected = isDeviceConnected(device->instanceId);
+void DeviceMonitor::updateDeviceInfo(DeviceTable& devices) {
+    Trace::Span span("update device info");
+    uint64_t started = LatencyProbes::now();
+    int64_t now = DeviceStateCache::now();
+    uint64_t notPresent = 0;
+    uint64_t noLevel = 0;
+    for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+        Trace::Span deviceSpan("query device", devicePool.view(devices.name(row)));
+
+        StringId device = devices.instanceId(row);
+        DeviceBackend::Reading reading = backend->query(devicePool.view(device));
+        bool connected = reading.present && reading.isConnected;
+        if (devices.update(row, reading.present ? reading.batteryLevel : std::nullopt, connected, now)) {
+            EventLog::log(EventLog::Type::STATE, device, devices.batteryLevel(row).value_or(-1), connected);
+        }
+        if (!reading.present) {
+            notPresent++;
+            EventLog::log(EventLog::Type::QUERY_FAILED, device, static_cast<int64_t>(EventLog::Failure::NOT_PRESENT));
+        } else if (connected && !devices.batteryLevel(row).has_value()) {
+            noLevel++;
+            EventLog::log(EventLog::Type::QUERY_FAILED, device, static_cast<int64_t>(EventLog::Failure::NO_LEVEL));
+        }
     }
+
+    totalQueries.fetch_add(devices.size(), std::memory_order_relaxed);
+    totalNotPresent.fetch_add(notPresent, std::memory_order_relaxed);
+    totalNoLevel.fetch_add(noLevel, std::memory_order_relaxed);
+    uint64_t elapsed = LatencyProbes::elapsedNanoseconds(started, LatencyProbes::now());
+    LatencyProbes::histogram(LatencyProbes::Site::Refresh).record(elapsed);
+    EventLog::log(EventLog::Type::REFRESH, EventLog::NO_DEVICE, static_cast<int64_t>(elapsed),
+                  static_cast<int64_t>(devices.size()));
+    EventLog::requestFlush();
 }
@@ -1,49 +1,90 @@
 #pragma once
 
-#include <windows.h>
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <optional>
 #include <memory>
 #include "ConfigManager.h"
+#include "DeviceBackend.h"
+#include "DeviceStateCache.h"
+#include "DeviceTable.h"
+#include "StringPool.h"
+#include "PatternMatcher.h"
 
-// Structure to hold Razer device information
-struct RazerDevice {
-    std::wstring name;
-    std::wstring instanceId;
-    std::optional<int> batteryLevel;  // 0-100, or nullopt if unavailable
-    bool isConnected;
-
-    RazerDevice(std::wstring devName, std::wstring devInstanceId)
-        : name(std::move(devName))
-        , instanceId(std::move(devInstanceId))
-        , batteryLevel(std::nullopt)
-        , isConnected(false)
-    {}
-};
-
+// Tracks the devices a backend reports that match the configured rules.
+// Portable: all OS access goes through the DeviceBackend. Device names and
+// instance IDs in the tables it returns are UTF-8 strings interned in its
+// pool; two devices are the same device exactly when their handles match.
 class DeviceMonitor {
 public:
-    DeviceMonitor();
-    explicit DeviceMonitor(const Config& config);
+    // Device queries made by every monitor in the process since launch
+    struct QueryCounts {
+        uint64_t queries;
+        uint64_t notPresent;  // the device node was gone
+        uint64_t noLevel;     // connected, but no (or an out-of-range) battery level
+    };
+    static QueryCounts queryCounts();
+
+    explicit DeviceMonitor(std::shared_ptr<DeviceBackend> backend);
+    DeviceMonitor(std::shared_ptr<DeviceBackend> backend, std::shared_ptr<const PatternMatcher> matcher);
     ~DeviceMonitor();
 
+    // Switch to newly compiled rules (config reload); takes effect on the
+    // next enumerateRazerDevices()
+    void setMatcher(std::shared_ptr<const PatternMatcher> matcher);
+
     // Enumerate all Razer Bluetooth LE devices (uses config if available)
-    std::vector<std::unique_ptr<RazerDevice>> enumerateRazerDevices();
+    DeviceTable enumerateRazerDevices();
+
+    // A device as the backend reports it, matching or not
+    struct Discovered {
+        std::string_view name;          // UTF-8, valid during the callback
+        std::string_view instanceId;
+        std::optional<PatternMatcher::Match> match;   // nullopt: no rule matches
+        DeviceBackend::Reading reading;
+    };
+
+    // Enumerate every device the backend reports, match and read each one,
+    // and report it as soon as it is found (--discover); nothing is
+    // tracked, interned or logged
+    void discover(const std::function<void(const Discovered& device)>& onDevice);
 
-    // Update battery levels and connection status for devices
-    void updateDeviceInfo(std::vector<std::unique_ptr<RazerDevice>>& devices);
+    // Update battery levels and connection status for devices (timed as
+    // LatencyProbes::Site::Refresh, counted in queryCounts())
+    void updateDeviceInfo(DeviceTable& devices);
+
+    // Interned device names and instance IDs (UTF-8)
+    const StringPool& strings() const { return devicePool; }
+
+    // Bytes held for the devices (the pool, what was logged) and by the
+    // matcher cache built from the config
+    size_t memoryUsage() const;
+    size_t matcherCacheUsage() const { return matcherCache.memoryUsage(); }
+
+    // Convert to and from the persisted last-known state (warm start)
+    DeviceStateCache::State captureState(const DeviceTable& devices) const;
+    DeviceTable restoreState(const DeviceStateCache::State& state);
 
 private:
-    // Query battery level for a specific device
-    std::optional<int> getBatteryLevel(const std::wstring& instanceId);
+    // Source of devices and readings (shared with other monitors)
+    std::shared_ptr<DeviceBackend> backend;
+
+    // Device-name rules compiled from the config (or the default hardcoded
+    // patterns when constructed without one); shared with the config snapshot
+    std::shared_ptr<const PatternMatcher> matcher;
+
+    // This monitor's lazily built matcher DFA states
+    PatternMatcher::Cache matcherCache;
 
-    // Check if device is actually connected (not just paired)
-    bool isDeviceConnected(const std::wstring& instanceId);
+    // Identities of every device seen so far; rediscovery reuses handles
+    StringPool devicePool;
 
-    // Get device node instance from instance ID
-    bool getDeviceNode(const std::wstring& instanceId, DWORD& devInst);
+    // Instance ID handles whose texts went to the EventLog
+    std::vector<bool> logged;
 
-    // Optional config (if not set, uses default hardcoded patterns)
-    std::optional<Config> config;
+    // Log the device's name and instance ID if the EventLog has not seen them
+    void logIdentity(StringId name, StringId instanceId);
 };
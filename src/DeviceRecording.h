@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Device recording format (.rzrec), written by RecordingBackend and read by
+// ReplayBackend. Recordings are taken on one machine and replayed on
+// another, so unlike BinaryIO everything is byte-order independent: a
+// 4-byte magic followed by LEB128 varints (signed values zigzag encoded).
+//
+//   header   : "RZRC" version startedAt(unix seconds, signed)
+//   DEVICE   : tag index name instanceId    defines device index (the next
+//                                           one), or names it if first seen
+//                                           by a query without a name
+//   ENUMERATE: tag dt count index...        one completed enumeration
+//   QUERY    : tag dt index flags [level]   one query() result
+//
+// Strings are a length followed by UTF-8 bytes. dt is microseconds since the
+// previous timed record (the first one: since the recording started). The
+// file is appended as the recording runs; a reader keeps every complete
+// record and ignores a torn tail.
+namespace DeviceRecording {
+    constexpr char MAGIC[4] = {'R', 'Z', 'R', 'C'};
+    constexpr uint64_t FORMAT_VERSION = 1;
+
+    enum Tag : uint8_t {
+        DEVICE = 1,
+        ENUMERATE = 2,
+        QUERY = 3,
+    };
+
+    // QUERY flags
+    constexpr uint8_t PRESENT = 1;
+    constexpr uint8_t CONNECTED = 2;
+    constexpr uint8_t HAS_LEVEL = 4;  // a zigzag level follows (raw, not clamped)
+
+    // Longest encoding of a 64-bit varint
+    constexpr size_t MAX_VARINT = 10;
+
+    // Encode into out (at least MAX_VARINT bytes); returns the bytes written
+    inline size_t encodeVarint(uint64_t value, char* out) {
+        size_t length = 0;
+        while (value >= 0x80) {
+            out[length++] = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out[length++] = static_cast<char>(value);
+        return length;
+    }
+
+    inline uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    // Bounds-checked varint reader; every read fails once the input is
+    // exhausted or malformed
+    class Reader {
+    public:
+        explicit Reader(std::string_view data) : input(data), offset(0) {}
+
+        bool readVarint(uint64_t& value) {
+            value = 0;
+            for (unsigned shift = 0; shift < 64 && offset < input.size(); shift += 7) {
+                uint8_t byte = static_cast<uint8_t>(input[offset++]);
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) return true;
+            }
+            return false;
+        }
+
+        bool readByte(uint8_t& value) {
+            if (offset >= input.size()) return false;
+            value = static_cast<uint8_t>(input[offset++]);
+            return true;
+        }
+
+        bool readString(std::string& value) {
+            uint64_t length = 0;
+            if (!readVarint(length) || length > input.size() - offset) return false;
+            value.assign(input.data() + offset, static_cast<size_t>(length));
+            offset += static_cast<size_t>(length);
+            return true;
+        }
+
+        // A view into the input instead of a copy
+        bool readString(std::string_view& value) {
+            uint64_t length = 0;
+            if (!readVarint(length) || length > input.size() - offset) return false;
+            value = input.substr(offset, static_cast<size_t>(length));
+            offset += static_cast<size_t>(length);
+            return true;
+        }
+
+        // This format's magic, or another one built on the same encoding
+        bool readMagic(std::string_view magic = std::string_view(MAGIC, sizeof(MAGIC))) {
+            if (input.size() - offset < magic.size()) return false;
+            bool matches = input.compare(offset, magic.size(), magic) == 0;
+            offset += magic.size();
+            return matches;
+        }
+
+        bool atEnd() const { return offset == input.size(); }
+
+    private:
+        std::string_view input;
+        size_t offset;
+    };
+}
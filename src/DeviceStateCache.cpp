@@ -0,0 +1,93 @@
+#include "DeviceStateCache.h"
+#include "BinaryIO.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <cstring>
+
+namespace {
+    constexpr char MAGIC[4] = {'R', 'Z', 'T', 'D'};
+    constexpr int8_t NO_LEVEL = -1;
+
+    struct Header {
+        char magic[4];
+        uint32_t formatVersion;
+        int64_t savedAt;
+        uint64_t payloadSize;
+        uint64_t payloadHash;
+    };
+}
+
+std::filesystem::path DeviceStateCache::pathFor(const std::filesystem::path& configPath) {
+    return configPath.parent_path() / "devices.cache";
+}
+
+int64_t DeviceStateCache::now() {
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+}
+
+std::optional<DeviceStateCache::State> DeviceStateCache::load(const std::filesystem::path& path) {
+    MappedFile file(path);
+    std::string_view data = file.contents();
+    if (!file.isValid() || data.size() < sizeof(Header)) {
+        return std::nullopt;
+    }
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    std::string_view payload = data.substr(sizeof(Header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        header.formatVersion != FORMAT_VERSION ||
+        header.payloadSize != payload.size() ||
+        header.payloadHash != BinaryIO::hash(payload)) {
+        return std::nullopt;
+    }
+
+    BinaryIO::Reader in(payload);
+    State state;
+    state.savedAt = header.savedAt;
+
+    uint64_t count = 0;
+    if (!in.read(count)) {
+        return std::nullopt;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        Device device;
+        int8_t level = NO_LEVEL;
+        if (!in.readString(device.name) || !in.readString(device.instanceId) ||
+            !in.read(level) || !in.read(device.isConnected)) {
+            return std::nullopt;
+        }
+        if (level != NO_LEVEL) {
+            if (level < 0 || level > 100) return std::nullopt;
+            device.batteryLevel = level;
+        }
+        state.devices.push_back(std::move(device));
+    }
+    if (!in.atEnd()) {
+        return std::nullopt;
+    }
+    return state;
+}
+
+bool DeviceStateCache::save(const std::filesystem::path& path, const State& state) {
+    BinaryIO::Writer payload;
+    payload.write(static_cast<uint64_t>(state.devices.size()));
+    for (const auto& device : state.devices) {
+        payload.writeString(device.name);
+        payload.writeString(device.instanceId);
+        payload.write(static_cast<int8_t>(device.batteryLevel.value_or(NO_LEVEL)));
+        payload.write(device.isConnected);
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.savedAt = state.savedAt;
+    header.payloadSize = payload.data().size();
+    header.payloadHash = BinaryIO::hash(payload.data());
+
+    std::string file(reinterpret_cast<const char*>(&header), sizeof(header));
+    file += payload.data();
+    return BinaryIO::replaceFile(path, file);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Last known devices and readings, persisted (devices.cache next to
+// config.json) so the tray can show them the moment it starts, before the
+// first enumeration finishes.
+//
+// The file is a small versioned header (with the time it was saved and a
+// payload checksum) followed by one record per device. Anything that does
+// not check out loads as nothing; the tray then starts as it would without
+// a cache.
+namespace DeviceStateCache {
+    constexpr uint32_t FORMAT_VERSION = 1;
+
+    struct Device {
+        std::string name;         // UTF-8
+        std::string instanceId;   // UTF-8
+        std::optional<int> batteryLevel;
+        bool isConnected;
+    };
+
+    struct State {
+        int64_t savedAt;          // seconds since the Unix epoch
+        std::vector<Device> devices;
+    };
+
+    // config.json -> devices.cache in the same directory
+    std::filesystem::path pathFor(const std::filesystem::path& configPath);
+
+    std::optional<State> load(const std::filesystem::path& path);
+
+    // Write the state (atomically, see BinaryIO::replaceFile)
+    bool save(const std::filesystem::path& path, const State& state);
+
+    // Current time in State::savedAt units
+    int64_t now();
+}
@@ -0,0 +1,129 @@
+#include "DeviceTable.h"
+#include "MemoryAccounting.h"
+#include <algorithm>
+
+void DeviceTable::reserve(size_t count) {
+    names.reserve(count);
+    instanceIds.reserve(count);
+    levels.reserve(count);
+    flags.reserve(count);
+    changeTimes.reserve(count);
+    heap.reserve(count);
+    heapPositions.reserve(count);
+}
+
+void DeviceTable::clear() {
+    names.clear();
+    instanceIds.clear();
+    levels.clear();
+    flags.clear();
+    changeTimes.clear();
+    heap.clear();
+    heapPositions.clear();
+    connected = 0;
+}
+
+DeviceTable::Row DeviceTable::add(StringId name, StringId instanceId) {
+    names.push_back(name);
+    instanceIds.push_back(instanceId);
+    levels.push_back(NO_LEVEL);
+    flags.push_back(0);
+    changeTimes.push_back(0);
+    heapPositions.push_back(NOT_IN_HEAP);
+    if (heap.capacity() < names.size()) {
+        heap.reserve(names.capacity());  // so update() never allocates
+    }
+    return static_cast<Row>(names.size() - 1);
+}
+
+void DeviceTable::change(Row row, int8_t newLevel, uint8_t newFlags, int64_t now) {
+    changeTimes[row] = now;
+    bool isConnected = (newFlags & CONNECTED) != 0;
+    if ((newFlags ^ flags[row]) & CONNECTED) {
+        if (isConnected) {
+            connected++;
+        } else {
+            connected--;
+        }
+    }
+    levels[row] = newLevel;
+    flags[row] = newFlags;
+
+    bool belongs = isConnected && newLevel != NO_LEVEL;
+    if (heapPositions[row] != NOT_IN_HEAP) {
+        if (belongs) {
+            heap[heapPositions[row]] = keyOf(newLevel, row);
+            heapFix(heapPositions[row]);
+        } else {
+            heapRemove(row);
+        }
+    } else if (belongs) {
+        heapInsert(row);
+    }
+}
+
+void DeviceTable::heapInsert(Row row) {
+    heap.push_back(keyOf(levels[row], row));
+    heapPositions[row] = static_cast<uint32_t>(heap.size() - 1);
+    siftUp(heapPositions[row]);
+}
+
+void DeviceTable::heapRemove(Row row) {
+    uint32_t position = heapPositions[row];
+    heapPositions[row] = NOT_IN_HEAP;
+    Key last = heap.back();
+    heap.pop_back();
+    if (position < heap.size()) {
+        place(position, last);
+        heapFix(position);
+    }
+}
+
+void DeviceTable::heapFix(uint32_t position) {
+    if (position > 0 && heap[position] < heap[(position - 1) / ARITY]) {
+        siftUp(position);
+    } else {
+        siftDown(position);
+    }
+}
+
+void DeviceTable::siftUp(uint32_t position) {
+    Key key = heap[position];
+    while (position > 0) {
+        uint32_t parent = (position - 1) / ARITY;
+        if (!(key < heap[parent])) break;
+        place(position, heap[parent]);
+        position = parent;
+    }
+    place(position, key);
+}
+
+void DeviceTable::siftDown(uint32_t position) {
+    Key key = heap[position];
+    uint32_t count = static_cast<uint32_t>(heap.size());
+    while (true) {
+        uint32_t first = position * ARITY + 1;
+        if (first >= count) break;
+        uint32_t child = first;
+        uint32_t last = std::min(first + ARITY, count);
+        for (uint32_t candidate = first + 1; candidate < last; candidate++) {
+            if (heap[candidate] < heap[child]) child = candidate;
+        }
+        if (!(heap[child] < key)) break;
+        place(position, heap[child]);
+        position = child;
+    }
+    place(position, key);
+}
+
+void DeviceTable::place(uint32_t position, Key key) {
+    heap[position] = key;
+    heapPositions[rowOf(key)] = position;
+}
+
+size_t DeviceTable::memoryUsage() const {
+    return MemoryAccounting::bytesOf(names) + MemoryAccounting::bytesOf(instanceIds) +
+           MemoryAccounting::bytesOf(levels) + MemoryAccounting::bytesOf(flags) +
+           MemoryAccounting::bytesOf(changeTimes) + MemoryAccounting::bytesOf(heap) +
+           MemoryAccounting::bytesOf(heapPositions);
+}
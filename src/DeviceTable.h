@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include "StringPool.h"
+
+// The tracked devices, one row per device, stored as parallel arrays
+// (structure of arrays) so a refresh or a scan over one field walks
+// contiguous memory instead of chasing a heap node per device.
+//
+// The aggregates the tray icon needs are maintained as rows change rather
+// than recomputed: the number of connected devices, and an indexed 4-ary
+// min-heap of connected devices with a known level, ordered by level then
+// row, whose top is the lowest battery. Heap entries carry their own key
+// (level << 32 | row), so sifting compares within the heap array. An update
+// that changes nothing costs two compares; one that does is O(log n).
+// Nothing allocates after reserve() except add().
+class DeviceTable {
+public:
+    using Row = uint32_t;
+
+    static constexpr int8_t NO_LEVEL = -1;
+
+    size_t size() const { return names.size(); }
+    bool empty() const { return names.empty(); }
+    void reserve(size_t count);
+    void clear();
+
+    // Bytes held by the columns and the heap (capacity, not size)
+    size_t memoryUsage() const;
+
+    // Append a device (no level, not connected); returns its row
+    Row add(StringId name, StringId instanceId);
+
+    // Record a reading taken at `now` (seconds since the Unix epoch); true
+    // if the level or connection changed. Levels outside 0-100 are stored
+    // as unknown.
+    bool update(Row row, std::optional<int> level, bool connected, int64_t now) {
+        int8_t newLevel = level.has_value() && *level >= 0 && *level <= 100 ? static_cast<int8_t>(*level) : NO_LEVEL;
+        uint8_t newFlags = connected ? CONNECTED : 0;
+        if (newLevel == levels[row] && newFlags == flags[row]) {
+            return false;
+        }
+        change(row, newLevel, newFlags, now);
+        return true;
+    }
+
+    // Columns
+    StringId name(Row row) const { return names[row]; }
+    StringId instanceId(Row row) const { return instanceIds[row]; }
+    std::optional<int> batteryLevel(Row row) const {
+        return levels[row] == NO_LEVEL ? std::nullopt : std::optional<int>(levels[row]);
+    }
+    bool isConnected(Row row) const { return (flags[row] & CONNECTED) != 0; }
+    int64_t changedAt(Row row) const { return changeTimes[row]; }  // last level or connection change; 0 = never
+
+    // Aggregates
+    size_t connectedCount() const { return connected; }
+    std::optional<Row> lowestBattery() const {
+        return heap.empty() ? std::nullopt : std::optional<Row>(rowOf(heap.front()));
+    }
+
+private:
+    static constexpr uint8_t CONNECTED = 1;
+    static constexpr uint32_t NOT_IN_HEAP = UINT32_MAX;
+    static constexpr uint32_t ARITY = 4;  // children per heap node (one cache line of keys)
+
+    // Heap order: level, then row (so ties resolve to the first device)
+    using Key = uint64_t;
+    static Key keyOf(int8_t level, Row row) { return static_cast<Key>(level) << 32 | row; }
+    static Row rowOf(Key key) { return static_cast<Row>(key); }
+
+    // update() for a row whose level or flags differ
+    void change(Row row, int8_t newLevel, uint8_t newFlags, int64_t now);
+
+    void heapInsert(Row row);
+    void heapRemove(Row row);
+    void heapFix(uint32_t position);
+    void siftUp(uint32_t position);
+    void siftDown(uint32_t position);
+    void place(uint32_t position, Key key);
+
+    std::vector<StringId> names;
+    std::vector<StringId> instanceIds;
+    std::vector<int8_t> levels;       // NO_LEVEL or 0-100
+    std::vector<uint8_t> flags;
+    std::vector<int64_t> changeTimes;
+
+    std::vector<Key> heap;
+    std::vector<uint32_t> heapPositions;   // per row: index into heap or NOT_IN_HEAP
+    size_t connected = 0;
+};
@@ -0,0 +1,121 @@
+#include "Discovery.h"
+#include "ConfigStore.h"
+#include "JsonReader.h"
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+namespace {
+    // The namePatterns entry or the devices entry's name the match points at
+    std::string_view ruleOf(const PatternMatcher::Match& match, const Config& config) {
+        if (match.kind == PatternMatcher::Match::Kind::NamePattern) {
+            return match.index < config.namePatterns.size() ? std::string_view(config.namePatterns[match.index])
+                                                            : std::string_view();
+        }
+        return match.index < config.devices.size() ? std::string_view(config.devices[match.index].name)
+                                                   : std::string_view();
+    }
+}
+
+namespace Discovery {
+    std::string toJson(const DeviceMonitor::Discovered& device, std::string_view source, const Config& config) {
+        std::string out = "{\"name\":";
+        appendJsonString(out, device.name);
+        out += ",\"instanceId\":";
+        appendJsonString(out, device.instanceId);
+        out += ",\"source\":";
+        if (!source.empty()) {
+            appendJsonString(out, source);
+        } else {
+            out += "null";
+        }
+        out += device.reading.isConnected ? ",\"connected\":true" : ",\"connected\":false";
+        out += ",\"batteryLevel\":";
+        out += device.reading.batteryLevel ? std::to_string(*device.reading.batteryLevel) : "null";
+        out += ",\"match\":";
+        if (device.match) {
+            out += device.match->kind == PatternMatcher::Match::Kind::NamePattern ? "{\"kind\":\"namePattern\""
+                                                                                  : "{\"kind\":\"device\"";
+            out += ",\"index\":";
+            out += std::to_string(device.match->index);
+            out += ",\"rule\":";
+            appendJsonString(out, ruleOf(*device.match, config));
+            out += '}';
+        } else {
+            out += "null";
+        }
+        out += "}\n";
+        return out;
+    }
+
+    std::string toText(const DeviceMonitor::Discovered& device, std::string_view source, const Config& config) {
+        char level[8] = "  --";
+        if (device.reading.batteryLevel) {
+            std::snprintf(level, sizeof(level), "%3d%%", *device.reading.batteryLevel);
+        }
+        std::string rule = "-";
+        if (device.match) {
+            rule = device.match->kind == PatternMatcher::Match::Kind::NamePattern ? "namePatterns: " : "devices: ";
+            rule += ruleOf(*device.match, config);
+        }
+        char line[512];
+        std::snprintf(line, sizeof(line), "  %-40.*s %s  %-12s  %-12.*s  %s\n", static_cast<int>(device.name.size()),
+                      device.name.data(), level, device.reading.isConnected ? "connected" : "disconnected",
+                      static_cast<int>(source.size()), source.data(), rule.c_str());
+        return line;
+    }
+
+    int run(std::shared_ptr<DeviceBackend> backend, const MultiSourceBackend* sources,
+            const std::filesystem::path& configPath, bool json,
+            const std::function<void(std::string_view text)>& onOutput,
+            const std::function<void(std::string_view message)>& onWarning) {
+        // The tray's rules, except that a missing file is not created:
+        // discovering devices is often what comes before writing one
+        ConfigStore configStore(configPath);
+        std::optional<JsonError> error;
+        if (!configStore.reload(error)) {
+            if (error.has_value()) {
+                char message[512];
+                std::snprintf(message, sizeof(message), "config.json line %zu, column %zu: %s; using default settings",
+                              error->line, error->column, error->message.c_str());
+                onWarning(message);
+            }
+            ConfigManager configMgr;
+            configStore.publish(configMgr.getDefaultConfig());
+        }
+        std::shared_ptr<const ConfigSnapshot> snapshot = configStore.current();
+
+        DeviceMonitor monitor(std::move(backend), snapshot->matcher);
+        size_t found = 0;
+        size_t matched = 0;
+        auto started = std::chrono::steady_clock::now();
+        monitor.discover([&](const DeviceMonitor::Discovered& device) {
+            found++;
+            if (device.match) matched++;
+            std::string_view source = sources ? sources->sourceOf(device.instanceId) : std::string_view();
+            onOutput(json ? toJson(device, source, snapshot->config) : toText(device, source, snapshot->config));
+        });
+
+        if (!json) {
+            auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started);
+            char line[128];
+            std::snprintf(line, sizeof(line), "%zu devices, %zu matched (%.0f ms)\n", found, matched, elapsed.count());
+            onOutput(line);
+            auto sourceTimings = sources ? sources->lastEnumeration() : std::vector<MultiSourceBackend::SourceTiming>();
+            if (!sourceTimings.empty()) {
+                // Enumerated at the same time: the slowest one bounds the scan
+                std::string timings = "Sources:";
+                for (const auto& timing : sourceTimings) {
+                    std::snprintf(line, sizeof(line), " %.*s %.1f ms (%u devices, %u duplicates),",
+                                  static_cast<int>(timing.name.size()), timing.name.data(),
+                                  static_cast<double>(timing.nanoseconds) / 1e6, timing.devices, timing.duplicates);
+                    timings += line;
+                }
+                timings.back() = '\n';
+                onOutput(timings);
+            }
+        }
+        return 0;
+    }
+}
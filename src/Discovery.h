@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "ConfigManager.h"
+#include "DeviceBackend.h"
+#include "DeviceMonitor.h"
+#include "MultiSourceBackend.h"
+
+// `RazerTray --discover [--json]` (and razertray_headless): every device the
+// platform backend reports, matched against config.json's rules by the
+// same compiled PatternMatcher the tray uses. Once every enumerator has
+// listed its devices, each one is read and printed in turn.
+// razer-config.ps1 reads the JSON form instead of asking PnP and matching
+// with rules of its own.
+//
+// The JSON form is one object per line:
+//   {"name":"BSKV3P 35K","instanceId":"BTHLE\\DEV_...","source":"BTHLE",
+//    "connected":true,"batteryLevel":80,
+//    "match":{"kind":"namePattern","index":0,"rule":"BSK*"}}
+// source is the enumerator that listed the device (null for a recording);
+// batteryLevel is null without a reading; match is null when no rule
+// matches, otherwise kind is "namePattern" or "device", index points into
+// namePatterns or devices, and rule is the pattern or the entry's name.
+namespace Discovery {
+    // One device as a JSON line (with the newline); source empty: null
+    std::string toJson(const DeviceMonitor::Discovered& device, std::string_view source, const Config& config);
+    // One device as a line of text, like `--status`, plus its source and
+    // the matching rule
+    std::string toText(const DeviceMonitor::Discovered& device, std::string_view source, const Config& config);
+
+    // Load the config (defaults if it is missing, defaults and a warning if
+    // it is invalid), then write each device through onOutput once its
+    // sources have been enumerated; the text form ends with a count, the
+    // time taken and each source's time. sources: the enumerators behind
+    // backend, if it is a MultiSourceBackend (null otherwise). Returns the
+    // process exit code.
+    int run(std::shared_ptr<DeviceBackend> backend, const MultiSourceBackend* sources,
+            const std::filesystem::path& configPath, bool json,
+            const std::function<void(std::string_view text)>& onOutput,
+            const std::function<void(std::string_view message)>& onWarning);
+}
@@ -0,0 +1,605 @@
+#include "EventLog.h"
+#include "LatencyProbes.h"
+#include "MappedFile.h"
+#include "MemoryAccounting.h"
+#include "ProcessTelemetry.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    using EventLog::Event;
+    using EventLog::Type;
+
+    static_assert((EventLog::RING_CAPACITY & (EventLog::RING_CAPACITY - 1)) == 0,
+                  "RING_CAPACITY must be a power of two");
+
+    constexpr size_t MAX_THREADS = 64;
+    constexpr size_t TEXT_CHUNK = 16;
+    constexpr size_t HEADER_SIZE = sizeof(EventLog::MAGIC) + sizeof(uint32_t);
+    // A ring's fill is checked every this many events; at half full or
+    // more the flush thread is woken
+    constexpr uint32_t FILL_CHECK = EventLog::RING_CAPACITY / 4;
+
+    // One thread's events. The owner advances head, the writer tail; each
+    // only reads the other's index to see how far it may go.
+    struct Ring {
+        explicit Ring(uint8_t thread) : thread(thread) {}
+
+        alignas(64) std::atomic<uint32_t> head = 0;
+        uint32_t cachedTail = 0;                // owner's last look at tail
+        alignas(64) std::atomic<uint32_t> tail = 0;
+        std::atomic<uint64_t> dropped = 0;      // since the writer last looked
+        std::atomic<bool> retired = false;      // the thread has exited
+        const uint8_t thread;
+        Event events[EventLog::RING_CAPACITY];
+    };
+
+    // Claimed with a compare-exchange, so registering a thread takes no lock
+    std::array<std::atomic<Ring*>, MAX_THREADS> rings = {};
+    std::atomic<uint32_t> threadCount = 0;
+    std::atomic<uint64_t> totalDropped = 0;
+    std::atomic<size_t> ringBytes = 0;          // rings allocated and not yet freed
+
+    thread_local Ring* currentRing = nullptr;
+    thread_local bool unregistered = false;     // no ring slot was free
+
+    // Marks the thread's ring for the writer to drain and free
+    struct ThreadExit {
+        ~ThreadExit() {
+            if (currentRing) currentRing->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    Ring* attach() {
+        if (unregistered) return nullptr;
+        thread_local ThreadExit retireOnExit;
+        (void)retireOnExit;
+
+        uint32_t number = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        auto ring = std::make_unique<Ring>(static_cast<uint8_t>(number));
+        for (auto& slot : rings) {
+            Ring* expected = nullptr;
+            if (slot.compare_exchange_strong(expected, ring.get(), std::memory_order_acq_rel)) {
+                currentRing = ring.release();
+                ringBytes.fetch_add(sizeof(Ring), std::memory_order_relaxed);
+                return currentRing;
+            }
+        }
+        unregistered = true;
+        return nullptr;
+    }
+
+    // Everything below belongs to whoever holds writerMutex (the flush
+    // thread, or flush()/start()/stop() callers)
+    std::mutex writerMutex;
+    std::FILE* file = nullptr;
+    std::filesystem::path filePath;
+    uint64_t fileLimit = EventLog::DEFAULT_MAX_FILE_BYTES;
+    uint64_t fileSize = 0;
+    // Texts logged for each device, repeated at the top of every new file
+    std::unordered_map<uint32_t, std::array<std::string, 2>> deviceTexts;
+    std::atomic<size_t> textBytes = 0;          // deviceTexts' heap, for memoryUsage()
+
+    std::thread flusher;
+    std::mutex wakeMutex;
+    std::condition_variable wakeup;
+    bool stopRequested = false;
+    bool flushRequested = false;
+
+    void wakeFlusher() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            flushRequested = true;
+        }
+        wakeup.notify_one();
+    }
+
+    std::string_view header() {
+        static const std::array<char, HEADER_SIZE> bytes = [] {
+            std::array<char, HEADER_SIZE> value;
+            uint32_t version = EventLog::FORMAT_VERSION;
+            std::memcpy(value.data(), EventLog::MAGIC, sizeof(EventLog::MAGIC));
+            std::memcpy(value.data() + sizeof(EventLog::MAGIC), &version, sizeof(version));
+            return value;
+        }();
+        return std::string_view(bytes.data(), bytes.size());
+    }
+
+    int64_t unixNanoseconds() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    int64_t processId() {
+#ifdef _WIN32
+        return static_cast<int64_t>(GetCurrentProcessId());
+#else
+        return static_cast<int64_t>(getpid());
+#endif
+    }
+
+    std::FILE* openFile(const std::filesystem::path& path, bool append) {
+#ifdef _WIN32
+        return _wfopen(path.c_str(), append ? L"ab" : L"wb");
+#else
+        return std::fopen(path.c_str(), append ? "ab" : "wb");
+#endif
+    }
+
+    // Apply one text chunk to the text it belongs to
+    void applyChunk(std::string& text, const Event& event) {
+        char chunk[TEXT_CHUNK];
+        std::memcpy(chunk, &event.a, sizeof(event.a));
+        std::memcpy(chunk + sizeof(event.a), &event.b, sizeof(event.b));
+        size_t length = 0;
+        while (length < TEXT_CHUNK && chunk[length] != '\0') length++;
+        text.resize(std::min<size_t>(event.aux, text.size()));
+        text.append(chunk, length);
+    }
+
+    bool isText(Type type) {
+        return type == Type::DEVICE_NAME || type == Type::DEVICE_ID;
+    }
+
+    // Text chunks of a name or instance ID, handed to emit(offset, a, b);
+    // an empty text is one empty chunk
+    template<typename Emit>
+    void forEachChunk(std::string_view text, Emit&& emit) {
+        text = text.substr(0, EventLog::MAX_TEXT);
+        for (size_t offset = 0; offset == 0 || offset < text.size(); offset += TEXT_CHUNK) {
+            char chunk[TEXT_CHUNK] = {};
+            size_t length = std::min(TEXT_CHUNK, text.size() - std::min(offset, text.size()));
+            if (length > 0) std::memcpy(chunk, text.data() + offset, length);
+            int64_t a;
+            int64_t b;
+            std::memcpy(&a, chunk, sizeof(a));
+            std::memcpy(&b, chunk + sizeof(a), sizeof(b));
+            emit(static_cast<uint16_t>(offset), a, b);
+        }
+    }
+
+    bool writeRaw(const Event* events, size_t count) {
+        if (count == 0) return true;
+        bool written = std::fwrite(events, sizeof(Event), count, file) == count;
+        fileSize += count * sizeof(Event);
+        return written;
+    }
+
+    void repeatTexts() {
+        std::vector<Event> events;
+        int64_t time = unixNanoseconds();
+        for (const auto& [device, texts] : deviceTexts) {
+            for (Type type : {Type::DEVICE_NAME, Type::DEVICE_ID}) {
+                forEachChunk(texts[type == Type::DEVICE_NAME ? 0 : 1], [&](uint16_t offset, int64_t a, int64_t b) {
+                    events.push_back({static_cast<uint64_t>(time), device, type, 0, offset, a, b});
+                });
+            }
+        }
+        writeRaw(events.data(), events.size());
+    }
+
+    void beginFile() {
+        std::fwrite(header().data(), 1, HEADER_SIZE, file);
+        fileSize = HEADER_SIZE;
+    }
+
+    // Continue in a new file, which repeats the names of every device
+    void rotate() {
+        if (file) std::fclose(file);
+        std::filesystem::path previous = filePath;
+        previous += ".1";
+        std::error_code error;
+        std::filesystem::remove(previous, error);
+        std::filesystem::rename(filePath, previous, error);
+        file = openFile(filePath, false);
+        if (file) {
+            beginFile();
+            repeatTexts();
+        }
+    }
+
+    // Events already converted to Unix time
+    void write(const Event* events, size_t count) {
+        if (!file) return;
+        if (fileSize > HEADER_SIZE && fileSize + count * sizeof(Event) > fileLimit) {
+            rotate();
+            if (!file) return;
+        }
+        bool textsChanged = false;
+        for (size_t i = 0; i < count; i++) {
+            if (isText(events[i].type)) {
+                applyChunk(deviceTexts[events[i].device][events[i].type == Type::DEVICE_NAME ? 0 : 1], events[i]);
+                textsChanged = true;
+            }
+        }
+        if (textsChanged) {
+            size_t bytes = MemoryAccounting::hashTableBytes(deviceTexts);
+            for (const auto& [device, texts] : deviceTexts) {
+                bytes += MemoryAccounting::bytesOf(texts[0]) + MemoryAccounting::bytesOf(texts[1]);
+            }
+            textBytes.store(bytes, std::memory_order_relaxed);
+        }
+        writeRaw(events, count);
+    }
+
+    void drain() {
+        std::array<Event, 128> batch;
+        for (auto& slot : rings) {
+            Ring* ring = slot.load(std::memory_order_acquire);
+            if (!ring) continue;
+            // Read before head: a retired ring's last events are then in view
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            uint32_t head = ring->head.load(std::memory_order_acquire);
+            uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+
+            while (tail != head) {
+                size_t count = std::min<size_t>(head - tail, batch.size());
+                for (size_t i = 0; i < count; i++) {
+                    batch[i] = ring->events[(tail + i) & (EventLog::RING_CAPACITY - 1)];
+                }
+                tail += static_cast<uint32_t>(count);
+                ring->tail.store(tail, std::memory_order_release);
+
+                // Every copied event was stamped before these reads
+                uint64_t ticks = LatencyProbes::now();
+                int64_t unix = unixNanoseconds();
+                for (size_t i = 0; i < count; i++) {
+                    batch[i].time = static_cast<uint64_t>(
+                        unix - static_cast<int64_t>(LatencyProbes::elapsedNanoseconds(batch[i].time, ticks)));
+                }
+                write(batch.data(), count);
+            }
+
+            uint64_t lost = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (lost > 0) {
+                totalDropped.fetch_add(lost, std::memory_order_relaxed);
+                Event event = {static_cast<uint64_t>(unixNanoseconds()), EventLog::NO_DEVICE, Type::DROPPED,
+                               ring->thread, 0, static_cast<int64_t>(lost), 0};
+                write(&event, 1);
+            }
+            if (retired) {
+                slot.store(nullptr, std::memory_order_release);
+                delete ring;
+                ringBytes.fetch_sub(sizeof(Ring), std::memory_order_relaxed);
+            }
+        }
+        if (file) std::fflush(file);
+    }
+
+    // Sleeps until there is something to write; stop() drains the rest
+    void flushLoop() {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        while (true) {
+            wakeup.wait(lock, [] { return stopRequested || flushRequested; });
+            if (stopRequested) return;
+            flushRequested = false;
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::LogFlush);
+            lock.unlock();
+            EventLog::flush();
+            lock.lock();
+        }
+    }
+
+    // Civil date from days since 1970-01-01 (proleptic Gregorian)
+    void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+        unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        unsigned monthIndex = (5 * dayOfYear + 2) / 153;
+        day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+        month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+        year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2 ? 1 : 0);
+    }
+
+    void appendNumber(std::string& out, int64_t value) {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    void appendMilliseconds(std::string& out, int64_t nanoseconds) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.3f ms", static_cast<double>(nanoseconds) / 1e6);
+        out += buffer;
+    }
+}
+
+std::filesystem::path EventLog::pathFor(const std::filesystem::path& configPath) {
+    return configPath.parent_path() / "events.rzlog";
+}
+
+bool EventLog::start(const std::filesystem::path& path, uint64_t maxFileBytes) {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        filePath = path;
+        fileLimit = std::max<uint64_t>(maxFileBytes, HEADER_SIZE + 64 * sizeof(Event));
+
+        // Keep appending to a log of ours that still has room
+        bool append = false;
+        {
+            MappedFile existing(path);
+            std::string_view contents = existing.contents();
+            append = contents.size() >= HEADER_SIZE && contents.size() < fileLimit &&
+                     contents.substr(0, HEADER_SIZE) == header();
+            fileSize = contents.size();
+        }
+        if (fileSize >= fileLimit) {
+            std::filesystem::path previous = path;
+            previous += ".1";
+            std::error_code error;
+            std::filesystem::remove(previous, error);
+            std::filesystem::rename(path, previous, error);
+        }
+        file = openFile(path, append);
+        if (!file) {
+            return false;
+        }
+        if (!append) beginFile();
+
+        Event started = {static_cast<uint64_t>(unixNanoseconds()), NO_DEVICE, Type::START, 0, 0, processId(), 0};
+        writeRaw(&started, 1);
+        // START resets the decoder; devices logged before a restart of the
+        // log keep their names
+        repeatTexts();
+        std::fflush(file);
+    }
+
+    if (!currentRing) attach();
+    totalDropped.store(0, std::memory_order_relaxed);
+    stopRequested = false;
+    flushRequested = false;
+    logging.store(true, std::memory_order_release);
+    flusher = std::thread(flushLoop);
+    return true;
+}
+
+void EventLog::stop() {
+    logging.store(false, std::memory_order_release);
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopRequested = true;
+        }
+        wakeup.notify_one();
+        flusher.join();
+    }
+
+    std::lock_guard<std::mutex> lock(writerMutex);
+    drain();
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
+
+void EventLog::flush() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    drain();
+}
+
+void EventLog::requestFlush() {
+    if (enabled()) wakeFlusher();
+}
+
+uint64_t EventLog::dropped() {
+    // Rings are only freed under writerMutex
+    std::lock_guard<std::mutex> lock(writerMutex);
+    uint64_t total = totalDropped.load(std::memory_order_relaxed);
+    for (const auto& slot : rings) {
+        if (Ring* ring = slot.load(std::memory_order_acquire)) total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+size_t EventLog::memoryUsage() {
+    return ringBytes.load(std::memory_order_relaxed) + textBytes.load(std::memory_order_relaxed);
+}
+
+void EventLog::record(Type type, uint32_t device, int64_t a, int64_t b, uint16_t aux) {
+    Ring* ring = currentRing ? currentRing : attach();
+    if (!ring) {
+        totalDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint32_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->cachedTail >= RING_CAPACITY) {
+        ring->cachedTail = ring->tail.load(std::memory_order_acquire);
+        if (head - ring->cachedTail >= RING_CAPACITY) {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    Event& event = ring->events[head & (RING_CAPACITY - 1)];
+    event.time = LatencyProbes::now();
+    event.device = device;
+    event.type = type;
+    event.thread = ring->thread;
+    event.aux = aux;
+    event.a = a;
+    event.b = b;
+    ring->head.store(head + 1, std::memory_order_release);
+
+    // Between refreshes nothing else wakes the flush thread
+    if (((head + 1) & (FILL_CHECK - 1)) == 0) {
+        ring->cachedTail = ring->tail.load(std::memory_order_acquire);
+        if (head + 1 - ring->cachedTail >= RING_CAPACITY / 2) wakeFlusher();
+    }
+}
+
+void EventLog::recordText(Type type, uint32_t device, std::string_view text) {
+    forEachChunk(text, [&](uint16_t offset, int64_t a, int64_t b) {
+        record(type, device, a, b, offset);
+    });
+}
+
+bool EventLog::Decoder::decode(std::string_view contents, std::string& out) {
+    if (contents.size() < HEADER_SIZE || contents.substr(0, HEADER_SIZE) != header()) {
+        return false;
+    }
+
+    for (size_t offset = HEADER_SIZE; offset + sizeof(Event) <= contents.size(); offset += sizeof(Event)) {
+        Event event;
+        std::memcpy(&event, contents.data() + offset, sizeof(event));
+        eventCount++;
+        typeCounts[static_cast<uint8_t>(event.type) & 15]++;
+
+        if (isText(event.type)) {
+            Device& device = devices[event.device];
+            applyChunk(event.type == Type::DEVICE_NAME ? device.name : device.instanceId, event);
+            continue;
+        }
+        if (event.type == Type::SEEN) {
+            scanning.push_back(event.device);
+            continue;
+        }
+
+        appendTime(out, event.time);
+        out += " t";
+        appendNumber(out, event.thread);
+        out += ' ';
+
+        switch (event.type) {
+            case Type::START:
+                // A new process: its handles mean other devices
+                out += "log started (process ";
+                appendNumber(out, event.a);
+                out += ")\n";
+                devices.clear();
+                lastScan.clear();
+                scanning.clear();
+                break;
+            case Type::SCAN: {
+                out += "scan: ";
+                appendNumber(out, event.b);
+                out += " devices in ";
+                appendMilliseconds(out, event.a);
+                out += '\n';
+                std::sort(scanning.begin(), scanning.end());
+                scanning.erase(std::unique(scanning.begin(), scanning.end()), scanning.end());
+                for (uint32_t device : scanning) {
+                    if (!std::binary_search(lastScan.begin(), lastScan.end(), device)) {
+                        out += "    + ";
+                        appendDevice(out, device);
+                        out += '\n';
+                    }
+                }
+                for (uint32_t device : lastScan) {
+                    if (!std::binary_search(scanning.begin(), scanning.end(), device)) {
+                        out += "    - ";
+                        appendDevice(out, device);
+                        out += " (gone)\n";
+                    }
+                }
+                lastScan.swap(scanning);
+                scanning.clear();
+                break;
+            }
+            case Type::STATE:
+                appendDevice(out, event.device);
+                if (event.a >= 0) {
+                    out += ": ";
+                    appendNumber(out, event.a);
+                    out += "%, ";
+                } else {
+                    out += ": no level, ";
+                }
+                out += event.b != 0 ? "connected\n" : "disconnected\n";
+                break;
+            case Type::QUERY_FAILED:
+                appendDevice(out, event.device);
+                out += static_cast<Failure>(event.a) == Failure::NOT_PRESENT ? ": query failed (device not present)\n"
+                                                                             : ": query failed (no battery level)\n";
+                break;
+            case Type::REFRESH:
+                out += "refresh: ";
+                appendNumber(out, event.b);
+                out += " devices in ";
+                appendMilliseconds(out, event.a);
+                out += '\n';
+                break;
+            case Type::ALERT:
+                appendDevice(out, event.device);
+                out += ": alert rule ";
+                appendNumber(out, event.a);
+                if (event.b >= 0) {
+                    out += " at ";
+                    appendNumber(out, event.b);
+                    out += '%';
+                }
+                out += '\n';
+                break;
+            case Type::DROPPED:
+                lostCount += static_cast<uint64_t>(event.a);
+                appendNumber(out, event.a);
+                out += " events lost (ring full)\n";
+                break;
+            default:
+                out += "unknown event type ";
+                appendNumber(out, static_cast<uint8_t>(event.type));
+                out += '\n';
+                break;
+        }
+    }
+    return true;
+}
+
+// "2026-01-31 12:34:56.123456789Z"; the date and time of day are formatted
+// once per second
+void EventLog::Decoder::appendTime(std::string& out, uint64_t unixNanoseconds) {
+    int64_t seconds = static_cast<int64_t>(unixNanoseconds / 1000000000);
+    if (seconds != prefixSecond) {
+        int64_t year;
+        unsigned month;
+        unsigned day;
+        civilFromDays(seconds / 86400, year, month, day);
+        int64_t secondOfDay = seconds % 86400;
+        char buffer[48];
+        std::snprintf(buffer, sizeof(buffer), "%04lld-%02u-%02u %02lld:%02lld:%02lld.",
+                      static_cast<long long>(year), month, day, static_cast<long long>(secondOfDay / 3600),
+                      static_cast<long long>(secondOfDay / 60 % 60), static_cast<long long>(secondOfDay % 60));
+        secondPrefix = buffer;
+        prefixSecond = seconds;
+    }
+    out += secondPrefix;
+    char fraction[10] = "000000000";
+    uint64_t nanoseconds = unixNanoseconds % 1000000000;
+    for (int digit = 8; digit >= 0 && nanoseconds > 0; digit--) {
+        fraction[digit] = static_cast<char>('0' + nanoseconds % 10);
+        nanoseconds /= 10;
+    }
+    out.append(fraction, 9);
+    out += 'Z';
+}
+
+void EventLog::Decoder::appendDevice(std::string& out, uint32_t device) const {
+    auto known = devices.find(device);
+    if (known == devices.end()) {
+        out += "device #";
+        appendNumber(out, device);
+        return;
+    }
+    out += known->second.name;
+    out += " [";
+    out += known->second.instanceId;
+    out += ']';
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Always-on record of what happened to the devices (events.rzlog next to
+// config.json), for field issues the tray's current state cannot explain:
+// devices that vanished from a scan, levels that stopped changing, queries
+// that keep failing, refreshes that got slow.
+//
+// Events are fixed-size binary records. Each thread that logs gets its own
+// single-producer ring, allocated on its first event; logging one is a
+// clock read and a 32-byte store into that ring, with no lock, allocation
+// or system call. A full ring drops the event and counts it. A background
+// thread drains the rings into the file, converting clock ticks to Unix
+// nanoseconds, when asked to (requestFlush(), after every scan, refresh
+// and alert) or when a ring is half full; otherwise it sleeps, so an idle
+// process has no wakeups for the log. When the file reaches its size cap
+// it is renamed to events.rzlog.1 (replacing the previous one) and a new
+// file is started, so the log never takes more than twice the cap on disk.
+//
+// Devices are identified by the StringId of their instance ID in the
+// logging DeviceMonitor's pool. Their names and instance IDs are logged as
+// text events when first seen, and repeated at the top of every new file so
+// each file decodes on its own. `razertray_headless --decode-log` prints a
+// log as text (Decoder).
+//
+// File layout (little-endian): MAGIC, FORMAT_VERSION (u32), then Events.
+namespace EventLog {
+    constexpr char MAGIC[4] = {'R', 'Z', 'L', 'G'};
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr size_t RING_CAPACITY = 1024;              // events per thread (power of two)
+    constexpr uint64_t DEFAULT_MAX_FILE_BYTES = 1024 * 1024;
+    constexpr uint32_t NO_DEVICE = UINT32_MAX;
+    constexpr size_t MAX_TEXT = 256;                    // bytes of a name or instance ID kept
+
+    enum class Type : uint8_t {
+        START = 1,          // a = process ID
+        DEVICE_NAME = 2,    // text chunk (see Event)
+        DEVICE_ID = 3,      // text chunk
+        SEEN = 4,           // device matched by a scan
+        SCAN = 5,           // a = duration (ns), b = devices matched
+        STATE = 6,          // a = level (-1: none), b = connected
+        QUERY_FAILED = 7,   // a = Failure
+        REFRESH = 8,        // a = duration (ns), b = devices read
+        DROPPED = 9,        // a = events this thread lost to a full ring
+        ALERT = 10,         // a = alert rule (index into config alerts), b = level (-1: none)
+    };
+
+    enum class Failure : int64_t {
+        NOT_PRESENT = 1,    // the device node was gone
+        NO_LEVEL = 2,       // connected, but no (or an out-of-range) battery level
+    };
+
+    // One record. Text events carry 16 bytes of UTF-8 in a and b, chunk
+    // starts at byte offset `aux` of the text; a shorter last chunk is
+    // zero-padded.
+    struct Event {
+        uint64_t time;      // platform ticks in the ring, Unix nanoseconds in the file
+        uint32_t device;    // StringId of the instance ID, or NO_DEVICE
+        Type type;
+        uint8_t thread;     // logging thread, numbered from 1 in order of first event
+        uint16_t aux;
+        int64_t a;
+        int64_t b;
+    };
+    static_assert(sizeof(Event) == 32, "events are written as they are laid out");
+
+    inline std::atomic<bool> logging = false;
+
+    inline bool enabled() { return logging.load(std::memory_order_relaxed); }
+
+    // config.json -> events.rzlog in the same directory
+    std::filesystem::path pathFor(const std::filesystem::path& configPath);
+
+    // Append to path (starting a new file if it is not a log or already
+    // over the cap) and start the flush thread; false if the file cannot be
+    // opened. The calling thread's ring is allocated here, so its first
+    // event does not allocate.
+    bool start(const std::filesystem::path& path, uint64_t maxFileBytes = DEFAULT_MAX_FILE_BYTES);
+    // Write everything logged so far and stop the flush thread
+    void stop();
+    // Write everything logged so far now (returns once it is in the file)
+    void flush();
+    // Have the flush thread write everything logged so far; returns at once
+    // (takes the flush thread's wake lock, no allocation)
+    void requestFlush();
+
+    // Events lost to full rings since start()
+    uint64_t dropped();
+
+    // Bytes held by the rings and the device texts (MemoryAccounting);
+    // lock-free, as of the last write
+    size_t memoryUsage();
+
+    // Record an event (when enabled()); lock-free and allocation-free after
+    // the thread's first event, except that every RING_CAPACITY / 4 events
+    // a ring found half full wakes the flush thread
+    void record(Type type, uint32_t device, int64_t a = 0, int64_t b = 0, uint16_t aux = 0);
+    // Record text as DEVICE_NAME / DEVICE_ID chunks (up to MAX_TEXT bytes)
+    void recordText(Type type, uint32_t device, std::string_view text);
+
+    inline void log(Type type, uint32_t device, int64_t a = 0, int64_t b = 0) {
+        if (enabled()) record(type, device, a, b);
+    }
+
+    // Log files as text: a line per scan (with the devices that appeared or
+    // vanished), refresh, state change, failed query, alert, start and loss of
+    // events. State (device names, the last scan) carries over from one decode() to the next, so a rotated file
+    // followed by its successor reads as one log.
+    class Decoder {
+    public:
+        // Append the events of one file's contents; false if it is not an
+        // event log (nothing is appended)
+        bool decode(std::string_view contents, std::string& out);
+
+        // Events decoded so far, in all and of one type
+        uint64_t events() const { return eventCount; }
+        uint64_t count(Type type) const { return typeCounts[static_cast<uint8_t>(type) & 15]; }
+        // Events the logging threads lost to full rings (DROPPED)
+        uint64_t lost() const { return lostCount; }
+
+    private:
+        struct Device {
+            std::string name;
+            std::string instanceId;
+        };
+
+        void appendTime(std::string& out, uint64_t unixNanoseconds);
+        void appendDevice(std::string& out, uint32_t device) const;
+
+        std::unordered_map<uint32_t, Device> devices;
+        std::vector<uint32_t> lastScan;     // sorted
+        std::vector<uint32_t> scanning;     // SEEN since the last SCAN
+        uint64_t eventCount = 0;
+        uint64_t typeCounts[16] = {};
+        uint64_t lostCount = 0;
+        int64_t prefixSecond = -1;
+        std::string secondPrefix;           // "YYYY-MM-DD hh:mm:ss." of prefixSecond
+    };
+}
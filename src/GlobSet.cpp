@@ -0,0 +1,271 @@
+#include "GlobSet.h"
+#include "MemoryAccounting.h"
+#include <algorithm>
+#include <atomic>
+
+namespace {
+    bool isContinuation(uint8_t b) { return (b & 0xC0) == 0x80; }
+
+    std::atomic<uint64_t> nextGlobSetId{1};
+}
+
+std::array<uint8_t, 256> GlobSet::foldTable(bool ignoreCase) {
+    std::array<uint8_t, 256> table;
+    for (int b = 0; b < 256; b++) {
+        table[b] = (ignoreCase && b >= 'A' && b <= 'Z')
+            ? static_cast<uint8_t>(b - 'A' + 'a')
+            : static_cast<uint8_t>(b);
+    }
+    return table;
+}
+
+GlobSet::GlobSet(const std::vector<std::string>& globs, bool ignoreCase)
+    : id(nextGlobSetId.fetch_add(1, std::memory_order_relaxed))
+    , fold(foldTable(ignoreCase))
+{
+    std::vector<std::map<uint8_t, uint32_t>> children;
+    newNode();
+    children.emplace_back();
+    for (size_t i = 0; i < globs.size(); i++) {
+        addGlob(globs[i], static_cast<uint32_t>(i), children);
+    }
+
+    // Flatten the build-time maps into one sorted edge array
+    for (size_t i = 0; i < nodes.size(); i++) {
+        nodes[i].firstEdge = static_cast<uint32_t>(edges.size());
+        nodes[i].edgeCount = static_cast<uint32_t>(children[i].size());
+        for (const auto& [byte, target] : children[i]) {
+            edges.push_back({byte, {}, target});
+        }
+    }
+}
+
+uint32_t GlobSet::newNode() {
+    nodes.emplace_back();
+    return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void GlobSet::addGlob(std::string_view glob, uint32_t index,
+                      std::vector<std::map<uint8_t, uint32_t>>& children) {
+    uint32_t node = 0;
+    for (char ch : glob) {
+        uint8_t c = static_cast<uint8_t>(ch);
+
+        if (c == '*') {
+            // "**" is the same as "*"
+            if (nodes[node].isStar) continue;
+            if (nodes[node].starChild == NONE) {
+                uint32_t star = newNode();
+                children.emplace_back();
+                nodes[star].isStar = true;
+                nodes[node].starChild = static_cast<int32_t>(star);
+            }
+            node = static_cast<uint32_t>(nodes[node].starChild);
+        } else if (c == '?') {
+            if (nodes[node].anyChild == NONE) {
+                uint32_t any = newNode();
+                // Helpers waiting for 1, 2 or 3 more continuation bytes of a
+                // multi-byte character before reaching the '?' target
+                uint32_t lead = newNode();
+                newNode();
+                newNode();
+                children.resize(nodes.size());
+                nodes[lead].continuation = static_cast<int32_t>(any);
+                nodes[lead + 1].continuation = static_cast<int32_t>(lead);
+                nodes[lead + 2].continuation = static_cast<int32_t>(lead + 1);
+                nodes[node].anyChild = static_cast<int32_t>(any);
+                nodes[node].anyLead = static_cast<int32_t>(lead);
+            }
+            node = static_cast<uint32_t>(nodes[node].anyChild);
+        } else {
+            uint8_t b = fold[c];
+            auto found = children[node].find(b);
+            if (found == children[node].end()) {
+                uint32_t next = newNode();
+                children.emplace_back();
+                found = children[node].emplace(b, next).first;
+            }
+            node = found->second;
+        }
+    }
+    nodes[node].accept = std::min(nodes[node].accept, index);
+}
+
+int32_t GlobSet::findEdge(const Node& node, uint8_t byte) const {
+    auto begin = edges.begin() + node.firstEdge;
+    auto end = begin + node.edgeCount;
+    auto it = std::lower_bound(begin, end, byte,
+        [](const Edge& edge, uint8_t b) { return edge.byte < b; });
+    return (it != end && it->byte == byte) ? static_cast<int32_t>(it->target) : NONE;
+}
+
+void GlobSet::addClosure(uint32_t node, std::vector<uint32_t>& set, Cache& cache) const {
+    while (cache.nodeMark[node] != cache.markGeneration) {
+        cache.nodeMark[node] = cache.markGeneration;
+        set.push_back(node);
+        if (nodes[node].starChild == NONE) break;
+        node = static_cast<uint32_t>(nodes[node].starChild);
+    }
+}
+
+void GlobSet::resetDfa(Cache& cache) const {
+    cache.owner = id;
+    cache.dfaSets.clear();
+    cache.dfaAccept.clear();
+    cache.dfaNext.clear();
+    cache.dfaIndex.clear();
+    cache.nodeMark.assign(nodes.size(), 0);
+    cache.markGeneration = 0;
+
+    std::vector<uint32_t> dead;
+    addDfaState(dead, cache);
+
+    std::vector<uint32_t> start;
+    cache.markGeneration++;
+    addClosure(0, start, cache);
+    addDfaState(start, cache);
+}
+
+uint32_t GlobSet::addDfaState(std::vector<uint32_t>& set, Cache& cache) const {
+    std::sort(set.begin(), set.end());
+    auto found = cache.dfaIndex.find(set);
+    if (found != cache.dfaIndex.end()) {
+        return found->second;
+    }
+
+    uint32_t accept = NO_MATCH;
+    for (uint32_t node : set) {
+        accept = std::min(accept, nodes[node].accept);
+    }
+
+    uint32_t state = static_cast<uint32_t>(cache.dfaSets.size());
+    cache.dfaIndex.emplace(set, state);
+    cache.dfaSets.push_back(set);
+    cache.dfaAccept.push_back(accept);
+    cache.dfaNext.resize(cache.dfaNext.size() + 256, UNKNOWN);
+    return state;
+}
+
+uint32_t GlobSet::computeTransition(uint32_t state, uint8_t byte, Cache& cache) const {
+    std::vector<uint32_t>& next = cache.scratchSet;
+    next.clear();
+    cache.markGeneration++;
+
+    for (uint32_t node : cache.dfaSets[state]) {
+        const Node& n = nodes[node];
+
+        if (n.isStar) {
+            addClosure(node, next, cache);
+        }
+        if (n.continuation != NONE) {
+            if (isContinuation(byte)) addClosure(static_cast<uint32_t>(n.continuation), next, cache);
+            continue;
+        }
+        int32_t target = findEdge(n, byte);
+        if (target != NONE) {
+            addClosure(static_cast<uint32_t>(target), next, cache);
+        }
+        if (n.anyChild != NONE) {
+            // '?' consumes one whole UTF-8 character
+            if (byte < 0x80) {
+                addClosure(static_cast<uint32_t>(n.anyChild), next, cache);
+            } else if ((byte & 0xE0) == 0xC0) {
+                addClosure(static_cast<uint32_t>(n.anyLead), next, cache);
+            } else if ((byte & 0xF0) == 0xE0) {
+                addClosure(static_cast<uint32_t>(n.anyLead + 1), next, cache);
+            } else if ((byte & 0xF8) == 0xF0) {
+                addClosure(static_cast<uint32_t>(n.anyLead + 2), next, cache);
+            }
+        }
+    }
+
+    if (cache.dfaSets.size() >= MAX_DFA_STATES) {
+        // Cache is full: start over. The new state is still valid, only the
+        // transition into it is not recorded.
+        std::vector<uint32_t> pending = std::move(next);
+        resetDfa(cache);
+        return addDfaState(pending, cache);
+    }
+
+    uint32_t nextState = addDfaState(next, cache);
+    cache.dfaNext[state * 256 + byte] = static_cast<int32_t>(nextState);
+    return nextState;
+}
+
+uint32_t GlobSet::run(std::string_view text, Cache& cache) const {
+    if (cache.owner != id) {
+        resetDfa(cache);
+    }
+
+    uint32_t state = START_STATE;
+    for (char ch : text) {
+        uint8_t byte = fold[static_cast<uint8_t>(ch)];
+        int32_t next = cache.dfaNext[state * 256 + byte];
+        state = next != UNKNOWN ? static_cast<uint32_t>(next) : computeTransition(state, byte, cache);
+        if (state == DEAD_STATE) {
+            break;
+        }
+    }
+    return state;
+}
+
+uint32_t GlobSet::match(std::string_view text, Cache& cache) const {
+    return cache.dfaAccept[run(text, cache)];
+}
+
+void GlobSet::matchAll(std::string_view text, std::vector<uint32_t>& indices, Cache& cache) const {
+    indices.clear();
+    uint32_t state = run(text, cache);
+    if (cache.dfaAccept[state] == NO_MATCH) {
+        return;
+    }
+    for (uint32_t node : cache.dfaSets[state]) {
+        if (nodes[node].accept != NO_MATCH) {
+            indices.push_back(nodes[node].accept);
+        }
+    }
+}
+
+void GlobSet::serialize(BinaryIO::Writer& out) const {
+    out.write(fold);
+    out.writeArray(nodes);
+    out.writeArray(edges);
+}
+
+std::optional<GlobSet> GlobSet::deserialize(BinaryIO::Reader& in) {
+    GlobSet set({}, false);
+    if (!in.read(set.fold) || !in.readArray(set.nodes) || !in.readArray(set.edges) || set.nodes.empty()) {
+        return std::nullopt;
+    }
+
+    const size_t nodeCount = set.nodes.size();
+    auto validLink = [&](int32_t link, size_t span) {
+        return link == NONE || (link >= 0 && static_cast<size_t>(link) + span < nodeCount);
+    };
+    for (const Node& node : set.nodes) {
+        if (static_cast<uint64_t>(node.firstEdge) + node.edgeCount > set.edges.size() ||
+            !validLink(node.anyChild, 0) || !validLink(node.anyLead, 2) ||
+            !validLink(node.starChild, 0) || !validLink(node.continuation, 0)) {
+            return std::nullopt;
+        }
+    }
+    for (const Edge& edge : set.edges) {
+        if (edge.target >= nodeCount) {
+            return std::nullopt;
+        }
+    }
+    return set;
+}
+
+size_t GlobSet::memoryUsage() const {
+    return MemoryAccounting::bytesOf(nodes) + MemoryAccounting::bytesOf(edges);
+}
+
+size_t GlobSet::Cache::memoryUsage() const {
+    size_t bytes = MemoryAccounting::bytesOf(dfaSets) + MemoryAccounting::bytesOf(dfaAccept) +
+                   MemoryAccounting::bytesOf(dfaNext) + MemoryAccounting::treeBytes(dfaIndex) +
+                   MemoryAccounting::bytesOf(nodeMark) + MemoryAccounting::bytesOf(scratchSet);
+    for (const auto& set : dfaSets) bytes += MemoryAccounting::bytesOf(set);
+    for (const auto& [set, state] : dfaIndex) bytes += MemoryAccounting::bytesOf(set);
+    return bytes;
+}
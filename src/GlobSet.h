@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "BinaryIO.h"
+
+// A set of full-match globs (`*` = any run of characters, `?` = one UTF-8
+// character) compiled into one automaton.
+//
+// The globs are merged into a trie-shaped NFA over pattern tokens, so globs
+// sharing a prefix share states, and the NFA is determinized lazily while
+// matching: each input byte costs one table lookup once its transition has
+// been seen. The DFA is bounded; when full it is flushed and rebuilt from the
+// state matching is currently in.
+//
+// The compiled NFA is immutable and can be shared between threads; the
+// lazily built DFA lives in a Cache owned by each caller. A cache remembers
+// which GlobSet it was built for and starts over when used with another one.
+class GlobSet {
+public:
+    static constexpr uint32_t NO_MATCH = UINT32_MAX;
+
+    class Cache {
+    public:
+        // DFA states built so far (bounded by MAX_DFA_STATES)
+        size_t states() const { return dfaSets.size(); }
+
+        // Bytes held by the DFA and the scratch
+        size_t memoryUsage() const;
+
+    private:
+        friend class GlobSet;
+
+        uint64_t owner = 0;   // GlobSet::id the DFA belongs to
+
+        // State -> sorted NFA node set; 256 transitions per state, UNKNOWN
+        // until first taken
+        std::vector<std::vector<uint32_t>> dfaSets;
+        std::vector<uint32_t> dfaAccept;
+        std::vector<int32_t> dfaNext;
+        std::map<std::vector<uint32_t>, uint32_t> dfaIndex;
+
+        // Scratch for computeTransition (marks NFA nodes already in the set)
+        std::vector<uint32_t> nodeMark;
+        uint32_t markGeneration = 0;
+        std::vector<uint32_t> scratchSet;
+    };
+
+    GlobSet(const std::vector<std::string>& globs, bool ignoreCase);
+
+    // Bytes held by the compiled NFA
+    size_t memoryUsage() const;
+
+    // Lowest index of a glob matching the whole text, or NO_MATCH
+    uint32_t match(std::string_view text, Cache& cache) const;
+
+    // Indices of all matching globs (identical globs report the lowest index)
+    void matchAll(std::string_view text, std::vector<uint32_t>& indices, Cache& cache) const;
+
+    // Byte mapping applied to patterns and input: identity, or ASCII A-Z to
+    // a-z. Device names are overwhelmingly ASCII, so that is all we fold.
+    static std::array<uint8_t, 256> foldTable(bool ignoreCase);
+
+    // Compiled NFA as flat arrays (see ConfigCache); deserialize checks that
+    // every link stays in range and returns nullopt otherwise
+    void serialize(BinaryIO::Writer& out) const;
+    static std::optional<GlobSet> deserialize(BinaryIO::Reader& in);
+
+private:
+    static constexpr int32_t NONE = -1;
+
+    // Transitions on literal bytes live in edges[] (sorted per node); '?' and
+    // '*' get dedicated links
+    // Written to config.cache as is, so padding is explicit and zero
+    struct Edge {
+        uint8_t byte;
+        uint8_t padding[3];
+        uint32_t target;
+    };
+
+    struct Node {
+        uint32_t firstEdge = 0;
+        uint32_t edgeCount = 0;
+        int32_t anyChild = NONE;       // after '?'
+        int32_t anyLead = NONE;        // first of three helpers for multi-byte '?'
+        int32_t starChild = NONE;      // after '*', entered without consuming input
+        int32_t continuation = NONE;   // helper: next continuation byte leads here
+        bool isStar = false;           // loops on any byte
+        uint8_t padding[3] = {};
+        uint32_t accept = NO_MATCH;    // lowest glob index ending here
+    };
+
+    static constexpr size_t MAX_DFA_STATES = 2048;
+    static constexpr uint32_t DEAD_STATE = 0;
+    static constexpr uint32_t START_STATE = 1;
+    static constexpr int32_t UNKNOWN = -1;
+
+    void addGlob(std::string_view glob, uint32_t index,
+                 std::vector<std::map<uint8_t, uint32_t>>& children);
+    uint32_t newNode();
+    int32_t findEdge(const Node& node, uint8_t byte) const;
+
+    // Add a node and everything reachable from it without input
+    void addClosure(uint32_t node, std::vector<uint32_t>& set, Cache& cache) const;
+
+    void resetDfa(Cache& cache) const;
+    uint32_t addDfaState(std::vector<uint32_t>& set, Cache& cache) const;
+    uint32_t computeTransition(uint32_t state, uint8_t byte, Cache& cache) const;
+
+    // DFA state after consuming the whole text
+    uint32_t run(std::string_view text, Cache& cache) const;
+
+    uint64_t id;                     // identifies the compiled NFA for caches
+    std::array<uint8_t, 256> fold;
+
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+};
@@ -0,0 +1,288 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ConfigManager.h"
+#include "DeviceStateCache.h"
+#include "Discovery.h"
+#include "EventLog.h"
+#include "HeadlessService.h"
+#include "MappedFile.h"
+#include "MultiSourceBackend.h"
+#include "RecordingBackend.h"
+#include "ReplayBackend.h"
+#include "StatusSegment.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include "SetupApiBackend.h"
+#include "Utf8.h"
+#else
+#include <signal.h>
+#include "SysfsBackend.h"
+#endif
+
+// razertray_headless - the device engine without the tray (HeadlessService):
+// console entry point for Windows and Linux
+
+namespace {
+    // The running service, for the stop handlers
+    HeadlessService* activeService = nullptr;
+
+#ifdef _WIN32
+    BOOL WINAPI onConsoleControl(DWORD) {
+        if (activeService) activeService->stop();
+        return TRUE;
+    }
+#else
+    void onStopSignal(int) {
+        if (activeService) activeService->stop();
+    }
+#endif
+
+    void printUsage(FILE* out) {
+        std::fputs("Usage: razertray_headless [options]\n"
+                   "  (no options)         refresh devices every refreshInterval and publish them\n"
+                   "                       (status segment, metricsPort, devices.cache), log\n"
+                   "                       device events (events.rzlog) and print the config's\n"
+                   "                       alerts until stopped\n"
+                   "  --once [--json]      scan once, print the devices and exit\n"
+                   "  --status [--json]    print the state published by a running instance\n"
+                   "  --discover [--json]  print every device the system reports, its source and\n"
+                   "                       the config rule that matches it, and exit\n"
+                   "  --record <file>      also record every device result (see --replay)\n"
+                   "  --replay <file>      read devices from a recording instead of the system\n"
+                   "  --replay-speed <n>   playback and refresh speed multiplier (default 1)\n"
+                   "  --status-name <name> publish under another status segment name\n"
+                   "  --collect [<address>:]<port>\n"
+                   "                       also receive other machines' devices (config collector)\n"
+                   "                       and export them on the metricsPort endpoint\n"
+                   "  --host-name <name>   push to the collector under this name instead of the\n"
+                   "                       machine's\n"
+                   "  --event-log <file>   log device events to this file instead of events.rzlog\n"
+                   "  --decode-log <file>...\n"
+                   "                       print event logs as text (oldest first, e.g.\n"
+                   "                       events.rzlog.1 events.rzlog) and exit\n",
+                   out);
+    }
+
+    std::filesystem::path toPath(std::string_view utf8) {
+        return std::filesystem::path(std::u8string_view(reinterpret_cast<const char8_t*>(utf8.data()), utf8.size()));
+    }
+
+    // Like `RazerTray --status`; exit code 1 if no instance is running
+    int printStatus(const std::string& name, bool json) {
+        StatusSegment::Reader reader(name);
+        if (!reader.isValid()) {
+            std::fputs("Razer Tray is not running.\n", stderr);
+            return 1;
+        }
+        auto payload = std::make_unique<StatusSegment::Payload>();
+        if (!reader.read(*payload)) {
+            std::fputs("Razer Tray is not responding.\n", stderr);
+            return 1;
+        }
+        std::string text = json ? StatusSegment::toJson(*payload) : StatusSegment::toText(*payload, DeviceStateCache::now());
+        std::fputs(text.c_str(), stdout);
+        return 0;
+    }
+
+    // --decode-log; exit code 1 if a file is missing or not an event log
+    int decodeLogs(const std::vector<std::string>& paths) {
+        EventLog::Decoder decoder;
+        int result = 0;
+        for (const auto& path : paths) {
+            MappedFile file(toPath(path));
+            std::string text;
+            if (!file.isValid() || !decoder.decode(file.contents(), text)) {
+                std::fprintf(stderr, "razertray_headless: %s is not an event log\n", path.c_str());
+                result = 1;
+                continue;
+            }
+            std::fwrite(text.data(), 1, text.size(), stdout);
+        }
+        return result;
+    }
+
+    int run(const std::vector<std::string>& args) {
+        bool once = false;
+        bool status = false;
+        bool discover = false;
+        bool json = false;
+        double replaySpeed = 1.0;
+        std::filesystem::path recordPath;
+        std::filesystem::path replayPath;
+        std::string statusName = StatusSegment::defaultName();
+        std::string collect;
+        std::string hostName;
+        std::filesystem::path eventLogPath;
+        std::vector<std::string> decodePaths;
+
+        for (size_t i = 0; i < args.size(); i++) {
+            std::string_view arg = args[i];
+            bool hasValue = i + 1 < args.size();
+            if (arg == "--once") {
+                once = true;
+            } else if (arg == "--status") {
+                status = true;
+            } else if (arg == "--discover") {
+                discover = true;
+            } else if (arg == "--json") {
+                json = true;
+            } else if (arg == "--record" && hasValue) {
+                recordPath = toPath(args[++i]);
+            } else if (arg == "--replay" && hasValue) {
+                replayPath = toPath(args[++i]);
+            } else if (arg == "--replay-speed" && hasValue) {
+                const char* value = args[++i].c_str();
+                char* end = nullptr;
+                replaySpeed = std::strtod(value, &end);
+                if (end == value || *end != '\0' || !std::isfinite(replaySpeed) || replaySpeed <= 0.0) {
+                    std::fprintf(stderr, "razertray_headless: --replay-speed takes a positive number, not '%s'\n", value);
+                    printUsage(stderr);
+                    return 2;
+                }
+            } else if (arg == "--status-name" && hasValue) {
+                statusName = args[++i];
+            } else if (arg == "--collect" && hasValue) {
+                collect = args[++i];
+            } else if (arg == "--host-name" && hasValue) {
+                hostName = args[++i];
+            } else if (arg == "--event-log" && hasValue) {
+                eventLogPath = toPath(args[++i]);
+            } else if (arg == "--decode-log" && hasValue) {
+                while (i + 1 < args.size()) decodePaths.push_back(args[++i]);
+            } else if (arg == "--help" || arg == "-h") {
+                printUsage(stdout);
+                return 0;
+            } else {
+                std::fprintf(stderr, "razertray_headless: unknown argument '%s'\n", args[i].c_str());
+                printUsage(stderr);
+                return 2;
+            }
+        }
+
+        if (status) {
+            return printStatus(statusName, json);
+        }
+        if (!decodePaths.empty()) {
+            return decodeLogs(decodePaths);
+        }
+
+        std::shared_ptr<DeviceBackend> backend;
+        std::shared_ptr<MultiSourceBackend> sources;   // null when replaying
+        if (!replayPath.empty()) {
+            auto replay = ReplayBackend::open(replayPath);
+            if (!replay) {
+                std::fputs("razertray_headless: the file given to --replay is not a device recording\n", stderr);
+                return 1;
+            }
+            replay->setSpeed(replaySpeed);
+            backend = replay;
+        } else {
+#ifdef _WIN32
+            sources = SetupApiBackend::systemSources();
+#else
+            sources = SysfsBackend::systemSources();
+#endif
+            backend = sources;
+            if (!recordPath.empty()) {
+                auto recorder = std::make_shared<RecordingBackend>(backend, recordPath);
+                if (!recorder->isRecording()) {
+                    std::fputs("razertray_headless: could not create the file given to --record; "
+                               "running without recording\n", stderr);
+                }
+                backend = recorder;
+            }
+        }
+
+        ConfigManager configMgr;
+        if (discover) {
+            // One line at a time, so a reader sees each device as it is found
+            return Discovery::run(
+                backend, sources.get(), configMgr.getDefaultConfigPath(), json,
+                [](std::string_view text) {
+                    std::fwrite(text.data(), 1, text.size(), stdout);
+                    std::fflush(stdout);
+                },
+                [](std::string_view message) {
+                    std::fprintf(stderr, "razertray_headless: %.*s\n", static_cast<int>(message.size()), message.data());
+                });
+        }
+
+        HeadlessService::Options options;
+        options.configPath = configMgr.getDefaultConfigPath();
+        options.statusName = statusName;
+        options.useDeviceCache = replayPath.empty();  // replayed devices are not the real last known state
+        if (!once) {
+            // Likewise their events, unless asked for
+            options.eventLogPath = !eventLogPath.empty() ? eventLogPath
+                                 : replayPath.empty() ? EventLog::pathFor(options.configPath)
+                                 : std::filesystem::path();
+        }
+        options.serve = !once;
+        options.collect = collect;
+        options.hostName = hostName;
+        options.refreshSpeed = replayPath.empty() ? 1.0 : replaySpeed;
+        options.onWarning = [](std::string_view message) {
+            std::fprintf(stderr, "razertray_headless: %.*s\n", static_cast<int>(message.size()), message.data());
+        };
+        if (!once) {
+            // --once prints the devices instead
+            options.onAlert = [](std::string_view message) {
+                std::fprintf(stdout, "alert: %.*s\n", static_cast<int>(message.size()), message.data());
+                std::fflush(stdout);
+            };
+        }
+        HeadlessService service(backend, std::move(options));
+        if (!once && !collect.empty() && !service.collector()) {
+            return 1;  // asked to collect and cannot (already reported)
+        }
+
+        if (once) {
+            service.scan();
+            auto payload = std::make_unique<StatusSegment::Payload>();
+            int64_t now = DeviceStateCache::now();
+            StatusSegment::capture(*payload, service.devices(), service.strings(), now, std::nullopt, service.memoryUsage(),
+                                   ProcessTelemetry::sample());
+            std::string text = json ? StatusSegment::toJson(*payload) : StatusSegment::toText(*payload, now);
+            std::fputs(text.c_str(), stdout);
+            return 0;
+        }
+
+        activeService = &service;
+#ifdef _WIN32
+        SetConsoleCtrlHandler(onConsoleControl, TRUE);
+#else
+        struct sigaction action = {};
+        action.sa_handler = onStopSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        sigaction(SIGHUP, &action, nullptr);
+#endif
+        service.run();
+        activeService = nullptr;
+        return 0;
+    }
+}
+
+#ifdef _WIN32
+int wmain(int argc, wchar_t** argv) {
+    // Device names are printed as UTF-8
+    SetConsoleOutputCP(CP_UTF8);
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        args.push_back(Utf8::fromWide(argv[i]));
+    }
+    return run(args);
+}
+#else
+int main(int argc, char** argv) {
+    return run(std::vector<std::string>(argv + 1, argv + argc));
+}
+#endif
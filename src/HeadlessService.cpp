@@ -0,0 +1,347 @@
+#include "HeadlessService.h"
+#include "AllocationCounter.h"
+#include "DeviceStateCache.h"
+#include "EventLog.h"
+#include "ProcessTelemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+HeadlessService::HeadlessService(std::shared_ptr<DeviceBackend> backend, Options options)
+    : options(std::move(options))
+    , stopping(false)
+    , configChanged(false)
+#ifdef _WIN32
+    , wakeEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr))
+#else
+    , wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+#endif
+{
+    // Same rules as the tray: run on defaults if the file is invalid (and
+    // leave it alone), create it if it is missing
+    ConfigManager configMgr;
+    configStore = std::make_unique<ConfigStore>(this->options.configPath);
+    std::optional<JsonError> error;
+    if (!configStore->reload(error)) {
+        Config defaults = configMgr.getDefaultConfig();
+        if (error.has_value()) {
+            char message[512];
+            std::snprintf(message, sizeof(message), "config.json line %zu, column %zu: %s; using default settings",
+                          error->line, error->column, error->message.c_str());
+            warn(message);
+        } else {
+            configMgr.saveConfig(defaults, configStore->path());
+        }
+        configStore->publish(std::move(defaults));
+    }
+    activeConfig = configStore->current();
+
+    if (this->options.useDeviceCache) {
+        deviceCachePath = DeviceStateCache::pathFor(configStore->path());
+    }
+    if (!this->options.eventLogPath.empty() && !EventLog::start(this->options.eventLogPath)) {
+        warn("could not open the event log; not logging device events");
+    }
+    deviceMonitor = std::make_unique<DeviceMonitor>(std::move(backend), activeConfig->matcher);
+
+    if (this->options.serve) {
+        statusPublisher = std::make_unique<StatusSegment::Publisher>(this->options.statusName);
+        if (!this->options.collect.empty()) {
+            collectorServer = std::make_unique<Collector>(this->options.collect);
+            if (!collectorServer->isListening()) {
+                collectorServer.reset();
+                char message[256];
+                std::snprintf(message, sizeof(message),
+                              "could not receive on %.64s (not [a.b.c.d:]port, or the port is in use); not collecting",
+                              this->options.collect.c_str());
+                warn(message);
+            }
+        }
+        startMetricsServer();
+        startCollectorAgent();
+
+        // Parse edits on the watcher thread; run() applies the snapshot
+        configWatcher = std::make_unique<ConfigWatcher>(configStore->path(), [this]() {
+            std::optional<JsonError> error;
+            if (configStore->reload(error)) {
+                configChanged.store(true, std::memory_order_release);
+                wake();
+            } else if (error.has_value()) {
+                char message[512];
+                std::snprintf(message, sizeof(message),
+                              "config.json line %zu, column %zu: %s; keeping the previous settings",
+                              error->line, error->column, error->message.c_str());
+                warn(message);
+            }
+        });
+        configWatcher->start();
+    }
+}
+
+HeadlessService::~HeadlessService() {
+    configWatcher.reset();
+
+    // Persist the last known state for the next launch
+    saveDeviceState();
+    EventLog::stop();
+
+    // --status reports no instance and scrapes fail from here on
+    statusPublisher.reset();
+    metricsServer.reset();
+    collectorAgent.reset();
+    collectorServer.reset();
+
+#ifdef _WIN32
+    if (wakeEvent) CloseHandle(wakeEvent);
+#else
+    if (wakeFd >= 0) close(wakeFd);
+#endif
+}
+
+void HeadlessService::scan() {
+    deviceTable = deviceMonitor->enumerateRazerDevices();
+    deviceMonitor->updateDeviceInfo(deviceTable);
+    cachedSince.reset();
+    publish();
+    pushToCollector();
+    evaluateAlerts();
+    saveDeviceState();
+}
+
+void HeadlessService::refresh() {
+    {
+        ScopedNoAllocations noAllocations("HeadlessService::refresh");
+        deviceMonitor->updateDeviceInfo(deviceTable);
+        cachedSince.reset();
+        publish();
+    }
+    pushToCollector();
+    evaluateAlerts();
+    saveDeviceState();
+}
+
+void HeadlessService::run() {
+    // Answer --status with the last known devices while enumerating
+    if (!deviceCachePath.empty()) {
+        std::optional<DeviceStateCache::State> state = DeviceStateCache::load(deviceCachePath);
+        if (state.has_value() && !state->devices.empty()) {
+            deviceTable = deviceMonitor->restoreState(*state);
+            cachedSince = state->savedAt;
+            publish();
+        }
+    }
+    scan();
+
+    // At least a second apart, whatever the config says (divided by the
+    // speed of a replay, whose clock runs that much faster)
+    double speed = options.refreshSpeed > 0.0 ? options.refreshSpeed : 1.0;
+    auto interval = [this, speed]() {
+        double seconds = std::max(activeConfig->config.refreshInterval, 1) / speed;
+        return std::max(std::chrono::ceil<std::chrono::milliseconds>(std::chrono::duration<double>(seconds)),
+                        std::chrono::milliseconds(1));
+    };
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point nextRefresh = Clock::now() + interval();
+    while (true) {
+        // Rounded up: a wait cut short by the rounding would wake twice
+        auto remaining = std::chrono::ceil<std::chrono::milliseconds>(nextRefresh - Clock::now());
+        if (remaining.count() <= 0) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::RefreshTimer);
+            refresh();
+            nextRefresh = Clock::now() + interval();
+            continue;
+        }
+        if (!wait(static_cast<uint32_t>(remaining.count()))) {
+            break;
+        }
+        if (configChanged.exchange(false, std::memory_order_acquire)) {
+            int previousInterval = activeConfig->config.refreshInterval;
+            applyConfig(configStore->current());
+            if (activeConfig->config.refreshInterval != previousInterval) {
+                nextRefresh = Clock::now() + interval();  // like re-arming the tray's timer
+            }
+        }
+        if (collectorAgent && collectorAgent->snapshotRequested()) {
+            pushToCollector();  // the collector lost track; answer now, not at the next refresh
+        }
+    }
+}
+
+void HeadlessService::stop() {
+    stopping.store(true, std::memory_order_release);
+    wake();
+}
+
+void HeadlessService::applyConfig(std::shared_ptr<const ConfigSnapshot> next) {
+    if (!next || next == activeConfig) {
+        return;
+    }
+
+    // Rebuild only what the edit touched (icon colors do not apply here)
+    std::shared_ptr<const ConfigSnapshot> previous = std::move(activeConfig);
+    activeConfig = std::move(next);
+
+    if (activeConfig->config.metricsPort != previous->config.metricsPort) {
+        startMetricsServer();
+    }
+
+    if (activeConfig->config.collector != previous->config.collector) {
+        startCollectorAgent();
+        pushToCollector();
+    }
+
+    if (activeConfig->matcher != previous->matcher) {
+        // Device rules changed - the set of tracked devices may differ
+        deviceMonitor->setMatcher(activeConfig->matcher);
+        scan();
+    } else if (activeConfig->alerts != previous->alerts) {
+        evaluateAlerts();  // new rules see every device now, not at the next refresh
+    }
+}
+
+void HeadlessService::startMetricsServer() {
+    metricsServer.reset();
+    int port = activeConfig->config.metricsPort;
+    if (port == 0) {
+        return;
+    }
+
+    // A collector's scrapes also carry every host it receives from
+    MetricsServer::Section hosts;
+    if (collectorServer) {
+        hosts = [collector = collectorServer.get()](std::string& out) { collector->render(out); };
+    }
+    metricsServer = std::make_unique<MetricsServer>(static_cast<uint16_t>(port), std::move(hosts));
+    if (!metricsServer->isListening()) {
+        metricsServer.reset();
+        char message[128];
+        std::snprintf(message, sizeof(message), "could not listen on 127.0.0.1:%d (is the port in use?); metrics are off",
+                      port);
+        warn(message);
+        return;
+    }
+    metricsServer->update(deviceTable, deviceMonitor->strings(), DeviceStateCache::now(), cachedSince);
+}
+
+void HeadlessService::startCollectorAgent() {
+    collectorAgent.reset();
+    const std::string& address = activeConfig->config.collector;
+    if (address.empty()) {
+        return;
+    }
+
+    std::string hostName = options.hostName.empty() ? CollectorAgent::machineName() : options.hostName;
+    collectorAgent = std::make_unique<CollectorAgent>(std::move(hostName), address, [this]() { wake(); });
+    if (!collectorAgent->isConnected()) {
+        collectorAgent.reset();
+        char message[256];
+        std::snprintf(message, sizeof(message),
+                      "collector \"%.64s\" is not an IPv4 address and port (a.b.c.d:port); not pushing",
+                      address.c_str());
+        warn(message);
+    }
+}
+
+void HeadlessService::publish() {
+    int64_t now = DeviceStateCache::now();
+    if (statusPublisher) {
+        statusPublisher->publish(deviceTable, deviceMonitor->strings(), now, cachedSince, memoryUsage(), ProcessTelemetry::sample());
+    }
+    if (metricsServer) {
+        metricsServer->update(deviceTable, deviceMonitor->strings(), now, cachedSince);
+    }
+}
+
+MemoryAccounting::Report HeadlessService::memoryUsage() const {
+    using MemoryAccounting::Subsystem;
+    MemoryAccounting::Report report;
+    report.add(Subsystem::Config, (activeConfig ? activeConfig->memoryUsage() : 0) + deviceMonitor->matcherCacheUsage());
+    report.add(Subsystem::Devices, deviceTable.memoryUsage() + deviceMonitor->memoryUsage() + alertState.memoryUsage() +
+                                       (collectorServer ? collectorServer->memoryUsage() : 0));
+    report.add(Subsystem::Buffers, (metricsServer ? metricsServer->memoryUsage() : 0) +
+                                       (collectorAgent ? collectorAgent->memoryUsage() : 0));
+    MemoryAccounting::addProcessWide(report);
+    return report;
+}
+
+void HeadlessService::pushToCollector() {
+    // The last known state from devices.cache is not news to anyone
+    if (collectorAgent && !cachedSince.has_value()) {
+        collectorAgent->push(deviceTable, deviceMonitor->strings(), DeviceStateCache::now());
+    }
+}
+
+void HeadlessService::evaluateAlerts() {
+    if (cachedSince.has_value()) {
+        return;  // the last known state is not a reading
+    }
+    const AlertRules& rules = *activeConfig->alerts;
+    rules.evaluate(deviceTable, deviceMonitor->strings(), AlertRules::Moment::local(DeviceStateCache::now()), alertState,
+                   [&](const AlertRules::Alert& alert) {
+                       if (!options.onAlert) return;
+                       std::string message = rules.name(alert.rule);
+                       message += ": ";
+                       message += AlertRules::describe(deviceTable, deviceMonitor->strings(), alert.row);
+                       options.onAlert(message);
+                   });
+}
+
+void HeadlessService::saveDeviceState() {
+    if (cachedSince.has_value() || deviceCachePath.empty()) {
+        return;  // nothing newer than the file yet, or no file
+    }
+    DeviceStateCache::save(deviceCachePath, deviceMonitor->captureState(deviceTable));
+}
+
+void HeadlessService::warn(std::string_view message) const {
+    if (options.onWarning) {
+        options.onWarning(message);
+    }
+}
+
+#ifdef _WIN32
+
+bool HeadlessService::wait(uint32_t milliseconds) {
+    if (wakeEvent) {
+        if (WaitForSingleObject(wakeEvent, milliseconds) == WAIT_OBJECT_0) {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+        }
+    } else {
+        Sleep(milliseconds);  // no event: stop() takes effect at the next refresh
+    }
+    return !stopping.load(std::memory_order_acquire);
+}
+
+void HeadlessService::wake() {
+    if (wakeEvent) SetEvent(wakeEvent);
+}
+
+#else
+
+bool HeadlessService::wait(uint32_t milliseconds) {
+    // Without an eventfd (fd -1 is ignored) stop() takes effect at the next refresh
+    pollfd wakeup = {wakeFd, POLLIN, 0};
+    if (poll(&wakeup, 1, static_cast<int>(std::min<uint32_t>(milliseconds, INT32_MAX))) > 0) {
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+        uint64_t count;
+        (void)!read(wakeFd, &count, sizeof(count));
+    }
+    return !stopping.load(std::memory_order_acquire);
+}
+
+void HeadlessService::wake() {
+    // write() is async-signal-safe; a full counter is already a wakeup
+    uint64_t one = 1;
+    if (wakeFd >= 0) (void)!write(wakeFd, &one, sizeof(one));
+}
+
+#endif
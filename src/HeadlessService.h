@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "Collector.h"
+#include "CollectorAgent.h"
+#include "ConfigStore.h"
+#include "ConfigWatcher.h"
+#include "DeviceMonitor.h"
+#include "DeviceTable.h"
+#include "MemoryAccounting.h"
+#include "MetricsServer.h"
+#include "StatusSegment.h"
+
+// The device engine without a user interface (razertray_headless), for
+// machines nobody looks at: no window, tray icon or icon drawing, nothing
+// from user32 or gdi32. It enumerates once, refreshes every refreshInterval
+// seconds and hands each result to the same export surfaces as the tray -
+// the status segment (`--status`, with the service's MemoryAccounting
+// report), the metrics endpoint (metricsPort),
+// devices.cache and a collector (config `collector`) - runs the config's
+// alert rules on what changed, logs device events (EventLog) and sleeps in
+// between. With Options::collect it is also the collector other machines
+// push to, and the metrics endpoint exports their devices too.
+//
+// run() blocks on one wait handle (an event on Windows, an eventfd
+// elsewhere) that the refresh timeout, a config edit, the collector asking
+// for a snapshot or stop() ends. The
+// whole process stays below RESIDENT_BUDGET_BYTES of resident memory
+// (razertray_bench Headless checks a running instance).
+class HeadlessService {
+public:
+    static constexpr uint64_t RESIDENT_BUDGET_BYTES = 2 * 1024 * 1024;
+
+    // Heap a service that has scanned `devices` devices may hold, and
+    // memoryUsage() may account for outside the process-wide History
+    // (razertray_bench Memory checks both)
+    static constexpr uint64_t heapBudgetBytes(size_t devices) {
+        return HEAP_BUDGET_BASE_BYTES + devices * HEAP_BUDGET_PER_DEVICE_BYTES;
+    }
+    static constexpr uint64_t HEAP_BUDGET_BASE_BYTES = 192 * 1024;
+    static constexpr uint64_t HEAP_BUDGET_PER_DEVICE_BYTES = 256;
+
+    struct Options {
+        std::filesystem::path configPath;   // config.json (defaults are written if it is missing)
+        std::string statusName = StatusSegment::defaultName();
+        bool useDeviceCache = true;         // show and save devices.cache
+        std::filesystem::path eventLogPath; // device events (EventLog); empty: not logged
+        bool serve = true;                  // status segment, metrics endpoint, config watcher, collector
+        std::string collect;                // "[a.b.c.d:]port" to run a collector on; empty: none
+        std::string hostName;               // pushed to the collector; empty: the machine's name
+        double refreshSpeed = 1.0;          // divides refreshInterval (a replay's --replay-speed)
+        // Invalid config edits, unusable metrics port or collector address;
+        // may be called on the config watcher thread
+        std::function<void(std::string_view message)> onWarning;
+        // Alerts of the config's alert rules ("<rule>: <device>: 18%,
+        // connected"); called on the thread running scan() and refresh()
+        std::function<void(std::string_view message)> onAlert;
+    };
+
+    HeadlessService(std::shared_ptr<DeviceBackend> backend, Options options);
+    ~HeadlessService();
+
+    // Prevent copying (owns threads and OS handles)
+    HeadlessService(const HeadlessService&) = delete;
+    HeadlessService& operator=(const HeadlessService&) = delete;
+
+    // Enumerate, read every device and publish
+    void scan();
+    // Read every known device again and publish (allocation-free apart
+    // from saving devices.cache)
+    void refresh();
+
+    // Publish the last known state, scan(), then refresh() every
+    // refreshInterval until stop()
+    void run();
+    // Make run() return; async-signal-safe, so a signal or console control
+    // handler may call it
+    void stop();
+
+    const DeviceTable& devices() const { return deviceTable; }
+    const StringPool& strings() const { return deviceMonitor->strings(); }
+    // Set while devices() is the last known state from devices.cache
+    std::optional<int64_t> staleSince() const { return cachedSince; }
+    // The collector other machines push to (Options::collect); nullptr if
+    // not collecting or the port could not be bound
+    const Collector* collector() const { return collectorServer.get(); }
+
+    // What the service holds, by subsystem (published with every refresh)
+    MemoryAccounting::Report memoryUsage() const;
+
+private:
+    void applyConfig(std::shared_ptr<const ConfigSnapshot> next);
+    void startMetricsServer();
+    void startCollectorAgent();
+    void publish();
+    void pushToCollector();
+    void evaluateAlerts();
+    void saveDeviceState();
+    void warn(std::string_view message) const;
+
+    // Wait until stop(), wake() or the timeout (a wake is counted as a
+    // Notification wakeup); false when stopping
+    bool wait(uint32_t milliseconds);
+    void wake();
+
+    Options options;
+    std::unique_ptr<ConfigStore> configStore;
+    std::shared_ptr<const ConfigSnapshot> activeConfig;
+    std::unique_ptr<ConfigWatcher> configWatcher;
+
+    std::unique_ptr<DeviceMonitor> deviceMonitor;
+    DeviceTable deviceTable;
+    AlertRules::State alertState;
+    std::optional<int64_t> cachedSince;
+    std::filesystem::path deviceCachePath;    // empty: no devices.cache
+
+    std::unique_ptr<StatusSegment::Publisher> statusPublisher;
+    std::unique_ptr<MetricsServer> metricsServer;
+    std::unique_ptr<Collector> collectorServer;
+    std::unique_ptr<CollectorAgent> collectorAgent;
+
+    std::atomic<bool> stopping;
+    std::atomic<bool> configChanged;
+#ifdef _WIN32
+    void* wakeEvent;    // HANDLE, auto-reset
+#else
+    int wakeFd;         // eventfd
+#endif
+};
@@ -0,0 +1,51 @@
+#include "IconRaster.h"
+#include <algorithm>
+
+namespace {
+    // Battery body, terminal on top
+    constexpr int BATTERY_X = 3;
+    constexpr int BATTERY_Y = 2;
+    constexpr int BATTERY_WIDTH = 10;
+    constexpr int BATTERY_HEIGHT = 13;
+    constexpr int OUTLINE = 2;
+    constexpr int TERMINAL_WIDTH = 4;
+    constexpr int TERMINAL_HEIGHT = 2;
+
+    void fillRect(IconRaster::Pixels& pixels, int left, int top, int right, int bottom, uint32_t value) {
+        left = std::max(left, 0);
+        top = std::max(top, 0);
+        right = std::min(right, IconRaster::SIZE);
+        bottom = std::min(bottom, IconRaster::SIZE);
+        for (int y = top; y < bottom; y++) {
+            std::fill(pixels.begin() + y * IconRaster::SIZE + left, pixels.begin() + y * IconRaster::SIZE + right, value);
+        }
+    }
+}
+
+void IconRaster::drawBattery(Pixels& pixels, std::optional<int> batteryLevel, uint32_t color) {
+    // COLORREF (0x00BBGGRR) -> pixel (0x00RRGGBB)
+    uint32_t pixel = ((color & 0xFF) << 16) | (color & 0xFF00) | ((color >> 16) & 0xFF);
+    pixels.fill(0);
+
+    const int left = BATTERY_X;
+    const int top = BATTERY_Y;
+    const int right = BATTERY_X + BATTERY_WIDTH;
+    const int bottom = BATTERY_Y + BATTERY_HEIGHT;
+
+    // Outline
+    fillRect(pixels, left, top, right, top + OUTLINE, pixel);
+    fillRect(pixels, left, bottom - OUTLINE, right, bottom, pixel);
+    fillRect(pixels, left, top, left + OUTLINE, bottom, pixel);
+    fillRect(pixels, right - OUTLINE, top, right, bottom, pixel);
+
+    // Terminal
+    const int terminalX = left + (BATTERY_WIDTH - TERMINAL_WIDTH) / 2;
+    fillRect(pixels, terminalX, top - TERMINAL_HEIGHT, terminalX + TERMINAL_WIDTH, top, pixel);
+
+    // Fill, from the bottom of the body up
+    int level = std::clamp(batteryLevel.value_or(0), 0, 100);
+    if (level > 0) {
+        int fillHeight = (BATTERY_HEIGHT - 2) * level / 100;
+        fillRect(pixels, left + 1, bottom - 1 - fillHeight, right - 1, bottom - 1, pixel);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+// The 16x16 battery glyph drawn straight into a pixel array, so the tray
+// icon needs no device contexts, pens or brushes (BatteryIcon wraps the
+// pixels in an HICON) and the drawing runs and is benchmarked on any host.
+namespace IconRaster {
+    constexpr int SIZE = 16;
+
+    // 0x00RRGGBB per pixel, rows top to bottom: the memory layout of a
+    // 32-bit top-down bitmap. Black is the (XOR-transparent) background.
+    using Pixels = std::array<uint32_t, SIZE * SIZE>;
+
+    // Outline and terminal in the level's color, filled from the bottom in
+    // proportion to the level (no fill without a reading). color uses the
+    // COLORREF layout of BatteryColors.
+    void drawBattery(Pixels& pixels, std::optional<int> batteryLevel, uint32_t color);
+}
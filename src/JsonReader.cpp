@@ -0,0 +1,374 @@
+#include "JsonReader.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+JsonReader::JsonReader(std::string_view source)
+    : text(source)
+    , pos(0)
+    , valueStart(0)
+    , depth(0)
+{
+    // Tolerate a UTF-8 byte order mark (Notepad adds one)
+    if (text.substr(0, 3) == "\xEF\xBB\xBF") {
+        pos = 3;
+    }
+}
+
+void JsonReader::skipWhitespace() {
+    while (pos < text.size()) {
+        char c = text[pos];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') break;
+        pos++;
+    }
+}
+
+bool JsonReader::peekIs(char c) {
+    return pos < text.size() && text[pos] == c;
+}
+
+bool JsonReader::failAt(size_t offset, std::string message) {
+    if (lastError.has_value()) return false;  // keep the first error
+
+    // Line/column are only needed on failure, so count them lazily
+    size_t line = 1;
+    size_t lineStart = 0;
+    for (size_t i = 0; i < offset && i < text.size(); i++) {
+        if (text[i] == '\n') {
+            line++;
+            lineStart = i + 1;
+        }
+    }
+
+    lastError = JsonError{line, offset - lineStart + 1, std::move(message)};
+    return false;
+}
+
+bool JsonReader::fail(std::string message) {
+    return failAt(valueStart, std::move(message));
+}
+
+bool JsonReader::expect(char c, const char* what) {
+    skipWhitespace();
+    if (!peekIs(c)) {
+        return failAt(pos, std::string("expected ") + what);
+    }
+    pos++;
+    return true;
+}
+
+bool JsonReader::beginContainer(char open, const char* what) {
+    skipWhitespace();
+    if (!peekIs(open)) {
+        return failAt(pos, std::string("expected ") + what);
+    }
+    if (++depth > MAX_DEPTH) {
+        return failAt(pos, "nesting too deep");
+    }
+    pos++;
+    return true;
+}
+
+bool JsonReader::readKey(std::string_view& key) {
+    skipWhitespace();
+    if (!peekIs('"')) {
+        return failAt(pos, "expected string key");
+    }
+    return readStringToken(key, keyScratch);
+}
+
+bool JsonReader::afterMember(char close, bool& done) {
+    skipWhitespace();
+    if (pos >= text.size()) {
+        return failAt(pos, close == '}' ? "unterminated object" : "unterminated array");
+    }
+    if (text[pos] == ',') {
+        pos++;
+        skipWhitespace();
+        if (peekIs(close)) {
+            return failAt(pos, "trailing comma");
+        }
+        return true;
+    }
+    if (text[pos] == close) {
+        pos++;
+        done = true;
+        return true;
+    }
+    return failAt(pos, close == '}' ? "expected ',' or '}'" : "expected ',' or ']'");
+}
+
+bool JsonReader::readStringToken(std::string_view& view, std::string& scratch) {
+    size_t start = ++pos;  // skip opening quote
+
+    // Fast path: scan to the closing quote; only fall back to decoding when
+    // an escape shows up
+    while (pos < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[pos]);
+        if (c == '"') {
+            view = text.substr(start, pos - start);
+            pos++;
+            return true;
+        }
+        if (c == '\\') break;
+        if (c < 0x20) return failAt(pos, "control character in string");
+        pos++;
+    }
+
+    if (pos >= text.size()) {
+        return failAt(start - 1, "unterminated string");
+    }
+
+    scratch.assign(text.data() + start, pos - start);
+    while (pos < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[pos]);
+        if (c == '"') {
+            view = scratch;
+            pos++;
+            return true;
+        }
+        if (c < 0x20) return failAt(pos, "control character in string");
+        if (c == '\\') {
+            if (!decodeEscape(scratch)) return false;
+        } else {
+            scratch += static_cast<char>(c);
+            pos++;
+        }
+    }
+    return failAt(start - 1, "unterminated string");
+}
+
+bool JsonReader::decodeEscape(std::string& out) {
+    size_t escapeStart = pos++;  // skip backslash
+    if (pos >= text.size()) return failAt(escapeStart, "unterminated escape");
+
+    char c = text[pos++];
+    switch (c) {
+        case '"': out += '"'; return true;
+        case '\\': out += '\\'; return true;
+        case '/': out += '/'; return true;
+        case 'b': out += '\b'; return true;
+        case 'f': out += '\f'; return true;
+        case 'n': out += '\n'; return true;
+        case 'r': out += '\r'; return true;
+        case 't': out += '\t'; return true;
+        case 'u': break;
+        default: return failAt(escapeStart, "invalid escape sequence");
+    }
+
+    auto readHex4 = [this](uint32_t& value) {
+        if (text.size() - pos < 4) return false;
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            char h = text[pos++];
+            value <<= 4;
+            if (h >= '0' && h <= '9') value |= h - '0';
+            else if (h >= 'a' && h <= 'f') value |= h - 'a' + 10;
+            else if (h >= 'A' && h <= 'F') value |= h - 'A' + 10;
+            else return false;
+        }
+        return true;
+    };
+
+    uint32_t codePoint = 0;
+    if (!readHex4(codePoint)) return failAt(escapeStart, "invalid \\u escape");
+
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+        // High surrogate must be followed by an escaped low surrogate
+        uint32_t low = 0;
+        if (text.substr(pos, 2) != "\\u") return failAt(escapeStart, "unpaired surrogate in \\u escape");
+        pos += 2;
+        if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+            return failAt(escapeStart, "unpaired surrogate in \\u escape");
+        }
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+    } else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+        return failAt(escapeStart, "unpaired surrogate in \\u escape");
+    }
+
+    // Append as UTF-8
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    return true;
+}
+
+bool JsonReader::readString(std::string& out) {
+    skipWhitespace();
+    valueStart = pos;
+    if (!peekIs('"')) {
+        return failAt(pos, "expected string");
+    }
+
+    std::string scratch;
+    std::string_view view;
+    if (!readStringToken(view, scratch)) return false;
+
+    if (view.data() == scratch.data()) {
+        out = std::move(scratch);
+    } else {
+        out.assign(view);
+    }
+    return true;
+}
+
+bool JsonReader::readInt(int& out) {
+    skipWhitespace();
+    valueStart = pos;
+
+    bool negative = peekIs('-');
+    if (negative) pos++;
+
+    if (pos >= text.size() || text[pos] < '0' || text[pos] > '9') {
+        return failAt(valueStart, "expected integer");
+    }
+    if (text[pos] == '0' && pos + 1 < text.size() && text[pos + 1] >= '0' && text[pos + 1] <= '9') {
+        return failAt(valueStart, "leading zeros are not allowed");
+    }
+
+    long long value = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        value = value * 10 + (text[pos] - '0');
+        if (value > std::numeric_limits<int>::max()) {
+            return failAt(valueStart, "integer out of range");
+        }
+        pos++;
+    }
+
+    if (pos < text.size() && (text[pos] == '.' || text[pos] == 'e' || text[pos] == 'E')) {
+        return failAt(valueStart, "expected integer");
+    }
+
+    out = static_cast<int>(negative ? -value : value);
+    return true;
+}
+
+bool JsonReader::readDouble(double& out) {
+    skipWhitespace();
+    valueStart = pos;
+    if (pos >= text.size() || (text[pos] != '-' && (text[pos] < '0' || text[pos] > '9'))) {
+        return failAt(valueStart, "expected number");
+    }
+
+    // skipValue() checks the JSON number grammar, from_chars converts it
+    size_t start = pos;
+    if (!skipValue()) {
+        return false;
+    }
+    auto [end, ec] = std::from_chars(text.data() + start, text.data() + pos, out);
+    if (ec != std::errc() || end != text.data() + pos) {
+        return failAt(start, "number out of range");
+    }
+    return true;
+}
+
+bool JsonReader::readBool(bool& out) {
+    skipWhitespace();
+    valueStart = pos;
+    std::string_view rest = text.substr(pos);
+    if (rest.starts_with("true")) {
+        out = true;
+        pos += 4;
+        return true;
+    }
+    if (rest.starts_with("false")) {
+        out = false;
+        pos += 5;
+        return true;
+    }
+    return failAt(pos, "expected true or false");
+}
+
+bool JsonReader::skipValue() {
+    skipWhitespace();
+    valueStart = pos;
+    if (pos >= text.size()) {
+        return failAt(pos, "unexpected end of input");
+    }
+
+    char c = text[pos];
+    if (c == '{') {
+        return readObject([this](std::string_view) { return skipValue(); });
+    }
+    if (c == '[') {
+        return readArray([this]() { return skipValue(); });
+    }
+    if (c == '"') {
+        std::string_view ignored;
+        std::string scratch;
+        return readStringToken(ignored, scratch);
+    }
+    if (c == 't' || c == 'f') {
+        bool ignored;
+        return readBool(ignored);
+    }
+    if (text.substr(pos).starts_with("null")) {
+        pos += 4;
+        return true;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        // Any JSON number: -?int(.frac)?([eE][+-]?exp)?
+        size_t start = pos;
+        if (c == '-') pos++;
+        auto digits = [this]() {
+            size_t first = pos;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') pos++;
+            return pos > first;
+        };
+        if (!digits()) return failAt(start, "invalid number");
+        if (peekIs('.')) {
+            pos++;
+            if (!digits()) return failAt(start, "invalid number");
+        }
+        if (peekIs('e') || peekIs('E')) {
+            pos++;
+            if (peekIs('+') || peekIs('-')) pos++;
+            if (!digits()) return failAt(start, "invalid number");
+        }
+        return true;
+    }
+    return failAt(pos, "unexpected character");
+}
+
+bool JsonReader::finish() {
+    skipWhitespace();
+    if (pos != text.size()) {
+        return failAt(pos, "unexpected content after end of document");
+    }
+    return true;
+}
+
+void appendJsonString(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escape[8];
+                    std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Position and description of a JSON syntax or schema error
+struct JsonError {
+    size_t line;    // 1-based
+    size_t column;  // 1-based, in bytes
+    std::string message;
+};
+
+// Single-pass pull reader over a JSON document held in memory.
+// The caller walks the document in order: readObject()/readArray() invoke a
+// callback per member/element, and the callback must consume exactly one
+// value (read it or skipValue() it). Keys are string_views into the source
+// buffer (or into a scratch buffer when they contain escapes), so nothing is
+// copied unless a string value is stored. Nesting and escapes are handled
+// properly; the first error stops the parse and is kept with its line and
+// column.
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view text);
+
+    // Read an object; onMember(std::string_view key) returns false to abort
+    template<typename OnMember>
+    bool readObject(OnMember&& onMember);
+
+    // Read an array; onElement() returns false to abort
+    template<typename OnElement>
+    bool readArray(OnElement&& onElement);
+
+    // Scalars
+    bool readString(std::string& out);
+    bool readInt(int& out);
+    bool readDouble(double& out);
+    bool readBool(bool& out);
+
+    // Skip any value, including nested objects and arrays
+    bool skipValue();
+
+    // Check that only whitespace follows the top-level value
+    bool finish();
+
+    // Record a schema error at the start of the value just read
+    bool fail(std::string message);
+
+    const std::optional<JsonError>& error() const { return lastError; }
+
+private:
+    // Nesting deeper than this is rejected rather than recursing further
+    static constexpr int MAX_DEPTH = 64;
+
+    void skipWhitespace();
+    bool expect(char c, const char* what);
+    bool peekIs(char c);
+    bool failAt(size_t offset, std::string message);
+
+    // Parse a string token; view points into the source or into scratch
+    bool readStringToken(std::string_view& view, std::string& scratch);
+    bool decodeEscape(std::string& out);
+
+    bool beginContainer(char open, const char* what);
+    bool readKey(std::string_view& key);
+    bool afterMember(char close, bool& done);
+
+    std::string_view text;
+    size_t pos;
+    size_t valueStart;
+    int depth;
+    std::string keyScratch;
+    std::optional<JsonError> lastError;
+};
+
+// Append value to out as a quoted JSON string, escaping what readString()
+// unescapes (quote, backslash, control characters); bytes >= 0x80 are
+// copied as they are, so UTF-8 stays UTF-8
+void appendJsonString(std::string& out, std::string_view value);
+
+template<typename OnMember>
+bool JsonReader::readObject(OnMember&& onMember) {
+    if (!beginContainer('{', "object")) return false;
+
+    skipWhitespace();
+    if (peekIs('}')) {
+        pos++;
+        depth--;
+        return true;
+    }
+
+    bool done = false;
+    while (!done) {
+        std::string_view key;
+        if (!readKey(key)) return false;
+        if (!expect(':', "':' after object key")) return false;
+
+        skipWhitespace();
+        valueStart = pos;
+        if (!onMember(key)) return false;
+
+        if (!afterMember('}', done)) return false;
+    }
+    depth--;
+    return true;
+}
+
+template<typename OnElement>
+bool JsonReader::readArray(OnElement&& onElement) {
+    if (!beginContainer('[', "array")) return false;
+
+    skipWhitespace();
+    if (peekIs(']')) {
+        pos++;
+        depth--;
+        return true;
+    }
+
+    bool done = false;
+    while (!done) {
+        skipWhitespace();
+        valueStart = pos;
+        if (!onElement()) return false;
+
+        if (!afterMember(']', done)) return false;
+    }
+    depth--;
+    return true;
+}
@@ -0,0 +1,66 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+size_t LatencyHistogram::bucketIndex(uint64_t nanoseconds) {
+    if (nanoseconds < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(nanoseconds);
+    }
+
+    // Power-of-two range, then the linear sub-bucket within it
+    unsigned exponent = static_cast<unsigned>(std::bit_width(nanoseconds)) - 1;
+    if (exponent > MAX_EXPONENT) {
+        return BUCKET_COUNT - 1;
+    }
+    unsigned shift = exponent - SUB_BUCKET_BITS;
+    uint64_t subBucket = (nanoseconds >> shift) - SUB_BUCKET_COUNT;
+    return static_cast<size_t>(SUB_BUCKET_COUNT * (shift + 1) + subBucket);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    unsigned shift = static_cast<unsigned>(index / SUB_BUCKET_COUNT) - 1;
+    uint64_t subBucket = index % SUB_BUCKET_COUNT;
+    uint64_t lower = (SUB_BUCKET_COUNT + subBucket) << shift;
+    return lower + (uint64_t(1) << shift) - 1;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    result.count = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        result.counts[i] = buckets[i].load(std::memory_order_relaxed);
+        result.count += result.counts[i];
+    }
+    result.sum = sum.load(std::memory_order_relaxed);
+    result.max = maximum.load(std::memory_order_relaxed);
+    return result;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    sum.store(0, std::memory_order_relaxed);
+    maximum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    fraction = std::clamp(fraction, 0.0, 1.0);
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketUpperBound(i), max);
+        }
+    }
+    return max;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size, lock-free latency histogram (nanoseconds).
+// Buckets are log-linear in the style of HdrHistogram: values below 32 ns
+// get a bucket each, every power of two above that is split into 32 equal
+// sub-buckets, so any recorded value is reported to within ~3%. The bucket
+// array is allocated inline once (about 9 KB) and record() is two relaxed
+// atomic adds plus a max update that only writes on a new maximum - callable
+// from any thread, never blocks, never allocates.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = uint64_t(1) << SUB_BUCKET_BITS;
+
+    // Largest power of two tracked (2^39 ns ~ 9 min); longer calls land in
+    // the last bucket
+    static constexpr unsigned MAX_EXPONENT = 39;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (MAX_EXPONENT - SUB_BUCKET_BITS + 2);
+
+    // Counts copied out of a histogram at one point in time
+    struct Snapshot {
+        std::array<uint64_t, BUCKET_COUNT> counts;
+        uint64_t count;  // sum of counts
+        uint64_t sum;
+        uint64_t max;
+
+        // Value at or below which the given fraction (0..1) of the samples
+        // fall, reported as the top of its bucket and capped at max
+        uint64_t percentile(double fraction) const;
+        double mean() const { return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0; }
+    };
+
+    LatencyHistogram() = default;
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void record(uint64_t nanoseconds) {
+        buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        uint64_t seen = maximum.load(std::memory_order_relaxed);
+        while (nanoseconds > seen &&
+               !maximum.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Concurrent record() calls may or may not be included
+    Snapshot snapshot() const;
+
+    void reset();
+
+    static size_t bucketIndex(uint64_t nanoseconds);
+
+    // Largest value that falls into the bucket
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets = {};
+    std::atomic<uint64_t> sum = 0;
+    std::atomic<uint64_t> maximum = 0;
+};
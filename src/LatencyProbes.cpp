@@ -0,0 +1,149 @@
+#include "LatencyProbes.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace {
+    std::array<LatencyHistogram, LatencyProbes::SITE_COUNT> histograms;
+
+    const char* const SITE_NAMES[LatencyProbes::SITE_COUNT] = {
+        "SetupDiEnumDeviceInfo",
+        "CM_Locate_DevNodeW",
+        "CM_Get_DevNode_PropertyW",
+        "Icon creation",
+        "Shell_NotifyIconW",
+        "Device refresh",
+    };
+
+    // Sites timed around other sites; left out of the overhead ratio so
+    // their calls are not counted twice
+    bool enclosesOtherSites(size_t site) {
+        return site == static_cast<size_t>(LatencyProbes::Site::Refresh);
+    }
+
+#ifdef _WIN32
+    uint64_t ticksPerSecond() {
+        static const uint64_t frequency = [] {
+            LARGE_INTEGER value;
+            QueryPerformanceFrequency(&value);
+            return static_cast<uint64_t>(value.QuadPart);
+        }();
+        return frequency;
+    }
+#endif
+
+    void appendDuration(std::string& out, double nanoseconds) {
+        char buffer[32];
+        if (nanoseconds < 1000.0) {
+            std::snprintf(buffer, sizeof(buffer), "%.0f ns", nanoseconds);
+        } else if (nanoseconds < 1000000.0) {
+            std::snprintf(buffer, sizeof(buffer), "%.1f \xC2\xB5s", nanoseconds / 1000.0);
+        } else {
+            std::snprintf(buffer, sizeof(buffer), "%.2f ms", nanoseconds / 1000000.0);
+        }
+        out += buffer;
+    }
+}
+
+const char* LatencyProbes::name(Site site) {
+    return SITE_NAMES[static_cast<size_t>(site)];
+}
+
+LatencyHistogram& LatencyProbes::histogram(Site site) {
+    return histograms[static_cast<size_t>(site)];
+}
+
+size_t LatencyProbes::memoryUsage() {
+    return sizeof(histograms);
+}
+
+uint64_t LatencyProbes::now() {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return static_cast<uint64_t>(counter.QuadPart);
+#else
+    auto sinceEpoch = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(sinceEpoch).count());
+#endif
+}
+
+uint64_t LatencyProbes::elapsedNanoseconds(uint64_t startTicks, uint64_t endTicks) {
+    uint64_t ticks = endTicks - startTicks;
+#ifdef _WIN32
+    // Split so large deltas cannot overflow the multiplication
+    uint64_t frequency = ticksPerSecond();
+    return ticks / frequency * 1000000000 + ticks % frequency * 1000000000 / frequency;
+#else
+    return ticks;
+#endif
+}
+
+double LatencyProbes::probeOverheadNanoseconds() {
+    constexpr int ROUNDS = 10000;
+    auto scratch = std::make_unique<LatencyHistogram>();
+
+    uint64_t start = now();
+    for (int i = 0; i < ROUNDS; i++) {
+        uint64_t probeStart = now();
+        scratch->record(elapsedNanoseconds(probeStart, now()));
+    }
+    return static_cast<double>(elapsedNanoseconds(start, now())) / ROUNDS;
+}
+
+std::string LatencyProbes::report() {
+    std::string text;
+    char buffer[64];
+    uint64_t totalCalls = 0;
+    uint64_t totalNanoseconds = 0;
+
+    for (size_t i = 0; i < SITE_COUNT; i++) {
+        LatencyHistogram::Snapshot snapshot = histograms[i].snapshot();
+        if (!enclosesOtherSites(i)) {
+            totalCalls += snapshot.count;
+            totalNanoseconds += snapshot.sum;
+        }
+
+        text += SITE_NAMES[i];
+        if (snapshot.count == 0) {
+            text += ": no calls yet\n\n";
+            continue;
+        }
+        std::snprintf(buffer, sizeof(buffer), ": %llu calls, mean ",
+                      static_cast<unsigned long long>(snapshot.count));
+        text += buffer;
+        appendDuration(text, snapshot.mean());
+
+        const std::pair<const char*, double> percentiles[] = {
+            {"p50", 0.50}, {"p90", 0.90}, {"p99", 0.99}, {"p99.9", 0.999},
+        };
+        text += "\n  ";
+        for (const auto& [label, fraction] : percentiles) {
+            text += label;
+            text += ' ';
+            appendDuration(text, static_cast<double>(snapshot.percentile(fraction)));
+            text += "  ";
+        }
+        text += "max ";
+        appendDuration(text, static_cast<double>(snapshot.max));
+        text += "\n\n";
+    }
+
+    double overhead = probeOverheadNanoseconds();
+    text += "Probe overhead: ";
+    appendDuration(text, overhead);
+    text += " per call";
+    if (totalNanoseconds > 0) {
+        std::snprintf(buffer, sizeof(buffer), " (%.3f%% of the time spent in timed calls)",
+                      100.0 * overhead * static_cast<double>(totalCalls) / static_cast<double>(totalNanoseconds));
+        text += buffer;
+    }
+    text += "\n";
+    return text;
+}
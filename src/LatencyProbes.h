@@ -0,0 +1,74 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "TraceRecorder.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Process-wide latency histograms for the OS calls on the device query and
+// render paths, plus whole device refreshes. Each call site wraps its call in a Probe (or timed()); the
+// timings go into that site's LatencyHistogram and can be dumped at any time
+// as percentiles (tray menu "Latency Statistics").
+//
+// The clock is the cheapest monotonic counter the platform has
+// (QueryPerformanceCounter on Windows, CLOCK_MONOTONIC elsewhere), read once
+// before and once after the call.
+namespace LatencyProbes {
+    enum class Site {
+        EnumDeviceInfo,      // SetupDiEnumDeviceInfo
+        LocateDevNode,       // CM_Locate_DevNodeW
+        GetDevNodeProperty,  // CM_Get_DevNode_PropertyW
+        CreateIcon,          // BatteryIcon::createBatteryIcon
+        NotifyIcon,          // Shell_NotifyIconW
+        Refresh,             // DeviceMonitor::updateDeviceInfo (all devices; encloses the CM_ calls)
+        Count
+    };
+
+    constexpr size_t SITE_COUNT = static_cast<size_t>(Site::Count);
+
+    // Display name (the API being timed)
+    const char* name(Site site);
+
+    LatencyHistogram& histogram(Site site);
+
+    // Bytes held by the histograms (MemoryAccounting)
+    size_t memoryUsage();
+
+    // Monotonic clock in platform ticks, and tick deltas in nanoseconds
+    uint64_t now();
+    uint64_t elapsedNanoseconds(uint64_t startTicks, uint64_t endTicks);
+
+    // Times its own lifetime into the site's histogram (and the trace, while
+    // one is being recorded)
+    class Probe {
+    public:
+        explicit Probe(Site site) : site(site), start(now()) {}
+        ~Probe() {
+            uint64_t end = now();
+            histogram(site).record(elapsedNanoseconds(start, end));
+            if (Trace::enabled()) Trace::complete(name(site), start, end);
+        }
+
+        Probe(const Probe&) = delete;
+        Probe& operator=(const Probe&) = delete;
+
+    private:
+        Site site;
+        uint64_t start;
+    };
+
+    // Time one call and pass its result through, for calls in conditions
+    template<typename Function>
+    auto timed(Site site, Function&& function) {
+        Probe probe(site);
+        return std::forward<Function>(function)();
+    }
+
+    // Cost of one Probe (two clock reads and a record), measured on the spot
+    double probeOverheadNanoseconds();
+
+    // Count, mean and p50/p90/p99/p99.9/max per site, plus the probe's own
+    // overhead relative to the calls it timed (UTF-8, one block per site)
+    std::string report();
+}
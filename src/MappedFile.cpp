@@ -0,0 +1,109 @@
+#include "MappedFile.h"
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(nullptr), length(0), opened(false) {
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path) : MappedFile() {
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return;
+    }
+
+    opened = true;
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(file);  // nothing to map
+        return;
+    }
+
+    // The view keeps the mapping (and file) alive once both handles close
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        opened = false;
+        return;
+    }
+
+    data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        opened = false;
+        return;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat info = {};
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return;
+    }
+
+    opened = true;
+    if (info.st_size > 0) {
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            opened = false;
+        } else {
+            data = mapped;
+            length = static_cast<size_t>(info.st_size);
+        }
+    }
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    cleanup();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(std::exchange(other.data, nullptr))
+    , length(std::exchange(other.length, 0))
+    , opened(std::exchange(other.opened, false))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        cleanup();
+        data = std::exchange(other.data, nullptr);
+        length = std::exchange(other.length, 0);
+        opened = std::exchange(other.opened, false);
+    }
+    return *this;
+}
+
+void MappedFile::cleanup() {
+    if (data) {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<void*>(data), length);
+#endif
+    }
+    data = nullptr;
+    length = 0;
+    opened = false;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// Read-only memory mapping of a whole file (RAII).
+// The contents stay valid for the lifetime of the object, so parsers can
+// hand out string_views into the file instead of copying it.
+class MappedFile {
+public:
+    MappedFile();
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    // Prevent copying (the mapping has a single owner)
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Allow moving
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // True if the file was opened (an empty file is valid with no contents)
+    bool isValid() const { return opened; }
+
+    std::string_view contents() const {
+        return std::string_view(static_cast<const char*>(data), length);
+    }
+
+private:
+    void cleanup();
+
+    const void* data;
+    size_t length;
+    bool opened;
+};
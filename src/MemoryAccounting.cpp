@@ -0,0 +1,82 @@
+#include "MemoryAccounting.h"
+#include "AllocationCounter.h"
+#include "EventLog.h"
+#include "LatencyProbes.h"
+#include "TraceRecorder.h"
+#include <atomic>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+    constexpr const char* SUBSYSTEM_NAMES[] = {"config", "devices", "icons", "history", "buffers"};
+    static_assert(sizeof(SUBSYSTEM_NAMES) / sizeof(SUBSYSTEM_NAMES[0]) == MemoryAccounting::SUBSYSTEM_COUNT);
+
+    // Reports are made with every publish, on the tray's UI thread, and a
+    // heap walk locks the heap: the heap is sampled at most this often and
+    // the reports in between repeat the last sample
+    constexpr std::chrono::seconds HEAP_SAMPLE_INTERVAL(30);
+
+    std::atomic<bool> heapSampled{false};
+    std::atomic<std::chrono::steady_clock::rep> heapSampledAt{0};
+    std::atomic<uint64_t> sampledHeapBytes{0};
+
+    uint64_t sampleHeap() {
+        auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+        auto sampledAt = heapSampledAt.load(std::memory_order_relaxed);
+        auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(HEAP_SAMPLE_INTERVAL).count();
+        bool due = !heapSampled.load(std::memory_order_acquire) || now - sampledAt >= interval;
+        // One caller takes the sample; the others use the previous one
+        if (due && heapSampledAt.compare_exchange_strong(sampledAt, now, std::memory_order_relaxed)) {
+            sampledHeapBytes.store(MemoryAccounting::heapInUse().value_or(0), std::memory_order_relaxed);
+            heapSampled.store(true, std::memory_order_release);
+        }
+        return sampledHeapBytes.load(std::memory_order_relaxed);
+    }
+}
+
+const char* MemoryAccounting::name(Subsystem subsystem) {
+    return SUBSYSTEM_NAMES[static_cast<size_t>(subsystem)];
+}
+
+uint64_t MemoryAccounting::Report::total() const {
+    uint64_t sum = 0;
+    for (uint64_t count : bytes) sum += count;
+    return sum;
+}
+
+void MemoryAccounting::addProcessWide(Report& report) {
+    report.add(Subsystem::History, EventLog::memoryUsage() + LatencyProbes::memoryUsage() + Trace::memoryUsage());
+    report.heapBytes = sampleHeap();
+}
+
+std::optional<uint64_t> MemoryAccounting::heapInUse() {
+    if constexpr (AllocationCounter::enabled()) {
+        return AllocationCounter::liveBytes();
+    } else {
+#ifdef _WIN32
+        // The CRT allocates from the process heap
+        HANDLE heap = GetProcessHeap();
+        if (!HeapLock(heap)) {
+            return std::nullopt;
+        }
+        uint64_t busy = 0;
+        PROCESS_HEAP_ENTRY entry = {};
+        while (HeapWalk(heap, &entry)) {
+            if (entry.wFlags & PROCESS_HEAP_ENTRY_BUSY) busy += entry.cbData;
+        }
+        HeapUnlock(heap);
+        return busy;
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        // Small blocks in use plus blocks mmapped on their own
+        struct mallinfo2 info = mallinfo2();
+        return static_cast<uint64_t>(info.uordblks) + info.hblkhd;
+#else
+        return std::nullopt;
+#endif
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Where the process's memory goes, per subsystem, as the owners of that
+// memory count it: the capacity of their containers and the size of their
+// fixed buffers, not allocator overhead or code. The tray and the headless
+// service fill a Report with every publish and it is shown by `--status`;
+// the heap the allocator reports is shown next to it, so a growing gap
+// between the two points at memory nobody accounts for.
+//
+// Subsystems:
+//  - Config: the active ConfigSnapshot (config, compiled matcher, icon
+//    colors) and the matcher caches built from it
+//  - Devices: device tables, interned names and instance IDs, the
+//    collector's remote devices
+//  - Icons: the icon renderer and the icon on display (tray only)
+//  - History: the event log's rings and device texts, the latency
+//    histograms, the trace ring once a trace was recorded
+//  - Buffers: the refresh arena, the metrics server's and the collector
+//    agent's reused buffers
+namespace MemoryAccounting {
+    enum class Subsystem {
+        Config,
+        Devices,
+        Icons,
+        History,
+        Buffers,
+        Count
+    };
+
+    constexpr size_t SUBSYSTEM_COUNT = static_cast<size_t>(Subsystem::Count);
+
+    // Lowercase name, as in --status output
+    const char* name(Subsystem subsystem);
+
+    struct Report {
+        std::array<uint64_t, SUBSYSTEM_COUNT> bytes = {};
+        uint64_t heapBytes = 0;     // heapInUse() sampled within the last 30 s, 0 = unknown
+
+        void add(Subsystem subsystem, size_t count) { bytes[static_cast<size_t>(subsystem)] += count; }
+        uint64_t operator[](Subsystem subsystem) const { return bytes[static_cast<size_t>(subsystem)]; }
+        uint64_t total() const;
+    };
+
+    // Add what is held process-wide rather than by one owner (History:
+    // EventLog, LatencyProbes, Trace) and the heap in use, sampled at most
+    // every 30 s so that a report stays cheap enough for every publish
+    void addProcessWide(Report& report);
+
+    // Bytes the process's heap has handed out and not taken back: exact
+    // in RAZERTRAY_COUNT_ALLOCATIONS builds (AllocationCounter), otherwise
+    // as glibc's or the Windows process heap's statistics report it;
+    // nullopt where neither is available
+    std::optional<uint64_t> heapInUse();
+
+    // Heap held by standard containers
+    template<typename T>
+    size_t bytesOf(const std::vector<T>& vector) { return vector.capacity() * sizeof(T); }
+    inline size_t bytesOf(const std::vector<bool>& vector) { return (vector.capacity() + 7) / 8; }
+    inline size_t bytesOf(const std::string& string) {
+        // Short strings live inside the object
+        return string.capacity() > std::string().capacity() ? string.capacity() + 1 : 0;
+    }
+    // Buckets, plus one node per entry (next pointer, cached hash, value)
+    template<typename Map>
+    size_t hashTableBytes(const Map& map) {
+        return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*));
+    }
+    // One node per entry (three links and a color, then the value)
+    template<typename Map>
+    size_t treeBytes(const Map& map) {
+        return map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void*));
+    }
+}
@@ -0,0 +1,417 @@
+#include "MetricsServer.h"
+#include "DeviceMonitor.h"
+#include "LatencyProbes.h"
+#include "MemoryAccounting.h"
+#include "ProcessTelemetry.h"
+#include "PrometheusText.h"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <fcntl.h>
+#endif
+
+namespace {
+    using namespace PrometheusText;
+
+    constexpr uintptr_t NO_SOCKET = ~uintptr_t(0);
+    constexpr int IO_TIMEOUT_MS = 2000;       // per request, against clients that stall
+    constexpr size_t MAX_REQUEST = 8192;      // request line and headers
+
+    void appendDeviceSample(std::string& out, const char* name, const StatusSegment::Device& device, int64_t value) {
+        out += name;
+        out += '{';
+        appendLabel(out, "name", device.name);
+        out += ',';
+        appendLabel(out, "instance_id", device.instanceId);
+        out += "} ";
+        appendValue(out, value);
+    }
+
+    void appendSeconds(std::string& out, const char* name, const char* labels, uint64_t nanoseconds) {
+        out += name;
+        out += labels;
+        out += ' ';
+        char digits[32];
+        out.append(digits, std::to_chars(digits, digits + sizeof(digits), static_cast<double>(nanoseconds) / 1e9).ptr);
+        out += '\n';
+    }
+
+    // Nothing refreshed yet: no devices
+    void clearSnapshot(StatusSegment::Payload& snapshot) {
+        snapshot.publishedAt = 0;
+        snapshot.staleSince = 0;
+        snapshot.deviceCount = 0;
+        snapshot.totalDevices = 0;
+        snapshot.connectedCount = 0;
+        snapshot.lowestLevel = StatusSegment::NO_LEVEL;
+    }
+
+    // Method and path of the request line; empty if malformed
+    std::pair<std::string_view, std::string_view> requestTarget(std::string_view request) {
+        size_t methodEnd = request.find(' ');
+        if (methodEnd == std::string_view::npos) return {};
+        size_t targetEnd = request.find(' ', methodEnd + 1);
+        if (targetEnd == std::string_view::npos) return {};
+        std::string_view target = request.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+        return {request.substr(0, methodEnd), target.substr(0, target.find('?'))};
+    }
+
+    void closeSocket(uintptr_t socket) {
+#ifdef _WIN32
+        closesocket(static_cast<SOCKET>(socket));
+#else
+        ::close(static_cast<int>(socket));
+#endif
+    }
+}
+
+void MetricsServer::renderDevices(std::string& out, const StatusSegment::Payload& snapshot) {
+    appendHeader(out, "razertray_devices", "gauge", "Devices the tray tracks.");
+    appendSample(out, "razertray_devices", snapshot.totalDevices);
+    appendHeader(out, "razertray_devices_connected", "gauge", "Tracked devices that are connected.");
+    appendSample(out, "razertray_devices_connected", snapshot.connectedCount);
+    appendHeader(out, "razertray_state_stale", "gauge",
+                 "1 while the readings are the last known state from a previous run (first scan pending).");
+    appendSample(out, "razertray_state_stale", snapshot.staleSince != 0 ? 1 : 0);
+    appendHeader(out, "razertray_last_update_timestamp_seconds", "gauge", "Unix time of the readings.");
+    appendSample(out, "razertray_last_update_timestamp_seconds",
+                 snapshot.staleSince != 0 ? snapshot.staleSince : snapshot.publishedAt);
+
+    appendHeader(out, "razertray_battery_level_percent", "gauge", "Battery level of each device that reports one.");
+    for (uint32_t i = 0; i < snapshot.deviceCount; i++) {
+        const StatusSegment::Device& device = snapshot.devices[i];
+        if (device.batteryLevel != StatusSegment::NO_LEVEL) {
+            appendDeviceSample(out, "razertray_battery_level_percent", device, device.batteryLevel);
+        }
+    }
+    appendHeader(out, "razertray_device_connected", "gauge", "1 if the device is connected.");
+    for (uint32_t i = 0; i < snapshot.deviceCount; i++) {
+        appendDeviceSample(out, "razertray_device_connected", snapshot.devices[i], snapshot.devices[i].connected);
+    }
+    appendHeader(out, "razertray_device_last_change_timestamp_seconds", "gauge",
+                 "Unix time of the device's last level or connection change.");
+    for (uint32_t i = 0; i < snapshot.deviceCount; i++) {
+        if (snapshot.devices[i].changedAt != 0) {
+            appendDeviceSample(out, "razertray_device_last_change_timestamp_seconds", snapshot.devices[i],
+                               snapshot.devices[i].changedAt);
+        }
+    }
+}
+
+void MetricsServer::renderCounters(std::string& out) {
+    DeviceMonitor::QueryCounts counts = DeviceMonitor::queryCounts();
+    appendHeader(out, "razertray_device_queries_total", "counter", "Device queries since launch.");
+    appendSample(out, "razertray_device_queries_total", static_cast<int64_t>(counts.queries));
+    appendHeader(out, "razertray_device_query_failures_total", "counter",
+                 "Device queries without a reading: device node gone, or connected without a battery level.");
+    appendSample(out, "razertray_device_query_failures_total{reason=\"not_present\"}",
+                 static_cast<int64_t>(counts.notPresent));
+    appendSample(out, "razertray_device_query_failures_total{reason=\"no_level\"}",
+                 static_cast<int64_t>(counts.noLevel));
+
+    // Same histogram as "Device refresh" in Latency Statistics
+    LatencyHistogram::Snapshot refresh = LatencyProbes::histogram(LatencyProbes::Site::Refresh).snapshot();
+    appendHeader(out, "razertray_refresh_duration_seconds", "summary", "Time to query every tracked device once.");
+    const std::pair<const char*, double> quantiles[] = {
+        {"{quantile=\"0.5\"}", 0.5}, {"{quantile=\"0.9\"}", 0.9}, {"{quantile=\"0.99\"}", 0.99},
+    };
+    for (const auto& [labels, fraction] : quantiles) {
+        appendSeconds(out, "razertray_refresh_duration_seconds", labels, refresh.count ? refresh.percentile(fraction) : 0);
+    }
+    appendSeconds(out, "razertray_refresh_duration_seconds_sum", "", refresh.sum);
+    appendSample(out, "razertray_refresh_duration_seconds_count", static_cast<int64_t>(refresh.count));
+}
+
+void MetricsServer::render(std::string& out, const StatusSegment::Payload& snapshot) {
+    renderDevices(out, snapshot);
+    renderCounters(out);
+}
+
+void MetricsServer::update(const DeviceTable& devices, const StringPool& strings,
+                           int64_t now, std::optional<int64_t> staleSince) {
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    StatusSegment::capture(*snapshot, devices, strings, now, staleSince, MemoryAccounting::Report(), {});
+    generation++;
+    slotsUsed.store(std::max(slotsUsed.load(std::memory_order_relaxed), snapshot->deviceCount),
+                    std::memory_order_relaxed);
+}
+
+size_t MetricsServer::memoryUsage() const {
+    // Both snapshots are allocated for overwrite; slots never written stay untouched
+    size_t snapshotBytes = offsetof(StatusSegment::Payload, devices) +
+                           slotsUsed.load(std::memory_order_relaxed) * sizeof(StatusSegment::Device);
+    return 2 * snapshotBytes + bufferBytes.load(std::memory_order_relaxed);
+}
+
+void MetricsServer::serve(uintptr_t connection) {
+    // Read through the end of the headers; closing with unread request
+    // bytes would reset the connection under the response
+    char request[MAX_REQUEST];
+    size_t length = 0;
+    while (length < sizeof(request)) {
+#ifdef _WIN32
+        int received = recv(static_cast<SOCKET>(connection), request + length, static_cast<int>(sizeof(request) - length), 0);
+#else
+        ssize_t received = recv(static_cast<int>(connection), request + length, sizeof(request) - length, 0);
+#endif
+        if (received <= 0) {
+            return;  // closed, timed out or failed
+        }
+        length += static_cast<size_t>(received);
+        if (std::string_view(request, length).find("\r\n\r\n") != std::string_view::npos) {
+            break;
+        }
+    }
+
+    auto [method, path] = requestTarget(std::string_view(request, length));
+    const char* status = "200 OK";
+    body.clear();
+    if (method != "GET") {
+        status = "405 Method Not Allowed";
+        body = "Only GET is supported.\n";
+    } else if (path != "/metrics") {
+        status = "404 Not Found";
+        body = "Metrics are at /metrics.\n";
+    } else {
+        // The device section only changes with update(); between refreshes
+        // a scrape re-renders just the counters
+        bool changed = false;
+        {
+            std::lock_guard<std::mutex> lock(snapshotMutex);
+            if (generation != renderedGeneration) {
+                constexpr size_t HEADER = offsetof(StatusSegment::Payload, devices);
+                std::memcpy(scrapeCopy.get(), snapshot.get(), HEADER + snapshot->deviceCount * sizeof(StatusSegment::Device));
+                renderedGeneration = generation;
+                changed = true;
+            }
+        }
+        if (changed) {
+            deviceSection.clear();
+            renderDevices(deviceSection, *scrapeCopy);
+        }
+        body = deviceSection;
+        renderCounters(body);
+        if (extraSection) {
+            extraSection(body);
+        }
+        scrapeCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    char headers[192];
+    int headerLength = std::snprintf(headers, sizeof(headers),
+                                     "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                     "Content-Length: %zu\r\nConnection: close\r\n\r\n",
+                                     status, body.size());
+    response.assign(headers, static_cast<size_t>(headerLength));
+    response += body;
+    bufferBytes.store(MemoryAccounting::bytesOf(deviceSection) + MemoryAccounting::bytesOf(body) +
+                      MemoryAccounting::bytesOf(response), std::memory_order_relaxed);
+
+    size_t sent = 0;
+    while (sent < response.size()) {
+#ifdef _WIN32
+        int result = send(static_cast<SOCKET>(connection), response.data() + sent, static_cast<int>(response.size() - sent), 0);
+#else
+        ssize_t result = send(static_cast<int>(connection), response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+#endif
+        if (result <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(result);
+    }
+#ifdef _WIN32
+    shutdown(static_cast<SOCKET>(connection), SD_SEND);
+#else
+    shutdown(static_cast<int>(connection), SHUT_WR);
+#endif
+}
+
+#ifdef _WIN32
+
+MetricsServer::MetricsServer(uint16_t port, Section appendSection)
+    : snapshot(std::make_unique_for_overwrite<StatusSegment::Payload>())
+    , generation(0)
+    , scrapeCopy(std::make_unique_for_overwrite<StatusSegment::Payload>())
+    , renderedGeneration(~uint64_t(0))
+    , extraSection(std::move(appendSection))
+    , scrapeCount(0)
+    , boundPort(0)
+    , listener(NO_SOCKET)
+    , acceptEvent(nullptr)
+    , stopEvent(nullptr)
+{
+    clearSnapshot(*snapshot);
+
+    WSADATA data;
+    if (WSAStartup(MAKEWORD(2, 2), &data) != 0) {
+        return;
+    }
+
+    SOCKET server = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (server == INVALID_SOCKET) {
+        WSACleanup();
+        return;
+    }
+    BOOL exclusive = TRUE;
+    setsockopt(server, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    int addressLength = sizeof(address);
+    acceptEvent = WSACreateEvent();
+    stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(server, SOMAXCONN) != 0 ||
+        getsockname(server, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0 ||
+        acceptEvent == WSA_INVALID_EVENT || !stopEvent ||
+        WSAEventSelect(server, acceptEvent, FD_ACCEPT) != 0) {
+        closesocket(server);
+        if (acceptEvent != WSA_INVALID_EVENT) WSACloseEvent(acceptEvent);
+        if (stopEvent) CloseHandle(stopEvent);
+        acceptEvent = nullptr;
+        stopEvent = nullptr;
+        WSACleanup();
+        return;
+    }
+
+    listener = static_cast<uintptr_t>(server);
+    boundPort = ntohs(address.sin_port);
+    thread = std::thread(&MetricsServer::serveLoop, this);
+}
+
+MetricsServer::~MetricsServer() {
+    if (!thread.joinable()) {
+        return;
+    }
+    SetEvent(stopEvent);
+    thread.join();
+    closesocket(static_cast<SOCKET>(listener));
+    WSACloseEvent(acceptEvent);
+    CloseHandle(stopEvent);
+    WSACleanup();
+}
+
+void MetricsServer::serveLoop() {
+    SOCKET server = static_cast<SOCKET>(listener);
+    while (true) {
+        HANDLE handles[] = { stopEvent, acceptEvent };
+        DWORD wait = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+        if (wait != WAIT_OBJECT_0 + 1) {
+            return;  // stop requested (or the wait failed)
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+        WSAResetEvent(acceptEvent);
+
+        SOCKET connection;
+        while ((connection = accept(server, nullptr, nullptr)) != INVALID_SOCKET) {
+            // Accepted sockets inherit the listener's event selection and
+            // non-blocking mode; serve them blocking with timeouts
+            WSAEventSelect(connection, nullptr, 0);
+            u_long blocking = 0;
+            ioctlsocket(connection, FIONBIO, &blocking);
+            DWORD timeout = IO_TIMEOUT_MS;
+            setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            serve(static_cast<uintptr_t>(connection));
+            closeSocket(static_cast<uintptr_t>(connection));
+        }
+    }
+}
+
+#else
+
+MetricsServer::MetricsServer(uint16_t port, Section appendSection)
+    : snapshot(std::make_unique_for_overwrite<StatusSegment::Payload>())
+    , generation(0)
+    , scrapeCopy(std::make_unique_for_overwrite<StatusSegment::Payload>())
+    , renderedGeneration(~uint64_t(0))
+    , extraSection(std::move(appendSection))
+    , scrapeCount(0)
+    , boundPort(0)
+    , listener(NO_SOCKET)
+    , stopFd(-1)
+{
+    clearSnapshot(*snapshot);
+
+    int server = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (server < 0) {
+        return;
+    }
+    int reuse = 1;
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));  // restart while old connections linger
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t addressLength = sizeof(address);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stopFd < 0 ||
+        bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(server, SOMAXCONN) != 0 ||
+        getsockname(server, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0) {
+        ::close(server);
+        if (stopFd >= 0) ::close(stopFd);
+        stopFd = -1;
+        return;
+    }
+
+    listener = static_cast<uintptr_t>(server);
+    boundPort = ntohs(address.sin_port);
+    thread = std::thread(&MetricsServer::serveLoop, this);
+}
+
+MetricsServer::~MetricsServer() {
+    if (!thread.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = ::write(stopFd, &one, sizeof(one));
+    thread.join();
+    ::close(static_cast<int>(listener));
+    ::close(stopFd);
+}
+
+void MetricsServer::serveLoop() {
+    int server = static_cast<int>(listener);
+    while (true) {
+        pollfd fds[] = { { stopFd, POLLIN, 0 }, { server, POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        if (fds[0].revents != 0) {
+            return;  // stop requested
+        }
+        ProcessTelemetry::count(ProcessTelemetry::Wakeup::Network);
+
+        int connection;
+        while ((connection = accept4(server, nullptr, nullptr, SOCK_CLOEXEC)) >= 0) {
+            timeval timeout = { IO_TIMEOUT_MS / 1000, (IO_TIMEOUT_MS % 1000) * 1000 };
+            setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            serve(static_cast<uintptr_t>(connection));
+            closeSocket(static_cast<uintptr_t>(connection));
+        }
+    }
+}
+
+#endif
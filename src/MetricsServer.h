@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include "DeviceTable.h"
+#include "StatusSegment.h"
+#include "StringPool.h"
+
+// Opt-in Prometheus endpoint (config `metricsPort`): a background thread
+// answers `GET /metrics` on 127.0.0.1 in the text exposition format.
+//
+// A scrape never touches devices. The UI thread hands over each refreshed
+// device table with update(), which copies it into a preallocated snapshot
+// (allocation-free, the StatusSegment payload layout). The server thread
+// renders the device section once per snapshot and, on every scrape, the
+// process-wide query counters and refresh latency histogram after it, into
+// buffers it reuses: after the first scrape answering costs a few
+// microseconds of formatting plus one send.
+//
+// Connections are served one at a time and closed after the response; the
+// listener is bound to the loopback interface only. An owner with more to
+// export (the collector's hosts) passes appendSection, which the server
+// thread calls at the end of every scrape.
+class MetricsServer {
+public:
+    using Section = std::function<void(std::string& out)>;
+
+    // port 0 picks a free port (see port())
+    explicit MetricsServer(uint16_t port, Section appendSection = nullptr);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // False if the port could not be bound (in use, no network stack)
+    bool isListening() const { return thread.joinable(); }
+    uint16_t port() const { return boundPort; }
+
+    // Replace the snapshot scrapes are answered from
+    void update(const DeviceTable& devices, const StringPool& strings,
+                int64_t now, std::optional<int64_t> staleSince);
+
+    // Scrapes answered so far
+    uint64_t scrapes() const { return scrapeCount.load(std::memory_order_relaxed); }
+
+    // Bytes held by the snapshots (the device slots used so far) and the
+    // scrape buffers (as of the last scrape)
+    size_t memoryUsage() const;
+
+    // The exposition text for a snapshot (appended to out): the per-device
+    // section, then the process-wide counters and refresh latency
+    static void render(std::string& out, const StatusSegment::Payload& snapshot);
+
+private:
+    static void renderDevices(std::string& out, const StatusSegment::Payload& snapshot);
+    static void renderCounters(std::string& out);
+
+    void serveLoop();
+    void serve(uintptr_t connection);
+
+    std::unique_ptr<StatusSegment::Payload> snapshot;
+    uint64_t generation;           // bumped by update()
+    std::mutex snapshotMutex;      // guards snapshot and generation
+    std::atomic<uint32_t> slotsUsed = 0;    // most devices a snapshot held
+
+    // Server thread only, reused across scrapes: the snapshot copied out
+    // under the lock (so update() never waits for formatting), its rendered
+    // device section, the body and the full response
+    std::unique_ptr<StatusSegment::Payload> scrapeCopy;
+    uint64_t renderedGeneration;
+    std::string deviceSection;
+    std::string body;
+    std::string response;
+    std::atomic<size_t> bufferBytes = 0;    // the three above, for memoryUsage()
+
+    Section extraSection;
+
+    std::thread thread;
+    std::atomic<uint64_t> scrapeCount;
+    uint16_t boundPort;
+    uintptr_t listener;     // SOCKET / fd
+
+#ifdef _WIN32
+    void* acceptEvent;      // HANDLE, signaled by WSAEventSelect on the listener
+    void* stopEvent;        // HANDLE, signaled by the destructor
+#else
+    int stopFd;             // eventfd, written by the destructor
+#endif
+};
@@ -0,0 +1,125 @@
+#include "MultiSourceBackend.h"
+#include "BinaryIO.h"
+#include "BluetoothAddress.h"
+#include "LatencyProbes.h"
+#include "TraceRecorder.h"
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+namespace {
+    constexpr uint64_t HASHED_IDENTITY = uint64_t(1) << 63;
+
+    char upper(char c) {
+        return (c >= 'a' && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+    }
+
+    bool startsWithFolded(std::string_view text, std::string_view prefix) {
+        if (text.size() < prefix.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < prefix.size(); i++) {
+            if (upper(text[i]) != upper(prefix[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // What one source listed; the backend's views are only valid during
+    // its callback, so the strings are copied
+    struct Listing {
+        std::vector<std::pair<std::string, std::string>> devices;
+        uint64_t nanoseconds = 0;
+    };
+}
+
+MultiSourceBackend::MultiSourceBackend(std::vector<Source> sources)
+    : sources(std::move(sources))
+{
+}
+
+void MultiSourceBackend::enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) {
+    Trace::Span span("enumerate sources");
+    std::vector<Listing> listings(sources.size());
+    auto list = [this, &listings](size_t index) {
+        Trace::Span sourceSpan("enumerate source", sources[index].name);
+        uint64_t started = LatencyProbes::now();
+        sources[index].backend->enumerate([&](std::string_view name, std::string_view instanceId) {
+            listings[index].devices.emplace_back(name, instanceId);
+        });
+        listings[index].nanoseconds = LatencyProbes::elapsedNanoseconds(started, LatencyProbes::now());
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < sources.size(); i++) {
+        workers.emplace_back(list, i);
+    }
+    if (!sources.empty()) {
+        list(0);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::unordered_set<uint64_t> seen;
+    std::vector<SourceTiming> result;
+    result.reserve(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        SourceTiming timing = {sources[i].name, listings[i].nanoseconds,
+                               static_cast<uint32_t>(listings[i].devices.size()), 0};
+        for (const auto& [name, instanceId] : listings[i].devices) {
+            if (!seen.insert(identityOf(instanceId)).second) {
+                timing.duplicates++;
+                continue;
+            }
+            onDevice(name, instanceId);
+        }
+        result.push_back(timing);
+    }
+
+    std::lock_guard<std::mutex> lock(timingsMutex);
+    timings = std::move(result);
+}
+
+DeviceBackend::Reading MultiSourceBackend::query(std::string_view instanceId) {
+    const Source* source = route(instanceId);
+    if (!source) {
+        return {false, std::nullopt, false};
+    }
+    return source->backend->query(instanceId);
+}
+
+std::string_view MultiSourceBackend::sourceOf(std::string_view instanceId) const {
+    const Source* source = route(instanceId);
+    return source ? std::string_view(source->name) : std::string_view();
+}
+
+std::vector<MultiSourceBackend::SourceTiming> MultiSourceBackend::lastEnumeration() const {
+    std::lock_guard<std::mutex> lock(timingsMutex);
+    return timings;
+}
+
+uint64_t MultiSourceBackend::identityOf(std::string_view instanceId) {
+    if (auto address = BluetoothAddress::fromDeviceNode(instanceId)) {
+        return *address;
+    }
+    // Windows instance IDs are case-insensitive
+    char folded[512];
+    if (instanceId.size() > sizeof(folded)) {
+        return BinaryIO::hash(instanceId) | HASHED_IDENTITY;
+    }
+    for (size_t i = 0; i < instanceId.size(); i++) {
+        folded[i] = upper(instanceId[i]);
+    }
+    return BinaryIO::hash(std::string_view(folded, instanceId.size())) | HASHED_IDENTITY;
+}
+
+const MultiSourceBackend::Source* MultiSourceBackend::route(std::string_view instanceId) const {
+    for (const auto& source : sources) {
+        if (startsWithFolded(instanceId, source.instanceIdPrefix)) {
+            return &source;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DeviceBackend.h"
+
+// Several device enumerators behind one DeviceBackend (on Windows the BTHLE,
+// BTHENUM, USB and HID enumerators; on Linux the power_supply class).
+//
+// enumerate() runs every source's enumerate() at the same time, the first
+// on the calling thread and each other one on a thread of its own, so a
+// scan takes as long as the slowest source rather than all of them in
+// turn. The listings are then reported in source order with duplicates
+// left out: two entries are the same device when they have the same
+// hardware identity (identityOf()), and the first one listed wins.
+// query() goes to the source whose instance ID prefix matches, so it
+// works for instance IDs from devices.cache before the first scan too.
+class MultiSourceBackend : public DeviceBackend {
+public:
+    struct Source {
+        std::string name;               // "BTHLE", "power_supply"
+        std::string instanceIdPrefix;   // "BTHLE\\" (ASCII case-insensitive); empty: any instance ID
+        std::shared_ptr<DeviceBackend> backend;
+    };
+
+    // One source's part in the last enumerate()
+    struct SourceTiming {
+        std::string_view name;
+        uint64_t nanoseconds;
+        uint32_t devices;       // listed by the source
+        uint32_t duplicates;    // of those, already listed (by an earlier source or this one)
+    };
+
+    explicit MultiSourceBackend(std::vector<Source> sources);
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override;
+    Reading query(std::string_view instanceId) override;
+
+    // Name of the source query() uses for this instance ID; empty if none
+    std::string_view sourceOf(std::string_view instanceId) const;
+
+    // Per-source timings of the last enumerate() that finished, in source
+    // order
+    std::vector<SourceTiming> lastEnumeration() const;
+
+    // The Bluetooth address for any Bluetooth device node
+    // (BluetoothAddress::fromDeviceNode), otherwise a hash of the instance
+    // ID with ASCII case folded (top bit set, so the two never collide)
+    static uint64_t identityOf(std::string_view instanceId);
+
+private:
+    const Source* route(std::string_view instanceId) const;
+
+    std::vector<Source> sources;
+    mutable std::mutex timingsMutex;
+    std::vector<SourceTiming> timings;
+};
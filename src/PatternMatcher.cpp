@@ -0,0 +1,273 @@
+#include "PatternMatcher.h"
+#include "BluetoothAddress.h"
+#include "MemoryAccounting.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+
+PatternMatcher::PatternMatcher()
+    : PatternMatcher({}, {}, false)
+{
+}
+
+PatternMatcher::PatternMatcher(const Config& config)
+    : PatternMatcher(config.namePatterns, config.devices, config.caseInsensitivePatterns)
+{
+}
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& namePatterns,
+                               const std::vector<DevicePattern>& devices,
+                               bool ignoreCase)
+    : fold(GlobSet::foldTable(ignoreCase))
+    , names(namePatterns, ignoreCase)
+    , ruleConstraint(devices.size(), NONE)
+    , instanceIds({}, true)
+{
+    // Device IDs are case-insensitive on Windows, so instance ID patterns
+    // always are; identical patterns share one constraint
+    auto caseFold = GlobSet::foldTable(true);
+    std::map<std::string, int32_t> constraintIds;
+    std::vector<std::string> constraints;
+
+    std::vector<std::map<uint8_t, uint32_t>> children(1);
+    std::vector<std::vector<uint32_t>> nodeRules(1);
+    ac.emplace_back();
+
+    for (size_t i = 0; i < devices.size(); i++) {
+        const auto& device = devices[i];
+        uint32_t index = static_cast<uint32_t>(i);
+        if (!device.enabled) continue;
+
+        if (auto address = BluetoothAddress::fromInstanceId(device.instanceIdPattern)) {
+            pinned.emplace(*address, index);  // first (lowest) index wins
+            continue;
+        }
+        if (device.name.empty()) continue;
+
+        if (!device.instanceIdPattern.empty()) {
+            std::string key = device.instanceIdPattern;
+            for (char& c : key) c = static_cast<char>(caseFold[static_cast<uint8_t>(c)]);
+            auto [it, inserted] = constraintIds.emplace(key, static_cast<int32_t>(constraints.size()));
+            if (inserted) constraints.push_back(device.instanceIdPattern);
+            ruleConstraint[i] = it->second;
+        }
+
+        uint32_t node = 0;
+        for (char ch : device.name) {
+            uint8_t b = fold[static_cast<uint8_t>(ch)];
+            auto found = children[node].find(b);
+            if (found == children[node].end()) {
+                ac.emplace_back();
+                children.emplace_back();
+                nodeRules.emplace_back();
+                found = children[node].emplace(b, static_cast<uint32_t>(ac.size() - 1)).first;
+            }
+            node = found->second;
+        }
+        nodeRules[node].push_back(index);
+    }
+
+    if (!constraints.empty()) {
+        instanceIds = GlobSet(constraints, true);
+    }
+    constraintCount = constraints.size();
+
+    // Flatten the build-time maps into sorted edge and rule arrays
+    for (size_t i = 0; i < ac.size(); i++) {
+        ac[i].firstEdge = static_cast<uint32_t>(acEdges.size());
+        ac[i].edgeCount = static_cast<uint32_t>(children[i].size());
+        for (const auto& [byte, target] : children[i]) {
+            acEdges.push_back({byte, {}, target});
+        }
+        ac[i].firstRule = static_cast<uint32_t>(acRules.size());
+        ac[i].ruleCount = static_cast<uint32_t>(nodeRules[i].size());
+        acRules.insert(acRules.end(), nodeRules[i].begin(), nodeRules[i].end());
+    }
+
+    // Breadth-first: a node's failure link points to the longest proper
+    // suffix that is also in the trie
+    acRoot.fill(0);
+    std::deque<uint32_t> queue;
+    for (const auto& [byte, target] : children[0]) {
+        acRoot[byte] = target;
+        queue.push_back(target);
+    }
+
+    while (!queue.empty()) {
+        uint32_t node = queue.front();
+        queue.pop_front();
+        for (const auto& [byte, target] : children[node]) {
+            uint32_t fail = ac[node].fail;
+            int32_t next = NONE;
+            while (fail != 0 && (next = findAcEdge(ac[fail], byte)) == NONE) {
+                fail = ac[fail].fail;
+            }
+            uint32_t targetFail = fail != 0 ? static_cast<uint32_t>(next) : acRoot[byte];
+            ac[target].fail = targetFail;
+            ac[target].outputLink = ac[targetFail].ruleCount > 0 ? targetFail : ac[targetFail].outputLink;
+            queue.push_back(target);
+        }
+    }
+}
+
+int32_t PatternMatcher::findAcEdge(const AcNode& node, uint8_t byte) const {
+    auto begin = acEdges.begin() + node.firstEdge;
+    auto end = begin + node.edgeCount;
+    auto it = std::lower_bound(begin, end, byte,
+        [](const AcEdge& edge, uint8_t b) { return edge.byte < b; });
+    return (it != end && it->byte == byte) ? static_cast<int32_t>(it->target) : NONE;
+}
+
+uint32_t PatternMatcher::matchDevices(std::string_view name, std::string_view instanceId, Cache& cache) const {
+    // Pinned addresses first; their index bounds the substring search
+    uint32_t best = NO_RULE;
+    if (!pinned.empty()) {
+        if (auto address = BluetoothAddress::fromInstanceId(instanceId)) {
+            auto found = pinned.find(*address);
+            if (found != pinned.end()) best = found->second;
+        }
+    }
+
+    // Instance ID constraints are evaluated once, on first use
+    bool constraintsEvaluated = false;
+    auto satisfied = [&](int32_t constraint) {
+        if (!constraintsEvaluated) {
+            instanceIds.matchAll(instanceId, cache.constraintHits, cache.instanceIds);
+            cache.constraintMatched.assign(constraintCount, 0);
+            for (uint32_t hit : cache.constraintHits) cache.constraintMatched[hit] = 1;
+            constraintsEvaluated = true;
+        }
+        return cache.constraintMatched[constraint] != 0;
+    };
+
+    uint32_t node = 0;
+    for (char ch : name) {
+        if (best == 0) break;  // nothing can beat the first rule
+
+        uint8_t byte = fold[static_cast<uint8_t>(ch)];
+        int32_t next = NONE;
+        while (node != 0 && (next = findAcEdge(ac[node], byte)) == NONE) {
+            node = ac[node].fail;
+        }
+        node = node != 0 ? static_cast<uint32_t>(next) : acRoot[byte];
+
+        // Every rule ending here, including those ending at suffixes
+        uint32_t output = ac[node].ruleCount > 0 ? node : ac[node].outputLink;
+        for (; output != 0; output = ac[output].outputLink) {
+            for (uint32_t r = 0; r < ac[output].ruleCount; r++) {
+                uint32_t rule = acRules[ac[output].firstRule + r];
+                if (rule >= best) continue;
+                int32_t constraint = ruleConstraint[rule];
+                if (constraint == NONE || satisfied(constraint)) {
+                    best = rule;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+std::optional<PatternMatcher::Match> PatternMatcher::match(std::string_view name, std::string_view instanceId,
+                                                           Cache& cache) const {
+    uint32_t glob = names.match(name, cache.names);
+    if (glob != GlobSet::NO_MATCH) {
+        return Match{Match::Kind::NamePattern, glob};
+    }
+
+    uint32_t device = matchDevices(name, instanceId, cache);
+    if (device != NO_RULE) {
+        return Match{Match::Kind::Device, device};
+    }
+
+    return std::nullopt;
+}
+
+namespace {
+    struct PinnedEntry {
+        uint64_t address;
+        uint32_t index;
+        uint32_t padding;
+    };
+}
+
+void PatternMatcher::serialize(BinaryIO::Writer& out) const {
+    out.write(fold);
+    names.serialize(out);
+    out.writeArray(ac);
+    out.writeArray(acEdges);
+    out.writeArray(acRules);
+    out.write(acRoot);
+    out.writeArray(ruleConstraint);
+    instanceIds.serialize(out);
+    out.write(static_cast<uint64_t>(constraintCount));
+
+    std::vector<PinnedEntry> entries;
+    entries.reserve(pinned.size());
+    for (const auto& [address, index] : pinned) {
+        entries.push_back({address, index, 0});
+    }
+    out.writeArray(entries);
+}
+
+std::optional<PatternMatcher> PatternMatcher::deserialize(BinaryIO::Reader& in) {
+    PatternMatcher matcher;
+    uint64_t constraints = 0;
+    std::vector<PinnedEntry> entries;
+
+    if (!in.read(matcher.fold)) return std::nullopt;
+    auto names = GlobSet::deserialize(in);
+    if (!names) return std::nullopt;
+    if (!in.readArray(matcher.ac) || !in.readArray(matcher.acEdges) || !in.readArray(matcher.acRules) ||
+        !in.read(matcher.acRoot) || !in.readArray(matcher.ruleConstraint)) {
+        return std::nullopt;
+    }
+    auto instanceIds = GlobSet::deserialize(in);
+    if (!instanceIds || !in.read(constraints) || !in.readArray(entries)) return std::nullopt;
+
+    matcher.names = std::move(*names);
+    matcher.instanceIds = std::move(*instanceIds);
+    matcher.constraintCount = static_cast<size_t>(constraints);
+
+    // Every index the matching loops follow must stay in range
+    const size_t nodeCount = matcher.ac.size();
+    const size_t ruleCount = matcher.ruleConstraint.size();
+    if (nodeCount == 0) return std::nullopt;
+    for (const AcNode& node : matcher.ac) {
+        if (static_cast<uint64_t>(node.firstEdge) + node.edgeCount > matcher.acEdges.size() ||
+            static_cast<uint64_t>(node.firstRule) + node.ruleCount > matcher.acRules.size() ||
+            node.fail >= nodeCount || node.outputLink >= nodeCount) {
+            return std::nullopt;
+        }
+    }
+    for (const AcEdge& edge : matcher.acEdges) {
+        if (edge.target >= nodeCount) return std::nullopt;
+    }
+    for (uint32_t target : matcher.acRoot) {
+        if (target >= nodeCount) return std::nullopt;
+    }
+    for (uint32_t rule : matcher.acRules) {
+        if (rule >= ruleCount) return std::nullopt;
+    }
+    for (int32_t constraint : matcher.ruleConstraint) {
+        if (constraint != NONE && (constraint < 0 || static_cast<uint64_t>(constraint) >= constraints)) {
+            return std::nullopt;
+        }
+    }
+
+    for (const PinnedEntry& entry : entries) {
+        if (entry.index >= ruleCount) return std::nullopt;
+        matcher.pinned.emplace(entry.address, entry.index);
+    }
+    return matcher;
+}
+
+size_t PatternMatcher::memoryUsage() const {
+    return names.memoryUsage() + instanceIds.memoryUsage() + MemoryAccounting::bytesOf(ac) +
+           MemoryAccounting::bytesOf(acEdges) + MemoryAccounting::bytesOf(acRules) +
+           MemoryAccounting::bytesOf(ruleConstraint) + MemoryAccounting::hashTableBytes(pinned);
+}
+
+size_t PatternMatcher::Cache::memoryUsage() const {
+    return names.memoryUsage() + instanceIds.memoryUsage() + MemoryAccounting::bytesOf(constraintHits) +
+           MemoryAccounting::bytesOf(constraintMatched);
+}
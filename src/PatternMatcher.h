@@ -0,0 +1,131 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "BinaryIO.h"
+#include "ConfigManager.h"
+#include "GlobSet.h"
+
+// Device rules of a Config compiled into automata, built once per config.
+//
+// namePatterns are full-match globs (see GlobSet). Enabled devices[] entries
+// come in two kinds:
+//  - pinned: instanceIdPattern names one Bluetooth address
+//    ("BTHLE\DEV_C8A2D3E4F501"). The entry matches that physical device,
+//    whatever its name, via a hash lookup on the 48-bit address.
+//  - by name: devices[].name is a substring rule matched with Aho-Corasick;
+//    a non-empty instanceIdPattern additionally has to match the device's
+//    instance ID as a case-insensitive glob (e.g. "BTHLE\DEV_*").
+// Either way a name is scanned once, byte by byte, no matter how many rules
+// there are.
+//
+// A compiled matcher is immutable and can be shared between threads (it is
+// published as part of a ConfigSnapshot). Each caller passes its own Cache,
+// which holds the lazily built glob DFAs and matching scratch.
+class PatternMatcher {
+public:
+    // Which rule matched: an index into Config::namePatterns or Config::devices
+    struct Match {
+        enum class Kind : uint8_t { NamePattern, Device };
+        Kind kind;
+        uint32_t index;
+    };
+
+    class Cache {
+    public:
+        // Glob DFA states built so far
+        size_t states() const { return names.states() + instanceIds.states(); }
+
+        // Bytes held by the DFAs and the scratch
+        size_t memoryUsage() const;
+
+    private:
+        friend class PatternMatcher;
+
+        GlobSet::Cache names;
+        GlobSet::Cache instanceIds;
+
+        // Constraint results for the device being matched
+        std::vector<uint32_t> constraintHits;
+        std::vector<uint8_t> constraintMatched;
+    };
+
+    // Matches nothing
+    PatternMatcher();
+
+    // Compile namePatterns and enabled devices of a config
+    explicit PatternMatcher(const Config& config);
+
+    // Compile explicit rule lists (indices refer to the vectors' positions)
+    PatternMatcher(const std::vector<std::string>& namePatterns,
+                   const std::vector<DevicePattern>& devices,
+                   bool ignoreCase);
+
+    // Find the rule a device (UTF-8 name and instance ID) matches.
+    // namePatterns take precedence over devices; within each, the lowest
+    // index wins.
+    std::optional<Match> match(std::string_view name, std::string_view instanceId, Cache& cache) const;
+
+    // Bytes held by the compiled tables
+    size_t memoryUsage() const;
+
+    // Number of devices[] entries pinned to a Bluetooth address
+    size_t pinnedDevices() const { return pinned.size(); }
+
+    // Compiled tables as flat arrays, so a cached config skips compilation
+    // (see ConfigCache). deserialize returns nullopt for inconsistent input.
+    void serialize(BinaryIO::Writer& out) const;
+    static std::optional<PatternMatcher> deserialize(BinaryIO::Reader& in);
+
+private:
+    static constexpr uint32_t NO_RULE = UINT32_MAX;
+    static constexpr int32_t NONE = -1;
+
+    // Aho-Corasick automaton over the substring rules. Rules ending at a node
+    // are rules[firstRule, firstRule + ruleCount); outputLink chains to the
+    // nearest proper suffix node that has rules of its own.
+    // Written to config.cache as is, so padding is explicit and zero
+    struct AcEdge {
+        uint8_t byte;
+        uint8_t padding[3];
+        uint32_t target;
+    };
+
+    struct AcNode {
+        uint32_t firstEdge = 0;
+        uint32_t edgeCount = 0;
+        uint32_t fail = 0;
+        uint32_t outputLink = 0;       // 0 = none (the root ends no rule)
+        uint32_t firstRule = 0;
+        uint32_t ruleCount = 0;
+    };
+
+    int32_t findAcEdge(const AcNode& node, uint8_t byte) const;
+
+    // Lowest device rule whose name occurs in the text and whose instance ID
+    // constraint (if any) holds
+    uint32_t matchDevices(std::string_view name, std::string_view instanceId, Cache& cache) const;
+
+    std::array<uint8_t, 256> fold;   // input byte -> matched byte (case folding)
+
+    GlobSet names;
+
+    std::vector<AcNode> ac;
+    std::vector<AcEdge> acEdges;
+    std::vector<uint32_t> acRules;     // device indices, grouped per node
+    std::array<uint32_t, 256> acRoot;  // dense transitions out of the root
+
+    // Per device index: constraint id into instanceIds, or NONE
+    std::vector<int32_t> ruleConstraint;
+    GlobSet instanceIds;               // distinct instanceIdPatterns
+
+    size_t constraintCount = 0;
+
+    // Bluetooth address -> lowest pinned device index
+    std::unordered_map<uint64_t, uint32_t> pinned;
+};
@@ -0,0 +1,77 @@
+#include "ProcessTelemetry.h"
+#include "DeviceMonitor.h"
+#include <atomic>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    constexpr const char* WAKEUP_NAMES[] = {
+        "refresh", "animation", "notification", "input", "files", "log", "network",
+    };
+    static_assert(sizeof(WAKEUP_NAMES) / sizeof(WAKEUP_NAMES[0]) == ProcessTelemetry::WAKEUP_COUNT);
+
+    std::array<std::atomic<uint64_t>, ProcessTelemetry::WAKEUP_COUNT> wakeupCounts = {};
+
+    // Static initialization runs before main(), close enough to the start
+    const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+    uint64_t cpuMicroseconds() {
+#ifdef _WIN32
+        FILETIME creation, exited, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &creation, &exited, &kernel, &user)) {
+            return 0;
+        }
+        auto ticks = [](const FILETIME& time) {
+            return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+        };
+        return (ticks(kernel) + ticks(user)) / 10;  // 100 ns units
+#else
+        rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        auto microseconds = [](const timeval& time) {
+            return static_cast<uint64_t>(time.tv_sec) * 1000000 + static_cast<uint64_t>(time.tv_usec);
+        };
+        return microseconds(usage.ru_utime) + microseconds(usage.ru_stime);
+#endif
+    }
+}
+
+const char* ProcessTelemetry::name(Wakeup cause) {
+    return WAKEUP_NAMES[static_cast<size_t>(cause)];
+}
+
+void ProcessTelemetry::count(Wakeup cause) {
+    wakeupCounts[static_cast<size_t>(cause)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ProcessTelemetry::Sample::totalWakeups() const {
+    uint64_t sum = 0;
+    for (uint64_t wakeupCount : wakeups) sum += wakeupCount;
+    return sum;
+}
+
+ProcessTelemetry::Sample ProcessTelemetry::sample() {
+    Sample sample;
+    sample.uptimeMilliseconds = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count());
+    sample.cpuMicroseconds = cpuMicroseconds();
+    sample.deviceQueries = DeviceMonitor::queryCounts().queries;
+    for (size_t i = 0; i < WAKEUP_COUNT; i++) {
+        sample.wakeups[i] = wakeupCounts[i].load(std::memory_order_relaxed);
+    }
+    return sample;
+}
+
+double ProcessTelemetry::perHour(uint64_t count, uint64_t uptimeMilliseconds) {
+    if (uptimeMilliseconds == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(count) * 3600000.0 / static_cast<double>(uptimeMilliseconds);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// What the process itself costs the machine while it sits in the tray: how
+// often each of its threads wakes up and why, the CPU time it has used and
+// the device queries it made. The tray and the headless service publish a
+// Sample with every status update, and `--status` shows it as rates per
+// hour, so an idle instance can be checked for overhead that should not be
+// there.
+//
+// A wakeup is counted where a thread returns from waiting: the window
+// procedure for the tray's timers and posted messages, the headless
+// service's wait, and the loops of the background threads (config watcher,
+// event log flush, metrics endpoint, collector sockets). Counting is one
+// relaxed atomic increment.
+namespace ProcessTelemetry {
+    enum class Wakeup {
+        RefreshTimer,       // the refreshInterval timer
+        AnimationTimer,     // a refresh animation frame or its end
+        Notification,       // another thread's message: scan done, config applied, collector resync
+        Input,              // tray icon clicks and menu commands
+        FileWatch,          // a change to config.json, or its debounced reload
+        LogFlush,           // the event log's flush thread
+        Network,            // a metrics scrape or a collector datagram
+        Count
+    };
+
+    constexpr size_t WAKEUP_COUNT = static_cast<size_t>(Wakeup::Count);
+
+    // Lowercase name, as in --status output
+    const char* name(Wakeup cause);
+
+    // Record a wakeup; lock-free, from any thread
+    void count(Wakeup cause);
+
+    struct Sample {
+        uint64_t uptimeMilliseconds = 0;    // since the process started
+        uint64_t cpuMicroseconds = 0;       // user and kernel time of all threads
+        uint64_t deviceQueries = 0;         // DeviceMonitor::queryCounts()
+        std::array<uint64_t, WAKEUP_COUNT> wakeups = {};
+
+        uint64_t operator[](Wakeup cause) const { return wakeups[static_cast<size_t>(cause)]; }
+        uint64_t totalWakeups() const;
+    };
+
+    // Counters so far, plus the process's CPU time (GetProcessTimes,
+    // getrusage); allocation-free
+    Sample sample();
+
+    // count per hour of uptime, 0 before the first millisecond
+    double perHour(uint64_t count, uint64_t uptimeMilliseconds);
+}
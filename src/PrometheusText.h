@@ -0,0 +1,56 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Building blocks of the Prometheus text exposition format (version 0.0.4),
+// shared by the metrics endpoint and the collector's host section. Numbers
+// are formatted with to_chars: no locale, no format parsing; everything is
+// appended to a caller-owned buffer so renders can reuse it.
+namespace PrometheusText {
+    // Label value with \, " and newline escaped; runs without any are
+    // appended in one piece
+    inline void appendLabel(std::string& out, const char* key, std::string_view value) {
+        out += key;
+        out += "=\"";
+        size_t run = 0;
+        for (size_t i = 0; i < value.size(); i++) {
+            char c = value[i];
+            if (c == '\\' || c == '"' || c == '\n') {
+                out.append(value.data() + run, i - run);
+                out += '\\';
+                out += c == '\n' ? 'n' : c;
+                run = i + 1;
+            }
+        }
+        out.append(value.data() + run, value.size() - run);
+        out += '"';
+    }
+
+    inline void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+        out += "# HELP ";
+        out += name;
+        out += ' ';
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += ' ';
+        out += type;
+        out += '\n';
+    }
+
+    // The value and the end of the line
+    inline void appendValue(std::string& out, int64_t value) {
+        char digits[24];
+        out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+        out += '\n';
+    }
+
+    inline void appendSample(std::string& out, const char* name, int64_t value) {
+        out += name;
+        out += ' ';
+        appendValue(out, value);
+    }
+}
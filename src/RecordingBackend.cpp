@@ -0,0 +1,193 @@
+#include "RecordingBackend.h"
+#include "BinaryIO.h"
+#include "DeviceStateCache.h"
+#include "LatencyProbes.h"
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+RecordingBackend::RecordingBackend(std::shared_ptr<DeviceBackend> source, const std::filesystem::path& path)
+    : inner(std::move(source))
+    , recording(false)
+    , buffer(new char[BUFFER_SIZE])
+    , used(0)
+    , table(new Slot[TABLE_SIZE]())
+    , deviceCount(0)
+    , dropped(0)
+    , originTicks(LatencyProbes::now())
+    , lastMicros(0)
+    , lastFlushMicros(0)
+{
+    // Unbuffered: records are batched in our own buffer, and a stream buffer
+    // would be allocated on the first write, inside the refresh path
+    file.rdbuf()->pubsetbuf(nullptr, 0);
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        return;
+    }
+
+    recording.store(true, std::memory_order_relaxed);
+    put(DeviceRecording::MAGIC, sizeof(DeviceRecording::MAGIC));
+    putVarint(DeviceRecording::FORMAT_VERSION);
+    putVarint(DeviceRecording::zigzag(DeviceStateCache::now()));
+    flushLocked();
+}
+
+RecordingBackend::~RecordingBackend() {
+    flush();
+}
+
+void RecordingBackend::enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) {
+    if (!isRecording()) {
+        inner->enumerate(onDevice);
+        return;
+    }
+
+    std::vector<std::pair<std::string, std::string>> found;
+    inner->enumerate([&](std::string_view name, std::string_view instanceId) {
+        found.emplace_back(name, instanceId);
+        onDevice(name, instanceId);
+    });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> indices;
+    indices.reserve(found.size());
+    for (const auto& [name, instanceId] : found) {
+        uint32_t index = deviceIndex(instanceId, name);
+        if (index != NO_INDEX) {
+            indices.push_back(index);
+        } else {
+            dropped++;
+        }
+    }
+
+    putTimed(DeviceRecording::ENUMERATE);
+    putVarint(indices.size());
+    for (uint32_t index : indices) {
+        putVarint(index);
+    }
+    // Rare, and the point a replay starts from: get it on disk now
+    flushLocked();
+}
+
+DeviceBackend::Reading RecordingBackend::query(std::string_view instanceId) {
+    Reading reading = inner->query(instanceId);
+    if (!isRecording()) {
+        return reading;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t index = deviceIndex(instanceId, std::nullopt);
+    if (index == NO_INDEX) {
+        dropped++;
+        return reading;
+    }
+
+    uint8_t flags = (reading.present ? DeviceRecording::PRESENT : 0) |
+                    (reading.isConnected ? DeviceRecording::CONNECTED : 0) |
+                    (reading.batteryLevel.has_value() ? DeviceRecording::HAS_LEVEL : 0);
+    putTimed(DeviceRecording::QUERY);
+    putVarint(index);
+    put(reinterpret_cast<const char*>(&flags), 1);
+    if (reading.batteryLevel.has_value()) {
+        putVarint(DeviceRecording::zigzag(*reading.batteryLevel));
+    }
+    flushIfDue();
+    return reading;
+}
+
+void RecordingBackend::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    flushLocked();
+}
+
+uint64_t RecordingBackend::droppedRecords() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dropped;
+}
+
+uint32_t RecordingBackend::deviceIndex(std::string_view instanceId, std::optional<std::string_view> name) {
+    uint64_t hash = BinaryIO::hash(instanceId);
+    if (hash == 0) hash = 1;
+
+    size_t position = static_cast<size_t>(hash) & (TABLE_SIZE - 1);
+    while (table[position].hash != 0 && table[position].hash != hash) {
+        position = (position + 1) & (TABLE_SIZE - 1);
+    }
+
+    Slot& slot = table[position];
+    if (slot.hash == 0) {
+        if (deviceCount == MAX_DEVICES) {
+            return NO_INDEX;
+        }
+        slot = {hash, deviceCount++, false};
+    } else if (slot.named || !name.has_value()) {
+        return slot.index;
+    }
+
+    // New device, or one first seen by a query and now enumerated with its name
+    slot.named = name.has_value();
+    std::string_view deviceName = name.value_or(std::string_view());
+    char tag = DeviceRecording::DEVICE;
+    put(&tag, 1);
+    putVarint(slot.index);
+    putVarint(deviceName.size());
+    put(deviceName.data(), deviceName.size());
+    putVarint(instanceId.size());
+    put(instanceId.data(), instanceId.size());
+    return slot.index;
+}
+
+void RecordingBackend::putTimed(DeviceRecording::Tag tag) {
+    uint64_t micros = LatencyProbes::elapsedNanoseconds(originTicks, LatencyProbes::now()) / 1000;
+    if (micros < lastMicros) micros = lastMicros;
+
+    char bytes[1 + DeviceRecording::MAX_VARINT];
+    bytes[0] = static_cast<char>(tag);
+    size_t length = 1 + DeviceRecording::encodeVarint(micros - lastMicros, bytes + 1);
+    put(bytes, length);
+    lastMicros = micros;
+}
+
+void RecordingBackend::putVarint(uint64_t value) {
+    char bytes[DeviceRecording::MAX_VARINT];
+    put(bytes, DeviceRecording::encodeVarint(value, bytes));
+}
+
+void RecordingBackend::put(const char* data, size_t length) {
+    if (length > BUFFER_SIZE - used) {
+        flushLocked();
+    }
+    if (length > BUFFER_SIZE) {
+        if (file.is_open() && !file.write(data, static_cast<std::streamsize>(length))) {
+            stopRecording();
+        }
+        return;
+    }
+    if (length > 0) {
+        std::memcpy(buffer.get() + used, data, length);
+        used += length;
+    }
+}
+
+void RecordingBackend::flushLocked() {
+    if (used > 0 && file.is_open()) {
+        if (!file.write(buffer.get(), static_cast<std::streamsize>(used)) || !file.flush()) {
+            stopRecording();  // disk full or gone: keep working without it
+        }
+    }
+    used = 0;
+    lastFlushMicros = lastMicros;
+}
+
+void RecordingBackend::flushIfDue() {
+    if (lastMicros - lastFlushMicros >= FLUSH_INTERVAL_US) {
+        flushLocked();
+    }
+}
+
+void RecordingBackend::stopRecording() {
+    file.close();
+    recording.store(false, std::memory_order_relaxed);
+}
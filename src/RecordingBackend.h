@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include "DeviceBackend.h"
+#include "DeviceRecording.h"
+
+// Passes every call through to another backend and appends what it returned,
+// with a timestamp, to a device recording (see DeviceRecording.h). Used to
+// capture field problems (a device flapping between connected and
+// disconnected, a driver reporting nonsense levels) for ReplayBackend.
+//
+// query() stays allocation-free: records go into a buffer allocated up
+// front, devices are numbered through a fixed hash table, and the buffer is
+// written out when it fills or every few seconds. Up to MAX_DEVICES distinct
+// devices are recorded; results for further ones are counted as dropped.
+class RecordingBackend : public DeviceBackend {
+public:
+    static constexpr size_t MAX_DEVICES = 4096;
+
+    // Creates (or truncates) path; if it cannot be opened, or a write
+    // fails later, the backend only passes calls through
+    RecordingBackend(std::shared_ptr<DeviceBackend> inner, const std::filesystem::path& path);
+    ~RecordingBackend() override;
+
+    RecordingBackend(const RecordingBackend&) = delete;
+    RecordingBackend& operator=(const RecordingBackend&) = delete;
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override;
+    Reading query(std::string_view instanceId) override;
+
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    // Write out everything recorded so far
+    void flush();
+
+    // Results not recorded because the device table was full
+    uint64_t droppedRecords() const;
+
+private:
+    static constexpr size_t BUFFER_SIZE = 64 * 1024;
+    static constexpr size_t TABLE_SIZE = MAX_DEVICES * 2;  // power of two, at most half full
+    static constexpr uint32_t NO_INDEX = UINT32_MAX;
+    static constexpr uint64_t FLUSH_INTERVAL_US = 5'000'000;
+
+    struct Slot {
+        uint64_t hash;   // of the instance ID; 0 = empty
+        uint32_t index;
+        bool named;      // a DEVICE record with its enumerated name was written
+    };
+
+    // All of the following run with the mutex held
+    // Index of a device, defining it first if new (name is unknown when
+    // the device was not enumerated through this backend, e.g. restored
+    // from the warm-start cache); NO_INDEX once the table is full
+    uint32_t deviceIndex(std::string_view instanceId, std::optional<std::string_view> name);
+    void putTimed(DeviceRecording::Tag tag);  // tag and time since the last timed record
+    void putVarint(uint64_t value);
+    void put(const char* data, size_t length);
+    void flushLocked();
+    void flushIfDue();
+    void stopRecording();
+
+    std::shared_ptr<DeviceBackend> inner;
+    std::atomic<bool> recording;
+
+    mutable std::mutex mutex;
+    std::ofstream file;
+    std::unique_ptr<char[]> buffer;
+    size_t used;
+    std::unique_ptr<Slot[]> table;
+    uint32_t deviceCount;
+    uint64_t dropped;
+
+    uint64_t originTicks;
+    uint64_t lastMicros;
+    uint64_t lastFlushMicros;
+};
@@ -0,0 +1,13 @@
+#include "RefreshArena.h"
+
+RefreshArena::RefreshArena()
+    : buffer{}
+    , monotonic(buffer.data(), buffer.size(), std::pmr::new_delete_resource())
+{
+}
+
+void RefreshArena::reset() {
+    // release() rewinds to the start of the inline buffer and returns any
+    // spilled blocks to the upstream resource
+    monotonic.release();
+}
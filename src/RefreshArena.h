@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+
+// Scratch memory for a single refresh cycle.
+// Everything a refresh only needs until the tray icon has been updated
+// (the tooltip text) is carved out of a fixed inline
+// buffer and released in one step by reset(). If a cycle ever outgrows the
+// buffer it spills to the global heap, so it keeps working - it just stops
+// being allocation-free.
+class RefreshArena {
+public:
+    RefreshArena();
+
+    // The arena owns its buffer; copying or moving it would leave the
+    // resource pointing at the wrong storage
+    RefreshArena(const RefreshArena&) = delete;
+    RefreshArena& operator=(const RefreshArena&) = delete;
+
+    // Memory resource to hand to std::pmr containers
+    std::pmr::memory_resource* resource() { return &monotonic; }
+
+    // Release everything allocated since the last reset (end of cycle)
+    void reset();
+
+    // Resets the arena when it goes out of scope. Declare it before any arena
+    // backed container so those are destroyed first.
+    class Scope {
+    public:
+        explicit Scope(RefreshArena& arena) : arena(arena) {}
+        ~Scope() { arena.reset(); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        RefreshArena& arena;
+    };
+
+private:
+    // Far more than a tooltip needs (the shell caps it at 128 characters)
+    static constexpr size_t BUFFER_SIZE = 16 * 1024;
+
+    alignas(std::max_align_t) std::array<std::byte, BUFFER_SIZE> buffer;
+    std::pmr::monotonic_buffer_resource monotonic;
+};
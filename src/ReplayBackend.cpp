@@ -0,0 +1,174 @@
+#include "ReplayBackend.h"
+#include "DeviceRecording.h"
+#include "LatencyProbes.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+std::shared_ptr<ReplayBackend> ReplayBackend::open(const std::filesystem::path& path) {
+    MappedFile file(path);
+    if (!file.isValid()) {
+        return nullptr;
+    }
+    return fromBytes(file.contents());
+}
+
+std::shared_ptr<ReplayBackend> ReplayBackend::fromBytes(std::string_view data) {
+    std::shared_ptr<ReplayBackend> replay(new ReplayBackend());
+    if (!replay->parse(data)) {
+        return nullptr;
+    }
+    return replay;
+}
+
+ReplayBackend::ReplayBackend()
+    : queries(0)
+    , length(0)
+    , recordedAt(0)
+    , anchorPosition(0)
+    , anchorTicks(LatencyProbes::now())
+    , speed(1.0)
+{
+}
+
+bool ReplayBackend::parse(std::string_view data) {
+    DeviceRecording::Reader in(data);
+    uint64_t version = 0;
+    uint64_t started = 0;
+    if (!in.readMagic() || !in.readVarint(version) || version != DeviceRecording::FORMAT_VERSION ||
+        !in.readVarint(started)) {
+        return false;
+    }
+    recordedAt = DeviceRecording::unzigzag(started);
+
+    // Each record is applied only once it has been read completely
+    uint64_t time = 0;
+    uint8_t tag = 0;
+    while (in.readByte(tag)) {
+        if (tag == DeviceRecording::DEVICE) {
+            uint64_t index = 0;
+            Device device;
+            if (!in.readVarint(index) || index > devices.size() ||
+                !in.readString(device.name) || !in.readString(device.instanceId)) {
+                break;
+            }
+            if (index == devices.size()) {
+                devices.push_back(std::move(device));
+            } else {
+                devices[index].name = std::move(device.name);
+            }
+        } else if (tag == DeviceRecording::ENUMERATE) {
+            uint64_t delta = 0;
+            uint64_t count = 0;
+            Enumeration enumeration;
+            bool complete = in.readVarint(delta) && in.readVarint(count) && count <= devices.size();
+            for (uint64_t i = 0; complete && i < count; i++) {
+                uint64_t index = 0;
+                complete = in.readVarint(index) && index < devices.size();
+                enumeration.devices.push_back(static_cast<uint32_t>(index));
+            }
+            if (!complete) {
+                break;
+            }
+            time += delta;
+            enumeration.time = time;
+            enumerations.push_back(std::move(enumeration));
+        } else if (tag == DeviceRecording::QUERY) {
+            uint64_t delta = 0;
+            uint64_t index = 0;
+            uint8_t flags = 0;
+            uint64_t level = 0;
+            if (!in.readVarint(delta) || !in.readVarint(index) || index >= devices.size() || !in.readByte(flags) ||
+                ((flags & DeviceRecording::HAS_LEVEL) && !in.readVarint(level))) {
+                break;
+            }
+            time += delta;
+            Reading reading = {(flags & DeviceRecording::PRESENT) != 0, std::nullopt,
+                               (flags & DeviceRecording::CONNECTED) != 0};
+            if (flags & DeviceRecording::HAS_LEVEL) {
+                reading.batteryLevel = static_cast<int>(std::clamp<int64_t>(DeviceRecording::unzigzag(level),
+                                                                            INT_MIN, INT_MAX));
+            }
+            devices[index].samples.push_back({time, reading});
+            queries++;
+        } else {
+            break;  // garbage: treat like a torn tail
+        }
+    }
+    length = time;
+
+    byInstanceId.reserve(devices.size());
+    for (uint32_t i = 0; i < devices.size(); i++) {
+        byInstanceId.emplace(devices[i].instanceId, i);
+    }
+    return true;
+}
+
+void ReplayBackend::enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) {
+    if (enumerations.empty()) {
+        return;
+    }
+    uint64_t now = position();
+    auto after = std::upper_bound(enumerations.begin(), enumerations.end(), now,
+                                  [](uint64_t time, const Enumeration& e) { return time < e.time; });
+    const Enumeration& current = after == enumerations.begin() ? enumerations.front() : *(after - 1);
+    for (uint32_t index : current.devices) {
+        onDevice(devices[index].name, devices[index].instanceId);
+    }
+}
+
+DeviceBackend::Reading ReplayBackend::query(std::string_view instanceId) {
+    auto it = byInstanceId.find(instanceId);
+    if (it == byInstanceId.end() || devices[it->second].samples.empty()) {
+        return {false, std::nullopt, false};
+    }
+
+    const std::vector<Sample>& samples = devices[it->second].samples;
+    uint64_t now = position();
+    auto after = std::upper_bound(samples.begin(), samples.end(), now,
+                                  [](uint64_t time, const Sample& s) { return time < s.time; });
+    return after == samples.begin() ? samples.front().reading : (after - 1)->reading;
+}
+
+void ReplayBackend::setSpeed(double multiplier) {
+    std::lock_guard<std::mutex> lock(clockMutex);
+    anchorPosition = positionLocked();
+    anchorTicks = LatencyProbes::now();
+    speed = std::isfinite(multiplier) && multiplier > 0.0 ? multiplier : 0.0;
+}
+
+void ReplayBackend::seek(uint64_t microseconds) {
+    std::lock_guard<std::mutex> lock(clockMutex);
+    anchorPosition = microseconds;
+    anchorTicks = LatencyProbes::now();
+}
+
+uint64_t ReplayBackend::position() const {
+    std::lock_guard<std::mutex> lock(clockMutex);
+    return positionLocked();
+}
+
+uint64_t ReplayBackend::positionLocked() const {
+    if (speed == 0.0) {
+        return anchorPosition;
+    }
+    double elapsed = static_cast<double>(LatencyProbes::elapsedNanoseconds(anchorTicks, LatencyProbes::now())) / 1000.0;
+    return anchorPosition + static_cast<uint64_t>(elapsed * speed);
+}
+
+std::vector<uint64_t> ReplayBackend::eventTimes() const {
+    std::vector<uint64_t> times;
+    times.reserve(queries + enumerations.size());
+    for (const auto& enumeration : enumerations) {
+        times.push_back(enumeration.time);
+    }
+    for (const auto& device : devices) {
+        for (const auto& sample : device.samples) {
+            times.push_back(sample.time);
+        }
+    }
+    std::sort(times.begin(), times.end());
+    times.erase(std::unique(times.begin(), times.end()), times.end());
+    return times;
+}
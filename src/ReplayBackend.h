@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DeviceBackend.h"
+
+// Plays a device recording (RecordingBackend, DeviceRecording.h) back as a
+// backend, so the monitor and everything above it see exactly the sequence
+// that was captured: devices appearing and vanishing, connection flapping,
+// out-of-range levels (replayed raw, as the driver reported them).
+//
+// Recorded time follows a playback clock. enumerate() returns the last
+// enumeration completed by the current position and query() the last
+// reading taken by then (before a device's first reading, that first one).
+// The clock runs at a multiple of real time (1 = as recorded, 1000 for load
+// tests) or, at speed 0, moves only by seek() for deterministic stepping.
+// After the end the final state holds.
+class ReplayBackend : public DeviceBackend {
+public:
+    // nullptr if the file is not a device recording; a torn tail (the
+    // recording process died mid-write) is dropped
+    static std::shared_ptr<ReplayBackend> open(const std::filesystem::path& path);
+    static std::shared_ptr<ReplayBackend> fromBytes(std::string_view data);
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override;
+    Reading query(std::string_view instanceId) override;
+
+    // Playback clock, in microseconds of recorded time; a speed that is
+    // not a finite positive number (0, NaN) pauses it
+    void setSpeed(double multiplier);
+    void seek(uint64_t microseconds);
+    uint64_t position() const;
+    uint64_t duration() const { return length; }
+    bool finished() const { return position() >= length; }
+
+    // When the recording was started (seconds since the Unix epoch)
+    int64_t startedAt() const { return recordedAt; }
+
+    size_t deviceCount() const { return devices.size(); }
+    size_t enumerationCount() const { return enumerations.size(); }
+    size_t queryCount() const { return queries; }
+
+    // Recorded times (ascending) at which something was queried or
+    // enumerated, for stepping through a recording with seek()
+    std::vector<uint64_t> eventTimes() const;
+
+private:
+    struct Sample {
+        uint64_t time;
+        Reading reading;
+    };
+
+    struct Device {
+        std::string name;
+        std::string instanceId;
+        std::vector<Sample> samples;  // ascending time
+    };
+
+    struct Enumeration {
+        uint64_t time;
+        std::vector<uint32_t> devices;
+    };
+
+    ReplayBackend();
+    bool parse(std::string_view data);
+    uint64_t positionLocked() const;
+
+    std::vector<Device> devices;
+    std::unordered_map<std::string_view, uint32_t> byInstanceId;  // views into devices
+    std::vector<Enumeration> enumerations;
+    size_t queries;
+    uint64_t length;
+    int64_t recordedAt;
+
+    mutable std::mutex clockMutex;
+    uint64_t anchorPosition;  // position at anchorTicks
+    uint64_t anchorTicks;
+    double speed;
+};
@@ -0,0 +1,200 @@
+#include "SetupApiBackend.h"
+#include "LatencyProbes.h"
+#include "SafeHandles.h"
+#include "Utf8.h"
+#include <windows.h>
+#include <setupapi.h>
+#include <cfgmgr32.h>
+#include <devpkey.h>
+#include <initguid.h>
+#include <string_view>
+#include <utility>
+
+// Battery level property key: {104EA319-6EE2-4701-BD47-8DDBF425BBE5} 2
+DEFINE_GUID(GUID_BATTERY_LEVEL,
+    0x104EA319, 0x6EE2, 0x4701, 0xBD, 0x47, 0x8D, 0xDB, 0xF4, 0x25, 0xBB, 0xE5);
+
+const DEVPROPKEY DEVPKEY_Device_BatteryLevel = {
+    GUID_BATTERY_LEVEL,
+    2  // Property ID
+};
+
+// Connection status property key: DEVPKEY_Device_IsConnected
+// GUID: {83da6326-97a6-4088-9453-a1923f573b29}, Property ID: 15
+DEFINE_GUID(GUID_DEVICE_ISCONNECTED,
+    0x83da6326, 0x97a6, 0x4088, 0x94, 0x53, 0xa1, 0x92, 0x3f, 0x57, 0x3b, 0x29);
+
+const DEVPROPKEY DEVPKEY_Device_IsConnected_Custom = {
+    GUID_DEVICE_ISCONNECTED,
+    15  // Property ID (correct value!)
+};
+
+SetupApiBackend::SetupApiBackend(std::wstring enumerator)
+    : enumerator(std::move(enumerator))
+    , instanceIdPrefix(this->enumerator + L"\\")
+{
+}
+
+std::shared_ptr<MultiSourceBackend> SetupApiBackend::systemSources() {
+    // In order of preference when one device shows up under several:
+    // the Bluetooth nodes carry the battery level
+    std::vector<MultiSourceBackend::Source> sources;
+    for (const wchar_t* name : {L"BTHLE", L"BTHENUM", L"USB", L"HID"}) {
+        std::string utf8 = Utf8::fromWide(name);
+        sources.push_back({utf8, utf8 + "\\", std::make_shared<SetupApiBackend>(name)});
+    }
+    return std::make_shared<MultiSourceBackend>(std::move(sources));
+}
+
+void SetupApiBackend::enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) {
+    // Get device information set for this enumerator's devices
+    DeviceInfoHandle deviceInfo(
+        SetupDiGetClassDevsW(
+            nullptr,
+            enumerator.c_str(),
+            nullptr,
+            DIGCF_ALLCLASSES | DIGCF_PRESENT
+        )
+    );
+
+    if (!deviceInfo.isValid()) {
+        return;  // No devices on failure
+    }
+
+    SP_DEVINFO_DATA deviceInfoData = {};
+    deviceInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    // Enumerate all devices
+    auto nextDevice = [&](DWORD index) {
+        return LatencyProbes::timed(LatencyProbes::Site::EnumDeviceInfo, [&] {
+            return SetupDiEnumDeviceInfo(deviceInfo.get(), index, &deviceInfoData);
+        });
+    };
+    for (DWORD i = 0; nextDevice(i); ++i) {
+        // Get device instance ID
+        WCHAR instanceId[MAX_PATH] = {};
+        if (!SetupDiGetDeviceInstanceIdW(
+                deviceInfo.get(),
+                &deviceInfoData,
+                instanceId,
+                MAX_PATH,
+                nullptr)) {
+            continue;
+        }
+
+        // Get device description/name
+        WCHAR deviceName[256] = {};
+        DWORD propertyType = 0;
+        if (!SetupDiGetDeviceRegistryPropertyW(
+                deviceInfo.get(),
+                &deviceInfoData,
+                SPDRP_FRIENDLYNAME,
+                &propertyType,
+                reinterpret_cast<PBYTE>(deviceName),
+                sizeof(deviceName),
+                nullptr)) {
+            continue;
+        }
+
+        // Check that the node belongs to this enumerator
+        std::wstring_view instId(instanceId);
+        if (!instId.starts_with(instanceIdPrefix)) {
+            continue;
+        }
+
+        // Convert name and instance ID once at the OS boundary into stack
+        // buffers; the monitor interns only the devices that match
+        char nameUtf8[512];
+        char instanceIdUtf8[MAX_PATH * 3];
+        auto nameLength = Utf8::fromWide(deviceName, nameUtf8, sizeof(nameUtf8));
+        auto instanceIdLength = Utf8::fromWide(instId, instanceIdUtf8, sizeof(instanceIdUtf8));
+        if (!nameLength.has_value() || !instanceIdLength.has_value()) {
+            continue;
+        }
+        onDevice(std::string_view(nameUtf8, *nameLength), std::string_view(instanceIdUtf8, *instanceIdLength));
+    }
+}
+
+
+DeviceBackend::Reading SetupApiBackend::query(std::string_view instanceId) {
+    // Locate the node once and query both properties from it
+    DWORD devInst = 0;
+    if (!getDeviceNode(instanceId, devInst)) {
+        return {false, std::nullopt, false};
+    }
+    return {true, getBatteryLevel(devInst), isDeviceConnected(devInst)};
+}
+
+bool SetupApiBackend::getDeviceNode(std::string_view instanceId, DWORD& devInst) {
+    // Instance IDs are stored as UTF-8; widen into a stack buffer for the API
+    WCHAR wideInstanceId[MAX_PATH];
+    if (!Utf8::toWide(instanceId, wideInstanceId, MAX_PATH)) {
+        return false;
+    }
+
+    // Convert instance ID to device node
+    LatencyProbes::Probe probe(LatencyProbes::Site::LocateDevNode);
+    CONFIGRET ret = CM_Locate_DevNodeW(
+        &devInst,
+        wideInstanceId,
+        CM_LOCATE_DEVNODE_NORMAL
+    );
+
+    return ret == CR_SUCCESS;
+}
+
+std::optional<int> SetupApiBackend::getBatteryLevel(DWORD devInst) {
+    // Query battery level property
+    BYTE buffer[256] = {};
+    ULONG bufferSize = sizeof(buffer);
+    DEVPROPTYPE propertyType = 0;
+
+    CONFIGRET ret = LatencyProbes::timed(LatencyProbes::Site::GetDevNodeProperty, [&] {
+        return CM_Get_DevNode_PropertyW(
+            devInst,
+            &DEVPKEY_Device_BatteryLevel,
+            &propertyType,
+            buffer,
+            &bufferSize,
+            0
+        );
+    });
+
+    if (ret != CR_SUCCESS || propertyType != DEVPROP_TYPE_BYTE) {
+        return std::nullopt;
+    }
+
+    // Battery level is returned as a byte (0-100)
+    int batteryLevel = static_cast<int>(buffer[0]);
+    if (batteryLevel >= 0 && batteryLevel <= 100) {
+        return batteryLevel;
+    }
+
+    return std::nullopt;
+}
+
+bool SetupApiBackend::isDeviceConnected(DWORD devInst) {
+    // Query connection status property
+    BYTE buffer[256] = {};
+    ULONG bufferSize = sizeof(buffer);
+    DEVPROPTYPE propertyType = 0;
+
+    CONFIGRET ret = LatencyProbes::timed(LatencyProbes::Site::GetDevNodeProperty, [&] {
+        return CM_Get_DevNode_PropertyW(
+            devInst,
+            &DEVPKEY_Device_IsConnected_Custom,
+            &propertyType,
+            buffer,
+            &bufferSize,
+            0
+        );
+    });
+
+    if (ret != CR_SUCCESS || propertyType != DEVPROP_TYPE_BOOLEAN) {
+        return false;
+    }
+
+    // Connection status is returned as DEVPROP_BOOLEAN (DEVPROP_TRUE/DEVPROP_FALSE)
+    DEVPROP_BOOLEAN isConnected = *reinterpret_cast<DEVPROP_BOOLEAN*>(buffer);
+    return isConnected == DEVPROP_TRUE;
+}
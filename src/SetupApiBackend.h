@@ -0,0 +1,36 @@
+#pragma once
+
+#include <windows.h>
+#include <memory>
+#include <string>
+#include "DeviceBackend.h"
+#include "MultiSourceBackend.h"
+
+// Devices as Windows sees them: SetupAPI enumerates the device nodes of one
+// enumerator (BTHLE unless told otherwise), the Configuration Manager reads
+// battery level and connection state from each device node. Immutable, so
+// safe to share across threads.
+class SetupApiBackend : public DeviceBackend {
+public:
+    explicit SetupApiBackend(std::wstring enumerator = L"BTHLE");
+
+    // Bluetooth LE, classic Bluetooth (BTHENUM), USB and HID device nodes,
+    // enumerated in parallel and merged by hardware identity
+    static std::shared_ptr<MultiSourceBackend> systemSources();
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override;
+    Reading query(std::string_view instanceId) override;
+
+private:
+    // Get device node instance from instance ID
+    static bool getDeviceNode(std::string_view instanceId, DWORD& devInst);
+
+    // Query battery level for a located device node
+    static std::optional<int> getBatteryLevel(DWORD devInst);
+
+    // Check if device is actually connected (not just paired)
+    static bool isDeviceConnected(DWORD devInst);
+
+    std::wstring enumerator;
+    std::wstring instanceIdPrefix;  // enumerator + '\\'
+};
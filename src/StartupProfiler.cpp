@@ -0,0 +1,104 @@
+#include "StartupProfiler.h"
+#include "BinaryIO.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <string_view>
+#endif
+
+StartupProfiler::StartupProfiler() : origin(Clock::now()) {
+}
+
+double StartupProfiler::sinceStart(Clock::time_point time) const {
+    double ms = std::chrono::duration<double, std::milli>(time - origin).count();
+    return ms + processStartOffsetMs.value_or(0.0);
+}
+
+void StartupProfiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    phaseList.push_back({name, sinceStart(start), std::chrono::duration<double, std::milli>(end - start).count()});
+}
+
+void StartupProfiler::mark(const char* name) {
+    milestoneList.push_back({name, sinceStart(Clock::now())});
+}
+
+std::optional<StartupProfiler::MemoryUsage> StartupProfiler::sampleMemory() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    counters.cb = sizeof(counters);
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                              sizeof(counters))) {
+        return std::nullopt;
+    }
+    return MemoryUsage{counters.WorkingSetSize, counters.PeakWorkingSetSize, counters.PrivateUsage};
+#else
+    // VmRSS / VmHWM / RssAnon are the closest Linux equivalents
+    std::ifstream status("/proc/self/status");
+    if (!status.is_open()) {
+        return std::nullopt;
+    }
+    MemoryUsage usage = {0, 0, 0};
+    std::string line;
+    while (std::getline(status, line)) {
+        std::string_view view(line);
+        auto kilobytes = [&](std::string_view key, uint64_t& out) {
+            if (!view.starts_with(key)) return;
+            unsigned long long value = 0;
+            if (std::sscanf(line.c_str() + key.size(), "%llu", &value) == 1) out = value * 1024;
+        };
+        kilobytes("VmRSS:", usage.workingSet);
+        kilobytes("VmHWM:", usage.peakWorkingSet);
+        kilobytes("RssAnon:", usage.privateBytes);
+    }
+    return usage;
+#endif
+}
+
+std::string StartupProfiler::report(std::optional<uint64_t> executableBytes) const {
+    std::string json = "{\n";
+    char buffer[256];
+
+    std::snprintf(buffer, sizeof(buffer), "  \"timeOrigin\": \"%s\",\n",
+                  processStartOffsetMs ? "process creation" : "profiler start");
+    json += buffer;
+
+    json += "  \"phases\": [";
+    for (size_t i = 0; i < phaseList.size(); i++) {
+        std::snprintf(buffer, sizeof(buffer), "%s\n    { \"name\": \"%s\", \"startMs\": %.3f, \"durationMs\": %.3f }",
+                      i > 0 ? "," : "", phaseList[i].name.c_str(), phaseList[i].startMs, phaseList[i].durationMs);
+        json += buffer;
+    }
+    json += phaseList.empty() ? "],\n" : "\n  ],\n";
+
+    json += "  \"milestones\": [";
+    for (size_t i = 0; i < milestoneList.size(); i++) {
+        std::snprintf(buffer, sizeof(buffer), "%s\n    { \"name\": \"%s\", \"atMs\": %.3f }",
+                      i > 0 ? "," : "", milestoneList[i].name.c_str(), milestoneList[i].atMs);
+        json += buffer;
+    }
+    json += milestoneList.empty() ? "]" : "\n  ]";
+
+    if (auto memory = sampleMemory()) {
+        std::snprintf(buffer, sizeof(buffer),
+                      ",\n  \"memory\": { \"workingSetKB\": %llu, \"peakWorkingSetKB\": %llu, \"privateKB\": %llu }",
+                      static_cast<unsigned long long>(memory->workingSet / 1024),
+                      static_cast<unsigned long long>(memory->peakWorkingSet / 1024),
+                      static_cast<unsigned long long>(memory->privateBytes / 1024));
+        json += buffer;
+    }
+    if (executableBytes.has_value()) {
+        std::snprintf(buffer, sizeof(buffer), ",\n  \"executableKB\": %llu",
+                      static_cast<unsigned long long>(*executableBytes / 1024));
+        json += buffer;
+    }
+    json += "\n}\n";
+    return json;
+}
+
+bool StartupProfiler::writeReport(const std::filesystem::path& path, std::optional<uint64_t> executableBytes) const {
+    return BinaryIO::replaceFile(path, report(executableBytes));
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Times named startup phases and milestones and writes them, together with
+// the process's memory footprint, as a small JSON report
+// (startup-report.json next to the executable) that can be diffed between
+// builds.
+//
+// Times are milliseconds since process creation when the platform code
+// supplied the offset (setProcessStartOffset), otherwise since the profiler
+// was constructed. Not thread-safe: record from one thread and pass
+// timestamps taken elsewhere to record().
+class StartupProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Phase {
+        std::string name;
+        double startMs;
+        double durationMs;
+    };
+
+    struct Milestone {
+        std::string name;
+        double atMs;
+    };
+
+    // Resident memory of this process, in bytes
+    struct MemoryUsage {
+        uint64_t workingSet;
+        uint64_t peakWorkingSet;
+        uint64_t privateBytes;
+    };
+
+    // Times one phase until destroyed
+    class Scope {
+    public:
+        Scope(StartupProfiler& profiler, const char* name)
+            : profiler(profiler), name(name), start(Clock::now()) {}
+        ~Scope() { profiler.record(name, start, Clock::now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        StartupProfiler& profiler;
+        const char* name;
+        Clock::time_point start;
+    };
+
+    StartupProfiler();
+
+    // Time from process creation to this profiler's construction
+    void setProcessStartOffset(double milliseconds) { processStartOffsetMs = milliseconds; }
+
+    Scope phase(const char* name) { return Scope(*this, name); }
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+    void mark(const char* name);
+
+    const std::vector<Phase>& phases() const { return phaseList; }
+    const std::vector<Milestone>& milestones() const { return milestoneList; }
+
+    // Current footprint of this process (nullopt where unsupported)
+    static std::optional<MemoryUsage> sampleMemory();
+
+    // JSON report; memory is sampled now, executableBytes is included when
+    // known
+    std::string report(std::optional<uint64_t> executableBytes) const;
+    bool writeReport(const std::filesystem::path& path, std::optional<uint64_t> executableBytes) const;
+
+private:
+    double sinceStart(Clock::time_point time) const;
+
+    Clock::time_point origin;
+    std::optional<double> processStartOffsetMs;
+    std::vector<Phase> phaseList;
+    std::vector<Milestone> milestoneList;
+};
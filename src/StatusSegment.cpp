@@ -0,0 +1,454 @@
+#include "StatusSegment.h"
+#include "JsonReader.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define STATUS_HAVE_PAUSE 1
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include "Utf8.h"
+#else
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace StatusSegment {
+    struct Layout {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;                    // sizeof(Layout), so a layout change is never misread
+        uint32_t pid;                     // the publisher
+        std::atomic<uint64_t> sequence;   // odd while a publish is in progress
+        Payload payload;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "the sequence is shared across processes");
+
+    namespace {
+        constexpr char MAGIC[4] = {'R', 'Z', 'S', 'T'};
+        // A reader that finds a publish in progress spins (with a pause
+        // hint) for at most this many checks, which outlasts a publish of
+        // MAX_DEVICES devices
+        constexpr int READ_ATTEMPTS = 1 << 16;
+
+        void cpuRelax() {
+#ifdef STATUS_HAVE_PAUSE
+            _mm_pause();
+#endif
+        }
+
+        bool hasHeader(const Layout* layout) {
+            return std::memcmp(layout->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                   layout->version == FORMAT_VERSION && layout->size == sizeof(Layout);
+        }
+
+        uint32_t currentProcess() {
+#ifdef _WIN32
+            return GetCurrentProcessId();
+#else
+            return static_cast<uint32_t>(getpid());
+#endif
+        }
+
+        bool processAlive(uint32_t pid) {
+            if (pid == 0) return false;
+#ifdef _WIN32
+            HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+            if (!process) return false;
+            bool alive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+            CloseHandle(process);
+            return alive;
+#else
+            return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+#endif
+        }
+
+        void unmap(const Layout* layout, void* handle) {
+#ifdef _WIN32
+            UnmapViewOfFile(layout);
+            CloseHandle(static_cast<HANDLE>(handle));  // the last handle removes the mapping
+#else
+            (void)handle;
+            munmap(const_cast<Layout*>(layout), sizeof(Layout));
+#endif
+        }
+
+        // Copy a NUL-terminated UTF-8 string, cutting before a partial
+        // character if it doesn't fit
+        template<size_t N>
+        void copyString(char (&dest)[N], std::string_view source) {
+            size_t length = source.size() < N ? source.size() : N - 1;
+            if (length < source.size()) {
+                while (length > 0 && (static_cast<unsigned char>(source[length]) & 0xC0) == 0x80) {
+                    length--;
+                }
+            }
+            std::memcpy(dest, source.data(), length);
+            dest[length] = '\0';
+        }
+    }
+
+    std::string defaultName() {
+#ifdef _WIN32
+        return "Local\\RazerTrayStatus";
+#else
+        return "/razertray-status-" + std::to_string(getuid());
+#endif
+    }
+
+    void capture(Payload& payload, const DeviceTable& devices, const StringPool& strings,
+                 int64_t now, std::optional<int64_t> staleSince, const MemoryAccounting::Report& memory,
+                 const ProcessTelemetry::Sample& activity) {
+        size_t count = devices.size() < MAX_DEVICES ? devices.size() : MAX_DEVICES;
+        payload.publishedAt = now;
+        payload.staleSince = staleSince.value_or(0);
+        payload.deviceCount = static_cast<uint32_t>(count);
+        payload.totalDevices = static_cast<uint32_t>(devices.size());
+        payload.connectedCount = static_cast<uint32_t>(devices.connectedCount());
+        std::optional<DeviceTable::Row> lowest = devices.lowestBattery();
+        payload.lowestLevel = lowest.has_value() ? *devices.batteryLevel(*lowest) : NO_LEVEL;
+        std::copy(memory.bytes.begin(), memory.bytes.end(), payload.memoryBytes);
+        payload.heapBytes = memory.heapBytes;
+        payload.uptimeMilliseconds = activity.uptimeMilliseconds;
+        payload.cpuMicroseconds = activity.cpuMicroseconds;
+        payload.deviceQueries = activity.deviceQueries;
+        std::copy(activity.wakeups.begin(), activity.wakeups.end(), payload.wakeups);
+        for (DeviceTable::Row row = 0; row < count; row++) {
+            Device& device = payload.devices[row];
+            copyString(device.name, strings.view(devices.name(row)));
+            copyString(device.instanceId, strings.view(devices.instanceId(row)));
+            device.changedAt = devices.changedAt(row);
+            device.batteryLevel = static_cast<int8_t>(devices.batteryLevel(row).value_or(NO_LEVEL));
+            device.connected = devices.isConnected(row) ? 1 : 0;
+        }
+    }
+
+    Publisher::Publisher(const std::string& name) : segment(nullptr), name(name), handle(nullptr) {
+        Layout* layout = nullptr;
+#ifdef _WIN32
+        std::wstring wideName = Utf8::toWide(name);
+        HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                            static_cast<DWORD>(sizeof(Layout)), wideName.c_str());
+        if (!mapping) {
+            return;
+        }
+        layout = static_cast<Layout*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Layout)));
+        if (!layout) {
+            CloseHandle(mapping);
+            return;
+        }
+        handle = mapping;
+#else
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info = {};
+        if (fstat(fd, &info) != 0 ||
+            (static_cast<size_t>(info.st_size) != sizeof(Layout) && ftruncate(fd, sizeof(Layout)) != 0)) {
+            ::close(fd);
+            return;
+        }
+        void* mapped = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return;
+        }
+        layout = static_cast<Layout*>(mapped);
+#endif
+
+        // First instance wins; a segment left behind by one that has exited
+        // is taken over (and a publish it died in the middle of is abandoned)
+        uint32_t self = currentProcess();
+        if (hasHeader(layout) && layout->pid != self && processAlive(layout->pid)) {
+            unmap(layout, handle);
+            handle = nullptr;
+            return;
+        }
+        uint64_t sequence = layout->sequence.load(std::memory_order_relaxed) & ~uint64_t(1);
+        layout->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Payload& payload = layout->payload;
+        payload.publishedAt = 0;  // nothing from a previous run until the first publish
+        payload.staleSince = 0;
+        payload.deviceCount = 0;
+        payload.totalDevices = 0;
+        payload.connectedCount = 0;
+        payload.lowestLevel = NO_LEVEL;
+        std::fill(std::begin(payload.memoryBytes), std::end(payload.memoryBytes), 0);
+        payload.heapBytes = 0;
+        layout->sequence.store(sequence + 2, std::memory_order_release);
+        std::memcpy(layout->magic, MAGIC, sizeof(MAGIC));
+        layout->version = FORMAT_VERSION;
+        layout->size = sizeof(Layout);
+        layout->pid = self;
+        segment = layout;
+    }
+
+    Publisher::~Publisher() {
+        if (!segment) {
+            return;
+        }
+        bool owner = segment->pid == currentProcess();
+        if (owner) {
+            segment->pid = 0;  // readers that still have it mapped see no tray
+        }
+        unmap(segment, handle);
+#ifndef _WIN32
+        if (owner) {
+            shm_unlink(name.c_str());
+        }
+#endif
+    }
+
+    bool Publisher::publish(const DeviceTable& devices, const StringPool& strings,
+                            int64_t now, std::optional<int64_t> staleSince, const MemoryAccounting::Report& memory,
+                            const ProcessTelemetry::Sample& activity) {
+        if (!segment) {
+            return false;
+        }
+
+        // Odd sequence: readers retry until the matching even store below
+        uint64_t sequence = segment->sequence.load(std::memory_order_relaxed);
+        if ((sequence & 1) ||
+            !segment->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        capture(segment->payload, devices, strings, now, staleSince, memory, activity);
+        segment->sequence.store(sequence + 2, std::memory_order_release);
+        return true;
+    }
+
+    Reader::Reader(const std::string& name) : segment(nullptr), handle(nullptr) {
+        const Layout* layout = nullptr;
+#ifdef _WIN32
+        std::wstring wideName = Utf8::toWide(name);
+        HANDLE mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, wideName.c_str());
+        if (!mapping) {
+            return;
+        }
+        layout = static_cast<const Layout*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(Layout)));
+        if (!layout) {
+            CloseHandle(mapping);
+            return;
+        }
+        handle = mapping;
+#else
+        int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info = {};
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Layout)) {
+            ::close(fd);
+            return;
+        }
+        void* mapped = mmap(nullptr, sizeof(Layout), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            return;
+        }
+        layout = static_cast<const Layout*>(mapped);
+#endif
+        if (!hasHeader(layout)) {
+            unmap(layout, handle);
+            handle = nullptr;
+            return;
+        }
+        segment = layout;
+    }
+
+    Reader::~Reader() {
+        if (segment) {
+            unmap(segment, handle);
+        }
+    }
+
+    bool Reader::isValid() const {
+        return segment != nullptr && processAlive(segment->pid);
+    }
+
+    bool Reader::read(Payload& payload) const {
+        if (!segment) {
+            return false;
+        }
+        constexpr size_t HEADER = offsetof(Payload, devices);
+        for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++) {
+            uint64_t before = segment->sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                cpuRelax();  // mid-publish
+                continue;
+            }
+            std::memcpy(&payload, &segment->payload, HEADER);
+            if (payload.deviceCount > MAX_DEVICES) {
+                payload.deviceCount = 0;  // torn; the sequence check below rejects it
+            }
+            std::memcpy(payload.devices, segment->payload.devices, payload.deviceCount * sizeof(Device));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (segment->sequence.load(std::memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string toText(const Payload& payload, int64_t now) {
+        std::string out;
+        char line[256];
+        if (payload.staleSince != 0) {
+            std::snprintf(line, sizeof(line), "Last known state from %" PRId64 " s ago (discovering devices)\n",
+                          now - payload.staleSince);
+        } else {
+            std::snprintf(line, sizeof(line), "Updated %" PRId64 " s ago\n", now - payload.publishedAt);
+        }
+        out += line;
+
+        for (uint32_t i = 0; i < payload.deviceCount; i++) {
+            const Device& device = payload.devices[i];
+            char level[8] = "  --";
+            if (device.batteryLevel != NO_LEVEL) {
+                std::snprintf(level, sizeof(level), "%3d%%", device.batteryLevel);
+            }
+            std::snprintf(line, sizeof(line), "  %-40s %s  %s\n", device.name, level,
+                          device.connected ? "connected" : "disconnected");
+            out += line;
+        }
+        if (payload.totalDevices > payload.deviceCount) {
+            std::snprintf(line, sizeof(line), "  +%u more\n", payload.totalDevices - payload.deviceCount);
+            out += line;
+        }
+
+        if (payload.lowestLevel != NO_LEVEL) {
+            std::snprintf(line, sizeof(line), "%u of %u connected, lowest battery %d%%\n",
+                          payload.connectedCount, payload.totalDevices, payload.lowestLevel);
+        } else {
+            std::snprintf(line, sizeof(line), "%u of %u connected\n", payload.connectedCount, payload.totalDevices);
+        }
+        out += line;
+
+        out += "Memory:";
+        uint64_t total = 0;
+        for (size_t i = 0; i < MemoryAccounting::SUBSYSTEM_COUNT; i++) {
+            std::snprintf(line, sizeof(line), "%s %s %.1f KB", i ? "," : "",
+                          MemoryAccounting::name(static_cast<MemoryAccounting::Subsystem>(i)),
+                          static_cast<double>(payload.memoryBytes[i]) / 1024.0);
+            out += line;
+            total += payload.memoryBytes[i];
+        }
+        std::snprintf(line, sizeof(line), " (%.1f KB accounted", static_cast<double>(total) / 1024.0);
+        out += line;
+        if (payload.heapBytes != 0) {
+            std::snprintf(line, sizeof(line), ", heap %.1f KB", static_cast<double>(payload.heapBytes) / 1024.0);
+            out += line;
+        }
+        out += ")\n";
+
+        // Rates over the publisher's uptime, so an idle instance shows
+        // what it costs per hour
+        if (payload.uptimeMilliseconds != 0) {
+            uint64_t uptime = payload.uptimeMilliseconds;
+            double hours = static_cast<double>(uptime) / 3600000.0;
+            if (hours >= 1.0) {
+                std::snprintf(line, sizeof(line), "Activity over %.1f h:", hours);
+            } else if (uptime >= 60000) {
+                std::snprintf(line, sizeof(line), "Activity over %.0f min:", hours * 60.0);
+            } else {
+                std::snprintf(line, sizeof(line), "Activity over %.1f s:", static_cast<double>(uptime) / 1000.0);
+            }
+            out += line;
+            std::snprintf(line, sizeof(line), " CPU %.2f s (%.3f s/h), %" PRIu64 " device queries (%.1f/h)\n",
+                          static_cast<double>(payload.cpuMicroseconds) / 1e6,
+                          ProcessTelemetry::perHour(payload.cpuMicroseconds, uptime) / 1e6, payload.deviceQueries,
+                          ProcessTelemetry::perHour(payload.deviceQueries, uptime));
+            out += line;
+
+            uint64_t wakeups = 0;
+            for (uint64_t count : payload.wakeups) wakeups += count;
+            std::snprintf(line, sizeof(line), "Wakeups: %.1f/h (", ProcessTelemetry::perHour(wakeups, uptime));
+            out += line;
+            for (size_t i = 0; i < ProcessTelemetry::WAKEUP_COUNT; i++) {
+                std::snprintf(line, sizeof(line), "%s%s %.1f", i ? ", " : "",
+                              ProcessTelemetry::name(static_cast<ProcessTelemetry::Wakeup>(i)),
+                              ProcessTelemetry::perHour(payload.wakeups[i], uptime));
+                out += line;
+            }
+            out += ")\n";
+        }
+        return out;
+    }
+
+    std::string toJson(const Payload& payload) {
+        std::string out;
+        out.reserve(256 + payload.deviceCount * 160);
+        char number[64];
+        auto appendNumber = [&](const char* key, int64_t value) {
+            std::snprintf(number, sizeof(number), "\"%s\":%" PRId64, key, value);
+            out += number;
+        };
+
+        out += '{';
+        appendNumber("publishedAt", payload.publishedAt);
+        out += ",\"staleSince\":";
+        if (payload.staleSince != 0) {
+            out += std::to_string(payload.staleSince);
+        } else {
+            out += "null";
+        }
+        out += ',';
+        appendNumber("totalDevices", payload.totalDevices);
+        out += ',';
+        appendNumber("connectedCount", payload.connectedCount);
+        out += ",\"lowestBatteryLevel\":";
+        out += payload.lowestLevel != NO_LEVEL ? std::to_string(payload.lowestLevel) : "null";
+        out += ",\"memory\":{";
+        uint64_t total = 0;
+        for (size_t i = 0; i < MemoryAccounting::SUBSYSTEM_COUNT; i++) {
+            appendNumber(MemoryAccounting::name(static_cast<MemoryAccounting::Subsystem>(i)),
+                         static_cast<int64_t>(payload.memoryBytes[i]));
+            out += ',';
+            total += payload.memoryBytes[i];
+        }
+        appendNumber("total", static_cast<int64_t>(total));
+        out += ",\"heap\":";
+        out += payload.heapBytes != 0 ? std::to_string(payload.heapBytes) : "null";
+        out += "},\"activity\":{";
+        appendNumber("uptimeMs", static_cast<int64_t>(payload.uptimeMilliseconds));
+        out += ',';
+        appendNumber("cpuMicroseconds", static_cast<int64_t>(payload.cpuMicroseconds));
+        out += ',';
+        appendNumber("deviceQueries", static_cast<int64_t>(payload.deviceQueries));
+        out += ",\"wakeups\":{";
+        for (size_t i = 0; i < ProcessTelemetry::WAKEUP_COUNT; i++) {
+            if (i) out += ',';
+            appendNumber(ProcessTelemetry::name(static_cast<ProcessTelemetry::Wakeup>(i)),
+                         static_cast<int64_t>(payload.wakeups[i]));
+        }
+        out += "}},\"devices\":[";
+        for (uint32_t i = 0; i < payload.deviceCount; i++) {
+            const Device& device = payload.devices[i];
+            out += i ? ",{\"name\":" : "{\"name\":";
+            appendJsonString(out, device.name);
+            out += ",\"instanceId\":";
+            appendJsonString(out, device.instanceId);
+            out += ",\"batteryLevel\":";
+            out += device.batteryLevel != NO_LEVEL ? std::to_string(device.batteryLevel) : "null";
+            out += device.connected ? ",\"connected\":true," : ",\"connected\":false,";
+            appendNumber("changedAt", device.changedAt);
+            out += '}';
+        }
+        out += "]}\n";
+        return out;
+    }
+}
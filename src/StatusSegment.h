@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include "DeviceTable.h"
+#include "MemoryAccounting.h"
+#include "ProcessTelemetry.h"
+#include "StringPool.h"
+
+// The running tray's device state, published in a named shared-memory
+// segment (a pagefile-backed file mapping on Windows, POSIX shm elsewhere)
+// so scripts and overlays can read battery levels without enumerating
+// devices themselves. `RazerTray --status [--json]` is such a reader.
+//
+// The segment is a fixed-size header and device array guarded by a seqlock:
+// the publisher makes the sequence odd, writes, and makes it even again; a
+// reader copies the payload and keeps the copy only if the sequence was the
+// same even value before and after. Reading takes no lock and no system
+// call, and a reader can never stall the tray. Publishing is a copy into
+// the mapped view (no allocation), done with every icon update. Each
+// publish also carries the publisher's MemoryAccounting report and its
+// ProcessTelemetry sample, as of that publish.
+namespace StatusSegment {
+    constexpr uint32_t FORMAT_VERSION = 3;
+    constexpr size_t MAX_DEVICES = 1024;
+    constexpr size_t NAME_CAPACITY = 64;         // including the terminator
+    constexpr size_t INSTANCE_ID_CAPACITY = 96;  // including the terminator
+    constexpr int8_t NO_LEVEL = -1;
+
+    // Segment of the current user's session (Windows: Local\RazerTrayStatus,
+    // elsewhere /razertray-status-<uid>)
+    std::string defaultName();
+
+    // One device; strings are UTF-8, NUL-terminated, cut on a character
+    // boundary if longer than the capacity
+    struct Device {
+        char name[NAME_CAPACITY];
+        char instanceId[INSTANCE_ID_CAPACITY];
+        int64_t changedAt;      // Unix seconds of the last level/connection change
+        int8_t batteryLevel;    // 0-100 or NO_LEVEL
+        uint8_t connected;
+        uint8_t reserved[6];
+    };
+
+    // Everything the seqlock protects
+    struct Payload {
+        int64_t publishedAt;    // Unix seconds
+        int64_t staleSince;     // Unix seconds the readings on display date from, 0 = live
+        uint32_t deviceCount;   // devices[] entries in use (at most MAX_DEVICES)
+        uint32_t totalDevices;  // devices tracked, if more than fit
+        uint32_t connectedCount;
+        int32_t lowestLevel;    // lowest level among connected devices, or NO_LEVEL
+        uint64_t memoryBytes[MemoryAccounting::SUBSYSTEM_COUNT];  // the publisher's, by Subsystem
+        uint64_t heapBytes;     // the publisher's heap in use, 0 = unknown
+        uint64_t uptimeMilliseconds;    // the publisher's ProcessTelemetry::Sample
+        uint64_t cpuMicroseconds;
+        uint64_t deviceQueries;
+        uint64_t wakeups[ProcessTelemetry::WAKEUP_COUNT];  // by Wakeup
+        Device devices[MAX_DEVICES];
+    };
+
+    // Fill a payload from the device table (allocation-free); what publish()
+    // writes into the segment
+    void capture(Payload& payload, const DeviceTable& devices, const StringPool& strings,
+                 int64_t now, std::optional<int64_t> staleSince, const MemoryAccounting::Report& memory,
+                 const ProcessTelemetry::Sample& activity);
+
+    // The mapped segment: header, seqlock sequence, payload (StatusSegment.cpp)
+    struct Layout;
+
+    // Creates the segment and publishes into it (the tray). If the segment
+    // cannot be created every publish() is a no-op.
+    class Publisher {
+    public:
+        explicit Publisher(const std::string& name = defaultName());
+        ~Publisher();
+
+        Publisher(const Publisher&) = delete;
+        Publisher& operator=(const Publisher&) = delete;
+
+        bool isValid() const { return segment != nullptr; }
+
+        // Returns false if nothing was published (no segment, or another
+        // publisher of the same name is mid-write)
+        bool publish(const DeviceTable& devices, const StringPool& strings,
+                     int64_t now, std::optional<int64_t> staleSince, const MemoryAccounting::Report& memory,
+                 const ProcessTelemetry::Sample& activity);
+
+    private:
+        Layout* segment;
+        std::string name;
+        void* handle;  // Windows: file mapping handle
+    };
+
+    // Opens an existing segment read-only (a --status client)
+    class Reader {
+    public:
+        explicit Reader(const std::string& name = defaultName());
+        ~Reader();
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // False if no tray is running (no segment, or the process that
+        // created it has exited)
+        bool isValid() const;
+
+        // Copy a consistent snapshot; false if the publisher kept writing
+        // (or died mid-write) for every attempt. Only the first
+        // payload.deviceCount devices are copied.
+        bool read(Payload& payload) const;
+
+    private:
+        const Layout* segment;
+        void* handle;  // Windows: file mapping handle
+    };
+
+    // Human-readable and JSON renderings of a snapshot for --status
+    std::string toText(const Payload& payload, int64_t now);
+    std::string toJson(const Payload& payload);
+}
@@ -0,0 +1,111 @@
+#include "StringPool.h"
+#include <cstring>
+
+StringPool::StringPool()
+    : chunkUsed(CHUNK_SIZE)  // forces a chunk on first store
+    , chunkBytes(0)
+    , slots(64, EMPTY_SLOT)
+{
+}
+
+uint32_t StringPool::hash(std::string_view str) {
+    // FNV-1a: device names are short, so a simple byte hash is plenty
+    uint32_t h = 2166136261u;
+    for (unsigned char c : str) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+std::string_view StringPool::store(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+
+    // Oversized strings get a dedicated chunk
+    if (str.size() > CHUNK_SIZE / 4) {
+        chunks.push_back(std::make_unique<char[]>(str.size()));
+        chunkBytes += str.size();
+        std::memcpy(chunks.back().get(), str.data(), str.size());
+        std::string_view stored(chunks.back().get(), str.size());
+        // Keep filling the previous chunk: swap the dedicated one behind it
+        if (chunks.size() > 1) {
+            std::swap(chunks[chunks.size() - 1], chunks[chunks.size() - 2]);
+        }
+        return stored;
+    }
+
+    if (chunkUsed + str.size() > CHUNK_SIZE) {
+        chunks.push_back(std::make_unique<char[]>(CHUNK_SIZE));
+        chunkBytes += CHUNK_SIZE;
+        chunkUsed = 0;
+    }
+
+    char* dest = chunks.back().get() + chunkUsed;
+    std::memcpy(dest, str.data(), str.size());
+    chunkUsed += str.size();
+    return std::string_view(dest, str.size());
+}
+
+size_t StringPool::probe(std::string_view str, uint32_t strHash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = strHash & mask;
+    while (slots[slot] != EMPTY_SLOT) {
+        StringId id = slots[slot] - 1;
+        if (hashes[id] == strHash && entries[id] == str) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void StringPool::grow() {
+    std::vector<uint32_t> bigger(slots.size() * 2, EMPTY_SLOT);
+    size_t mask = bigger.size() - 1;
+    for (StringId id = 0; id < entries.size(); id++) {
+        size_t slot = hashes[id] & mask;
+        while (bigger[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & mask;
+        }
+        bigger[slot] = id + 1;
+    }
+    slots.swap(bigger);
+}
+
+StringId StringPool::intern(std::string_view str) {
+    uint32_t strHash = hash(str);
+    size_t slot = probe(str, strHash);
+    if (slots[slot] != EMPTY_SLOT) {
+        return slots[slot] - 1;
+    }
+
+    StringId id = static_cast<StringId>(entries.size());
+    entries.push_back(store(str));
+    hashes.push_back(strHash);
+    slots[slot] = id + 1;
+
+    // Keep load factor below 1/2 so probes stay short
+    if (entries.size() * 2 > slots.size()) {
+        grow();
+    }
+
+    return id;
+}
+
+std::optional<StringId> StringPool::find(std::string_view str) const {
+    size_t slot = probe(str, hash(str));
+    if (slots[slot] == EMPTY_SLOT) {
+        return std::nullopt;
+    }
+    return slots[slot] - 1;
+}
+
+size_t StringPool::memoryUsage() const {
+    return chunkBytes
+        + chunks.capacity() * sizeof(chunks[0])
+        + entries.capacity() * sizeof(entries[0])
+        + hashes.capacity() * sizeof(hashes[0])
+        + slots.capacity() * sizeof(slots[0]);
+}
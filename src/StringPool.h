@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Handle to a string interned in a StringPool
+using StringId = uint32_t;
+
+// Append-only pool of interned UTF-8 strings.
+// Each distinct string is stored once and referenced by a 32-bit handle, so
+// device identities compare, hash and copy as integers. Storage is chunked,
+// which keeps views returned by view() stable for the lifetime of the pool.
+class StringPool {
+public:
+    StringPool();
+
+    StringPool(const StringPool&) = delete;
+    StringPool& operator=(const StringPool&) = delete;
+    StringPool(StringPool&&) noexcept = default;
+    StringPool& operator=(StringPool&&) noexcept = default;
+
+    // Intern a string, returning the existing handle if already present
+    StringId intern(std::string_view str);
+
+    // Look up a string without interning it
+    std::optional<StringId> find(std::string_view str) const;
+
+    // Get the string for a handle (must come from this pool)
+    std::string_view view(StringId id) const { return entries[id]; }
+
+    // Number of distinct strings
+    size_t size() const { return entries.size(); }
+
+    // Bytes held by the pool (string data plus index)
+    size_t memoryUsage() const;
+
+private:
+    static constexpr size_t CHUNK_SIZE = 4096;
+    static constexpr uint32_t EMPTY_SLOT = 0;  // slots hold id + 1
+
+    static uint32_t hash(std::string_view str);
+
+    // Copy string bytes into chunk storage, returning a stable view
+    std::string_view store(std::string_view str);
+
+    // Find the slot holding str, or the empty slot where it would go
+    size_t probe(std::string_view str, uint32_t strHash) const;
+
+    void grow();
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunkUsed;
+    size_t chunkBytes;
+
+    std::vector<std::string_view> entries;  // indexed by StringId
+    std::vector<uint32_t> hashes;            // indexed by StringId
+    std::vector<uint32_t> slots;             // open-addressing table
+};
@@ -0,0 +1,115 @@
+#include "SysfsBackend.h"
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    // Attribute values are short ("Battery", "87", a model name)
+    constexpr size_t VALUE_CAPACITY = 128;
+
+    // One attribute file of the supply directory dirFd, without the
+    // trailing newline; empty if it does not exist or cannot be read
+    std::string_view readAttribute(int dirFd, const char* name, char (&buffer)[VALUE_CAPACITY]) {
+        int file = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+        if (file < 0) {
+            return {};
+        }
+        ssize_t length = read(file, buffer, sizeof(buffer));
+        close(file);
+        if (length <= 0) {
+            return {};
+        }
+        std::string_view value(buffer, static_cast<size_t>(length));
+        while (!value.empty() && (value.back() == '\n' || value.back() == ' ')) {
+            value.remove_suffix(1);
+        }
+        return value;
+    }
+
+    // Instance IDs come back from devices.cache and recordings too: only a
+    // plain directory name may be opened
+    bool isEntryName(std::string_view name) {
+        return !name.empty() && name.size() <= NAME_MAX && name.front() != '.' &&
+               name.find('/') == std::string_view::npos && name.find('\0') == std::string_view::npos;
+    }
+}
+
+SysfsBackend::SysfsBackend(std::string root)
+    : root(std::move(root))
+    , rootFd(open(this->root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+{
+}
+
+std::shared_ptr<MultiSourceBackend> SysfsBackend::systemSources() {
+    std::vector<MultiSourceBackend::Source> sources;
+    sources.push_back({"power_supply", "", std::make_shared<SysfsBackend>()});
+    return std::make_shared<MultiSourceBackend>(std::move(sources));
+}
+
+SysfsBackend::~SysfsBackend() {
+    if (rootFd >= 0) {
+        close(rootFd);
+    }
+}
+
+void SysfsBackend::enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) {
+    DIR* dir = rootFd >= 0 ? opendir(root.c_str()) : nullptr;
+    if (!dir) {
+        return;
+    }
+
+    char buffer[VALUE_CAPACITY];
+    while (dirent* entry = readdir(dir)) {
+        std::string_view entryName = entry->d_name;
+        if (!isEntryName(entryName)) {
+            continue;
+        }
+        // Entries are symlinks into the device tree
+        int supply = openat(rootFd, entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (supply < 0) {
+            continue;
+        }
+        if (readAttribute(supply, "type", buffer) == "Battery" && readAttribute(supply, "scope", buffer) == "Device") {
+            std::string_view model = readAttribute(supply, "model_name", buffer);
+            onDevice(model.empty() ? entryName : model, entryName);
+        }
+        close(supply);
+    }
+    closedir(dir);
+}
+
+DeviceBackend::Reading SysfsBackend::query(std::string_view instanceId) {
+    Reading reading = {false, std::nullopt, false};
+    if (rootFd < 0 || !isEntryName(instanceId)) {
+        return reading;
+    }
+
+    char entryName[NAME_MAX + 1];
+    std::memcpy(entryName, instanceId.data(), instanceId.size());
+    entryName[instanceId.size()] = '\0';
+    int supply = openat(rootFd, entryName, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (supply < 0) {
+        return reading;  // disconnected: the kernel removed the supply
+    }
+    reading.present = true;
+
+    // online / present are optional; HID batteries have neither
+    char buffer[VALUE_CAPACITY];
+    reading.isConnected = readAttribute(supply, "online", buffer) != "0" &&
+                          readAttribute(supply, "present", buffer) != "0";
+
+    std::string_view capacity = readAttribute(supply, "capacity", buffer);
+    int level = -1;
+    if (std::from_chars(capacity.data(), capacity.data() + capacity.size(), level).ec == std::errc() &&
+        level >= 0 && level <= 100) {
+        reading.batteryLevel = level;
+    }
+    close(supply);
+    return reading;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "DeviceBackend.h"
+#include "MultiSourceBackend.h"
+
+// Linux backend: peripheral batteries as the kernel lists them under
+// /sys/class/power_supply. Bluetooth and USB HID devices that report a
+// battery appear there (hid-<address>-battery, ...) for as long as they are
+// connected, so a supply that is gone reads as not present.
+//
+// A device is a supply of type Battery with scope Device (the machine's own
+// battery, chargers and UPSes are left out); its name is model_name (the
+// directory name if that is empty) and its instance ID the directory name.
+// Stateless apart from the open root directory, so safe to share across
+// threads.
+class SysfsBackend : public DeviceBackend {
+public:
+    // root: the power_supply class directory (another tree for tests)
+    explicit SysfsBackend(std::string root = "/sys/class/power_supply");
+    ~SysfsBackend() override;
+
+    SysfsBackend(const SysfsBackend&) = delete;
+    SysfsBackend& operator=(const SysfsBackend&) = delete;
+
+    // The machine's device sources: /sys/class/power_supply, the one
+    // enumerator Linux has for peripheral batteries (Bluetooth and USB HID
+    // alike), as a MultiSourceBackend for its per-source timing
+    static std::shared_ptr<MultiSourceBackend> systemSources();
+
+    void enumerate(const std::function<void(std::string_view name, std::string_view instanceId)>& onDevice) override;
+    Reading query(std::string_view instanceId) override;
+
+private:
+    std::string root;
+    int rootFd;     // -1 if root could not be opened (no devices)
+};
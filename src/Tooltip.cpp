@@ -0,0 +1,91 @@
+#include "Tooltip.h"
+#include "Utf8.h"
+#include <cstdio>
+
+namespace {
+    // The fixed parts of the tooltip are ASCII; format narrow, widen by copy
+    void appendAscii(std::pmr::wstring& text, const char* ascii, int length) {
+        if (length > 0) {
+            text.append(ascii, ascii + length);
+        }
+    }
+
+    // Room kept for "\n+<count> more"
+    constexpr size_t MORE_RESERVE = 20;
+}
+
+void Tooltip::build(std::pmr::wstring& text,
+                    const DeviceTable& devices,
+                    const StringPool& strings,
+                    std::optional<int64_t> staleSeconds,
+                    std::optional<TimeOfDay> updatedAt,
+                    size_t maxLength) {
+    text += L"Razer Tray";
+
+    // Add timestamp right under title if we've refreshed at least once, or
+    // the age of the last known state still on display
+    if (staleSeconds.has_value()) {
+        text += L"\n";
+        appendAge(text, *staleSeconds);
+    } else if (updatedAt.has_value()) {
+        text += L"\n";
+        appendTimestamp(text, *updatedAt);
+    }
+
+    // Add devices below timestamp
+    size_t limit = maxLength > MORE_RESERVE ? maxLength - MORE_RESERVE : 0;
+    bool hasConnected = false;
+    size_t omitted = 0;
+    for (DeviceTable::Row row = 0; row < devices.size(); row++) {
+        std::optional<int> batteryLevel = devices.batteryLevel(row);
+        if (!devices.isConnected(row) || !batteryLevel.has_value()) {
+            continue;
+        }
+        hasConnected = true;
+        if (omitted > 0) {
+            omitted++;
+            continue;
+        }
+
+        size_t lineStart = text.size();
+        char level[16];
+        int length = std::snprintf(level, sizeof(level), ": %d%%", *batteryLevel);
+        text += L"\n";
+        Utf8::appendWide(text, strings.view(devices.name(row)));
+        appendAscii(text, level, length);
+        if (text.size() > limit) {
+            text.resize(lineStart);
+            omitted = 1;
+        }
+    }
+
+    if (omitted > 0) {
+        char more[32];
+        appendAscii(text, more, std::snprintf(more, sizeof(more), "\n+%zu more", omitted));
+    } else if (!hasConnected) {
+        text += L"\nNo devices connected";
+    }
+}
+
+void Tooltip::appendTimestamp(std::pmr::wstring& text, TimeOfDay time) {
+    char buffer[64];
+    int length = std::snprintf(buffer, sizeof(buffer), "Updated: %02d:%02d:%02d",
+                               time.hour, time.minute, time.second);
+    appendAscii(text, buffer, length);
+}
+
+void Tooltip::appendAge(std::pmr::wstring& text, int64_t seconds) {
+    char buffer[64];
+    long long age = seconds > 0 ? static_cast<long long>(seconds) : 0;
+    int length;
+    if (age < 60) {
+        length = std::snprintf(buffer, sizeof(buffer), "Last known state (%llds ago)", age);
+    } else if (age < 60 * 60) {
+        length = std::snprintf(buffer, sizeof(buffer), "Last known state (%lld min ago)", age / 60);
+    } else if (age < 24 * 60 * 60) {
+        length = std::snprintf(buffer, sizeof(buffer), "Last known state (%lld h %lld min ago)", age / 3600, age % 3600 / 60);
+    } else {
+        length = std::snprintf(buffer, sizeof(buffer), "Last known state (%lld days ago)", age / 86400);
+    }
+    appendAscii(text, buffer, length);
+}
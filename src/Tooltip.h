@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include "DeviceTable.h"
+#include "StringPool.h"
+
+// Tray tooltip text: the title, how fresh the readings are, then one
+// "name: level%" line per connected device with a reading, as many as fit
+// in maxLength characters followed by "+N more". Appends to the caller's
+// string (the tray passes one backed by its refresh arena), so building it
+// makes no heap allocation of its own.
+namespace Tooltip {
+    struct TimeOfDay {
+        int hour;
+        int minute;
+        int second;
+    };
+
+    // staleSeconds: age of the last known state still on display (warm
+    // start); otherwise updatedAt: time of the last refresh, if any.
+    // maxLength: the shell's limit (szTip holds 127 characters)
+    void build(std::pmr::wstring& text,
+               const DeviceTable& devices,
+               const StringPool& strings,
+               std::optional<int64_t> staleSeconds,
+               std::optional<TimeOfDay> updatedAt,
+               size_t maxLength);
+
+    void appendTimestamp(std::pmr::wstring& text, TimeOfDay time);
+    void appendAge(std::pmr::wstring& text, int64_t seconds);
+}
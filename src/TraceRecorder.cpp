@@ -0,0 +1,176 @@
+#include "TraceRecorder.h"
+#include "BinaryIO.h"
+#include "JsonReader.h"
+#include "LatencyProbes.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace {
+    static_assert((Trace::CAPACITY & (Trace::CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+    constexpr size_t MAX_THREADS = 64;
+
+    // One span; sequence is its claim index + 1 once fully written, so a
+    // reader can tell a finished slot from one being (over)written
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        uint32_t thread;
+        uint8_t detailLength;
+        char detail[Trace::DETAIL_CAPACITY];
+    };
+
+    // The ring is allocated once and never freed, so a writer that saw
+    // recording just before stop() can still finish safely
+    std::atomic<Slot*> ring = nullptr;
+    std::once_flag ringAllocated;
+
+    std::atomic<uint64_t> nextIndex = 0;
+    std::atomic<uint64_t> sessionFirstIndex = 0;
+    std::atomic<uint64_t> sessionOrigin = 0;
+
+    std::atomic<uint32_t> threadCount = 0;
+    std::array<std::atomic<const char*>, MAX_THREADS> threadNames = {};
+
+    uint32_t currentThread() {
+        thread_local const uint32_t index = threadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        return index;
+    }
+
+    double microseconds(uint64_t fromTicks, uint64_t toTicks) {
+        if (toTicks < fromTicks) return 0.0;
+        return static_cast<double>(LatencyProbes::elapsedNanoseconds(fromTicks, toTicks)) / 1000.0;
+    }
+}
+
+uint64_t Trace::now() {
+    return LatencyProbes::now();
+}
+
+void Trace::start() {
+    std::call_once(ringAllocated, [] {
+        ring.store(new Slot[CAPACITY](), std::memory_order_release);
+    });
+    sessionFirstIndex.store(nextIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    sessionOrigin.store(now(), std::memory_order_relaxed);
+    recording.store(true, std::memory_order_release);
+}
+
+void Trace::stop() {
+    recording.store(false, std::memory_order_release);
+}
+
+size_t Trace::memoryUsage() {
+    return ring.load(std::memory_order_relaxed) ? CAPACITY * sizeof(Slot) : 0;
+}
+
+void Trace::complete(const char* name, uint64_t startTicks, uint64_t endTicks, std::string_view detail) {
+    Slot* slots = ring.load(std::memory_order_acquire);
+    if (!slots) {
+        return;
+    }
+
+    uint64_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[index & (CAPACITY - 1)];
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.name = name;
+    slot.start = startTicks;
+    slot.end = endTicks;
+    slot.thread = currentThread();
+    size_t length = std::min(detail.size(), DETAIL_CAPACITY);
+    if (length < detail.size()) {
+        // Cut on a UTF-8 character boundary
+        while (length > 0 && (static_cast<unsigned char>(detail[length]) & 0xC0) == 0x80) length--;
+    }
+    if (length > 0) {
+        std::memcpy(slot.detail, detail.data(), length);
+    }
+    slot.detailLength = static_cast<uint8_t>(length);
+
+    slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void Trace::nameThread(const char* name) {
+    uint32_t thread = currentThread();
+    if (thread < MAX_THREADS) {
+        threadNames[thread].store(name, std::memory_order_relaxed);
+    }
+}
+
+std::string Trace::toJson() {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    char buffer[160];
+    bool first = true;
+    auto separator = [&]() -> const char* {
+        const char* text = first ? "\n" : ",\n";
+        first = false;
+        return text;
+    };
+
+    std::snprintf(buffer, sizeof(buffer), "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+                  "\"args\":{\"name\":\"RazerTray\"}}", separator());
+    json += buffer;
+    uint32_t threads = std::min<uint32_t>(threadCount.load(std::memory_order_relaxed) + 1, MAX_THREADS);
+    for (uint32_t thread = 1; thread < threads; thread++) {
+        if (const char* name = threadNames[thread].load(std::memory_order_relaxed)) {
+            std::snprintf(buffer, sizeof(buffer), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                          "\"args\":{\"name\":", separator(), thread);
+            json += buffer;
+            appendJsonString(json, name);
+            json += "}}";
+        }
+    }
+
+    Slot* slots = ring.load(std::memory_order_acquire);
+    if (slots) {
+        uint64_t end = nextIndex.load(std::memory_order_acquire);
+        uint64_t begin = std::max(sessionFirstIndex.load(std::memory_order_relaxed),
+                                  end > CAPACITY ? end - CAPACITY : 0);
+        uint64_t origin = sessionOrigin.load(std::memory_order_relaxed);
+
+        for (uint64_t index = begin; index < end; index++) {
+            const Slot& slot = slots[index & (CAPACITY - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != index + 1) {
+                continue;  // still being written, or already overwritten
+            }
+            const char* name = slot.name;
+            uint64_t start = slot.start;
+            uint64_t finish = slot.end;
+            uint32_t thread = slot.thread;
+            char detail[DETAIL_CAPACITY];
+            size_t detailLength = std::min<size_t>(slot.detailLength, DETAIL_CAPACITY);
+            std::memcpy(detail, slot.detail, detailLength);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.sequence.load(std::memory_order_relaxed) != index + 1 || start < origin) {
+                continue;
+            }
+
+            std::snprintf(buffer, sizeof(buffer), "%s{\"name\":", separator());
+            json += buffer;
+            appendJsonString(json, name);
+            std::snprintf(buffer, sizeof(buffer), ",\"cat\":\"razertray\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                          "\"pid\":1,\"tid\":%u", microseconds(origin, start), microseconds(start, finish), thread);
+            json += buffer;
+            if (detailLength > 0) {
+                json += ",\"args\":{\"detail\":";
+                appendJsonString(json, std::string_view(detail, detailLength));
+                json += "}";
+            }
+            json += "}";
+        }
+    }
+
+    json += "\n]}\n";
+    return json;
+}
+
+bool Trace::writeJson(const std::filesystem::path& path) {
+    return BinaryIO::replaceFile(path, toJson());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+// Opt-in timeline of what the app is doing (refresh cycles, per-device
+// property queries, icon rendering, shell updates), saved as Chrome
+// trace-event JSON that chrome://tracing and ui.perfetto.dev open directly.
+//
+// Spans go into a ring buffer allocated once, on the first start(); when it
+// wraps, the oldest spans are dropped. Writers on any thread claim a slot
+// with one atomic increment and never block or allocate. While not
+// recording, a Span costs one relaxed load and a branch.
+namespace Trace {
+    constexpr size_t CAPACITY = 16384;       // spans kept (power of two)
+    constexpr size_t DETAIL_CAPACITY = 47;   // bytes of per-span detail kept
+
+    inline std::atomic<bool> recording = false;
+
+    inline bool enabled() { return recording.load(std::memory_order_relaxed); }
+
+    // Begin a new trace (discarding anything not yet written) / stop adding
+    // spans. Both may be called from any thread.
+    void start();
+    void stop();
+
+    // Clock shared with LatencyProbes (platform ticks)
+    uint64_t now();
+
+    // Record a finished span; name must be a string literal (only the
+    // pointer is kept). detail is copied, truncated to DETAIL_CAPACITY.
+    void complete(const char* name, uint64_t startTicks, uint64_t endTicks, std::string_view detail = {});
+
+    // Label the calling thread in the trace; name must be a string literal
+    void nameThread(const char* name);
+
+    // Bytes held by the ring (MemoryAccounting); 0 until the first start()
+    size_t memoryUsage();
+
+    // Spans recorded since start() as Chrome trace-event JSON
+    std::string toJson();
+    bool writeJson(const std::filesystem::path& path);
+
+    // Times its own lifetime while recording
+    class Span {
+    public:
+        explicit Span(const char* name, std::string_view detail = {})
+            : name(name), detail(detail), start(enabled() ? now() : 0) {}
+        ~Span() {
+            if (start != 0) complete(name, start, now(), detail);
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* name;
+        std::string_view detail;
+        uint64_t start;
+    };
+}
@@ -1,18 +1,26 @@
 #include "TrayApp.h"
+#include "AllocationCounter.h"
+#include "EventLog.h"
+#include "LatencyProbes.h"
+#include "ProcessTelemetry.h"
+#include "TraceRecorder.h"
+#include "SetupApiBackend.h"
+#include "StatusSegment.h"
+#include "Tooltip.h"
+#include "Utf8.h"
 #include <string>
 #include <algorithm>
-#include <sstream>
 #include <cmath>
 
 static const wchar_t* WINDOW_CLASS_NAME = L"RazerBatteryTrayClass";
 static const wchar_t* WINDOW_TITLE = L"Razer Battery Tray";
 
-TrayApp::TrayApp(HINSTANCE hInst)
-    : hInstance(hInst)
+TrayApp::TrayApp(HINSTANCE hInst, std::shared_ptr<DeviceBackend> backend, bool useDeviceCache, double speed)
+    : startupReported(false)
+    , hInstance(hInst)
     , hwnd(nullptr)
-    , batteryIcon(std::make_unique<BatteryIcon>())
-    , config(std::nullopt)
     , refreshInterval(5 * 60 * 1000)  // Default 5 minutes
+    , refreshSpeed(speed > 0.0 ? speed : 1.0)
     , isRefreshing(false)
     , animationFrame(0)
 {
@@ -20,24 +28,52 @@ TrayApp::TrayApp(HINSTANCE hInst)
     notifyIconData.cbSize = sizeof(NOTIFYICONDATAW);
     ZeroMemory(&lastRefreshTime, sizeof(lastRefreshTime));
 
-    // Try to load config
-    ConfigManager configMgr;
-    config = configMgr.loadConfig();
+    startupProfiler.setProcessStartOffset(millisecondsSinceProcessStart());
+    Trace::nameThread("UI");
 
-    if (config.has_value()) {
-        // Config loaded successfully
-        refreshInterval = config->refreshInterval * 1000;
-        deviceMonitor = std::make_unique<DeviceMonitor>(config.value());
-    } else {
-        // No config found - use defaults and try to save for next run
-        config = configMgr.getDefaultConfig();
-        refreshInterval = config->refreshInterval * 1000;
+    // Load config; later edits are picked up by the watcher (see initialize())
+    std::optional<StartupProfiler::Scope> configPhase;
+    configPhase.emplace(startupProfiler, "config load");
+    ConfigManager configMgr;
+    configStore = std::make_unique<ConfigStore>(configMgr.getDefaultConfigPath());
+
+    std::optional<JsonError> error;
+    if (!configStore->reload(error)) {
+        if (error.has_value()) {
+            // Config exists but is invalid - tell the user where, run on defaults
+            // and leave their file alone so it can be fixed
+            wchar_t message[512];
+            swprintf_s(message, L"config.json line %zu, column %zu: %hs\n\nUsing default settings.",
+                       error->line, error->column, error->message.c_str());
+            MessageBoxW(nullptr, message, L"Razer Tray - Invalid Configuration", MB_ICONWARNING | MB_OK);
+
+            configStore->publish(configMgr.getDefaultConfig());
+        } else {
+            // No config found - use defaults and try to save for next run
+            Config defaults = configMgr.getDefaultConfig();
 
-        // Try to save default config (fail silently if permissions issue)
-        configMgr.saveConfig(config.value());
+            // Try to save default config (fail silently if permissions issue)
+            configMgr.saveConfig(defaults);
+            configStore->publish(std::move(defaults));
+        }
+    }
 
-        // Create DeviceMonitor with default config
-        deviceMonitor = std::make_unique<DeviceMonitor>(config.value());
+    activeConfig = configStore->current();
+    if (useDeviceCache) {
+        deviceCachePath = DeviceStateCache::pathFor(configStore->path());
+        // Before the monitor exists, so the first scan's devices are named
+        EventLog::start(EventLog::pathFor(configStore->path()));
+    }
+    refreshInterval = refreshTimerInterval(activeConfig->config.refreshInterval);
+    deviceBackend = backend ? std::move(backend) : SetupApiBackend::systemSources();
+    deviceMonitor = std::make_unique<DeviceMonitor>(deviceBackend, activeConfig->matcher);
+    statusPublisher = std::make_unique<StatusSegment::Publisher>();
+    configPhase.reset();
+
+    {
+        auto phase = startupProfiler.phase("graphics init");
+        batteryIcon = std::make_unique<BatteryIcon>();
+        batteryIcon->setLevelColors(activeConfig->levelColors);
     }
 }
 
@@ -46,25 +82,360 @@ TrayApp::~TrayApp() {
 }
 
 bool TrayApp::initialize() {
-    if (!createWindow()) {
-        return false;
+    {
+        auto phase = startupProfiler.phase("window creation");
+        if (!createWindow()) {
+            return false;
+        }
     }
 
-    if (!addTrayIcon()) {
-        return false;
+    {
+        auto phase = startupProfiler.phase("tray add");
+        if (!addTrayIcon()) {
+            return false;
+        }
     }
 
-    // Initial device discovery and update
-    discoverDevices();
-    refreshDevices();
-    updateTrayIcon();
+    // Before the first icon update, which hands them the first snapshot
+    startMetricsServer();
+    startCollectorAgent();
+
+    // Show the last known devices immediately; the real enumeration runs
+    // in the background and replaces them when it finishes
+    {
+        auto phase = startupProfiler.phase("cached state");
+        showCachedDevices();
+    }
+    startDiscovery();
 
     // Set up auto-refresh timer (use configured interval)
     SetTimer(hwnd, TIMER_REFRESH, refreshInterval, nullptr);
 
+    // Apply config.json edits without a restart (runs on without it if the
+    // directory cannot be watched)
+    startConfigWatcher();
+
     return true;
 }
 
+bool TrayApp::showCachedDevices() {
+    if (deviceCachePath.empty()) {
+        return false;
+    }
+    std::optional<DeviceStateCache::State> state = DeviceStateCache::load(deviceCachePath);
+    if (!state.has_value() || state->devices.empty()) {
+        return false;
+    }
+
+    devices = deviceMonitor->restoreState(*state);
+    staleSince = state->savedAt;
+    updateTrayIcon();
+    startupProfiler.mark("last known state shown");
+    return true;
+}
+
+void TrayApp::startDiscovery() {
+    HWND target = hwnd;
+    std::shared_ptr<DeviceBackend> backend = deviceBackend;
+    std::shared_ptr<const PatternMatcher> matcher = activeConfig->matcher;
+
+    discoveryThread = std::thread([target, backend, matcher]() {
+        Trace::nameThread("discovery");
+        Trace::Span span("discovery");
+        auto result = std::make_unique<DiscoveryResult>();
+        result->matcher = matcher;
+        result->started = StartupProfiler::Clock::now();
+        result->monitor = std::make_unique<DeviceMonitor>(backend, matcher);
+        result->devices = result->monitor->enumerateRazerDevices();
+        result->enumerated = StartupProfiler::Clock::now();
+        result->monitor->updateDeviceInfo(result->devices);
+        result->refreshed = StartupProfiler::Clock::now();
+
+        if (PostMessageW(target, WM_DEVICES_DISCOVERED, 0, reinterpret_cast<LPARAM>(result.get()))) {
+            result.release();  // owned by the message now
+        }
+    });
+}
+
+void TrayApp::onDevicesDiscovered(std::unique_ptr<DiscoveryResult> result) {
+    if (discoveryThread.joinable()) {
+        discoveryThread.join();  // it exits right after posting
+    }
+
+    // Adopt the worker's monitor: the devices' handles point into its pool
+    deviceMonitor = std::move(result->monitor);
+    devices = std::move(result->devices);
+    staleSince.reset();
+    GetLocalTime(&lastRefreshTime);
+
+    if (result->matcher != activeConfig->matcher) {
+        // The config was reloaded while enumerating
+        deviceMonitor->setMatcher(activeConfig->matcher);
+        discoverDevices();
+        deviceMonitor->updateDeviceInfo(devices);
+    }
+
+    if (!isRefreshing) {
+        updateTrayIcon();  // otherwise the end of the animation redraws it
+    }
+    startupProfiler.record("enumeration", result->started, result->enumerated);
+    startupProfiler.record("first refresh", result->enumerated, result->refreshed);
+    startupProfiler.mark("live state shown");
+    writeStartupReport();
+    saveDeviceState();
+    pushToCollector();
+    evaluateAlerts();
+}
+
+void TrayApp::saveDeviceState() {
+    if (staleSince.has_value() || deviceCachePath.empty()) {
+        return;  // nothing newer than the file yet, or no file
+    }
+    DeviceStateCache::save(deviceCachePath, deviceMonitor->captureState(devices));
+}
+
+double TrayApp::millisecondsSinceProcessStart() {
+    FILETIME created, exited, kernel, user, now;
+    if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) {
+        return 0.0;
+    }
+    GetSystemTimePreciseAsFileTime(&now);
+
+    ULARGE_INTEGER start, end;
+    start.LowPart = created.dwLowDateTime;
+    start.HighPart = created.dwHighDateTime;
+    end.LowPart = now.dwLowDateTime;
+    end.HighPart = now.dwHighDateTime;
+    return static_cast<double>(end.QuadPart - start.QuadPart) / 10000.0;  // 100 ns units
+}
+
+void TrayApp::writeStartupReport() {
+    // Once per launch, when the first live state is on screen
+    if (startupReported) {
+        return;
+    }
+    startupReported = true;
+
+    std::optional<uint64_t> executableBytes;
+    WCHAR exePath[MAX_PATH];
+    if (GetModuleFileNameW(nullptr, exePath, MAX_PATH) != 0) {
+        std::error_code error;
+        uintmax_t size = std::filesystem::file_size(exePath, error);
+        if (!error) executableBytes = size;
+    }
+
+    std::filesystem::path reportPath = configStore->path().parent_path() / "startup-report.json";
+    startupProfiler.writeReport(reportPath, executableBytes);
+
+    // Summary for a debugger or DebugView
+    for (const auto& milestone : startupProfiler.milestones()) {
+        wchar_t message[128];
+        swprintf_s(message, L"RazerTray: %hs %.1f ms after process start\n",
+                   milestone.name.c_str(), milestone.atMs);
+        OutputDebugStringW(message);
+    }
+}
+
+void TrayApp::startConfigWatcher() {
+    HWND target = hwnd;
+    ConfigStore* store = configStore.get();
+
+    // Runs on the watcher thread: parse and compile there, then only hand
+    // the UI thread a notification
+    configWatcher = std::make_unique<ConfigWatcher>(store->path(), [target, store]() {
+        Trace::nameThread("config watcher");
+        Trace::Span span("config reload");
+        std::optional<JsonError> error;
+        if (store->reload(error)) {
+            PostMessageW(target, WM_CONFIG_CHANGED, 0, 0);
+        } else if (error.has_value()) {
+            auto* pending = new JsonError(std::move(*error));
+            if (!PostMessageW(target, WM_CONFIG_INVALID, 0, reinterpret_cast<LPARAM>(pending))) {
+                delete pending;
+            }
+        }
+        // A missing file (mid-save rename or deletion) keeps the current settings
+    });
+    configWatcher->start();
+}
+
+UINT TrayApp::refreshTimerInterval(int seconds) const {
+    double milliseconds = std::round(seconds * 1000.0 / refreshSpeed);
+    return static_cast<UINT>(std::clamp(milliseconds, static_cast<double>(USER_TIMER_MINIMUM),
+                                        static_cast<double>(USER_TIMER_MAXIMUM)));
+}
+
+void TrayApp::applyConfig(std::shared_ptr<const ConfigSnapshot> next) {
+    if (!next || next == activeConfig) {
+        return;
+    }
+
+    // Rebuild only what the edit touched
+    std::shared_ptr<const ConfigSnapshot> previous = std::move(activeConfig);
+    activeConfig = std::move(next);
+    const Config& config = activeConfig->config;
+
+    if (config.refreshInterval != previous->config.refreshInterval) {
+        // Re-arming an existing timer ID replaces its interval
+        refreshInterval = refreshTimerInterval(config.refreshInterval);
+        SetTimer(hwnd, TIMER_REFRESH, refreshInterval, nullptr);
+    }
+
+    if (config.batteryThresholds != previous->config.batteryThresholds) {
+        batteryIcon->setLevelColors(activeConfig->levelColors);
+        if (!isRefreshing) {
+            updateTrayIcon();  // otherwise the end of the animation redraws it
+        }
+    }
+
+    if (config.metricsPort != previous->config.metricsPort) {
+        startMetricsServer();
+    }
+
+    if (config.collector != previous->config.collector) {
+        startCollectorAgent();
+        pushToCollector();
+    }
+
+    if (activeConfig->matcher != previous->matcher) {
+        // Device rules changed - the set of tracked devices may differ
+        deviceMonitor->setMatcher(activeConfig->matcher);
+        discoverDevices();
+        refreshDevices();
+    } else if (activeConfig->alerts != previous->alerts) {
+        evaluateAlerts();  // new rules see every device now, not at the next refresh
+    }
+}
+
+void TrayApp::showConfigError(const JsonError& error) {
+    // Balloon only; the icon and tooltip stay as they are
+    NOTIFYICONDATAW balloon = notifyIconData;
+    balloon.uFlags = NIF_INFO;
+    balloon.dwInfoFlags = NIIF_WARNING;
+    wcscpy_s(balloon.szInfoTitle, L"Razer Tray - Invalid Configuration");
+    swprintf_s(balloon.szInfo, L"config.json line %zu, column %zu: %hs\nKeeping the previous settings.",
+               error.line, error.column, error.message.c_str());
+    notifyShell(NIM_MODIFY, &balloon);
+}
+
+void TrayApp::startMetricsServer() {
+    metricsServer.reset();
+    int port = activeConfig->config.metricsPort;
+    if (port == 0) {
+        return;
+    }
+
+    metricsServer = std::make_unique<MetricsServer>(static_cast<uint16_t>(port));
+    if (!metricsServer->isListening()) {
+        metricsServer.reset();
+        NOTIFYICONDATAW balloon = notifyIconData;
+        balloon.uFlags = NIF_INFO;
+        balloon.dwInfoFlags = NIIF_WARNING;
+        wcscpy_s(balloon.szInfoTitle, L"Razer Tray - Metrics");
+        swprintf_s(balloon.szInfo, L"Could not listen on 127.0.0.1:%d (is the port in use?). Metrics are off.", port);
+        notifyShell(NIM_MODIFY, &balloon);
+        return;
+    }
+    metricsServer->update(devices, deviceMonitor->strings(), DeviceStateCache::now(), staleSince);
+}
+
+void TrayApp::startCollectorAgent() {
+    collectorAgent.reset();
+    const std::string& address = activeConfig->config.collector;
+    if (address.empty()) {
+        return;
+    }
+
+    // A RESYNC arrives on the agent's thread; the snapshot is sent from here
+    HWND target = hwnd;
+    collectorAgent = std::make_unique<CollectorAgent>(CollectorAgent::machineName(), address, [target]() {
+        PostMessageW(target, WM_COLLECTOR_RESYNC, 0, 0);
+    });
+    if (!collectorAgent->isConnected()) {
+        collectorAgent.reset();
+        NOTIFYICONDATAW balloon = notifyIconData;
+        balloon.uFlags = NIF_INFO;
+        balloon.dwInfoFlags = NIIF_WARNING;
+        wcscpy_s(balloon.szInfoTitle, L"Razer Tray - Collector");
+        swprintf_s(balloon.szInfo, L"\"%.64hs\" is not an IPv4 address and port (a.b.c.d:port). Not pushing to a collector.",
+                   address.c_str());
+        notifyShell(NIM_MODIFY, &balloon);
+    }
+}
+
+void TrayApp::pushToCollector() {
+    // The last known state from devices.cache is not news to anyone
+    if (collectorAgent && !staleSince.has_value()) {
+        collectorAgent->push(devices, deviceMonitor->strings(), DeviceStateCache::now());
+    }
+}
+
+void TrayApp::evaluateAlerts() {
+    if (staleSince.has_value()) {
+        return;  // the last known state is not a reading
+    }
+
+    // One balloon per refresh: the first alert, and how many others fired
+    const AlertRules& rules = *activeConfig->alerts;
+    std::optional<AlertRules::Alert> first;
+    size_t fired = 0;
+    rules.evaluate(devices, deviceMonitor->strings(), AlertRules::Moment::local(DeviceStateCache::now()), alertState,
+                   [&](const AlertRules::Alert& alert) {
+                       if (fired++ == 0) first = alert;
+                   });
+    if (!first.has_value()) {
+        return;
+    }
+
+    NOTIFYICONDATAW balloon = notifyIconData;
+    balloon.uFlags = NIF_INFO;
+    balloon.dwInfoFlags = NIIF_WARNING;
+    swprintf_s(balloon.szInfoTitle, L"Razer Tray - %.48ls", Utf8::toWide(rules.name(first->rule)).c_str());
+    std::wstring device = Utf8::toWide(AlertRules::describe(devices, deviceMonitor->strings(), first->row));
+    if (fired > 1) {
+        swprintf_s(balloon.szInfo, L"%.160ls\nand %zu more", device.c_str(), fired - 1);
+    } else {
+        swprintf_s(balloon.szInfo, L"%.200ls", device.c_str());
+    }
+    notifyShell(NIM_MODIFY, &balloon);
+}
+
+BOOL TrayApp::notifyShell(DWORD message, NOTIFYICONDATAW* data) {
+    LatencyProbes::Probe probe(LatencyProbes::Site::NotifyIcon);
+    return Shell_NotifyIconW(message, data);
+}
+
+void TrayApp::toggleTrace() {
+    if (!Trace::enabled()) {
+        Trace::start();
+        return;
+    }
+    Trace::stop();
+
+    SYSTEMTIME now;
+    GetLocalTime(&now);
+    wchar_t fileName[64];
+    swprintf_s(fileName, L"trace-%04d%02d%02d-%02d%02d%02d.json",
+               now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond);
+    std::filesystem::path tracePath = configStore->path().parent_path() / fileName;
+    bool saved = Trace::writeJson(tracePath);
+
+    NOTIFYICONDATAW balloon = notifyIconData;
+    balloon.uFlags = NIF_INFO;
+    balloon.dwInfoFlags = saved ? NIIF_INFO : NIIF_WARNING;
+    wcscpy_s(balloon.szInfoTitle, L"Razer Tray - Trace");
+    swprintf_s(balloon.szInfo, saved ? L"Saved %ls (open it in ui.perfetto.dev)" : L"Could not write %ls",
+               fileName);
+    notifyShell(NIM_MODIFY, &balloon);
+}
+
+void TrayApp::showLatencyReport() {
+    std::string report = LatencyProbes::report();
+    std::wstring text = Utf8::toWide(report);
+    OutputDebugStringW(text.c_str());
+    MessageBoxW(nullptr, text.c_str(), L"Razer Tray - Latency Statistics", MB_ICONINFORMATION | MB_OK);
+}
+
 bool TrayApp::createWindow() {
     // Register window class
     WNDCLASSEXW wc = {};
@@ -105,7 +476,7 @@ bool TrayApp::addTrayIcon() {
 
     wcscpy_s(notifyIconData.szTip, L"Razer Tray - Initializing...");
 
-    bool result = Shell_NotifyIconW(NIM_ADD, &notifyIconData);
+    bool result = notifyShell(NIM_ADD, &notifyIconData);
 
     if (icon) {
         DestroyIcon(icon);
@@ -115,41 +486,27 @@ bool TrayApp::addTrayIcon() {
 }
 
 void TrayApp::updateTrayIcon() {
-    // Filter for connected devices only
-    std::vector<RazerDevice*> connectedDevices;
-    for (const auto& device : devices) {
-        if (device->isConnected) {
-            connectedDevices.push_back(device.get());
-        }
-    }
+    // Icon update ends a refresh cycle; everything below lives in the arena
+    ScopedNoAllocations noAllocations("TrayApp::updateTrayIcon");
+    Trace::Span span("update tray icon");
+    RefreshArena::Scope cycle(refreshArena);
 
     // Update icon based on device state
     HICON newIcon = nullptr;
 
-    if (connectedDevices.empty()) {
+    if (devices.connectedCount() == 0) {
         // No devices connected - show gray icon
         newIcon = batteryIcon->createBatteryIcon(std::nullopt);
         wcscpy_s(notifyIconData.szTip, L"Razer Tray - No devices connected");
     } else {
-        // Find device with lowest battery
-        auto lowestBattery = std::min_element(
-            connectedDevices.begin(),
-            connectedDevices.end(),
-            [](const RazerDevice* a, const RazerDevice* b) {
-                if (!a->batteryLevel.has_value()) return false;
-                if (!b->batteryLevel.has_value()) return true;
-                return a->batteryLevel.value() < b->batteryLevel.value();
-            }
-        );
-
-        if (lowestBattery != connectedDevices.end() && (*lowestBattery)->batteryLevel.has_value()) {
-            newIcon = batteryIcon->createBatteryIcon((*lowestBattery)->batteryLevel);
-        } else {
-            newIcon = batteryIcon->createBatteryIcon(std::nullopt);
-        }
+        // Lowest battery among connected devices, kept up to date by the table
+        std::optional<DeviceTable::Row> lowestBattery = devices.lowestBattery();
+        newIcon = batteryIcon->createBatteryIcon(
+            lowestBattery.has_value() ? devices.batteryLevel(*lowestBattery) : std::nullopt);
 
         // Generate tooltip
-        std::wstring tooltip = getTooltipText();
+        Trace::Span tooltipSpan("tooltip");
+        std::pmr::wstring tooltip = getTooltipText();
         wcscpy_s(notifyIconData.szTip, tooltip.c_str());
     }
 
@@ -157,16 +514,26 @@ void TrayApp::updateTrayIcon() {
     if (newIcon) {
         HICON oldIcon = notifyIconData.hIcon;
         notifyIconData.hIcon = newIcon;
-        Shell_NotifyIconW(NIM_MODIFY, &notifyIconData);
+        notifyShell(NIM_MODIFY, &notifyIconData);
 
         if (oldIcon) {
             DestroyIcon(oldIcon);
         }
     }
+
+    // Same state for --status readers and metrics scrapes
+    int64_t now = DeviceStateCache::now();
+    if (statusPublisher) {
+        statusPublisher->publish(devices, deviceMonitor->strings(), now, staleSince, memoryUsage(),
+                                 ProcessTelemetry::sample());
+    }
+    if (metricsServer) {
+        metricsServer->update(devices, deviceMonitor->strings(), now, staleSince);
+    }
 }
 
 void TrayApp::removeTrayIcon() {
-    Shell_NotifyIconW(NIM_DELETE, &notifyIconData);
+    notifyShell(NIM_DELETE, &notifyIconData);
 
     if (notifyIconData.hIcon) {
         DestroyIcon(notifyIconData.hIcon);
@@ -177,6 +544,8 @@ void TrayApp::removeTrayIcon() {
 void TrayApp::showContextMenu() {
     HMENU menu = CreatePopupMenu();
     AppendMenuW(menu, MF_STRING, ID_MENU_REFRESH, L"Refresh Now");
+    AppendMenuW(menu, MF_STRING, ID_MENU_LATENCY, L"Latency Statistics");
+    AppendMenuW(menu, MF_STRING | (Trace::enabled() ? MF_CHECKED : MF_UNCHECKED), ID_MENU_TRACE, L"Record Trace");
     AppendMenuW(menu, MF_SEPARATOR, 0, nullptr);
     AppendMenuW(menu, MF_STRING, ID_MENU_EXIT, L"Exit");
 
@@ -194,17 +563,28 @@ void TrayApp::showContextMenu() {
 
 void TrayApp::discoverDevices() {
     devices = deviceMonitor->enumerateRazerDevices();
+    staleSince.reset();
 }
 
 void TrayApp::refreshDevices() {
+    Trace::Span span("refresh");
+
     // Start animation (will run for 3 seconds)
     startRefreshAnimation();
 
     // Perform refresh (instant, but animation continues)
-    deviceMonitor->updateDeviceInfo(devices);
+    {
+        ScopedNoAllocations noAllocations("DeviceMonitor::updateDeviceInfo");
+        deviceMonitor->updateDeviceInfo(devices);
+    }
 
     // Capture timestamp
     GetLocalTime(&lastRefreshTime);
+    staleSince.reset();
+
+    // The collector hears of it now, not when the animation ends
+    pushToCollector();
+    evaluateAlerts();
 
     // Update icon data (but keep showing animation)
     // Note: updateTrayIcon() is NOT called here - animation handles icon updates
@@ -214,36 +594,35 @@ void TrayApp::refreshDevices() {
     SetTimer(hwnd, TIMER_ANIMATION_STOP, ANIMATION_DURATION, nullptr);
 }
 
-std::wstring TrayApp::getTooltipText() {
-    std::wstringstream ss;
-    ss << L"Razer Tray";
+std::pmr::wstring TrayApp::getTooltipText() {
+    std::pmr::wstring text(refreshArena.resource());
+    text.reserve(TOOLTIP_RESERVE);
 
-    // Add timestamp right under title if we've refreshed at least once
-    if (lastRefreshTime.wYear != 0) {
-        ss << L"\n" << formatTimestamp(lastRefreshTime);
-    }
-
-    // Add devices below timestamp
-    bool hasConnected = false;
-    for (const auto& device : devices) {
-        if (device->isConnected && device->batteryLevel.has_value()) {
-            ss << L"\n" << device->name << L": " << device->batteryLevel.value() << L"%";
-            hasConnected = true;
-        }
+    std::optional<int64_t> staleSeconds;
+    if (staleSince.has_value()) {
+        staleSeconds = DeviceStateCache::now() - *staleSince;
     }
-
-    if (!hasConnected) {
-        ss << L"\nNo devices connected";
+    std::optional<Tooltip::TimeOfDay> updatedAt;
+    if (lastRefreshTime.wYear != 0) {
+        updatedAt = Tooltip::TimeOfDay{lastRefreshTime.wHour, lastRefreshTime.wMinute, lastRefreshTime.wSecond};
     }
 
-    return ss.str();
+    Tooltip::build(text, devices, deviceMonitor->strings(), staleSeconds, updatedAt,
+                   ARRAYSIZE(notifyIconData.szTip) - 1);
+    return text;
 }
 
-std::wstring TrayApp::formatTimestamp(const SYSTEMTIME& time) {
-    wchar_t buffer[64];
-    swprintf_s(buffer, L"Updated: %02d:%02d:%02d",
-               time.wHour, time.wMinute, time.wSecond);
-    return std::wstring(buffer);
+MemoryAccounting::Report TrayApp::memoryUsage() const {
+    using MemoryAccounting::Subsystem;
+    MemoryAccounting::Report report;
+    report.add(Subsystem::Config, (activeConfig ? activeConfig->memoryUsage() : 0) + deviceMonitor->matcherCacheUsage());
+    report.add(Subsystem::Devices, devices.memoryUsage() + deviceMonitor->memoryUsage() + alertState.memoryUsage());
+    report.add(Subsystem::Icons, (batteryIcon ? sizeof(BatteryIcon) : 0) +
+                                     (notifyIconData.hIcon ? BatteryIcon::iconBytes() : 0));
+    report.add(Subsystem::Buffers, sizeof(RefreshArena) + (metricsServer ? metricsServer->memoryUsage() : 0) +
+                                       (collectorAgent ? collectorAgent->memoryUsage() : 0));
+    MemoryAccounting::addProcessWide(report);
+    return report;
 }
 
 void TrayApp::startRefreshAnimation() {
@@ -254,7 +633,7 @@ void TrayApp::startRefreshAnimation() {
 
         // Update tooltip to show refreshing status
         wcscpy_s(notifyIconData.szTip, L"Refreshing...");
-        Shell_NotifyIconW(NIM_MODIFY, &notifyIconData);
+        notifyShell(NIM_MODIFY, &notifyIconData);
     }
 }
 
@@ -272,6 +651,7 @@ void TrayApp::stopRefreshAnimation() {
 
 void TrayApp::updateRefreshAnimation() {
     if (!isRefreshing) return;
+    Trace::Span span("animation frame");
 
     // Create icon with spinning indicator
     // We'll add a small dot that rotates around the battery icon
@@ -315,7 +695,7 @@ void TrayApp::updateRefreshAnimation() {
     if (animatedIcon) {
         HICON oldIcon = notifyIconData.hIcon;
         notifyIconData.hIcon = animatedIcon;
-        Shell_NotifyIconW(NIM_MODIFY, &notifyIconData);
+        notifyShell(NIM_MODIFY, &notifyIconData);
 
         if (oldIcon != currentIcon) {
             DestroyIcon(oldIcon);
@@ -342,6 +722,29 @@ void TrayApp::run() {
 }
 
 void TrayApp::cleanup() {
+    // Stop reloading before the window that receives the notifications goes
+    configWatcher.reset();
+
+    if (discoveryThread.joinable()) {
+        discoveryThread.join();
+    }
+    if (hwnd) {
+        // A discovery result nobody will handle any more
+        MSG pending;
+        while (PeekMessageW(&pending, hwnd, WM_DEVICES_DISCOVERED, WM_DEVICES_DISCOVERED, PM_REMOVE)) {
+            delete reinterpret_cast<DiscoveryResult*>(pending.lParam);
+        }
+
+        // Persist the last known state for the next launch
+        saveDeviceState();
+    }
+    EventLog::stop();
+
+    // --status reports no tray and scrapes fail from here on
+    statusPublisher.reset();
+    metricsServer.reset();
+    collectorAgent.reset();
+
     if (hwnd) {
         KillTimer(hwnd, TIMER_REFRESH);
         KillTimer(hwnd, TIMER_REFRESH_ANIMATION);
@@ -377,6 +780,7 @@ LRESULT CALLBACK TrayApp::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
 
     switch (msg) {
         case WM_TRAYICON:
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Input);
             if (lParam == WM_RBUTTONUP) {
                 app->showContextMenu();
             } else if (lParam == WM_LBUTTONDBLCLK) {
@@ -384,11 +788,40 @@ LRESULT CALLBACK TrayApp::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
             }
             return 0;
 
+        case WM_DEVICES_DISCOVERED:
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+            app->onDevicesDiscovered(std::unique_ptr<DiscoveryResult>(reinterpret_cast<DiscoveryResult*>(lParam)));
+            return 0;
+
+        case WM_CONFIG_CHANGED:
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+            app->applyConfig(app->configStore->current());
+            return 0;
+
+        case WM_COLLECTOR_RESYNC:
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+            app->pushToCollector();
+            return 0;
+
+        case WM_CONFIG_INVALID: {
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Notification);
+            std::unique_ptr<JsonError> error(reinterpret_cast<JsonError*>(lParam));
+            app->showConfigError(*error);
+            return 0;
+        }
+
         case WM_COMMAND:
+            ProcessTelemetry::count(ProcessTelemetry::Wakeup::Input);
             switch (LOWORD(wParam)) {
                 case ID_MENU_REFRESH:
                     app->refreshDevices();
                     break;
+                case ID_MENU_LATENCY:
+                    app->showLatencyReport();
+                    break;
+                case ID_MENU_TRACE:
+                    app->toggleTrace();
+                    break;
                 case ID_MENU_EXIT:
                     PostQuitMessage(0);
                     break;
@@ -397,10 +830,14 @@ LRESULT CALLBACK TrayApp::windowProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM
 
         case WM_TIMER:
             if (wParam == TIMER_REFRESH) {
+                ProcessTelemetry::count(ProcessTelemetry::Wakeup::RefreshTimer);
                 app->refreshDevices();
+                app->saveDeviceState();
             } else if (wParam == TIMER_REFRESH_ANIMATION) {
+                ProcessTelemetry::count(ProcessTelemetry::Wakeup::AnimationTimer);
                 app->updateRefreshAnimation();
             } else if (wParam == TIMER_ANIMATION_STOP) {
+                ProcessTelemetry::count(ProcessTelemetry::Wakeup::AnimationTimer);
                 app->stopRefreshAnimation();
             }
             return 0;
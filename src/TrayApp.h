@@ -3,15 +3,33 @@
 #include <windows.h>
 #include <shellapi.h>
 #include <memory>
+#include <memory_resource>
+#include <string>
 #include <vector>
 #include <optional>
+#include <thread>
 #include "DeviceMonitor.h"
+#include "AlertRules.h"
 #include "BatteryIcon.h"
+#include "CollectorAgent.h"
 #include "ConfigManager.h"
+#include "ConfigStore.h"
+#include "ConfigWatcher.h"
+#include "MemoryAccounting.h"
+#include "MetricsServer.h"
+#include "RefreshArena.h"
+#include "StartupProfiler.h"
+#include "StatusSegment.h"
 
 class TrayApp {
 public:
-    TrayApp(HINSTANCE hInstance);
+    // backend: where devices come from (nullptr: the system, via SetupAPI);
+    // useDeviceCache: show and save the last known state (devices.cache)
+    // and log device events (events.rzlog); off for replayed devices;
+    // refreshSpeed: divides the configured refresh interval (a replay's
+    // --replay-speed, so refreshes keep pace with its clock)
+    TrayApp(HINSTANCE hInstance, std::shared_ptr<DeviceBackend> backend = nullptr, bool useDeviceCache = true,
+            double refreshSpeed = 1.0);
     ~TrayApp();
 
     // Initialize and run the application
@@ -30,10 +48,16 @@ private:
 
     // Custom window messages
     static constexpr UINT WM_TRAYICON = WM_USER + 1;
+    static constexpr UINT WM_CONFIG_CHANGED = WM_USER + 2;  // a new snapshot was published
+    static constexpr UINT WM_CONFIG_INVALID = WM_USER + 3;  // lParam: JsonError* (receiver deletes)
+    static constexpr UINT WM_DEVICES_DISCOVERED = WM_USER + 4;  // lParam: DiscoveryResult* (receiver deletes)
+    static constexpr UINT WM_COLLECTOR_RESYNC = WM_USER + 5;  // the collector asked for a snapshot
 
     // Menu IDs
     static constexpr UINT ID_MENU_REFRESH = 1001;
     static constexpr UINT ID_MENU_EXIT = 1002;
+    static constexpr UINT ID_MENU_LATENCY = 1003;
+    static constexpr UINT ID_MENU_TRACE = 1004;
 
     // Refresh interval (5 minutes in milliseconds)
     static constexpr UINT REFRESH_INTERVAL = 5 * 60 * 1000;
@@ -43,21 +67,70 @@ private:
     static constexpr int ANIMATION_FRAMES = 8;  // Number of rotation steps
     static constexpr UINT ANIMATION_DURATION = 3000;  // Show animation for 3 seconds
 
+    // Initial tooltip capacity so the string never regrows mid-build
+    static constexpr size_t TOOLTIP_RESERVE = 512;
+
+    StartupProfiler startupProfiler;
+    bool startupReported;
+
     HINSTANCE hInstance;
     HWND hwnd;
     NOTIFYICONDATAW notifyIconData;
 
+    std::shared_ptr<DeviceBackend> deviceBackend;
     std::unique_ptr<DeviceMonitor> deviceMonitor;
     std::unique_ptr<BatteryIcon> batteryIcon;
-    std::vector<std::unique_ptr<RazerDevice>> devices;
-    std::optional<Config> config;
+    DeviceTable devices;
     UINT refreshInterval;
+    double refreshSpeed;
+
+    // Device state and memory for `RazerTray --status` (published with
+    // every icon update)
+    std::unique_ptr<StatusSegment::Publisher> statusPublisher;
+
+    // Loopback Prometheus endpoint while config metricsPort is set (updated
+    // with every icon update)
+    std::unique_ptr<MetricsServer> metricsServer;
+
+    // Pushes device changes to the collector while config collector is set
+    // (after every icon update)
+    std::unique_ptr<CollectorAgent> collectorAgent;
+
+    // Per-device state of the config's alert rules (evaluated after every
+    // refresh)
+    AlertRules::State alertState;
+
+    // config.json, reparsed on the watcher thread whenever it changes
+    std::unique_ptr<ConfigStore> configStore;
+    std::unique_ptr<ConfigWatcher> configWatcher;
+
+    // Snapshot the UI is currently running on
+    std::shared_ptr<const ConfigSnapshot> activeConfig;
+
+    // Startup enumeration, run on its own thread with its own DeviceMonitor
+    // while the last known state is on screen
+    struct DiscoveryResult {
+        std::unique_ptr<DeviceMonitor> monitor;
+        DeviceTable devices;
+        std::shared_ptr<const PatternMatcher> matcher;  // rules it enumerated with
+        StartupProfiler::Clock::time_point started, enumerated, refreshed;
+    };
+    std::thread discoveryThread;
+
+    // Last known devices (devices.cache; empty path when disabled);
+    // staleSince is set while the devices on display come from it rather
+    // than from the system
+    std::filesystem::path deviceCachePath;
+    std::optional<int64_t> staleSince;
 
     // Animation state
     bool isRefreshing;
     int animationFrame;
     SYSTEMTIME lastRefreshTime;
 
+    // Scratch memory for the current refresh cycle, reset after each icon update
+    RefreshArena refreshArena;
+
     // Create hidden window for message processing
     bool createWindow();
 
@@ -67,6 +140,44 @@ private:
     void removeTrayIcon();
     void showContextMenu();
 
+    // Shell_NotifyIconW, timed into the latency histograms
+    static BOOL notifyShell(DWORD message, NOTIFYICONDATAW* data);
+
+    // Percentiles of every timed OS call (tray menu)
+    void showLatencyReport();
+
+    // Start recording a trace, or stop and save it as trace-<time>.json
+    // next to config.json (tray menu)
+    void toggleTrace();
+
+    // Config hot reload
+    void startConfigWatcher();
+    void applyConfig(std::shared_ptr<const ConfigSnapshot> next);
+    // Refresh timer period for a config refreshInterval, in milliseconds
+    UINT refreshTimerInterval(int seconds) const;
+    void showConfigError(const JsonError& error);
+
+    // (Re)start or stop the metrics endpoint for the active config
+    void startMetricsServer();
+
+    // (Re)start or stop pushing to the collector for the active config
+    void startCollectorAgent();
+    void pushToCollector();
+
+    // Run the alert rules on the devices that changed; a balloon for what fired
+    void evaluateAlerts();
+
+    // Warm start
+    bool showCachedDevices();
+    void startDiscovery();
+    void onDevicesDiscovered(std::unique_ptr<DiscoveryResult> result);
+    void saveDeviceState();
+
+    // Startup phases and milestones, written to startup-report.json once
+    // the first live state is shown
+    static double millisecondsSinceProcessStart();
+    void writeStartupReport();
+
     // Device management
     void discoverDevices();
     void refreshDevices();
@@ -74,7 +185,9 @@ private:
     void stopRefreshAnimation();
     void updateRefreshAnimation();
 
-    // Generate tooltip text
-    std::wstring getTooltipText();
-    std::wstring formatTimestamp(const SYSTEMTIME& time);
+    // Generate tooltip text (allocated from the refresh arena)
+    std::pmr::wstring getTooltipText();
+
+    // What the tray holds, by subsystem (published with every icon update)
+    MemoryAccounting::Report memoryUsage() const;
 };
@@ -0,0 +1,453 @@
+#include "Utf8.h"
+#include <bit>
+#include <cstdint>
+#include <cwchar>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_HAVE_X86_SIMD 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define UTF8_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define UTF8_TARGET_AVX2
+#endif
+
+namespace {
+    using ConvertToUtf16 = std::optional<size_t> (*)(std::string_view, char16_t*, size_t);
+    using ConvertFromUtf16 = std::optional<size_t> (*)(std::u16string_view, char*, size_t);
+
+    // Decode one multi-byte sequence starting at in[i] (in[i] >= 0x80) and
+    // append it as UTF-16. Follows the well-formed byte sequence table of the
+    // Unicode standard (Table 3-7).
+    inline bool decodeSequence(const unsigned char* in, size_t length, size_t& i,
+                               char16_t* out, size_t& o, size_t capacity) {
+        unsigned char lead = in[i];
+        size_t sequenceLength;
+        uint32_t codePoint;
+
+        if (lead < 0xC2) {
+            return false;  // stray continuation byte or overlong 2-byte form
+        } else if (lead < 0xE0) {
+            sequenceLength = 2;
+            codePoint = lead & 0x1F;
+        } else if (lead < 0xF0) {
+            sequenceLength = 3;
+            codePoint = lead & 0x0F;
+        } else if (lead < 0xF5) {
+            sequenceLength = 4;
+            codePoint = lead & 0x07;
+        } else {
+            return false;
+        }
+
+        if (length - i < sequenceLength) {
+            return false;  // truncated
+        }
+
+        for (size_t k = 1; k < sequenceLength; k++) {
+            unsigned char next = in[i + k];
+            if ((next & 0xC0) != 0x80) {
+                return false;
+            }
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+
+        if (sequenceLength == 3 && (codePoint < 0x800 || (codePoint >= 0xD800 && codePoint <= 0xDFFF))) {
+            return false;  // overlong or encoded surrogate
+        }
+        if (sequenceLength == 4 && (codePoint < 0x10000 || codePoint > 0x10FFFF)) {
+            return false;
+        }
+
+        if (codePoint >= 0x10000) {
+            if (capacity - o < 2) return false;
+            codePoint -= 0x10000;
+            out[o++] = static_cast<char16_t>(0xD800 + (codePoint >> 10));
+            out[o++] = static_cast<char16_t>(0xDC00 + (codePoint & 0x3FF));
+        } else {
+            if (capacity - o < 1) return false;
+            out[o++] = static_cast<char16_t>(codePoint);
+        }
+
+        i += sequenceLength;
+        return true;
+    }
+
+    // Encode the non-ASCII code unit(s) at in[i] as UTF-8
+    inline bool encodeSequence(const char16_t* in, size_t length, size_t& i,
+                               char* out, size_t& o, size_t capacity) {
+        uint32_t codePoint = in[i];
+
+        if (codePoint >= 0xD800 && codePoint <= 0xDFFF) {
+            // Must be a high surrogate followed by a low surrogate
+            if (codePoint > 0xDBFF || length - i < 2 || in[i + 1] < 0xDC00 || in[i + 1] > 0xDFFF) {
+                return false;
+            }
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (in[i + 1] - 0xDC00);
+            if (capacity - o < 4) return false;
+            out[o++] = static_cast<char>(0xF0 | (codePoint >> 18));
+            out[o++] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            i += 2;
+            return true;
+        }
+
+        if (codePoint < 0x800) {
+            if (capacity - o < 2) return false;
+            out[o++] = static_cast<char>(0xC0 | (codePoint >> 6));
+            out[o++] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        } else {
+            if (capacity - o < 3) return false;
+            out[o++] = static_cast<char>(0xE0 | (codePoint >> 12));
+            out[o++] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            out[o++] = static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        i += 1;
+        return true;
+    }
+
+    // Scalar loops, also used for the tails of the SIMD versions
+    std::optional<size_t> toUtf16Tail(const unsigned char* in, size_t length, size_t i,
+                                      char16_t* out, size_t o, size_t capacity) {
+        while (i < length) {
+            if (in[i] < 0x80) {
+                if (o == capacity) return std::nullopt;
+                out[o++] = in[i++];
+            } else if (!decodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+        return o;
+    }
+
+    std::optional<size_t> fromUtf16Tail(const char16_t* in, size_t length, size_t i,
+                                        char* out, size_t o, size_t capacity) {
+        while (i < length) {
+            if (in[i] < 0x80) {
+                if (o == capacity) return std::nullopt;
+                out[o++] = static_cast<char>(in[i++]);
+            } else if (!encodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+        return o;
+    }
+
+    std::optional<size_t> toUtf16Scalar(std::string_view utf8, char16_t* out, size_t capacity) {
+        return toUtf16Tail(reinterpret_cast<const unsigned char*>(utf8.data()), utf8.size(), 0, out, 0, capacity);
+    }
+
+    std::optional<size_t> fromUtf16Scalar(std::u16string_view utf16, char* out, size_t capacity) {
+        return fromUtf16Tail(utf16.data(), utf16.size(), 0, out, 0, capacity);
+    }
+
+#ifdef UTF8_HAVE_X86_SIMD
+    // When a block contains non-ASCII input, its ASCII prefix is copied, the
+    // first multi-byte sequence goes through the scalar decoder and the
+    // vector loop resumes right after it.
+
+    std::optional<size_t> toUtf16Sse2(std::string_view utf8, char16_t* out, size_t capacity) {
+        const auto* in = reinterpret_cast<const unsigned char*>(utf8.data());
+        size_t length = utf8.size();
+        size_t i = 0;
+        size_t o = 0;
+        const __m128i zero = _mm_setzero_si128();
+
+        while (length - i >= 16 && capacity - o >= 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            int nonAscii = _mm_movemask_epi8(bytes);
+            if (nonAscii == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_unpacklo_epi8(bytes, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o + 8), _mm_unpackhi_epi8(bytes, zero));
+                i += 16;
+                o += 16;
+                continue;
+            }
+
+            for (int ascii = std::countr_zero(static_cast<unsigned>(nonAscii)); ascii > 0; ascii--) {
+                out[o++] = in[i++];
+            }
+            if (!decodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+
+        return toUtf16Tail(in, length, i, out, o, capacity);
+    }
+
+    std::optional<size_t> fromUtf16Sse2(std::u16string_view utf16, char* out, size_t capacity) {
+        const char16_t* in = utf16.data();
+        size_t length = utf16.size();
+        size_t i = 0;
+        size_t o = 0;
+        const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+
+        while (length - i >= 16 && capacity - o >= 16) {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+            __m128i lowAscii = _mm_cmpeq_epi16(_mm_and_si128(low, asciiMask), zero);
+            __m128i highAscii = _mm_cmpeq_epi16(_mm_and_si128(high, asciiMask), zero);
+            // One bit per code unit: set where the unit is not ASCII
+            unsigned nonAscii = ~static_cast<unsigned>(_mm_movemask_epi8(_mm_packs_epi16(lowAscii, highAscii))) & 0xFFFF;
+            if (nonAscii == 0) {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + o), _mm_packus_epi16(low, high));
+                i += 16;
+                o += 16;
+                continue;
+            }
+
+            for (int ascii = std::countr_zero(nonAscii); ascii > 0; ascii--) {
+                out[o++] = static_cast<char>(in[i++]);
+            }
+            if (!encodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+
+        return fromUtf16Tail(in, length, i, out, o, capacity);
+    }
+
+    UTF8_TARGET_AVX2
+    std::optional<size_t> toUtf16Avx2(std::string_view utf8, char16_t* out, size_t capacity) {
+        const auto* in = reinterpret_cast<const unsigned char*>(utf8.data());
+        size_t length = utf8.size();
+        size_t i = 0;
+        size_t o = 0;
+
+        while (length - i >= 32 && capacity - o >= 32) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            int nonAscii = _mm256_movemask_epi8(bytes);
+            if (nonAscii == 0) {
+                __m256i first = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes));
+                __m256i second = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), first);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o + 16), second);
+                i += 32;
+                o += 32;
+                continue;
+            }
+
+            for (int ascii = std::countr_zero(static_cast<unsigned>(nonAscii)); ascii > 0; ascii--) {
+                out[o++] = in[i++];
+            }
+            if (!decodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+
+        return toUtf16Tail(in, length, i, out, o, capacity);
+    }
+
+    UTF8_TARGET_AVX2
+    std::optional<size_t> fromUtf16Avx2(std::u16string_view utf16, char* out, size_t capacity) {
+        const char16_t* in = utf16.data();
+        size_t length = utf16.size();
+        size_t i = 0;
+        size_t o = 0;
+        const __m256i asciiMask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+        const __m256i zero = _mm256_setzero_si256();
+
+        while (length - i >= 32 && capacity - o >= 32) {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+            __m256i lowAscii = _mm256_cmpeq_epi16(_mm256_and_si256(low, asciiMask), zero);
+            __m256i highAscii = _mm256_cmpeq_epi16(_mm256_and_si256(high, asciiMask), zero);
+            // packs interleaves 128-bit lanes, permute back to element order
+            __m256i asciiBytes = _mm256_permute4x64_epi64(_mm256_packs_epi16(lowAscii, highAscii), 0xD8);
+            unsigned nonAscii = ~static_cast<unsigned>(_mm256_movemask_epi8(asciiBytes));
+            if (nonAscii == 0) {
+                // packus works per 128-bit lane; restore element order
+                __m256i packed = _mm256_packus_epi16(low, high);
+                packed = _mm256_permute4x64_epi64(packed, 0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + o), packed);
+                i += 32;
+                o += 32;
+                continue;
+            }
+
+            for (int ascii = std::countr_zero(nonAscii); ascii > 0; ascii--) {
+                out[o++] = static_cast<char>(in[i++]);
+            }
+            if (!encodeSequence(in, length, i, out, o, capacity)) {
+                return std::nullopt;
+            }
+        }
+
+        return fromUtf16Tail(in, length, i, out, o, capacity);
+    }
+
+    bool cpuHasAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+
+        // AVX needs OS support for saving YMM state
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return false;
+#endif
+    }
+#endif
+
+    struct Implementation {
+        const char* name;
+        ConvertToUtf16 toUtf16;
+        ConvertFromUtf16 fromUtf16;
+    };
+
+    const Implementation& implementation() {
+        static const Implementation selected = [] {
+#ifdef UTF8_HAVE_X86_SIMD
+            if (cpuHasAvx2()) {
+                return Implementation{"avx2", toUtf16Avx2, fromUtf16Avx2};
+            }
+            return Implementation{"sse2", toUtf16Sse2, fromUtf16Sse2};
+#else
+            return Implementation{"scalar", toUtf16Scalar, fromUtf16Scalar};
+#endif
+        }();
+        return selected;
+    }
+
+    constexpr bool WIDE_IS_UTF16 = sizeof(wchar_t) == sizeof(char16_t);
+
+    // wchar_t is UTF-32 outside Windows: code points map one to one
+    std::optional<size_t> toUtf32(std::string_view utf8, wchar_t* out, size_t capacity) {
+        // Decode via UTF-16 pairs one sequence at a time
+        const auto* in = reinterpret_cast<const unsigned char*>(utf8.data());
+        size_t o = 0;
+        for (size_t i = 0; i < utf8.size();) {
+            char16_t units[2];
+            size_t count = 0;
+            if (in[i] < 0x80) {
+                units[count++] = in[i++];
+            } else if (!decodeSequence(in, utf8.size(), i, units, count, 2)) {
+                return std::nullopt;
+            }
+            if (o == capacity) return std::nullopt;
+            out[o++] = count == 2
+                ? static_cast<wchar_t>(0x10000 + ((units[0] - 0xD800) << 10) + (units[1] - 0xDC00))
+                : static_cast<wchar_t>(units[0]);
+        }
+        return o;
+    }
+
+    std::optional<size_t> fromUtf32(std::wstring_view wide, char* out, size_t capacity) {
+        size_t o = 0;
+        for (wchar_t ch : wide) {
+            uint32_t codePoint = static_cast<uint32_t>(ch);
+            if (codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+                return std::nullopt;
+            }
+            char16_t units[2];
+            size_t count = 0;
+            if (codePoint >= 0x10000) {
+                units[count++] = static_cast<char16_t>(0xD800 + ((codePoint - 0x10000) >> 10));
+                units[count++] = static_cast<char16_t>(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+            } else {
+                units[count++] = static_cast<char16_t>(codePoint);
+            }
+            auto written = fromUtf16Tail(units, count, 0, out, o, capacity);
+            if (!written) return std::nullopt;
+            o = *written;
+        }
+        return o;
+    }
+
+    std::optional<size_t> toWideBuffer(std::string_view utf8, wchar_t* out, size_t capacity) {
+        if constexpr (WIDE_IS_UTF16) {
+            return implementation().toUtf16(utf8, reinterpret_cast<char16_t*>(out), capacity);
+        } else {
+            return toUtf32(utf8, out, capacity);
+        }
+    }
+
+    std::optional<size_t> fromWideBuffer(std::wstring_view wide, char* out, size_t capacity) {
+        if constexpr (WIDE_IS_UTF16) {
+            std::u16string_view utf16(reinterpret_cast<const char16_t*>(wide.data()), wide.size());
+            return implementation().fromUtf16(utf16, out, capacity);
+        } else {
+            return fromUtf32(wide, out, capacity);
+        }
+    }
+}
+
+std::optional<size_t> Utf8::toUtf16(std::string_view utf8, char16_t* out) {
+    return implementation().toUtf16(utf8, out, maxUtf16Length(utf8.size()));
+}
+
+std::optional<size_t> Utf8::fromUtf16(std::u16string_view utf16, char* out) {
+    return implementation().fromUtf16(utf16, out, maxUtf8Length(utf16.size()));
+}
+
+std::optional<size_t> Utf8::toUtf16Scalar(std::string_view utf8, char16_t* out) {
+    return ::toUtf16Scalar(utf8, out, maxUtf16Length(utf8.size()));
+}
+
+std::optional<size_t> Utf8::fromUtf16Scalar(std::u16string_view utf16, char* out) {
+    return ::fromUtf16Scalar(utf16, out, maxUtf8Length(utf16.size()));
+}
+
+const char* Utf8::implementationName() {
+    return implementation().name;
+}
+
+std::wstring Utf8::toWide(std::string_view utf8) {
+    if (utf8.empty()) return L"";
+
+    // Size for the worst case, convert once, then trim
+    std::wstring result(maxUtf16Length(utf8.size()), L'\0');
+    auto written = toWideBuffer(utf8, result.data(), result.size());
+    if (!written) return L"";
+
+    result.resize(*written);
+    return result;
+}
+
+std::string Utf8::fromWide(std::wstring_view wide) {
+    if (wide.empty()) return "";
+
+    std::string result(maxUtf8Length(wide.size()), '\0');
+    auto written = fromWideBuffer(wide, result.data(), result.size());
+    if (!written) return "";
+
+    result.resize(*written);
+    return result;
+}
+
+std::optional<size_t> Utf8::toWide(std::string_view utf8, wchar_t* out, size_t capacity) {
+    if (capacity == 0) return std::nullopt;
+
+    // Leave room for the terminator
+    auto written = toWideBuffer(utf8, out, capacity - 1);
+    if (!written) return std::nullopt;
+
+    out[*written] = L'\0';
+    return written;
+}
+
+std::optional<size_t> Utf8::fromWide(std::wstring_view wide, char* out, size_t capacity) {
+    if (capacity == 0) return std::nullopt;
+
+    auto written = fromWideBuffer(wide, out, capacity - 1);
+    if (!written) return std::nullopt;
+
+    out[*written] = '\0';
+    return written;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// UTF-8 <-> UTF-16 transcoding.
+// Everything inside the app (config, device identities) is UTF-8; wide
+// strings only exist where an OS API wants them. The converters are portable:
+// ASCII runs are handled 16/32 bytes at a time with SSE2/AVX2 where the CPU
+// has it, everything else goes through a validating scalar path. Each
+// conversion is a single pass into a buffer sized for the worst case.
+namespace Utf8 {
+    // Worst-case output sizes (in code units) for a single-pass conversion
+    constexpr size_t maxUtf16Length(size_t utf8Length) { return utf8Length; }
+    constexpr size_t maxUtf8Length(size_t utf16Length) { return utf16Length * 3; }
+
+    // Transcode into a caller buffer of at least the worst-case size. Returns
+    // the number of code units written, or nullopt on malformed input
+    // (overlong forms, surrogates encoded in UTF-8, unpaired surrogates,
+    // truncated sequences, code points above U+10FFFF).
+    std::optional<size_t> toUtf16(std::string_view utf8, char16_t* out);
+    std::optional<size_t> fromUtf16(std::u16string_view utf16, char* out);
+
+    // Same conversions without the SIMD fast paths (reference/fallback)
+    std::optional<size_t> toUtf16Scalar(std::string_view utf8, char16_t* out);
+    std::optional<size_t> fromUtf16Scalar(std::u16string_view utf16, char* out);
+
+    // Name of the fast path selected for this CPU ("avx2", "sse2", "scalar")
+    const char* implementationName();
+
+    // Convert to a newly allocated string (empty on invalid input).
+    // wchar_t is UTF-16 on Windows and UTF-32 elsewhere.
+    std::wstring toWide(std::string_view utf8);
+    std::string fromWide(std::wstring_view wide);
+
+    // Convert into a caller-supplied buffer without touching the heap.
+    // The output is null-terminated; returns the number of characters
+    // written (excluding the terminator), or nullopt if it doesn't fit or
+    // the input is malformed.
+    std::optional<size_t> toWide(std::string_view utf8, wchar_t* out, size_t capacity);
+    std::optional<size_t> fromWide(std::wstring_view wide, char* out, size_t capacity);
+
+    // Append UTF-8 text to any wide string (including std::pmr::wstring)
+    // via a stack buffer, so arena-backed strings stay allocation-free
+    template<typename WideString>
+    void appendWide(WideString& dest, std::string_view utf8) {
+        wchar_t buffer[256];
+        if (auto length = toWide(utf8, buffer, std::size(buffer))) {
+            dest.append(buffer, *length);
+        } else {
+            dest.append(toWide(utf8));
+        }
+    }
+}
@@ -1,5 +1,82 @@
 #include <windows.h>
+#include <shellapi.h>
+#include <cmath>
+#include <cwchar>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
 #include "TrayApp.h"
+#include "ConfigManager.h"
+#include "DeviceStateCache.h"
+#include "Discovery.h"
+#include "MultiSourceBackend.h"
+#include "RecordingBackend.h"
+#include "ReplayBackend.h"
+#include "SetupApiBackend.h"
+#include "StatusSegment.h"
+#include "TraceRecorder.h"
+#include "Utf8.h"
+
+namespace {
+    // A GUI-subsystem process has no console of its own: write to the
+    // redirected handle if there is one, else to the console we were
+    // started from (attached and opened once; --discover writes a line
+    // per device)
+    void writeOutput(DWORD stdHandle, std::string_view text) {
+        HANDLE out = GetStdHandle(stdHandle);
+        if (!out || out == INVALID_HANDLE_VALUE) {
+            static HANDLE parentConsole = AttachConsole(ATTACH_PARENT_PROCESS)
+                ? CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr)
+                : INVALID_HANDLE_VALUE;
+            out = parentConsole;
+        }
+        if (!out || out == INVALID_HANDLE_VALUE) {
+            return;
+        }
+
+        DWORD written = 0;
+        DWORD mode = 0;
+        if (GetConsoleMode(out, &mode)) {
+            std::wstring wide = Utf8::toWide(text);
+            WriteConsoleW(out, wide.data(), static_cast<DWORD>(wide.size()), &written, nullptr);
+        } else {
+            WriteFile(out, text.data(), static_cast<DWORD>(text.size()), &written, nullptr);  // UTF-8
+        }
+    }
+
+    // --status: print the running tray's device state from its status
+    // segment (no device enumeration); exit code 1 if no tray is running
+    int printStatus(bool json) {
+        StatusSegment::Reader reader;
+        if (!reader.isValid()) {
+            writeOutput(STD_ERROR_HANDLE, "Razer Tray is not running.\n");
+            return 1;
+        }
+        auto payload = std::make_unique<StatusSegment::Payload>();
+        if (!reader.read(*payload)) {
+            writeOutput(STD_ERROR_HANDLE, "Razer Tray is not responding.\n");
+            return 1;
+        }
+        writeOutput(STD_OUTPUT_HANDLE, json ? StatusSegment::toJson(*payload)
+                                            : StatusSegment::toText(*payload, DeviceStateCache::now()));
+        return 0;
+    }
+
+    // --discover: every device the system reports, matched against
+    // config.json, a line per device (razer-config.ps1 reads --json);
+    // sources is null when replaying
+    int discoverDevices(std::shared_ptr<DeviceBackend> backend, const MultiSourceBackend* sources, bool json) {
+        ConfigManager configMgr;
+        return Discovery::run(
+            std::move(backend), sources, configMgr.getDefaultConfigPath(), json,
+            [](std::string_view text) { writeOutput(STD_OUTPUT_HANDLE, text); },
+            [](std::string_view message) {
+                writeOutput(STD_ERROR_HANDLE, "RazerTray: " + std::string(message) + "\n");
+            });
+    }
+}
 
 // WinMain - Windows GUI application entry point
 // MinGW uses WinMain, not wWinMain
@@ -9,13 +86,90 @@ int WINAPI WinMain(
     LPSTR lpCmdLine,
     int nCmdShow)
 {
-    // Unreferenced parameters
+    // Unreferenced parameters (arguments are read wide, see below)
     (void)hPrevInstance;
     (void)lpCmdLine;
     (void)nCmdShow;
 
+    std::shared_ptr<DeviceBackend> backend;
+    std::shared_ptr<MultiSourceBackend> sources;
+    bool useDeviceCache = true;
+    bool status = false;
+    bool discover = false;
+    bool json = false;
+    double replaySpeed = 1.0;
+    std::filesystem::path recordPath;
+    std::filesystem::path replayPath;
+
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (int i = 1; argv && i < argc; i++) {
+        std::wstring_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == L"--trace") {
+            // Record from the very start (config load, first discovery);
+            // "Record Trace" in the tray menu stops and saves it
+            Trace::start();
+        } else if (arg == L"--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == L"--replay" && hasValue) {
+            replayPath = argv[++i];
+        } else if (arg == L"--replay-speed" && hasValue) {
+            wchar_t* end = nullptr;
+            replaySpeed = std::wcstod(argv[++i], &end);
+            if (end == argv[i] || *end != L'\0' || !std::isfinite(replaySpeed) || replaySpeed <= 0.0) {
+                LocalFree(argv);
+                MessageBoxW(nullptr, L"--replay-speed takes a positive number, such as 0.5 or 10.",
+                            L"Razer Tray - Replay", MB_ICONERROR | MB_OK);
+                return 1;
+            }
+        } else if (arg == L"--status") {
+            status = true;
+        } else if (arg == L"--discover") {
+            discover = true;
+        } else if (arg == L"--json") {
+            json = true;
+        }
+    }
+    LocalFree(argv);
+
+    if (status) {
+        return printStatus(json);
+    }
+
+    if (!replayPath.empty()) {
+        // Play a device recording instead of asking the system; the
+        // replayed devices must not overwrite the real last known state
+        auto replay = ReplayBackend::open(replayPath);
+        if (!replay) {
+            MessageBoxW(nullptr, L"The file given to --replay is not a device recording.",
+                        L"Razer Tray - Replay", MB_ICONERROR | MB_OK);
+            return 1;
+        }
+        replay->setSpeed(replaySpeed);
+        backend = replay;
+        useDeviceCache = false;
+    } else {
+        // Every enumerator at once, merged by hardware identity
+        sources = SetupApiBackend::systemSources();
+        backend = sources;
+        if (!recordPath.empty()) {
+            // Capture every device result for later replay (see DeviceRecording.h)
+            auto recorder = std::make_shared<RecordingBackend>(sources, recordPath);
+            if (!recorder->isRecording()) {
+                MessageBoxW(nullptr, L"Could not create the file given to --record; running without recording.",
+                            L"Razer Tray - Record", MB_ICONWARNING | MB_OK);
+            }
+            backend = recorder;
+        }
+    }
+
+    if (discover) {
+        return discoverDevices(backend, sources.get(), json);
+    }
+
     // Create and initialize the tray application
-    TrayApp app(hInstance);
+    TrayApp app(hInstance, backend, useDeviceCache, replayPath.empty() ? 1.0 : replaySpeed);
 
     if (!app.initialize()) {
         MessageBoxW(